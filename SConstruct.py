@@ -90,6 +90,15 @@ elif build_mode == "release":
 else:
     raise ValueError("Unknown build mode %s" % build_mode)
 
+# Enables UNI_PROFILE_ZONE instrumentation. Zones compile to nothing otherwise.
+if ARGUMENTS.get("profile", "0") == "1":
+    env.Append(CPPDEFINES="UNI_PROFILER")
+
+# Minimum log level compiled in, from 0 (trace) to 6 (off). Calls to
+# UNI_LOG_* below this level compile to nothing. See src/util/log.hpp.
+if "log_level" in ARGUMENTS:
+    env.Append(CPPDEFINES=[("UNI_LOG_MIN_LEVEL", ARGUMENTS["log_level"])])
+
 variant_dir = "bin/obj/"
 variant_dir_src = "%s/src" % variant_dir
 variant_dir_include = "%s/include" % variant_dir
@@ -102,10 +111,29 @@ for root, dirs, files in os.walk("src"):
 for root, dirs, files in os.walk("include"):
     sources.append(Glob("%s/%s/*.cpp" % (variant_dir, root)))
 
+objects = env.Object(sources)
+
 binary_path = "./%s" % (binary_name)
 binary_file_path = binary_path + binary_ext
 build = env.Program(
     target=binary_path,
-    source=sources,
+    source=objects,
+)
+Default(build)
+
+# Tests link every object except the editor's entry point.
+# Build them with `scons tests`, in any mode.
+variant_dir_tests = "%s/tests" % variant_dir
+env.VariantDir(variant_dir_tests, "tests", duplicate=0)
+main_object_path = os.path.normpath("%s/src/main" % variant_dir)
+test_objects = [
+    obj for obj in objects
+    if os.path.splitext(os.path.normpath(str(obj)))[0] != main_object_path
+]
+test_objects.append(env.Object(Glob("%s/*.cpp" % variant_dir_tests)))
+tests = env.Program(
+    target="./%s_tests" % (binary_name),
+    source=test_objects,
 )
+Alias("tests", tests)
 
@@ -1,22 +1,63 @@
 #include "app.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <thread>
+
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
 #include "rlImGui.h"
 #include "imgui.h"
-#include "spdlog/spdlog.h"
+
+#include "import/mesh_import.hpp"
+#include "level/level_file.hpp"
+#include "util/log.hpp"
 
 int app_message = 0;
 
+// Names of level journal entries, interned at startup like other
+// names, before the symbol table is frozen
+static const Symbol App_DeleteEntitiesName = Symbol("Delete Entities");
+static const Symbol App_ImportMeshesName = Symbol("Import Meshes");
+
 App::App() {
     this->input = InputController(this);
     this->gui_context = GUIContext(this);
     this->gui_command_palette = GUICommandPalette(this, &this->gui_context);
+    this->gui_log_console = GUILogConsole(this, &this->gui_context);
+    this->gui_profiler_overlay = GUIProfilerOverlay(
+        this, &this->gui_context, &this->profiler
+    );
+    this->gui_task_progress = GUITaskProgress(
+        this, &this->gui_context, &this->tasks
+    );
+    this->gui_asset_browser = GUIAssetBrowser(
+        this, &this->gui_context, &this->asset_thumbnailer, &this->thumbnail_atlas
+    );
+    this->tasks = TaskRunner(&this->jobs);
+    this->level_bvh = LevelBvh(&this->jobs);
+    this->level_culler = LevelCuller(&this->jobs);
+    this->level_vertex_hash = LevelVertexHash(&this->jobs);
+    this->render_batcher = RenderBatcher(&this->jobs);
+    this->csg = CsgCompiler(&this->jobs);
+    this->lightmap_baker = LightmapBaker(&this->jobs);
+    this->level_journal = LevelJournal(&this->level, &this->jobs);
+    this->level_exporter = LevelExporter(&this->jobs);
+    this->level_autosaver = LevelAutosaver(&this->jobs);
+    this->level_autosaver.path = this->level_autosave_path;
+    this->asset_thumbnailer = AssetThumbnailer(&this->jobs);
 }
 
 void App::init() {
+    Log_Init();
     // TODO: make configurable
-    spdlog::set_level(spdlog::level::trace);
+    Log_SetLevelAll(LogLevel_Trace);
+    this->profiler.init();
+    this->frame_arena.init(1 << 20);
+    this->jobs.init();
     // Raylib window setup
     // TODO: remember window size and position
     RaylibInitWindow(1280, 720, "Unilevel");
@@ -24,25 +65,216 @@ void App::init() {
     RaylibSetWindowState(RAYLIB_FLAG_WINDOW_RESIZABLE);
     RaylibSetExitKey(RAYLIB_KEY_NULL); // TODO uncomment
     RaylibSetTargetFPS(60); // TODO: make configurable
+    this->camera = RaylibCamera3D{};
+    this->camera.position = RaylibVector3{0.0f, 16.0f, 32.0f};
+    this->camera.target = RaylibVector3{0.0f, 0.0f, 0.0f};
+    this->camera.up = RaylibVector3{0.0f, 1.0f, 0.0f};
+    this->camera.fovy = 60.0f;
+    this->camera.projection = RAYLIB_CAMERA_PERSPECTIVE;
+    this->render_batcher.init();
     // ImGui setup
     rlImGuiSetup(true);
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags = ImGuiConfigFlags_NavNoCaptureKeyboard; // ?
     // InputController setup
     this->input.push_context(InputContext_General);
+    // The BVH, exporter and vertex hash follow edits through the
+    // journal, and the selection drops entities as they are destroyed
+    this->level_journal.listeners.push_back([this](const LevelHandle* handles, uint32_t count) {
+        this->level_bvh.mark_changed(handles, count);
+        this->level_exporter.mark_changed(handles, count);
+        this->level_vertex_hash.mark_changed(handles, count);
+        this->level_selection.remove_invalid(this->level, handles, count);
+    });
     // Initialize components
     this->gui_context.init(); // Loads fonts
     this->gui_command_palette.init();
+    this->gui_log_console.init();
+    this->gui_asset_browser.init();
+    const InputActionHandle action_undo = this->input.add_action(InputAction{
+        "level_undo",
+        InputContext_General,
+        [this](InputAction* action) { this->level_journal.undo(); }
+    });
+    const InputActionHandle action_redo = this->input.add_action(InputAction{
+        "level_redo",
+        InputContext_General,
+        [this](InputAction* action) { this->level_journal.redo(); }
+    });
+    const InputActionHandle action_pick = this->input.add_action(InputAction{
+        "level_pick",
+        InputContext_General,
+        [this](InputAction* action) {
+            if(ImGui::GetIO().WantCaptureMouse) {
+                return;
+            }
+            const RaylibRay mouse_ray = RaylibGetMouseRay(RaylibGetMousePosition(), this->camera);
+            const Ray3 ray = Ray3{
+                Vec3{mouse_ray.position.x, mouse_ray.position.y, mouse_ray.position.z},
+                Vec3{mouse_ray.direction.x, mouse_ray.direction.y, mouse_ray.direction.z}
+            };
+            LevelRayHit hit;
+            this->level_bvh.raycast(this->level, ray, &hit);
+            this->level_picked = hit.handle;
+            UNI_LOG_DEBUG(
+                LogSubsystem_Level, "Picked entity {} at distance {}.",
+                hit.handle.index, hit.distance
+            );
+        }
+    });
+    // TODO: Don't hardcode keybinds
+    this->input.add_action_key_bind(InputActionKeyBind(action_pick, "MouseLeft"));
+    this->input.add_action_key_bind(InputActionKeyBind(action_undo, "Ctrl+Z"));
+    this->input.add_action_key_bind(InputActionKeyBind(action_redo, "Ctrl+Y"));
+    this->input.add_action_key_bind(InputActionKeyBind(action_redo, "Ctrl+Shift+Z"));
     // TODO: don't
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Save Level",
+        "Writes the level to its level file.",
+        [this]() { LevelFile_SaveOver(&this->level, this->level_path.c_str()); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Reopen Level",
+        "Discards unsaved changes and opens the level file again.",
+        [this]() {
+            // Thumbnails in progress read the meshes being replaced
+            this->gui_asset_browser.reset();
+            LevelFile_Open(&this->level, this->level_path.c_str());
+            this->level_journal.clear();
+        }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Undo",
+        "Reverts the most recent change to the level.",
+        [this]() { this->level_journal.undo(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Redo",
+        "Reapplies the most recently undone change to the level.",
+        [this]() { this->level_journal.redo(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Export Level Sectors",
+        "Writes the level as sector files, for streaming, rewriting only sectors changed since the last export.",
+        [this]() {
+            this->level_exporter.directory = this->level_sectors_path;
+            this->level_exporter.export_changes(this->level);
+        }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Toggle Autosave",
+        "Writes changes to the level's autosave file in the background every minute.",
+        [this]() { this->level_autosaver.enabled = !this->level_autosaver.enabled; }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Toggle Vertex Snapping",
+        "Snaps the cursor to the nearest level vertex near the point under it.",
+        [this]() { this->snapping_enabled = !this->snapping_enabled; }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Select All",
+        "Selects every entity which isn't hidden or locked.",
+        [this]() { this->level_selection.select_all(this->level, &this->jobs); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Select None",
+        "Clears the selection.",
+        [this]() { this->level_selection.clear(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Invert Selection",
+        "Selects the entities which aren't selected, hidden, or locked, and deselects the rest.",
+        [this]() { this->level_selection.invert(this->level, &this->jobs); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Delete Selected Entities",
+        "Destroys every selected entity, as one change which can be undone.",
+        [this]() { this->delete_selection(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Add CSG Box Brush",
+        "Adds a solid box brush in front of the camera.",
+        [this]() { this->add_csg_box(CsgOperation_Add); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Subtract CSG Box Brush",
+        "Carves a box out of the brushes in front of the camera.",
+        [this]() { this->add_csg_box(CsgOperation_Subtract); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Clear CSG Brushes",
+        "Removes every brush and its compiled geometry.",
+        [this]() { this->csg.clear(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Toggle Lightmap Baking",
+        "Bakes light onto CSG geometry in the background, refining as it goes.",
+        [this]() {
+            this->lightmaps_enabled = !this->lightmaps_enabled;
+            if(!this->lightmaps_enabled) {
+                this->lightmap_baker.cancel();
+            }
+        }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Add Lightmap Light at Camera",
+        "Adds a point light where the camera is, and bakes lightmaps again.",
+        [this]() {
+            this->lightmap_baker.lights.push_back(LightmapLight{
+                Vec3{this->camera.position.x, this->camera.position.y, this->camera.position.z},
+                Vec3{60.0f, 56.0f, 48.0f}
+            });
+            this->lightmap_baker.reset();
+        }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Toggle Log Console",
+        "Shows or hides recent log messages, with filtering and search.",
+        [this]() { this->gui_log_console.toggle(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Toggle Asset Browser",
+        "Shows or hides thumbnails of the level's meshes.",
+        [this]() { this->gui_asset_browser.toggle(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Toggle Profiler Overlay",
+        "Shows or hides frame timings and the zone flame graph.",
+        [this]() { this->gui_profiler_overlay.toggle(); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Export Profiler Capture as Chrome Trace JSON",
+        "Writes recorded frames to profiler_capture.json, for chrome://tracing or Perfetto.",
+        [this]() { this->profiler.export_chrome_trace("profiler_capture.json"); }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Increase UI Scale",
+        "Makes text and other GUI elements larger.",
+        [this]() {
+            this->gui_context.set_ui_scale(this->gui_context.ui_scale + 0.125f);
+        }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Decrease UI Scale",
+        "Makes text and other GUI elements smaller.",
+        [this]() {
+            this->gui_context.set_ui_scale(this->gui_context.ui_scale - 0.125f);
+        }
+    });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        "Reset UI Scale",
+        "Sizes GUI elements according to the monitor's DPI only.",
+        [this]() { this->gui_context.set_ui_scale(1.0f); }
+    });
     this->gui_command_palette.add_command(GUICommandPaletteCommand{
         "Print Hello World Message",
         "Prints hello world text to stdout.",
-        []() { spdlog::info("Hello, world!"); }
+        []() { UNI_LOG_INFO(LogSubsystem_General, "Hello, world!"); }
     });
     this->gui_command_palette.add_command(GUICommandPaletteCommand{
         "Print Goodbye Message",
         "Prints goodbye text to stdout.",
-        []() { spdlog::info("Goodbye."); }
+        []() { UNI_LOG_INFO(LogSubsystem_General, "Goodbye."); }
     });
     this->gui_command_palette.add_command(GUICommandPaletteCommand{
         "Set Test GUI Message to Hello World",
@@ -59,6 +291,24 @@ void App::init() {
         "Sets the ImGui test message text to an alphabetical test.",
         []() { app_message = 2; }
     });
+    this->gui_command_palette.add_command(GUICommandPaletteCommand{
+        .name = "Run Test Background Task",
+        .summary = "Runs a slow cancellable task in the background, showing its progress.",
+        .activated_task = [](TaskContext* task) -> Task {
+            const int step_count = 20;
+            for(int i = 0; i < step_count && !task->is_cancelled(); ++i) {
+                task->set_status(fmt::format("Step {} of {}", i + 1, step_count));
+                co_await task->background([]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+                });
+                task->set_progress((float) (i + 1) / (float) step_count);
+            }
+            UNI_LOG_INFO(LogSubsystem_General, "Test background task done.");
+        }
+    });
+    // Names known at startup have been interned by now. Later
+    // lookups of them take no locks.
+    Symbol_Freeze();
 }
 
 bool App::done() {
@@ -66,11 +316,64 @@ bool App::done() {
 }
 
 void App::update() {
+    this->profiler.begin_frame();
+    this->frame_arena.reset();
+    // Completion callbacks for background jobs run here, between
+    // frames, so they may safely replace GUI and GPU resources.
+    this->jobs.update();
+    this->tasks.update();
+    // No edits are in progress between frames, so the level can be
+    // frozen for autosaving here
+    this->level_autosaver.update(this->level, RaylibGetTime());
+    this->asset_thumbnailer.update();
+    this->gui_context.update();
+    if(RaylibIsFileDropped()) {
+        RaylibFilePathList files = RaylibLoadDroppedFiles();
+        for(unsigned int i = 0; i < files.count; ++i) {
+            this->import_meshes(files.paths[i]);
+        }
+        RaylibUnloadDroppedFiles(files);
+    }
+    {
+        // Mouselook lasts while the right button is held, even if
+        // the cursor passes over a window
+        const bool mouselooking = this->input.get_current_context() == InputContext_Mouselook;
+        if(
+            RaylibIsMouseButtonDown(RAYLIB_MOUSE_BUTTON_RIGHT) &&
+            (mouselooking || !ImGui::GetIO().WantCaptureMouse)
+        ) {
+            if(!mouselooking) {
+                this->input.push_context(InputContext_Mouselook);
+            }
+            RaylibUpdateCamera(&this->camera, RAYLIB_CAMERA_FREE);
+        } else if(mouselooking) {
+            this->input.pop_context(InputContext_Mouselook);
+        }
+    }
+    this->level_bvh.update(this->level);
+    this->level_vertex_hash.update(this->level);
+    this->update_snap();
+    this->csg.update();
+    if(this->lightmaps_enabled) {
+        if(this->lightmap_sources_revision != this->csg.revision) {
+            this->lightmap_sources_revision = this->csg.revision;
+            std::vector<LightmapSource> sources;
+            Lightmap_GatherCsgSources(this->csg, this->lightmap_baker, &sources);
+            this->lightmap_baker.set_sources(std::move(sources));
+        }
+        this->lightmap_baker.update();
+    }
     RaylibBeginDrawing();
-    rlImGuiBegin();
+    {
+        UNI_PROFILE_ZONE("rlImGuiBegin");
+        rlImGuiBegin();
+    }
     this->input.update();
+    this->update_selection();
     this->gui_command_palette.update();
     RaylibClearBackground(RaylibColor{32, 24, 24});
+    this->draw_level();
+    this->draw_selection_drag();
     ImGui::PushFont(this->gui_context.font_normal);
     ImGui::TextColored(
         ImVec4(RaylibIsKeyDown(RAYLIB_KEY_TAB) ? 0.1 : 0.9, 0.9, 0.9, 1),
@@ -83,13 +386,376 @@ void App::update() {
     );
     ImGui::PopFont();
     this->gui_command_palette.draw();
-    rlImGuiEnd();
-    RaylibEndDrawing();
+    this->gui_task_progress.draw();
+    this->gui_log_console.draw();
+    this->gui_asset_browser.draw();
+    this->gui_profiler_overlay.draw();
+    {
+        UNI_PROFILE_ZONE("rlImGuiEnd");
+        rlImGuiEnd();
+    }
+    {
+        // Includes waiting for vsync or the target frame rate
+        UNI_PROFILE_ZONE("RaylibEndDrawing");
+        RaylibEndDrawing();
+    }
+    this->profiler.end_frame();
+}
+
+void App::update_snap() {
+    UNI_PROFILE_ZONE("App::update_snap");
+    this->level_snap_found = false;
+    if(!this->snapping_enabled) {
+        return;
+    }
+    const bool mouselooking = this->input.get_current_context() == InputContext_Mouselook;
+    if(!mouselooking && ImGui::GetIO().WantCaptureMouse) {
+        return;
+    }
+    // Mouselook hides the cursor, so aim with the middle of the view
+    const RaylibVector2 screen_point = mouselooking ? RaylibVector2{
+        (float) RaylibGetScreenWidth() * 0.5f, (float) RaylibGetScreenHeight() * 0.5f
+    } : RaylibGetMousePosition();
+    const RaylibRay screen_ray = RaylibGetMouseRay(screen_point, this->camera);
+    const Ray3 ray = Ray3{
+        Vec3{screen_ray.position.x, screen_ray.position.y, screen_ray.position.z},
+        Vec3{screen_ray.direction.x, screen_ray.direction.y, screen_ray.direction.z}
+    };
+    LevelRayHit hit;
+    if(!this->level_bvh.raycast(this->level, ray, &hit)) {
+        return;
+    }
+    LevelVertexHit vertex;
+    if(this->level_vertex_hash.find_nearest(ray.get_point(hit.distance), 1, this->snap_distance, &vertex) > 0) {
+        this->level_snap_found = true;
+        this->level_snap_point = vertex.position;
+    }
+}
+
+void App::update_selection() {
+    UNI_PROFILE_ZONE("App::update_selection");
+    const RaylibVector2 mouse = RaylibGetMousePosition();
+    const Vec2 point = Vec2{mouse.x, mouse.y};
+    if(!this->selection_dragging) {
+        if(
+            RaylibIsMouseButtonPressed(RAYLIB_MOUSE_BUTTON_LEFT) &&
+            this->input.get_current_context() == InputContext_General &&
+            !ImGui::GetIO().WantCaptureMouse
+        ) {
+            this->selection_dragging = true;
+            this->selection_lasso = RaylibIsKeyDown(RAYLIB_KEY_LEFT_ALT) || RaylibIsKeyDown(RAYLIB_KEY_RIGHT_ALT);
+            this->selection_drag_start = point;
+            this->selection_lasso_points.clear();
+            this->selection_lasso_points.push_back(point);
+        }
+        return;
+    }
+    if(this->selection_lasso) {
+        // Points closer together than this only add work
+        const Vec2& last = this->selection_lasso_points.back();
+        if(std::abs(point.x - last.x) + std::abs(point.y - last.y) >= 4.0f) {
+            this->selection_lasso_points.push_back(point);
+        }
+    }
+    if(RaylibIsMouseButtonDown(RAYLIB_MOUSE_BUTTON_LEFT)) {
+        return;
+    }
+    this->selection_dragging = false;
+    LevelSelection selected;
+    const Vec2 start = this->selection_drag_start;
+    if(std::abs(point.x - start.x) + std::abs(point.y - start.y) < 4.0f) {
+        // A click selects the entity the pick action found under it
+        const uint32_t row = this->level.get_row(this->level_picked);
+        if(row != LevelRow_None && !(this->level.flags[row] & (LevelEntityFlags_Hidden | LevelEntityFlags_Locked))) {
+            selected.add(this->level_picked);
+        }
+    } else if(this->selection_lasso) {
+        selected.select_lasso(
+            this->level,
+            this->level_bvh,
+            this->get_select_view(),
+            this->selection_lasso_points.data(),
+            (uint32_t) this->selection_lasso_points.size(),
+            &this->jobs
+        );
+    } else {
+        selected.select_box(this->level, this->level_bvh, this->get_select_view(), start, point, &this->jobs);
+    }
+    // Shift adds to the selection, and Ctrl removes from it
+    if(RaylibIsKeyDown(RAYLIB_KEY_LEFT_CONTROL) || RaylibIsKeyDown(RAYLIB_KEY_RIGHT_CONTROL)) {
+        this->level_selection.subtract(selected);
+    } else if(RaylibIsKeyDown(RAYLIB_KEY_LEFT_SHIFT) || RaylibIsKeyDown(RAYLIB_KEY_RIGHT_SHIFT)) {
+        this->level_selection.unite(selected);
+    } else {
+        this->level_selection = std::move(selected);
+    }
+}
+
+void App::draw_selection_drag() {
+    if(!this->selection_dragging) {
+        return;
+    }
+    ImDrawList* draw_list = ImGui::GetForegroundDrawList();
+    const ImU32 color = IM_COL32(64, 220, 255, 255);
+    if(this->selection_lasso) {
+        const uint32_t count = (uint32_t) this->selection_lasso_points.size();
+        ImVec2* points = this->frame_arena.allocate_array<ImVec2>(count);
+        for(uint32_t i = 0; i < count; ++i) {
+            points[i] = ImVec2(this->selection_lasso_points[i].x, this->selection_lasso_points[i].y);
+        }
+        draw_list->AddPolyline(points, (int) count, color, ImDrawFlags_Closed, 1.0f);
+        return;
+    }
+    const RaylibVector2 mouse = RaylibGetMousePosition();
+    const Vec2 start = this->selection_drag_start;
+    const ImVec2 box_min = ImVec2(std::min(start.x, mouse.x), std::min(start.y, mouse.y));
+    const ImVec2 box_max = ImVec2(std::max(start.x, mouse.x), std::max(start.y, mouse.y));
+    draw_list->AddRectFilled(box_min, box_max, IM_COL32(64, 220, 255, 32));
+    draw_list->AddRect(box_min, box_max, color);
+}
+
+LevelSelectView App::get_select_view() {
+    LevelSelectView view;
+    view.position = Vec3{this->camera.position.x, this->camera.position.y, this->camera.position.z};
+    view.forward = Vec3{this->camera.target.x, this->camera.target.y, this->camera.target.z} - view.position;
+    view.up = Vec3{this->camera.up.x, this->camera.up.y, this->camera.up.z};
+    view.fovy = this->camera.fovy * std::numbers::pi_v<float> / 180.0f;
+    view.near_distance = RL_CULL_DISTANCE_NEAR;
+    view.far_distance = RL_CULL_DISTANCE_FAR;
+    view.width = (float) std::max(1, RaylibGetScreenWidth());
+    view.height = (float) std::max(1, RaylibGetScreenHeight());
+    return view;
+}
+
+void App::delete_selection() {
+    std::vector<LevelHandle> handles;
+    this->level_selection.get_handles(this->level, &handles);
+    if(handles.empty()) {
+        return;
+    }
+    this->level_journal.begin(App_DeleteEntitiesName);
+    this->level_journal.record_destroy(handles.data(), (uint32_t) handles.size());
+    for(const LevelHandle handle : handles) {
+        this->level.destroy(handle);
+    }
+    this->level_journal.commit();
+    UNI_LOG_INFO(LogSubsystem_Level, "Deleted {} entities.", handles.size());
+}
+
+static void App_DrawBoundsWires(const Bounds3& bounds, RaylibColor color) {
+    const Vec3 center = bounds.get_center();
+    const Vec3 size = bounds.max - bounds.min;
+    RaylibDrawCubeWiresV(
+        RaylibVector3{center.x, center.y, center.z},
+        RaylibVector3{size.x, size.y, size.z},
+        color
+    );
+}
+
+void App::draw_level() {
+    UNI_PROFILE_ZONE("App::draw_level");
+    const Vec3 position = Vec3{
+        this->camera.position.x, this->camera.position.y, this->camera.position.z
+    };
+    const Vec3 target = Vec3{
+        this->camera.target.x, this->camera.target.y, this->camera.target.z
+    };
+    const Frustum3 frustum = Frustum3_FromPerspective(
+        position,
+        target - position,
+        Vec3{this->camera.up.x, this->camera.up.y, this->camera.up.z},
+        this->camera.fovy * std::numbers::pi_v<float> / 180.0f,
+        (float) RaylibGetScreenWidth() / (float) std::max(1, RaylibGetScreenHeight()),
+        RL_CULL_DISTANCE_NEAR,
+        RL_CULL_DISTANCE_FAR
+    );
+    this->level_culler.cull(this->level, frustum);
+    const auto& visible_rows = this->level_culler.get_visible_rows();
+    this->render_batcher.prepare(this->level, visible_rows.data(), (uint32_t) visible_rows.size());
+    RaylibBeginMode3D(this->camera);
+    if(!this->render_batcher.draw(this->level)) {
+        for(const uint32_t row : visible_rows) {
+            App_DrawBoundsWires(this->level.get_bounds(row), RaylibColor{160, 160, 170, 255});
+        }
+    }
+    this->draw_csg();
+    if(!this->level_selection.empty()) {
+        for(const uint32_t row : visible_rows) {
+            if(this->level_selection.contains(this->level.get_handle(row))) {
+                App_DrawBoundsWires(this->level.get_bounds(row), RaylibColor{64, 220, 255, 255});
+            }
+        }
+    }
+    const uint32_t picked_row = this->level.get_row(this->level_picked);
+    if(picked_row != LevelRow_None) {
+        App_DrawBoundsWires(this->level.get_bounds(picked_row), RaylibColor{255, 200, 64, 255});
+    }
+    if(this->level_snap_found) {
+        // Sized to look the same at any distance
+        const Vec3 offset = this->level_snap_point - position;
+        RaylibDrawSphere(
+            RaylibVector3{this->level_snap_point.x, this->level_snap_point.y, this->level_snap_point.z},
+            0.008f * Vec3_Length(offset),
+            RaylibColor{64, 220, 255, 255}
+        );
+    }
+    RaylibEndMode3D();
+}
+
+void App::draw_csg() {
+    UNI_PROFILE_ZONE("App::draw_csg");
+    const auto& regions = this->csg.get_regions();
+    if(
+        this->csg_draws_revision != this->csg.revision ||
+        this->csg_draws_lightmap_revision != this->lightmap_baker.revision
+    ) {
+        this->csg_draws_revision = this->csg.revision;
+        this->csg_draws_lightmap_revision = this->lightmap_baker.revision;
+        std::erase_if(this->csg_draws, [this, &regions](auto& entry) {
+            if(regions.contains(entry.first)) {
+                return false;
+            }
+            this->unload_csg_draw(&entry.second);
+            return true;
+        });
+        std::vector<uint8_t> pixels;
+        for(const auto& [key, region] : regions) {
+            AppCsgRegionDraw& draw = this->csg_draws[key];
+            // Regions are drawn with their lightmap page's mesh once
+            // it has been baked from the current one
+            const LightmapPage* page = this->lightmap_baker.find_page(key);
+            const bool lightmapped = page && page->signature == region->mesh_revision;
+            if(draw.mesh_revision != region->mesh_revision || draw.lightmapped != lightmapped) {
+                this->unload_csg_draw(&draw);
+                draw.mesh_revision = region->mesh_revision;
+                draw.lightmapped = lightmapped;
+                const LevelMesh& mesh = lightmapped ? page->mesh : region->mesh.render;
+                if(!mesh.indices.empty()) {
+                    draw.mesh = RenderMesh_Upload(mesh);
+                }
+            }
+            if(!lightmapped || draw.lightmap_revision == page->revision) {
+                continue;
+            }
+            draw.lightmap_revision = page->revision;
+            pixels.resize((size_t) page->width * page->height * 4);
+            page->get_pixels(this->lightmap_baker.settings.exposure, pixels.data());
+            if(draw.lightmap_texture) {
+                rlUpdateTexture(
+                    draw.lightmap_texture, 0, 0, (int) page->width, (int) page->height,
+                    RL_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, pixels.data()
+                );
+                continue;
+            }
+            draw.lightmap_texture = rlLoadTexture(
+                pixels.data(), (int) page->width, (int) page->height,
+                RL_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1
+            );
+            rlTextureParameters(draw.lightmap_texture, RL_TEXTURE_MIN_FILTER, RL_TEXTURE_FILTER_LINEAR);
+            rlTextureParameters(draw.lightmap_texture, RL_TEXTURE_MAG_FILTER, RL_TEXTURE_FILTER_LINEAR);
+            rlTextureParameters(draw.lightmap_texture, RL_TEXTURE_WRAP_S, RL_TEXTURE_WRAP_CLAMP);
+            rlTextureParameters(draw.lightmap_texture, RL_TEXTURE_WRAP_T, RL_TEXTURE_WRAP_CLAMP);
+        }
+    }
+    const float grey[4] = {0.7f, 0.7f, 0.72f, 1.0f};
+    for(const auto& [key, draw] : this->csg_draws) {
+        const CsgRegion* region = regions.at(key).get();
+        for(const auto& range : region->mesh.material_ranges) {
+            const float* color = (
+                range.material < this->level.material_assets.size() ?
+                this->level.material_assets[range.material].color : grey
+            );
+            if(!this->render_batcher.draw_mesh(
+                draw.mesh, (int) range.first_index, (int) range.index_count, color,
+                draw.lightmapped ? draw.lightmap_texture : 0
+            )) {
+                return;
+            }
+        }
+    }
+}
+
+void App::unload_csg_draw(AppCsgRegionDraw* draw) {
+    RenderMesh_Unload(&draw->mesh);
+    if(draw->lightmap_texture) {
+        rlUnloadTexture(draw->lightmap_texture);
+    }
+    *draw = AppCsgRegionDraw();
+}
+
+void App::add_csg_box(CsgOperation operation) {
+    const Vec3 position = Vec3{
+        this->camera.position.x, this->camera.position.y, this->camera.position.z
+    };
+    const Vec3 target = Vec3{
+        this->camera.target.x, this->camera.target.y, this->camera.target.z
+    };
+    // Snap to whole units, so that boxes placed near each other
+    // line up
+    const Vec3 ahead = position + Vec3_Normalize(target - position) * 8.0f;
+    const Vec3 center = Vec3{std::round(ahead.x), std::round(ahead.y), std::round(ahead.z)};
+    const Vec3 half_size = Vec3{2.0f, 2.0f, 2.0f};
+    this->csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{center - half_size, center + half_size}, operation, LevelMaterialId_None
+    ));
+}
+
+void App::import_meshes(std::string path) {
+    if(Import_GetFormat(path) == ImportFormat_Unknown) {
+        UNI_LOG_WARN(LogSubsystem_Assets, "Can't import '{}': unknown file type.", path);
+        return;
+    }
+    this->tasks.start(fmt::format("Import {}", path), [this, path](TaskContext* task) {
+        return this->import_meshes_task(task, path);
+    });
+}
+
+Task App::import_meshes_task(TaskContext* task, std::string path) {
+    task->set_status(fmt::format("Reading {}", path));
+    auto meshes = std::make_shared<std::vector<LevelMesh>>();
+    auto imported = std::make_shared<bool>(false);
+    co_await task->background([this, path, meshes, imported]() {
+        *imported = Import_Meshes(path.c_str(), &this->jobs, meshes.get());
+    });
+    if(!*imported || task->is_cancelled()) {
+        co_return;
+    }
+    const Vec3 position = Vec3{
+        this->camera.position.x, this->camera.position.y, this->camera.position.z
+    };
+    const Vec3 target = Vec3{
+        this->camera.target.x, this->camera.target.y, this->camera.target.z
+    };
+    LevelEntityDesc desc;
+    desc.position = position + Vec3_Normalize(target - position) * 8.0f;
+    // Meshes are moved into the document, keeping their arrays
+    this->level_journal.begin(App_ImportMeshesName);
+    for(auto& mesh : *meshes) {
+        desc.mesh = this->level.add_mesh(std::move(mesh));
+        this->level_journal.record_create(this->level.create(desc));
+    }
+    this->level_journal.commit();
 }
 
 int App::conclude() {
+    this->tasks.cancel_all();
+    this->level_journal.clear();
+    this->level_bvh.cancel();
+    this->csg.cancel();
+    this->lightmap_baker.cancel();
+    this->level_autosaver.cancel();
+    this->gui_asset_browser.conclude();
+    this->jobs.conclude();
+    this->tasks.conclude();
+    this->gui_context.conclude();
+    for(auto& [key, draw] : this->csg_draws) {
+        this->unload_csg_draw(&draw);
+    }
+    this->csg_draws.clear();
+    this->render_batcher.conclude();
     rlImGuiShutdown();
     RaylibCloseWindow();
+    Log_Conclude();
     return 0;
 }
 
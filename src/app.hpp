@@ -1,14 +1,123 @@
 #pragma once
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "raylib.h"
+
+#include "assets/thumbnail.hpp"
+#include "csg/compiler.hpp"
+#include "gui/asset_browser.hpp"
 #include "gui/command_palette.hpp"
 #include "gui/context.hpp"
+#include "gui/log_console.hpp"
+#include "gui/profiler_overlay.hpp"
+#include "gui/task_progress.hpp"
 #include "input/controller.hpp"
+#include "jobs/job_system.hpp"
+#include "jobs/task.hpp"
+#include "level/autosave.hpp"
+#include "level/bvh.hpp"
+#include "level/culling.hpp"
+#include "level/document.hpp"
+#include "level/exporter.hpp"
+#include "level/journal.hpp"
+#include "level/selection.hpp"
+#include "level/vertex_hash.hpp"
+#include "lightmap/baker.hpp"
+#include "render/batcher.hpp"
+#include "render/thumbnail_atlas.hpp"
+#include "util/arena.hpp"
+#include "util/math.hpp"
+#include "util/profiler.hpp"
+
+// GPU copies of one compiled CSG region.
+struct AppCsgRegionDraw {
+    // CsgRegion::mesh_revision of the mesh uploaded
+    uint64_t mesh_revision = 0;
+    // Set when the mesh uploaded is the region's lightmap page's,
+    // whose uvs address the lightmap texture
+    bool lightmapped = false;
+    RenderMesh mesh;
+    uint32_t lightmap_texture = 0;
+    // LightmapPage::revision of the texture uploaded
+    uint64_t lightmap_revision = 0;
+};
 
 class App {
 public:
     InputController input;
     GUIContext gui_context;
     GUICommandPalette gui_command_palette;
+    GUILogConsole gui_log_console;
+    GUIProfilerOverlay gui_profiler_overlay;
+    GUITaskProgress gui_task_progress;
+    GUIAssetBrowser gui_asset_browser;
+    Profiler profiler;
+    JobSystem jobs;
+    TaskRunner tasks;
+    // The level being edited
+    LevelDocument level;
+    // Answers raycasts against the level, such as for picking
+    LevelBvh level_bvh;
+    // Finds the entities in view of the camera, for drawing
+    LevelCuller level_culler;
+    // Draws visible entities with instancing
+    RenderBatcher render_batcher;
+    // Compiles level geometry made of brushes
+    CsgCompiler csg;
+    // Uploaded meshes of each CSG region, by region key
+    std::unordered_map<uint64_t, AppCsgRegionDraw> csg_draws;
+    // CsgCompiler::revision and LightmapBaker::revision when
+    // csg_draws was last updated
+    uint64_t csg_draws_revision = 0;
+    uint64_t csg_draws_lightmap_revision = 0;
+    // Bakes lightmaps for the CSG regions while enabled
+    LightmapBaker lightmap_baker;
+    bool lightmaps_enabled = false;
+    // CsgCompiler::revision when the baker's sources were last set
+    uint64_t lightmap_sources_revision = 0;
+    // Entity last clicked in the 3D view
+    LevelHandle level_picked = LevelHandle_None;
+    // Entities selected by clicking, or by box or lasso
+    LevelSelection level_selection;
+    // Set while the left mouse button is dragged over the 3D view,
+    // with Alt held for a lasso
+    bool selection_dragging = false;
+    bool selection_lasso = false;
+    Vec2 selection_drag_start;
+    std::vector<Vec2> selection_lasso_points;
+    // Finds level vertexes near the cursor, for snapping to them
+    LevelVertexHash level_vertex_hash;
+    bool snapping_enabled = true;
+    // Vertexes this near the point under the cursor are snapped to
+    float snap_distance = 0.5f;
+    // Vertex the cursor snaps to, if one was found this frame
+    bool level_snap_found = false;
+    Vec3 level_snap_point;
+    // Undo and redo history for the level
+    LevelJournal level_journal;
+    // Where the level is saved, and opened from
+    std::string level_path = "levels/untitled.unilevel";
+    // Where the level's sectors are written to, for streaming
+    std::string level_sectors_path = "levels/untitled_sectors";
+    // Writes sectors changed since the last export
+    LevelExporter level_exporter;
+    // Where the level is autosaved to, apart from its level file
+    std::string level_autosave_path = "levels/untitled.autosave.unilevel";
+    // Autosaves the level in the background every so often
+    LevelAutosaver level_autosaver;
+    // Draws and caches thumbnails of the level's meshes
+    AssetThumbnailer asset_thumbnailer;
+    // GPU copies of the thumbnails shown recently
+    RenderThumbnailAtlas thumbnail_atlas;
+    // Viewpoint for the 3D view. Flies while the right mouse
+    // button is held.
+    RaylibCamera3D camera;
+    // Memory for data which only lives until the end of the frame.
+    // Reset at the top of update.
+    Arena frame_arena;
     
     App();
     
@@ -18,6 +127,31 @@ public:
     bool done();
     // Runs once per frame.
     void update();
+    // Find the level vertex to snap to under the cursor, or under
+    // the middle of the view while mouselooking.
+    void update_snap();
+    // Follow box and lasso drags, and update the selection when
+    // one ends, or when an entity is clicked.
+    void update_selection();
+    // Draw the outline of the box or lasso being dragged.
+    void draw_selection_drag();
+    // Get the view selections are dragged in, matching the camera.
+    LevelSelectView get_select_view();
+    // Destroy the selected entities, as one undoable change.
+    void delete_selection();
+    // Draw the entities in view of the camera.
+    void draw_level();
+    // Upload changed CSG regions and lightmaps, and draw every
+    // region.
+    void draw_csg();
+    // Free the GPU copies of a CSG region.
+    void unload_csg_draw(AppCsgRegionDraw* draw);
+    // Add a box brush in front of the camera.
+    void add_csg_box(CsgOperation operation);
+    // Import the meshes of a model file in the background, and add
+    // an entity for each in front of the camera.
+    void import_meshes(std::string path);
+    Task import_meshes_task(TaskContext* task, std::string path);
     // Runs as the application exits.
     int conclude();
     // Handy way to call `init`, `done`, `update`, and `conclude`.
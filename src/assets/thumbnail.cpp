@@ -0,0 +1,474 @@
+#include "thumbnail.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include "util/hash.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Thumbnails are drawn at this many times their size in each
+// direction, then averaged down.
+const uint32_t AssetThumbnail_Supersample = 2;
+// Linear color of meshes in thumbnails.
+const Vec3 AssetThumbnail_Color = Vec3{0.72f, 0.68f, 0.62f};
+// Fraction of the color which faces turned away from the light get.
+const float AssetThumbnail_Ambient = 0.3f;
+
+const char AssetThumbnail_Magic[4] = {'U', 'T', 'H', 'M'};
+
+// Start of a cached thumbnail file, followed by data_size bytes of
+// encoded pixels.
+struct AssetThumbnailFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t size;
+    uint32_t data_size;
+};
+
+// Convert a linear color channel to an 8-bit sRGB value.
+static uint8_t AssetThumbnail_ToSrgb(float value) {
+    value = std::clamp(value, 0.0f, 1.0f);
+    const float srgb = value <= 0.0031308f ?
+        value * 12.92f :
+        1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t) (srgb * 255.0f + 0.5f);
+}
+
+// Pack an opaque color into a pixel, in memory order RGBA.
+static uint32_t AssetThumbnail_PackPixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint8_t bytes[4] = {r, g, b, a};
+    uint32_t pixel;
+    std::memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+/**
+ * Encode pixels as runs. A control byte of 0x80 | (n - 1) is
+ * followed by one pixel repeated n times, and a control byte of
+ * n - 1 by n pixels which are written as they are. Thumbnails are
+ * mostly transparent background and flat faces, so this shrinks
+ * them several times over.
+ */
+static void AssetThumbnail_Encode(const uint32_t* pixels, size_t count, std::vector<uint8_t>* bytes) {
+    size_t i = 0;
+    while(i < count) {
+        size_t run = 1;
+        while(i + run < count && run < 128 && pixels[i + run] == pixels[i]) {
+            run++;
+        }
+        if(run >= 2) {
+            bytes->push_back((uint8_t) (0x80 | (run - 1)));
+            const uint8_t* pixel = (const uint8_t*) &pixels[i];
+            bytes->insert(bytes->end(), pixel, pixel + 4);
+            i += run;
+            continue;
+        }
+        // Literal pixels, up to where the next run starts
+        const size_t start = i;
+        while(i < count && i - start < 128 && !(i + 1 < count && pixels[i + 1] == pixels[i])) {
+            i++;
+        }
+        bytes->push_back((uint8_t) (i - start - 1));
+        const uint8_t* first = (const uint8_t*) &pixels[start];
+        bytes->insert(bytes->end(), first, first + (i - start) * 4);
+    }
+}
+
+// Decode exactly count pixels. Returns false if the data is cut
+// short or would write past the end.
+static bool AssetThumbnail_Decode(const uint8_t* data, size_t size, uint32_t* pixels, size_t count) {
+    size_t offset = 0;
+    size_t written = 0;
+    while(written < count) {
+        if(offset >= size) {
+            return false;
+        }
+        const uint8_t control = data[offset++];
+        const size_t length = (size_t) (control & 0x7f) + 1;
+        if(written + length > count) {
+            return false;
+        }
+        if(control & 0x80) {
+            if(offset + 4 > size) {
+                return false;
+            }
+            uint32_t pixel;
+            std::memcpy(&pixel, data + offset, 4);
+            offset += 4;
+            std::fill(pixels + written, pixels + written + length, pixel);
+        } else {
+            if(offset + length * 4 > size) {
+                return false;
+            }
+            std::memcpy(pixels + written, data + offset, length * 4);
+            offset += length * 4;
+        }
+        written += length;
+    }
+    return offset == size;
+}
+
+// Generate the thumbnail of a source, from the cache if it's there.
+static bool AssetThumbnail_Generate(
+    const std::string& directory,
+    const AssetThumbnailSource& source,
+    AssetThumbnail* thumbnail
+) {
+    UNI_PROFILE_ZONE("AssetThumbnail_Generate");
+    thumbnail->id = source.id;
+    thumbnail->key = AssetThumbnail_GetKey(source);
+    thumbnail->pixels.resize((size_t) AssetThumbnail_Size * AssetThumbnail_Size * 4);
+    if(AssetThumbnail_Load(directory, thumbnail->key, thumbnail->pixels.data())) {
+        return true;
+    }
+    AssetThumbnail_Render(source, thumbnail->pixels.data());
+    return AssetThumbnail_Save(directory, thumbnail->key, thumbnail->pixels.data());
+}
+
+void AssetThumbnailer::request(const AssetThumbnailSource& source) {
+    if(this->pending_ids.contains(source.id)) {
+        return;
+    }
+    this->requests.push_back(source);
+}
+
+void AssetThumbnailer::update() {
+    if(!this->jobs) {
+        // Without a job system, one thumbnail per frame is all
+        // which can be afforded on this thread
+        if(!this->requests.empty()) {
+            AssetThumbnail thumbnail;
+            AssetThumbnail_Generate(this->cache_directory, this->requests.front(), &thumbnail);
+            this->pending_ids.insert(thumbnail.id);
+            this->ready.push_back(std::move(thumbnail));
+        }
+        this->requests.clear();
+        return;
+    }
+    std::erase_if(this->running, [this](JobHandle job) {
+        return this->jobs->is_done(job);
+    });
+    for(const auto& source : this->requests) {
+        if(this->running.size() >= this->max_jobs) {
+            break;
+        }
+        if(!this->pending_ids.insert(source.id).second) {
+            // Asked for more than once this frame
+            continue;
+        }
+        auto result = std::make_shared<AssetThumbnail>();
+        auto saved = std::make_shared<bool>(false);
+        const std::string directory = this->cache_directory;
+        const uint32_t generation = this->generation;
+        this->running.push_back(this->jobs->submit(
+            [directory, source, result, saved]() {
+                *saved = AssetThumbnail_Generate(directory, source, result.get());
+            },
+            {},
+            [this, result, saved, generation]() {
+                if(generation != this->generation) {
+                    return;
+                }
+                if(!*saved) {
+                    UNI_LOG_WARN(
+                        LogSubsystem_Assets, "Failed to write thumbnail {:016x} to {}.",
+                        result->key, this->cache_directory
+                    );
+                }
+                this->ready.push_back(std::move(*result));
+            }
+        ));
+    }
+    this->requests.clear();
+}
+
+bool AssetThumbnailer::pop_ready(AssetThumbnail* thumbnail) {
+    if(this->ready.empty()) {
+        return false;
+    }
+    *thumbnail = std::move(this->ready.front());
+    this->ready.pop_front();
+    this->pending_ids.erase(thumbnail->id);
+    return true;
+}
+
+void AssetThumbnailer::cancel() {
+    if(this->jobs) {
+        for(const JobHandle job : this->running) {
+            this->jobs->wait(job);
+        }
+    }
+    this->running.clear();
+    this->requests.clear();
+    this->pending_ids.clear();
+    this->ready.clear();
+    this->generation++;
+}
+
+uint32_t AssetThumbnailer::generate_all(const std::vector<AssetThumbnailSource>& sources) {
+    UNI_PROFILE_ZONE("AssetThumbnailer::generate_all");
+    std::atomic<uint32_t> failed_count = 0;
+    const auto generate = [this, &sources, &failed_count](int begin, int end) {
+        AssetThumbnail thumbnail;
+        for(int i = begin; i < end; ++i) {
+            if(!AssetThumbnail_Generate(this->cache_directory, sources[i], &thumbnail)) {
+                failed_count++;
+            }
+        }
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) sources.size(), 4, generate);
+    } else {
+        generate(0, (int) sources.size());
+    }
+    return failed_count;
+}
+
+AssetThumbnailSource AssetThumbnailSource_FromMesh(uint64_t id, const LevelMesh& mesh) {
+    AssetThumbnailSource source;
+    source.id = id;
+    source.positions = mesh.positions.data();
+    source.vertex_count = (uint32_t) mesh.positions.size();
+    source.indices = mesh.indices.data();
+    source.index_count = (uint32_t) mesh.indices.size();
+    source.bounds = mesh.bounds;
+    return source;
+}
+
+uint64_t AssetThumbnail_GetKey(const AssetThumbnailSource& source) {
+    Hasher hasher;
+    hasher.add(AssetThumbnail_Version);
+    hasher.add(AssetThumbnail_Size);
+    hasher.add_bytes(source.positions, (size_t) source.vertex_count * sizeof(Vec3));
+    hasher.add_bytes(source.indices, (size_t) source.index_count * sizeof(uint32_t));
+    return hasher.hash;
+}
+
+void AssetThumbnail_Render(const AssetThumbnailSource& source, uint8_t* rgba) {
+    UNI_PROFILE_ZONE("AssetThumbnail_Render");
+    const uint32_t size = AssetThumbnail_Size * AssetThumbnail_Supersample;
+    const float half_size = (float) size * 0.5f;
+    // Looking down from one corner, with the light over the
+    // viewer's left shoulder
+    const Vec3 forward = Vec3_Normalize(Vec3{-1.0f, -0.75f, -1.0f});
+    const Vec3 right = Vec3_Normalize(Vec3_Cross(forward, Vec3{0.0f, 1.0f, 0.0f}));
+    const Vec3 up = Vec3_Cross(right, forward);
+    const Vec3 light = Vec3_Normalize(forward * -1.0f + up * 0.6f + right * -0.4f);
+    const Vec3 center = source.bounds.get_center();
+    float radius = Vec3_Length(source.bounds.get_extent());
+    if(!(radius > 0.0f) || !std::isfinite(radius)) {
+        radius = 1.0f;
+    }
+    // Leave a small margin, since the bounding sphere is only
+    // reached at the corners of the bounds
+    const float scale = half_size * 0.92f / radius;
+    // Screen x and y, and distance along forward
+    std::vector<Vec3> screen(source.vertex_count);
+    for(uint32_t i = 0; i < source.vertex_count; ++i) {
+        const Vec3 offset = source.positions[i] - center;
+        screen[i] = Vec3{
+            half_size + Vec3_Dot(offset, right) * scale,
+            half_size - Vec3_Dot(offset, up) * scale,
+            Vec3_Dot(offset, forward)
+        };
+    }
+    std::vector<float> depths((size_t) size * size, std::numeric_limits<float>::infinity());
+    std::vector<uint32_t> samples((size_t) size * size, 0);
+    for(uint32_t i = 0; i + 2 < source.index_count; i += 3) {
+        const uint32_t ia = source.indices[i];
+        uint32_t ib = source.indices[i + 1];
+        uint32_t ic = source.indices[i + 2];
+        if(ia >= source.vertex_count || ib >= source.vertex_count || ic >= source.vertex_count) {
+            continue;
+        }
+        // Lit on whichever side faces the viewer
+        Vec3 normal = Vec3_Cross(
+            source.positions[ib] - source.positions[ia],
+            source.positions[ic] - source.positions[ia]
+        );
+        const float normal_length = Vec3_Length(normal);
+        if(!(normal_length > 0.0f)) {
+            continue;
+        }
+        normal = normal * (1.0f / normal_length);
+        if(Vec3_Dot(normal, forward) > 0.0f) {
+            normal = normal * -1.0f;
+        }
+        const float intensity = AssetThumbnail_Ambient +
+            (1.0f - AssetThumbnail_Ambient) * std::max(0.0f, Vec3_Dot(normal, light));
+        const uint32_t pixel = AssetThumbnail_PackPixel(
+            AssetThumbnail_ToSrgb(AssetThumbnail_Color.x * intensity),
+            AssetThumbnail_ToSrgb(AssetThumbnail_Color.y * intensity),
+            AssetThumbnail_ToSrgb(AssetThumbnail_Color.z * intensity),
+            255
+        );
+        // Wind the triangle clockwise on screen, so that pixels
+        // inside it are in front of every edge
+        Vec3 a = screen[ia];
+        Vec3 b = screen[ib];
+        Vec3 c = screen[ic];
+        const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if(area == 0.0f || !std::isfinite(area)) {
+            continue;
+        }
+        if(area < 0.0f) {
+            std::swap(b, c);
+        }
+        const float inverse_area = 1.0f / std::abs(area);
+        const int min_x = std::max(0, (int) std::floor(std::min({a.x, b.x, c.x})));
+        const int min_y = std::max(0, (int) std::floor(std::min({a.y, b.y, c.y})));
+        const int max_x = std::min((int) size - 1, (int) std::ceil(std::max({a.x, b.x, c.x})));
+        const int max_y = std::min((int) size - 1, (int) std::ceil(std::max({a.y, b.y, c.y})));
+        if(min_x > max_x || min_y > max_y) {
+            continue;
+        }
+        // Edge functions at the first pixel center, stepped across
+        // rows and columns. Each is twice the area of the triangle
+        // made by the pixel and the edge opposite a vertex.
+        const float start_x = (float) min_x + 0.5f;
+        const float start_y = (float) min_y + 0.5f;
+        float row_a = (c.x - b.x) * (start_y - b.y) - (c.y - b.y) * (start_x - b.x);
+        float row_b = (a.x - c.x) * (start_y - c.y) - (a.y - c.y) * (start_x - c.x);
+        float row_c = (b.x - a.x) * (start_y - a.y) - (b.y - a.y) * (start_x - a.x);
+        for(int y = min_y; y <= max_y; ++y) {
+            float weight_a = row_a;
+            float weight_b = row_b;
+            float weight_c = row_c;
+            for(int x = min_x; x <= max_x; ++x) {
+                if(weight_a >= 0.0f && weight_b >= 0.0f && weight_c >= 0.0f) {
+                    const float depth = (weight_a * a.z + weight_b * b.z + weight_c * c.z) * inverse_area;
+                    const size_t index = (size_t) y * size + (size_t) x;
+                    if(depth < depths[index]) {
+                        depths[index] = depth;
+                        samples[index] = pixel;
+                    }
+                }
+                weight_a -= c.y - b.y;
+                weight_b -= a.y - c.y;
+                weight_c -= b.y - a.y;
+            }
+            row_a += c.x - b.x;
+            row_b += a.x - c.x;
+            row_c += b.x - a.x;
+        }
+    }
+    // Average each square of samples, counting only the covered
+    // ones towards the color
+    const uint32_t factor = AssetThumbnail_Supersample;
+    for(uint32_t y = 0; y < AssetThumbnail_Size; ++y) {
+        for(uint32_t x = 0; x < AssetThumbnail_Size; ++x) {
+            uint32_t sums[3] = {};
+            uint32_t covered = 0;
+            for(uint32_t sy = 0; sy < factor; ++sy) {
+                for(uint32_t sx = 0; sx < factor; ++sx) {
+                    const uint32_t sample = samples[(size_t) (y * factor + sy) * size + x * factor + sx];
+                    const uint8_t* bytes = (const uint8_t*) &sample;
+                    if(bytes[3] == 0) {
+                        continue;
+                    }
+                    sums[0] += bytes[0];
+                    sums[1] += bytes[1];
+                    sums[2] += bytes[2];
+                    covered++;
+                }
+            }
+            uint8_t* out = rgba + ((size_t) y * AssetThumbnail_Size + x) * 4;
+            if(covered == 0) {
+                std::memset(out, 0, 4);
+                continue;
+            }
+            out[0] = (uint8_t) ((sums[0] + covered / 2) / covered);
+            out[1] = (uint8_t) ((sums[1] + covered / 2) / covered);
+            out[2] = (uint8_t) ((sums[2] + covered / 2) / covered);
+            out[3] = (uint8_t) ((covered * 255 + factor * factor / 2) / (factor * factor));
+        }
+    }
+}
+
+std::string AssetThumbnail_GetPath(const std::string& directory, uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.thumb", (unsigned long long) key);
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool AssetThumbnail_Load(const std::string& directory, uint64_t key, uint8_t* rgba) {
+    const std::string path = AssetThumbnail_GetPath(directory, key);
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+    AssetThumbnailFileHeader header;
+    std::vector<uint8_t> data;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+        std::memcmp(header.magic, AssetThumbnail_Magic, sizeof(header.magic)) == 0 &&
+        header.version == AssetThumbnail_Version &&
+        header.key == key &&
+        header.size == AssetThumbnail_Size &&
+        // Worst case is every pixel written as it is
+        header.data_size <= AssetThumbnail_Size * AssetThumbnail_Size * 5;
+    if(ok) {
+        data.resize(header.data_size);
+        ok = std::fread(data.data(), 1, data.size(), file) == data.size();
+    }
+    std::fclose(file);
+    const size_t pixel_count = (size_t) AssetThumbnail_Size * AssetThumbnail_Size;
+    std::vector<uint32_t> pixels(pixel_count);
+    if(!ok || !AssetThumbnail_Decode(data.data(), data.size(), pixels.data(), pixel_count)) {
+        UNI_LOG_WARN(LogSubsystem_Assets, "Ignoring damaged or outdated thumbnail {}.", path);
+        return false;
+    }
+    std::memcpy(rgba, pixels.data(), pixel_count * 4);
+    return true;
+}
+
+bool AssetThumbnail_Save(const std::string& directory, uint64_t key, const uint8_t* rgba) {
+    const size_t pixel_count = (size_t) AssetThumbnail_Size * AssetThumbnail_Size;
+    std::vector<uint32_t> pixels(pixel_count);
+    std::memcpy(pixels.data(), rgba, pixel_count * 4);
+    std::vector<uint8_t> data;
+    AssetThumbnail_Encode(pixels.data(), pixel_count, &data);
+    AssetThumbnailFileHeader header;
+    std::memcpy(header.magic, AssetThumbnail_Magic, sizeof(header.magic));
+    header.version = AssetThumbnail_Version;
+    header.key = key;
+    header.size = AssetThumbnail_Size;
+    header.data_size = (uint32_t) data.size();
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    // Written under a temporary name and renamed into place, so
+    // that another thread or process never reads half a file. The
+    // name is unique to this thread, in case two jobs draw the
+    // same mesh at once.
+    const std::string path = AssetThumbnail_GetPath(directory, key);
+    char suffix[32];
+    std::snprintf(
+        suffix, sizeof(suffix), ".%zx.tmp",
+        std::hash<std::thread::id>()(std::this_thread::get_id())
+    );
+    const std::string temp_path = path + suffix;
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if(!file) {
+        return false;
+    }
+    const bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+        std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    const bool ok = std::fclose(file) == 0 && written;
+    if(ok) {
+        std::filesystem::rename(temp_path, path, error);
+    }
+    if(!ok || error) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
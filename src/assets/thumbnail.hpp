@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/mesh.hpp"
+#include "util/math.hpp"
+
+// Width and height of thumbnails, in pixels.
+const uint32_t AssetThumbnail_Size = 64;
+// Changed whenever thumbnails would be drawn differently, so that
+// ones cached by older versions are drawn again.
+const uint32_t AssetThumbnail_Version = 1;
+
+/**
+ * Mesh to draw a thumbnail of. Refers to the mesh's arrays rather
+ * than copying them, so they must not change or be freed until
+ * its thumbnail is ready or AssetThumbnailer::cancel returns.
+ */
+struct AssetThumbnailSource {
+    // Tells thumbnails apart in the thumbnailer and atlas, such as
+    // a LevelMeshId
+    uint64_t id = 0;
+    const Vec3* positions = nullptr;
+    uint32_t vertex_count = 0;
+    const uint32_t* indices = nullptr;
+    uint32_t index_count = 0;
+    Bounds3 bounds = Bounds3_Empty;
+};
+
+// Finished thumbnail, as 8-bit RGBA with straight alpha.
+struct AssetThumbnail {
+    uint64_t id = 0;
+    // Content hash of the source, naming its file in the cache
+    uint64_t key = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/**
+ * Draws thumbnails of meshes in the background, and keeps them in
+ * a cache on disk named by a hash of each mesh's contents, so a
+ * mesh is only drawn once however often it is shown or loaded.
+ * 
+ * Thumbnails are drawn on the CPU, by AssetThumbnail_Render, so
+ * they need no GPU and can be made ahead of time by the headless
+ * thumbnail command. Each job hashes its mesh, then loads the
+ * thumbnail from the cache or draws and stores it.
+ * 
+ * Requests only last one frame. update starts jobs for the newest
+ * requests, up to max_jobs at a time, and drops the rest, so that
+ * scrolling past thousands of assets only draws the ones which
+ * stay in view. Callers ask again each frame for the thumbnails
+ * they still want.
+ */
+class AssetThumbnailer {
+public:
+    AssetThumbnailer() {};
+    AssetThumbnailer(JobSystem* jobs): jobs(jobs) {};
+    AssetThumbnailer(const AssetThumbnailer&) = delete;
+    AssetThumbnailer& operator=(const AssetThumbnailer&) = delete;
+    AssetThumbnailer& operator=(AssetThumbnailer&& other) = default;
+    
+    JobSystem* jobs = nullptr;
+    // Where thumbnail files are kept. Created when first written.
+    std::string cache_directory = "cache/thumbnails";
+    // Thumbnails being loaded or drawn at once, at most
+    uint32_t max_jobs = 8;
+    
+    // Ask for a thumbnail, until the next update. Sources which
+    // are already started or ready are ignored.
+    void request(const AssetThumbnailSource& source);
+    // Start jobs for this frame's requests, in the order they were
+    // made, and forget the ones left over. Call once per frame,
+    // after JobSystem::update.
+    void update();
+    // Take the oldest finished thumbnail. Returns false if none is
+    // ready.
+    bool pop_ready(AssetThumbnail* thumbnail);
+    // Wait for the jobs in the background, and discard every
+    // request and result.
+    void cancel();
+    // Make sure the cache has a thumbnail of every source, drawing
+    // the missing ones on the calling thread with help from the job
+    // system. Returns the number which couldn't be written.
+    uint32_t generate_all(const std::vector<AssetThumbnailSource>& sources);
+    
+private:
+    std::vector<AssetThumbnailSource> requests;
+    // Ids of the thumbnails started or ready, which new requests
+    // for are ignored
+    std::unordered_set<uint64_t> pending_ids;
+    std::vector<JobHandle> running;
+    std::deque<AssetThumbnail> ready;
+    uint32_t generation = 0;
+};
+
+// Get a source for a mesh.
+AssetThumbnailSource AssetThumbnailSource_FromMesh(uint64_t id, const LevelMesh& mesh);
+// Hash the contents of a source, along with AssetThumbnail_Version
+// and AssetThumbnail_Size.
+uint64_t AssetThumbnail_GetKey(const AssetThumbnailSource& source);
+/**
+ * Draw a source seen from above and to one side, fitted to the
+ * image, into AssetThumbnail_Size squared pixels of RGBA.
+ * 
+ * Triangles are filled by a depth-buffered rasterizer at twice
+ * the size in each direction, then averaged down, for smooth
+ * edges. Faces are lit flat by one light from behind the viewer,
+ * which keeps runs of equal pixels long for the cache's encoding.
+ * Pixels outside the mesh are transparent.
+ */
+void AssetThumbnail_Render(const AssetThumbnailSource& source, uint8_t* rgba);
+// Get the cache file path of a thumbnail.
+std::string AssetThumbnail_GetPath(const std::string& directory, uint64_t key);
+// Read a cached thumbnail. Returns false if there is none, or it
+// is damaged or out of date.
+bool AssetThumbnail_Load(const std::string& directory, uint64_t key, uint8_t* rgba);
+// Write a thumbnail to the cache, creating the directory if needed.
+bool AssetThumbnail_Save(const std::string& directory, uint64_t key, const uint8_t* rgba);
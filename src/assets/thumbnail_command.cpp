@@ -0,0 +1,57 @@
+#include "thumbnail_command.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include "thumbnail.hpp"
+#include "level/level_file.hpp"
+#include "util/log.hpp"
+
+int AssetThumbnailCommand_Run(int argc, char** argv) {
+    Log_Init();
+    Log_SetLevelAll(LogLevel_Info);
+    if(argc < 1) {
+        UNI_LOG_ERROR(
+            LogSubsystem_General,
+            "Usage: {} <level file> [cache directory]",
+            AssetThumbnailCommand_Argument
+        );
+        Log_Conclude();
+        return 2;
+    }
+    LevelDocument document;
+    if(!LevelFile_Open(&document, argv[0])) {
+        Log_Conclude();
+        return 1;
+    }
+    std::vector<AssetThumbnailSource> sources;
+    for(size_t i = 0; i < document.mesh_assets.size(); ++i) {
+        const LevelMesh& mesh = document.mesh_assets[i];
+        if(!mesh.positions.empty() && !mesh.indices.empty()) {
+            sources.push_back(AssetThumbnailSource_FromMesh(i, mesh));
+        }
+    }
+    JobSystem jobs;
+    jobs.init();
+    AssetThumbnailer thumbnailer(&jobs);
+    if(argc >= 2) {
+        thumbnailer.cache_directory = argv[1];
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t failed_count = thumbnailer.generate_all(sources);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    jobs.conclude();
+    if(failed_count > 0) {
+        UNI_LOG_ERROR(
+            LogSubsystem_Assets, "Failed to write {} of {} thumbnails to {}.",
+            failed_count, sources.size(), thumbnailer.cache_directory
+        );
+    } else {
+        UNI_LOG_INFO(
+            LogSubsystem_Assets, "Thumbnails of {} meshes are in {}, after {:.2f}s.",
+            sources.size(), thumbnailer.cache_directory, seconds
+        );
+    }
+    Log_Conclude();
+    return failed_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Argument which runs the thumbnail command instead of the editor.
+const char* const AssetThumbnailCommand_Argument = "--generate-thumbnails";
+
+/**
+ * Fill the thumbnail cache for a level's meshes without opening a
+ * window, as on a build machine, so that the asset browser finds
+ * every thumbnail ready. Arguments follow
+ * AssetThumbnailCommand_Argument:
+ * 
+ *     <level file> [cache directory]
+ * 
+ * Thumbnails already in the cache are left as they are.
+ * Returns the process exit code.
+ */
+int AssetThumbnailCommand_Run(int argc, char** argv);
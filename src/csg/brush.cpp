@@ -0,0 +1,255 @@
+#include "brush.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Intersect three planes, in double precision since nearly
+// parallel planes lose much of it. Returns false if they don't
+// meet at a single point.
+static bool CsgBrush_IntersectPlanes(
+    const Plane3& a,
+    const Plane3& b,
+    const Plane3& c,
+    Vec3* point
+) {
+    const double ax = a.normal.x, ay = a.normal.y, az = a.normal.z;
+    const double bx = b.normal.x, by = b.normal.y, bz = b.normal.z;
+    const double cx = c.normal.x, cy = c.normal.y, cz = c.normal.z;
+    // Cross products of the normals, by Cramer's rule
+    const double bc_x = by * cz - bz * cy;
+    const double bc_y = bz * cx - bx * cz;
+    const double bc_z = bx * cy - by * cx;
+    const double determinant = ax * bc_x + ay * bc_y + az * bc_z;
+    if(std::fabs(determinant) < 1e-9) {
+        return false;
+    }
+    const double ca_x = cy * az - cz * ay;
+    const double ca_y = cz * ax - cx * az;
+    const double ca_z = cx * ay - cy * ax;
+    const double ab_x = ay * bz - az * by;
+    const double ab_y = az * bx - ax * bz;
+    const double ab_z = ax * by - ay * bx;
+    const double da = -a.distance;
+    const double db = -b.distance;
+    const double dc = -c.distance;
+    *point = Vec3{
+        (float) ((da * bc_x + db * ca_x + dc * ab_x) / determinant),
+        (float) ((da * bc_y + db * ca_y + dc * ab_y) / determinant),
+        (float) ((da * bc_z + db * ca_z + dc * ab_z) / determinant)
+    };
+    return true;
+}
+
+// Get two unit axes on a plane, such that the cross product of the
+// first and second is the normal.
+static void CsgPolygon_GetAxes(const Vec3& normal, Vec3* u, Vec3* v) {
+    const Vec3 other = (
+        std::fabs(normal.x) < 0.9f ? Vec3{1.0f, 0.0f, 0.0f} : Vec3{0.0f, 1.0f, 0.0f}
+    );
+    *v = Vec3_Normalize(Vec3_Cross(normal, other));
+    *u = Vec3_Cross(*v, normal);
+}
+
+Vec3 CsgPolygon::get_center() const {
+    Vec3 sum;
+    for(const auto& vertex : this->vertexes) {
+        sum = sum + vertex;
+    }
+    return this->vertexes.empty() ? sum : sum * (1.0f / (float) this->vertexes.size());
+}
+
+Bounds3 CsgPolygon::get_bounds() const {
+    Bounds3 bounds = Bounds3_Empty;
+    for(const auto& vertex : this->vertexes) {
+        bounds = Bounds3_Grow(bounds, vertex);
+    }
+    return bounds;
+}
+
+bool CsgBrush::contains(const Vec3& point, float margin) const {
+    for(const auto& plane : this->planes) {
+        if(Vec3_Dot(plane.normal, point) + plane.distance > -margin) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CsgBrush_Build(CsgBrush* brush) {
+    const size_t plane_count = brush->planes.size();
+    brush->faces.assign(plane_count, CsgPolygon());
+    brush->bounds = Bounds3_Empty;
+    // Every corner is where three planes meet, inside the rest
+    for(size_t i = 0; i < plane_count; ++i) {
+        for(size_t j = i + 1; j < plane_count; ++j) {
+            for(size_t k = j + 1; k < plane_count; ++k) {
+                Vec3 point;
+                if(!CsgBrush_IntersectPlanes(
+                    brush->planes[i], brush->planes[j], brush->planes[k], &point
+                )) {
+                    continue;
+                }
+                bool inside = true;
+                for(const auto& plane : brush->planes) {
+                    if(Vec3_Dot(plane.normal, point) + plane.distance > Csg_Epsilon) {
+                        inside = false;
+                        break;
+                    }
+                }
+                if(!inside) {
+                    continue;
+                }
+                for(const size_t face : {i, j, k}) {
+                    auto& vertexes = brush->faces[face].vertexes;
+                    const bool duplicate = std::any_of(
+                        vertexes.begin(), vertexes.end(),
+                        [&point](const Vec3& vertex) {
+                            return Vec3_Length(vertex - point) < Csg_Epsilon;
+                        }
+                    );
+                    if(!duplicate) {
+                        vertexes.push_back(point);
+                    }
+                }
+                brush->bounds = Bounds3_Grow(brush->bounds, point);
+            }
+        }
+    }
+    // Order each face's corners around its center
+    bool any_face = false;
+    for(size_t i = 0; i < plane_count; ++i) {
+        CsgPolygon& face = brush->faces[i];
+        face.normal = brush->planes[i].normal;
+        if(face.empty()) {
+            face.vertexes.clear();
+            continue;
+        }
+        any_face = true;
+        Vec3 u;
+        Vec3 v;
+        CsgPolygon_GetAxes(face.normal, &u, &v);
+        const Vec3 center = face.get_center();
+        std::sort(
+            face.vertexes.begin(), face.vertexes.end(),
+            [&](const Vec3& a, const Vec3& b) {
+                const Vec3 da = a - center;
+                const Vec3 db = b - center;
+                return (
+                    std::atan2(Vec3_Dot(da, v), Vec3_Dot(da, u)) <
+                    std::atan2(Vec3_Dot(db, v), Vec3_Dot(db, u))
+                );
+            }
+        );
+    }
+    return any_face;
+}
+
+CsgBrush CsgBrush_CreateBox(const Bounds3& bounds, CsgOperation operation, LevelMaterialId material) {
+    CsgBrush brush;
+    brush.operation = operation;
+    brush.material = material;
+    brush.planes = {
+        Plane3{Vec3{1.0f, 0.0f, 0.0f}, -bounds.max.x},
+        Plane3{Vec3{-1.0f, 0.0f, 0.0f}, bounds.min.x},
+        Plane3{Vec3{0.0f, 1.0f, 0.0f}, -bounds.max.y},
+        Plane3{Vec3{0.0f, -1.0f, 0.0f}, bounds.min.y},
+        Plane3{Vec3{0.0f, 0.0f, 1.0f}, -bounds.max.z},
+        Plane3{Vec3{0.0f, 0.0f, -1.0f}, bounds.min.z},
+    };
+    CsgBrush_Build(&brush);
+    return brush;
+}
+
+void CsgPolygon_Split(
+    const CsgPolygon& polygon,
+    const Plane3& plane,
+    CsgPolygon* front,
+    CsgPolygon* back
+) {
+    front->vertexes.clear();
+    back->vertexes.clear();
+    front->normal = polygon.normal;
+    back->normal = polygon.normal;
+    const size_t count = polygon.vertexes.size();
+    bool any_front = false;
+    bool any_back = false;
+    // Distances are kept for each vertex in a small fixed array
+    // when possible, since polygons rarely have many vertexes
+    float small_distances[16];
+    std::vector<float> large_distances;
+    float* distances = small_distances;
+    if(count > 16) {
+        large_distances.resize(count);
+        distances = large_distances.data();
+    }
+    for(size_t i = 0; i < count; ++i) {
+        distances[i] = Vec3_Dot(plane.normal, polygon.vertexes[i]) + plane.distance;
+        any_front = any_front || distances[i] > Csg_Epsilon;
+        any_back = any_back || distances[i] < -Csg_Epsilon;
+    }
+    if(!any_front) {
+        back->vertexes = polygon.vertexes;
+        return;
+    }
+    if(!any_back) {
+        front->vertexes = polygon.vertexes;
+        return;
+    }
+    for(size_t i = 0; i < count; ++i) {
+        const size_t next = (i + 1) % count;
+        const Vec3& a = polygon.vertexes[i];
+        const Vec3& b = polygon.vertexes[next];
+        const float da = distances[i];
+        const float db = distances[next];
+        if(da >= -Csg_Epsilon) {
+            front->vertexes.push_back(a);
+        }
+        if(da <= Csg_Epsilon) {
+            back->vertexes.push_back(a);
+        }
+        if((da > Csg_Epsilon && db < -Csg_Epsilon) || (da < -Csg_Epsilon && db > Csg_Epsilon)) {
+            const Vec3 point = a + (b - a) * (da / (da - db));
+            front->vertexes.push_back(point);
+            back->vertexes.push_back(point);
+        }
+    }
+    if(front->empty()) {
+        front->vertexes.clear();
+    }
+    if(back->empty()) {
+        back->vertexes.clear();
+    }
+}
+
+CsgPolygon CsgPolygon_ClipToBounds(const CsgPolygon& polygon, const Bounds3& bounds) {
+    const Plane3 planes[6] = {
+        Plane3{Vec3{1.0f, 0.0f, 0.0f}, -bounds.max.x},
+        Plane3{Vec3{-1.0f, 0.0f, 0.0f}, bounds.min.x},
+        Plane3{Vec3{0.0f, 1.0f, 0.0f}, -bounds.max.y},
+        Plane3{Vec3{0.0f, -1.0f, 0.0f}, bounds.min.y},
+        Plane3{Vec3{0.0f, 0.0f, 1.0f}, -bounds.max.z},
+        Plane3{Vec3{0.0f, 0.0f, -1.0f}, bounds.min.z},
+    };
+    CsgPolygon result = polygon;
+    CsgPolygon front;
+    CsgPolygon back;
+    for(int i = 0; i < 6; ++i) {
+        const Plane3& plane = planes[i];
+        // Polygons on a shared side of two boxes belong to only one,
+        // the one whose minimum side it is
+        if(i % 2 == 0 && std::all_of(
+            result.vertexes.begin(), result.vertexes.end(),
+            [&plane](const Vec3& vertex) {
+                return std::fabs(Vec3_Dot(plane.normal, vertex) + plane.distance) <= Csg_Epsilon;
+            }
+        )) {
+            return CsgPolygon();
+        }
+        CsgPolygon_Split(result, plane, &front, &back);
+        std::swap(result, back);
+        if(result.empty()) {
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "level/mesh.hpp"
+#include "util/math.hpp"
+
+// Distance within which points are considered on a plane.
+const float Csg_Epsilon = 1e-3f;
+
+enum CsgOperation : uint32_t {
+    // The brush's volume is made solid
+    CsgOperation_Add = 0,
+    // The brush's volume is carved out of brushes added before it
+    CsgOperation_Subtract,
+};
+
+// Convex polygon, with vertexes counterclockwise when seen from
+// the side its normal faces.
+struct CsgPolygon {
+    std::vector<Vec3> vertexes;
+    Vec3 normal;
+    
+    bool empty() const {
+        return this->vertexes.size() < 3;
+    }
+    Vec3 get_center() const;
+    Bounds3 get_bounds() const;
+};
+
+/**
+ * Convex volume bounded by planes, such as a box or a wedge.
+ * Brushes are combined in order: each one adds its volume to the
+ * solid, or subtracts it from what came before.
+ * 
+ * Plane normals face outward, so points inside are behind every
+ * plane. Call CsgBrush_Build after changing the planes to update
+ * the faces and bounds.
+ */
+struct CsgBrush {
+    std::vector<Plane3> planes;
+    CsgOperation operation = CsgOperation_Add;
+    LevelMaterialId material = LevelMaterialId_None;
+    // One polygon per plane, empty where a plane doesn't touch the
+    // brush. Computed by CsgBrush_Build.
+    std::vector<CsgPolygon> faces;
+    Bounds3 bounds = Bounds3_Empty;
+    
+    // Returns true if a point is inside the brush, by more than
+    // margin from every plane.
+    bool contains(const Vec3& point, float margin) const;
+};
+
+// Compute a brush's faces and bounds from its planes. Returns
+// false if the planes don't enclose a volume.
+bool CsgBrush_Build(CsgBrush* brush);
+// Make a box brush, with its faces and bounds already built.
+CsgBrush CsgBrush_CreateBox(const Bounds3& bounds, CsgOperation operation, LevelMaterialId material);
+
+// Split a polygon by a plane into the parts in front of it and
+// behind it. A polygon lying on the plane goes behind it.
+void CsgPolygon_Split(
+    const CsgPolygon& polygon,
+    const Plane3& plane,
+    CsgPolygon* front,
+    CsgPolygon* back
+);
+// Keep only the part of a polygon inside a box. Polygons lying on
+// one of the box's maximum sides are dropped, so that a polygon on
+// the side shared by two neighbouring boxes is kept by only one.
+CsgPolygon CsgPolygon_ClipToBounds(const CsgPolygon& polygon, const Bounds3& bounds);
@@ -0,0 +1,470 @@
+#include "compiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Distance either side of a face at which the solid is sampled
+const float Csg_SampleOffset = 4.0f * Csg_Epsilon;
+// Collision vertexes closer than one over this are welded
+const float Csg_WeldScale = 1024.0f;
+
+Bounds3 CsgRegion_GetBounds(CsgRegionCoord coord, float region_size) {
+    const Vec3 min = Vec3{(float) coord.x, (float) coord.y, (float) coord.z} * region_size;
+    return Bounds3{min, min + Vec3{region_size, region_size, region_size}};
+}
+
+// Returns true if a point is solid after applying every brush.
+static bool CsgRegion_IsSolid(const std::vector<const CsgBrush*>& brushes, const Vec3& point) {
+    bool solid = false;
+    for(const CsgBrush* brush : brushes) {
+        if(brush->contains(point, 0.0f)) {
+            solid = brush->operation == CsgOperation_Add;
+        }
+    }
+    return solid;
+}
+
+// Returns true if a point on a face of one brush is also on a face
+// of a later brush, facing either way. Only the latest brush's face
+// is kept, so that coincident faces aren't drawn twice.
+static bool CsgRegion_IsOnLaterFace(
+    const std::vector<const CsgBrush*>& brushes,
+    size_t brush_index,
+    const Vec3& point,
+    const Vec3& normal
+) {
+    const Vec3 margin = Vec3{Csg_Epsilon, Csg_Epsilon, Csg_Epsilon};
+    const Bounds3 point_bounds = Bounds3{point - margin, point + margin};
+    for(size_t j = brush_index + 1; j < brushes.size(); ++j) {
+        const CsgBrush* other = brushes[j];
+        if(!Bounds3_Overlaps(other->bounds, point_bounds)) {
+            continue;
+        }
+        for(size_t k = 0; k < other->planes.size(); ++k) {
+            const Plane3& plane = other->planes[k];
+            if(
+                std::fabs(Vec3_Dot(plane.normal, normal)) < 1.0f - 1e-4f ||
+                std::fabs(Vec3_Dot(plane.normal, point) + plane.distance) > Csg_Epsilon
+            ) {
+                continue;
+            }
+            bool on_face = true;
+            for(const auto& other_plane : other->planes) {
+                if(Vec3_Dot(other_plane.normal, point) + other_plane.distance > Csg_Epsilon) {
+                    on_face = false;
+                    break;
+                }
+            }
+            if(on_face) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Add a polygon's triangles to a region's render and collision
+// meshes.
+static void CsgRegion_Emit(
+    const CsgPolygon& polygon,
+    bool flip,
+    const Bounds3& region_bounds,
+    float texture_size,
+    std::unordered_map<uint64_t, uint32_t>* welded,
+    CsgRegionMesh* mesh
+) {
+    const Vec3 normal = flip ? polygon.normal * -1.0f : polygon.normal;
+    const Vec3 abs_normal = Vec3_Abs(normal);
+    const float uv_scale = 1.0f / texture_size;
+    const uint32_t render_base = (uint32_t) mesh->render.positions.size();
+    const size_t count = polygon.vertexes.size();
+    uint32_t collision_indices[3];
+    for(size_t i = 0; i < count; ++i) {
+        // Reversing the winding turns the polygon around
+        const Vec3& vertex = polygon.vertexes[flip ? count - 1 - i : i];
+        mesh->render.positions.push_back(vertex);
+        mesh->render.normals.push_back(normal);
+        // Project along the axis the face is most aligned with
+        if(abs_normal.x >= abs_normal.y && abs_normal.x >= abs_normal.z) {
+            mesh->render.uvs.push_back(Vec2{vertex.z * uv_scale, -vertex.y * uv_scale});
+        }
+        else if(abs_normal.y >= abs_normal.z) {
+            mesh->render.uvs.push_back(Vec2{vertex.x * uv_scale, vertex.z * uv_scale});
+        }
+        else {
+            mesh->render.uvs.push_back(Vec2{vertex.x * uv_scale, -vertex.y * uv_scale});
+        }
+    }
+    for(size_t i = 1; i + 1 < count; ++i) {
+        mesh->render.indices.push_back(render_base);
+        mesh->render.indices.push_back(render_base + (uint32_t) i);
+        mesh->render.indices.push_back(render_base + (uint32_t) i + 1);
+    }
+    // Collision vertexes are welded by position, relative to the
+    // region so that each component fits in 21 bits
+    auto get_collision_index = [&](const Vec3& vertex) -> uint32_t {
+        const Vec3 local = (vertex - region_bounds.min) * Csg_WeldScale;
+        auto quantize = [](float value) -> uint64_t {
+            return (uint64_t) std::clamp((int64_t) std::lround(value) + 16, (int64_t) 0, (int64_t) 0x1fffff);
+        };
+        const uint64_t key = (quantize(local.x) << 42) | (quantize(local.y) << 21) | quantize(local.z);
+        const auto inserted = welded->emplace(key, (uint32_t) mesh->collision.positions.size());
+        if(inserted.second) {
+            mesh->collision.positions.push_back(vertex);
+        }
+        return inserted.first->second;
+    };
+    for(size_t i = 1; i + 1 < count; ++i) {
+        collision_indices[0] = get_collision_index(mesh->render.positions[render_base]);
+        collision_indices[1] = get_collision_index(mesh->render.positions[render_base + i]);
+        collision_indices[2] = get_collision_index(mesh->render.positions[render_base + i + 1]);
+        if(
+            collision_indices[0] != collision_indices[1] &&
+            collision_indices[1] != collision_indices[2] &&
+            collision_indices[2] != collision_indices[0]
+        ) {
+            mesh->collision.indices.insert(
+                mesh->collision.indices.end(), collision_indices, collision_indices + 3
+            );
+        }
+    }
+}
+
+void CsgRegion_Compile(
+    const Bounds3& region_bounds,
+    const std::vector<const CsgBrush*>& brushes,
+    float texture_size,
+    CsgRegionMesh* mesh
+) {
+    UNI_PROFILE_ZONE("CsgRegion_Compile");
+    *mesh = CsgRegionMesh();
+    std::unordered_map<uint64_t, uint32_t> welded;
+    std::vector<CsgPolygon> pieces;
+    std::vector<CsgPolygon> next_pieces;
+    CsgPolygon front;
+    CsgPolygon back;
+    for(size_t i = 0; i < brushes.size(); ++i) {
+        const CsgBrush* brush = brushes[i];
+        const uint32_t first_index = (uint32_t) mesh->render.indices.size();
+        for(const auto& face : brush->faces) {
+            if(face.empty()) {
+                continue;
+            }
+            CsgPolygon clipped = CsgPolygon_ClipToBounds(face, region_bounds);
+            if(clipped.empty()) {
+                continue;
+            }
+            // Split the face so that every piece is wholly inside or
+            // outside each other brush
+            const Bounds3 face_bounds = clipped.get_bounds();
+            pieces.clear();
+            pieces.push_back(std::move(clipped));
+            for(size_t j = 0; j < brushes.size() && !pieces.empty(); ++j) {
+                const CsgBrush* other = brushes[j];
+                if(j == i || !Bounds3_Overlaps(other->bounds, face_bounds)) {
+                    continue;
+                }
+                next_pieces.clear();
+                for(auto& piece : pieces) {
+                    for(const auto& plane : other->planes) {
+                        CsgPolygon_Split(piece, plane, &front, &back);
+                        if(!front.empty()) {
+                            next_pieces.push_back(std::move(front));
+                            front = CsgPolygon();
+                        }
+                        std::swap(piece, back);
+                        if(piece.empty()) {
+                            break;
+                        }
+                    }
+                    if(!piece.empty()) {
+                        next_pieces.push_back(std::move(piece));
+                    }
+                }
+                std::swap(pieces, next_pieces);
+            }
+            for(const auto& piece : pieces) {
+                const Vec3 center = piece.get_center();
+                if(CsgRegion_IsOnLaterFace(brushes, i, center, piece.normal)) {
+                    continue;
+                }
+                const bool front_solid = CsgRegion_IsSolid(
+                    brushes, center + piece.normal * Csg_SampleOffset
+                );
+                const bool back_solid = CsgRegion_IsSolid(
+                    brushes, center - piece.normal * Csg_SampleOffset
+                );
+                if(front_solid != back_solid) {
+                    CsgRegion_Emit(
+                        piece, front_solid, region_bounds, texture_size, &welded, mesh
+                    );
+                }
+            }
+        }
+        const uint32_t index_count = (uint32_t) mesh->render.indices.size() - first_index;
+        if(index_count == 0) {
+            continue;
+        }
+        auto& ranges = mesh->material_ranges;
+        if(!ranges.empty() && ranges.back().material == brush->material) {
+            ranges.back().index_count += index_count;
+        }
+        else {
+            ranges.push_back(CsgMaterialRange{brush->material, first_index, index_count});
+        }
+    }
+    mesh->render.update_bounds();
+}
+
+template<typename Fn>
+void CsgCompiler::for_each_region(const Bounds3& bounds, Fn&& fn) const {
+    // Faces on a region's side may belong to either region
+    const float scale = 1.0f / this->region_size;
+    const int32_t min_x = (int32_t) std::floor((bounds.min.x - Csg_Epsilon) * scale);
+    const int32_t min_y = (int32_t) std::floor((bounds.min.y - Csg_Epsilon) * scale);
+    const int32_t min_z = (int32_t) std::floor((bounds.min.z - Csg_Epsilon) * scale);
+    const int32_t max_x = (int32_t) std::floor((bounds.max.x + Csg_Epsilon) * scale);
+    const int32_t max_y = (int32_t) std::floor((bounds.max.y + Csg_Epsilon) * scale);
+    const int32_t max_z = (int32_t) std::floor((bounds.max.z + Csg_Epsilon) * scale);
+    for(int32_t z = min_z; z <= max_z; ++z) {
+        for(int32_t y = min_y; y <= max_y; ++y) {
+            for(int32_t x = min_x; x <= max_x; ++x) {
+                fn(CsgRegionCoord{x, y, z});
+            }
+        }
+    }
+}
+
+CsgBrushId CsgCompiler::add_brush(const CsgBrush& brush) {
+    auto built = std::make_shared<CsgBrush>(brush);
+    if(!CsgBrush_Build(built.get())) {
+        UNI_LOG_WARN(LogSubsystem_Level, "CSG brush has no volume and was not added.");
+        return CsgBrushId_None;
+    }
+    const CsgBrushId id = (CsgBrushId) this->brushes.size();
+    this->brushes.push_back(std::move(built));
+    this->brush_count++;
+    this->link_brush(id);
+    return id;
+}
+
+bool CsgCompiler::set_brush(CsgBrushId id, const CsgBrush& brush) {
+    if(!this->get_brush(id)) {
+        return false;
+    }
+    auto built = std::make_shared<CsgBrush>(brush);
+    if(!CsgBrush_Build(built.get())) {
+        UNI_LOG_WARN(LogSubsystem_Level, "CSG brush {} would have no volume and was not changed.", id);
+        return false;
+    }
+    this->unlink_brush(id);
+    this->brushes[id] = std::move(built);
+    this->link_brush(id);
+    return true;
+}
+
+bool CsgCompiler::remove_brush(CsgBrushId id) {
+    if(!this->get_brush(id)) {
+        return false;
+    }
+    this->unlink_brush(id);
+    this->brushes[id].reset();
+    this->brush_count--;
+    return true;
+}
+
+const CsgBrush* CsgCompiler::get_brush(CsgBrushId id) const {
+    return id < this->brushes.size() ? this->brushes[id].get() : nullptr;
+}
+
+void CsgCompiler::clear() {
+    this->cancel();
+    this->brushes.clear();
+    this->brush_count = 0;
+    this->regions.clear();
+    this->revision++;
+}
+
+void CsgCompiler::update() {
+    if(!this->jobs) {
+        this->compile_all();
+        return;
+    }
+    UNI_PROFILE_ZONE("CsgCompiler::update");
+    this->job_handles.erase(
+        std::remove_if(
+            this->job_handles.begin(),
+            this->job_handles.end(),
+            [this](JobHandle handle) { return this->jobs->is_done(handle); }
+        ),
+        this->job_handles.end()
+    );
+    this->remove_empty_regions();
+    for(auto& [key, region] : this->regions) {
+        if(region->dirty && !region->compiling) {
+            this->start_compile(region.get());
+        }
+    }
+}
+
+void CsgCompiler::compile_all() {
+    UNI_PROFILE_ZONE("CsgCompiler::compile_all");
+    this->cancel();
+    this->remove_empty_regions();
+    std::vector<CsgRegion*> dirty_regions;
+    for(auto& [key, region] : this->regions) {
+        if(region->dirty) {
+            dirty_regions.push_back(region.get());
+        }
+    }
+    if(dirty_regions.empty()) {
+        return;
+    }
+    // Regions are compiled in place, since nothing else can change
+    // them until this returns
+    auto compile = [&](int begin, int end) {
+        std::vector<const CsgBrush*> brushes;
+        for(int i = begin; i < end; ++i) {
+            CsgRegion* region = dirty_regions[i];
+            brushes.clear();
+            for(const CsgBrushId id : region->brushes) {
+                brushes.push_back(this->brushes[id].get());
+            }
+            CsgRegion_Compile(
+                CsgRegion_GetBounds(region->coord, this->region_size),
+                brushes, this->texture_size, &region->mesh
+            );
+        }
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) dirty_regions.size(), 1, compile);
+    }
+    else {
+        compile(0, (int) dirty_regions.size());
+    }
+    for(CsgRegion* region : dirty_regions) {
+        region->dirty = false;
+        region->mesh_revision++;
+    }
+    this->revision++;
+    UNI_LOG_TRACE(LogSubsystem_Level, "Compiled {} CSG regions.", dirty_regions.size());
+}
+
+void CsgCompiler::cancel() {
+    if(this->jobs) {
+        for(const JobHandle handle : this->job_handles) {
+            this->jobs->wait(handle);
+        }
+    }
+    this->job_handles.clear();
+    this->generation++;
+    // Results of the jobs are dropped, so compile those regions again
+    for(auto& [key, region] : this->regions) {
+        if(region->compiling) {
+            region->compiling = false;
+            region->dirty = true;
+        }
+    }
+}
+
+uint32_t CsgCompiler::get_dirty_count() const {
+    uint32_t count = 0;
+    for(const auto& [key, region] : this->regions) {
+        count += region->dirty ? 1 : 0;
+    }
+    return count;
+}
+
+void CsgCompiler::link_brush(CsgBrushId id) {
+    this->for_each_region(this->brushes[id]->bounds, [this, id](CsgRegionCoord coord) {
+        auto& region = this->regions[coord.get_key()];
+        if(!region) {
+            region = std::make_unique<CsgRegion>();
+            region->coord = coord;
+        }
+        auto& brushes = region->brushes;
+        brushes.insert(std::lower_bound(brushes.begin(), brushes.end(), id), id);
+        region->dirty = true;
+        region->edit_count++;
+    });
+}
+
+void CsgCompiler::unlink_brush(CsgBrushId id) {
+    this->for_each_region(this->brushes[id]->bounds, [this, id](CsgRegionCoord coord) {
+        CsgRegion* region = this->find_region(coord);
+        if(!region) {
+            return;
+        }
+        auto& brushes = region->brushes;
+        const auto found = std::lower_bound(brushes.begin(), brushes.end(), id);
+        if(found != brushes.end() && *found == id) {
+            brushes.erase(found);
+        }
+        region->dirty = true;
+        region->edit_count++;
+    });
+}
+
+CsgRegion* CsgCompiler::find_region(CsgRegionCoord coord) {
+    const auto found = this->regions.find(coord.get_key());
+    return found == this->regions.end() ? nullptr : found->second.get();
+}
+
+void CsgCompiler::start_compile(CsgRegion* region) {
+    // Jobs share the brushes rather than copying them, since
+    // brushes are replaced rather than changed
+    auto brushes = std::make_shared<std::vector<std::shared_ptr<const CsgBrush>>>();
+    for(const CsgBrushId id : region->brushes) {
+        brushes->push_back(this->brushes[id]);
+    }
+    auto result = std::make_shared<CsgRegionMesh>();
+    const Bounds3 bounds = CsgRegion_GetBounds(region->coord, this->region_size);
+    const float texture_size = this->texture_size;
+    const CsgRegionCoord coord = region->coord;
+    const uint64_t edit_count = region->edit_count;
+    const uint32_t generation = this->generation;
+    region->dirty = false;
+    region->compiling = true;
+    this->job_handles.push_back(this->jobs->submit(
+        [brushes, result, bounds, texture_size]() {
+            std::vector<const CsgBrush*> pointers;
+            pointers.reserve(brushes->size());
+            for(const auto& brush : *brushes) {
+                pointers.push_back(brush.get());
+            }
+            CsgRegion_Compile(bounds, pointers, texture_size, result.get());
+        },
+        {},
+        [this, result, coord, edit_count, generation]() {
+            if(generation != this->generation) {
+                return;
+            }
+            CsgRegion* region = this->find_region(coord);
+            if(!region) {
+                return;
+            }
+            region->compiling = false;
+            // A brush changed while compiling, and the region is
+            // still dirty, so it will be compiled again
+            if(region->edit_count != edit_count) {
+                return;
+            }
+            region->mesh = std::move(*result);
+            region->mesh_revision++;
+            this->revision++;
+        }
+    ));
+}
+
+void CsgCompiler::remove_empty_regions() {
+    const size_t count = this->regions.size();
+    std::erase_if(this->regions, [](const auto& entry) {
+        return entry.second->brushes.empty() && !entry.second->compiling;
+    });
+    if(this->regions.size() != count) {
+        this->revision++;
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "brush.hpp"
+#include "jobs/job_system.hpp"
+#include "level/mesh.hpp"
+
+// Identifies a brush in a CsgCompiler. Brushes are combined in
+// order of their ids, which are never reused.
+typedef uint32_t CsgBrushId;
+
+const CsgBrushId CsgBrushId_None = UINT32_MAX;
+
+// Position of a region in the grid of regions.
+struct CsgRegionCoord {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t z = 0;
+    
+    bool operator==(const CsgRegionCoord& other) const {
+        return this->x == other.x && this->y == other.y && this->z == other.z;
+    }
+    // Pack into a single value, for use as a map key. Each
+    // component keeps its low 21 bits.
+    uint64_t get_key() const {
+        return (
+            (((uint64_t) (uint32_t) this->x & 0x1fffff) << 42) |
+            (((uint64_t) (uint32_t) this->y & 0x1fffff) << 21) |
+            ((uint64_t) (uint32_t) this->z & 0x1fffff)
+        );
+    }
+};
+
+// Triangles of one material within a region's render mesh.
+struct CsgMaterialRange {
+    LevelMaterialId material = LevelMaterialId_None;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+};
+
+// Collision geometry, with vertexes shared between triangles.
+struct CsgCollisionMesh {
+    std::vector<Vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// Output of compiling one region.
+struct CsgRegionMesh {
+    // Triangles with normals and UVs, grouped by material
+    LevelMesh render;
+    std::vector<CsgMaterialRange> material_ranges;
+    CsgCollisionMesh collision;
+};
+
+// One cube of the world, compiled separately from the others.
+struct CsgRegion {
+    CsgRegionCoord coord;
+    // Brushes overlapping the region, in order
+    std::vector<CsgBrushId> brushes;
+    // Set when the region's brushes changed since it was compiled
+    bool dirty = true;
+    bool compiling = false;
+    // Incremented by every change to the region's brushes, so that
+    // the results of a compile which started before one are dropped
+    uint64_t edit_count = 0;
+    // Incremented each time a compile finishes
+    uint64_t mesh_revision = 0;
+    CsgRegionMesh mesh;
+};
+
+/**
+ * Compiles brushes into render and collision meshes.
+ * 
+ * The world is divided into a grid of cubic regions, and each
+ * region is compiled on its own, from only the brushes which
+ * overlap it. Each face of those brushes is clipped to the region,
+ * then split by the other brushes so that every piece is wholly
+ * inside or outside each of them. A piece is kept if the solid
+ * found by applying every brush in order differs on its two sides,
+ * and it faces away from the solid side.
+ * 
+ * Regions and brushes form a dependency graph: each region lists
+ * the brushes overlapping it. Changing a brush marks the regions
+ * it overlapped before and after the change as dirty, and only
+ * those are compiled again, each by its own job. Jobs write their
+ * triangles straight into the buffers which the region then keeps.
+ */
+class CsgCompiler {
+public:
+    CsgCompiler() {};
+    CsgCompiler(JobSystem* jobs): jobs(jobs) {};
+    CsgCompiler(const CsgCompiler&) = delete;
+    CsgCompiler& operator=(const CsgCompiler&) = delete;
+    CsgCompiler& operator=(CsgCompiler&& other) = default;
+    
+    // Compiles regions in the background if set
+    JobSystem* jobs = nullptr;
+    // Width of each region, in world units. Call clear before
+    // changing it.
+    float region_size = 64.0f;
+    // World units per repeat of a texture across a face
+    float texture_size = 4.0f;
+    // Incremented whenever any region's mesh changes, or a region
+    // is removed
+    uint64_t revision = 0;
+    
+    // Returns CsgBrushId_None if the brush has no volume.
+    CsgBrushId add_brush(const CsgBrush& brush);
+    // Returns false if there is no such brush, or if the new brush
+    // has no volume.
+    bool set_brush(CsgBrushId id, const CsgBrush& brush);
+    bool remove_brush(CsgBrushId id);
+    // Get a brush, or nullptr if there is none with that id.
+    const CsgBrush* get_brush(CsgBrushId id) const;
+    uint32_t get_brush_count() const {
+        return this->brush_count;
+    }
+    // Remove every brush and region. Waits for compile jobs.
+    void clear();
+    
+    // Start compiling dirty regions in the background, and remove
+    // regions which no longer overlap any brush. Call once per
+    // frame, after JobSystem::update. Compiles on the calling
+    // thread if there is no job system.
+    void update();
+    // Compile every dirty region now, in parallel, waiting for any
+    // compiles already running.
+    void compile_all();
+    // Wait for compile jobs, and discard their results.
+    void cancel();
+    uint32_t get_dirty_count() const;
+    
+    const std::unordered_map<uint64_t, std::unique_ptr<CsgRegion>>& get_regions() const {
+        return this->regions;
+    }
+    
+private:
+    // Indexed by CsgBrushId, and null once removed. Brushes are
+    // never changed in place, so compile jobs can share them.
+    std::vector<std::shared_ptr<const CsgBrush>> brushes;
+    uint32_t brush_count = 0;
+    std::unordered_map<uint64_t, std::unique_ptr<CsgRegion>> regions;
+    std::vector<JobHandle> job_handles;
+    // Incremented by cancel, so that callbacks from jobs started
+    // before it are ignored.
+    uint32_t generation = 0;
+    
+    // Call fn for the coordinates of every region a box overlaps.
+    template<typename Fn>
+    void for_each_region(const Bounds3& bounds, Fn&& fn) const;
+    void link_brush(CsgBrushId id);
+    void unlink_brush(CsgBrushId id);
+    CsgRegion* find_region(CsgRegionCoord coord);
+    void start_compile(CsgRegion* region);
+    // Remove regions which no longer overlap any brush.
+    void remove_empty_regions();
+};
+
+// Get the bounds of a region.
+Bounds3 CsgRegion_GetBounds(CsgRegionCoord coord, float region_size);
+// Compile the brushes overlapping a region into its meshes. The
+// brushes must be in order.
+void CsgRegion_Compile(
+    const Bounds3& region_bounds,
+    const std::vector<const CsgBrush*>& brushes,
+    float texture_size,
+    CsgRegionMesh* mesh
+);
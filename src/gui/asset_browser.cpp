@@ -0,0 +1,130 @@
+#include "asset_browser.hpp"
+
+#include <algorithm>
+
+#include "imgui.h"
+
+#include "app.hpp"
+#include "util/profiler.hpp"
+
+void GUIAssetBrowser::init() {
+    this->atlas->init(AssetThumbnail_Size);
+    this->texture = RaylibTexture2D{
+        this->atlas->get_texture(),
+        (int) RenderThumbnailAtlas_TextureSize,
+        (int) RenderThumbnailAtlas_TextureSize,
+        1,
+        RAYLIB_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+    };
+}
+
+void GUIAssetBrowser::conclude() {
+    this->thumbnailer->cancel();
+    this->atlas->conclude();
+    this->texture = {};
+}
+
+void GUIAssetBrowser::toggle() {
+    this->showing = !this->showing;
+}
+
+void GUIAssetBrowser::reset() {
+    this->thumbnailer->cancel();
+    this->atlas->clear();
+}
+
+void GUIAssetBrowser::draw() {
+    UNI_PROFILE_ZONE("GUIAssetBrowser::draw");
+    this->atlas->begin_frame();
+    if(this->showing) {
+        ImGui::PushFont(this->context->get_imgui_font(this->font));
+        ImGui::SetNextWindowSize(ImVec2(480.0f, 400.0f), ImGuiCond_FirstUseEver);
+        if(ImGui::Begin("Assets", &this->showing)) {
+            ImGui::TextDisabled("%u meshes", (unsigned) this->app->level.mesh_assets.size());
+            this->draw_grid();
+        }
+        ImGui::End();
+        ImGui::PopFont();
+    }
+    // Uploaded after the grid has looked up the thumbnails in view,
+    // so that they keep their slots. New ones show next frame.
+    AssetThumbnail thumbnail;
+    while(this->atlas->can_upload() && this->thumbnailer->pop_ready(&thumbnail)) {
+        this->atlas->upload(thumbnail.id, thumbnail.pixels.data());
+    }
+}
+
+void GUIAssetBrowser::draw_grid() {
+    if(!ImGui::BeginChild("##Grid", ImVec2(0.0f, 0.0f), true)) {
+        ImGui::EndChild();
+        return;
+    }
+    const ImGuiStyle& style = ImGui::GetStyle();
+    const float size = this->thumbnail_size * this->context->get_scale();
+    const int column_count = std::max(
+        1, (int) ((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / (size + style.ItemSpacing.x))
+    );
+    const uint32_t mesh_count = (uint32_t) this->app->level.mesh_assets.size();
+    const int row_count = (int) ((mesh_count + column_count - 1) / column_count);
+    const float row_height = size + ImGui::GetTextLineHeight() + style.ItemSpacing.y * 2.0f;
+    ImGuiListClipper clipper;
+    clipper.Begin(row_count, row_height);
+    while(clipper.Step()) {
+        for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            for(int column = 0; column < column_count; ++column) {
+                const uint32_t mesh_id = (uint32_t) (row * column_count + column);
+                if(mesh_id >= mesh_count) {
+                    break;
+                }
+                if(column > 0) {
+                    ImGui::SameLine();
+                }
+                this->draw_item(mesh_id, size);
+            }
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+}
+
+void GUIAssetBrowser::draw_item(LevelMeshId mesh_id, float size) {
+    const LevelMesh& mesh = this->app->level.mesh_assets[mesh_id];
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImGui::PushID((int) mesh_id);
+    ImGui::BeginGroup();
+    const int slot = this->atlas->find(mesh_id);
+    if(slot >= 0) {
+        float u0, v0, u1, v1;
+        this->atlas->get_slot_uvs(slot, &u0, &v0, &u1, &v1);
+        ImGui::Image((ImTextureID) &this->texture, ImVec2(size, size), ImVec2(u0, v0), ImVec2(u1, v1));
+    } else {
+        const ImVec2 min = ImGui::GetCursorScreenPos();
+        ImGui::Dummy(ImVec2(size, size));
+        draw_list->AddRect(min, ImVec2(min.x + size, min.y + size), ImGui::GetColorU32(ImGuiCol_Border));
+        if(!mesh.positions.empty() && !mesh.indices.empty()) {
+            this->thumbnailer->request(AssetThumbnailSource_FromMesh(mesh_id, mesh));
+        }
+    }
+    // Names are cut off at the thumbnail's width, keeping every row
+    // the same height for the clipper
+    const std::string_view name = mesh.name.view();
+    const ImVec2 text_min = ImGui::GetCursorScreenPos();
+    const float line_height = ImGui::GetTextLineHeight();
+    ImGui::Dummy(ImVec2(size, line_height));
+    const ImVec4 clip = ImVec4(text_min.x, text_min.y, text_min.x + size, text_min.y + line_height);
+    this->context->use_text(name.data(), name.data() + name.size());
+    draw_list->AddText(
+        ImGui::GetFont(), ImGui::GetFontSize(), text_min, ImGui::GetColorU32(ImGuiCol_Text),
+        name.data(), name.data() + name.size(), 0.0f, &clip
+    );
+    ImGui::EndGroup();
+    if(ImGui::IsItemHovered()) {
+        ImGui::BeginTooltip();
+        ImGui::TextUnformatted(name.data(), name.data() + name.size());
+        ImGui::TextDisabled(
+            "%zu vertexes, %zu triangles", mesh.positions.size(), mesh.indices.size() / 3
+        );
+        ImGui::EndTooltip();
+    }
+    ImGui::PopID();
+}
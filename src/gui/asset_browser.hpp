@@ -0,0 +1,62 @@
+#pragma once
+
+#include "raylib.h"
+
+#include "assets/thumbnail.hpp"
+#include "context.hpp"
+#include "render/thumbnail_atlas.hpp"
+
+/**
+ * Window which shows the level's meshes as a grid of thumbnails.
+ * 
+ * Only the rows in view are visited each frame. Thumbnails are
+ * drawn from the atlas when it has them; otherwise a placeholder
+ * is drawn and the thumbnailer is asked for them, and finished
+ * ones are uploaded to the atlas at its per-frame limit, so that
+ * scrolling never waits on thumbnails.
+ */
+class GUIAssetBrowser {
+public:
+    GUIAssetBrowser() {};
+    GUIAssetBrowser(
+        App* app,
+        GUIContext* context,
+        AssetThumbnailer* thumbnailer,
+        RenderThumbnailAtlas* atlas
+    ):
+        app(app),
+        context(context),
+        thumbnailer(thumbnailer),
+        atlas(atlas)
+    {};
+    
+    App* app = nullptr;
+    GUIContext* context = nullptr;
+    AssetThumbnailer* thumbnailer = nullptr;
+    RenderThumbnailAtlas* atlas = nullptr;
+    GUIFont font = GUIFont_Small;
+    bool showing = false;
+    // Thumbnail width and height at a scale of 1
+    float thumbnail_size = 64.0f;
+    
+    // Create the atlas. Call after the window is created.
+    void init();
+    // Free the atlas.
+    void conclude();
+    // Show the browser if hidden, or hide it if shown
+    void toggle();
+    // Forget every thumbnail, as when the level is replaced and
+    // mesh ids change meaning. Waits for thumbnails in progress.
+    void reset();
+    // Upload finished thumbnails, and draw the browser window
+    void draw();
+    
+    void draw_grid();
+    // Draw one mesh's thumbnail or placeholder, and its name.
+    void draw_item(LevelMeshId mesh_id, float size);
+    
+private:
+    // rlImGui draws ImTextureID values as Texture pointers, so this
+    // describes the atlas texture at a stable address.
+    RaylibTexture2D texture = {};
+};
@@ -5,9 +5,10 @@
 
 #include "imgui.h"
 #include "imgui_internal.h"
-#include "spdlog/spdlog.h"
 
 #include "app.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
 #include "util/string.hpp"
 #include "gui/imgui_util.hpp"
 
@@ -18,7 +19,7 @@ bool GUICommandPaletteCommand_AlwaysActiveCallback(
 }
 
 void GUICommandPalette::init() {
-    spdlog::debug("Initializing GUICommandPalette.");
+    UNI_LOG_DEBUG(LogSubsystem_GUI, "Initializing GUICommandPalette.");
     this->action_show = this->app->input.add_action(InputAction{
         "ui_command_palette_show",
         InputContext_General
@@ -87,7 +88,7 @@ void GUICommandPalette::show() {
     if(this->showing) {
         return;
     }
-    spdlog::debug("Showing GUICommandPalette.");
+    UNI_LOG_DEBUG(LogSubsystem_GUI, "Showing GUICommandPalette.");
     this->showing = true;
     this->show_init = true;
     this->selected_result_index = 0;
@@ -100,7 +101,7 @@ void GUICommandPalette::show() {
 }
 
 void GUICommandPalette::hide() {
-    spdlog::debug("Hiding GUICommandPalette.");
+    UNI_LOG_DEBUG(LogSubsystem_GUI, "Hiding GUICommandPalette.");
     this->showing = false;
     this->show_init = false;
     this->app->input.pop_context(InputContext_CommandPalette);
@@ -111,6 +112,7 @@ bool GUICommandPalette::is_showing() {
 }
 
 void GUICommandPalette::draw() {
+    UNI_PROFILE_ZONE("GUICommandPalette::draw");
     this->input_text_modified = false;
     this->hovered_result_index = -1;
     if(!this->showing) {
@@ -163,9 +165,10 @@ void GUICommandPalette::draw() {
         IM_ARRAYSIZE(this->input_text),
         ImGuiInputTextFlags_EnterReturnsTrue
     );
+    this->context->use_text(this->input_text);
     if(input_submitted) {
         this->input_text_submitted = true;
-        spdlog::trace("GUICommandPalette InputText field submitted.");
+        UNI_LOG_TRACE(LogSubsystem_GUI, "GUICommandPalette InputText field submitted.");
     }
     else if(ImGui::IsItemEdited()) {
         this->input_text_modified = true;
@@ -209,7 +212,7 @@ void GUICommandPalette::draw() {
     ImGui::PopFont();
     ImGui::EndChild();
     if(!ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows)) {
-        spdlog::trace("GUICommandPalette window no longer focused.");
+        UNI_LOG_TRACE(LogSubsystem_GUI, "GUICommandPalette window no longer focused.");
         this->hide();
     }
     ImGui::End();
@@ -269,8 +272,9 @@ bool GUICommandPalette::draw_result(
     if(im_context.LogEnabled) {
         ImGui::LogSetNextTextDecoration("[", "]");
     }
+    this->context->use_text(command.name.c_str());
     const ImVec2 name_label_size = ImGui::CalcTextSize(
-        command.name.c_str(), nullptr, true
+        command.name.c_str(), command.name.c_str() + command.name.size(), true
     );
     const ImU32 text_color = ImGui::GetColorU32(
         result.active ? ImGuiCol_Text : ImGuiCol_TextDisabled
@@ -281,11 +285,12 @@ bool GUICommandPalette::draw_result(
         box.Min + style.FramePadding,
         text_color,
         command.name.c_str(),
-        nullptr,
+        command.name.c_str() + command.name.size(),
         0.0f,
         nullptr
     );
     if(hovered && command.summary.size() > 0) {
+        this->context->use_text(command.summary.c_str());
         ImGuiUtil::SetTooltipUnformatted(command.summary.c_str());
     }
     if(hovered) {
@@ -295,6 +300,7 @@ bool GUICommandPalette::draw_result(
 }
 
 void GUICommandPalette::update() {
+    UNI_PROFILE_ZONE("GUICommandPalette::update");
     if(!this->showing) {
         if(this->app->input.is_action_active(this->action_show)) {
             this->show();
@@ -355,9 +361,10 @@ void GUICommandPalette::update() {
 void GUICommandPalette::add_command(
     GUICommandPaletteCommand command
 ) {
-    spdlog::debug(
+    UNI_LOG_DEBUG(
+        LogSubsystem_GUI,
         "Adding GUICommandPalette command '{}'.",
-        command.name
+        command.name.c_str()
     );
     // Order commands alphabetically by name
     auto comparator = [](
@@ -386,7 +393,7 @@ void GUICommandPalette::activate_result(
         this->commands.size() ==
         this->command_activated_times.size()
     );
-    spdlog::trace("Activating GUICommandPalette result.");
+    UNI_LOG_TRACE(LogSubsystem_GUI, "Activating GUICommandPalette result.");
     if(result.command < 0 ||
         result.command >= this->commands.size()
     ) {
@@ -396,22 +403,33 @@ void GUICommandPalette::activate_result(
         this->commands[result.command]
     );
     this->hide();
-    spdlog::debug(
+    UNI_LOG_DEBUG(
+        LogSubsystem_GUI,
         "Activating GUICommandPalette command '{}'.",
-        command.name
+        command.name.c_str()
     );
-    command.activated_callback();
+    if(command.activated_task) {
+        this->app->tasks.start(
+            std::string(command.name.view()), command.activated_task
+        );
+    }
+    else if(command.activated_callback) {
+        command.activated_callback();
+    }
     this->command_activated_times[result.command] = (
         this->command_time
     );
     this->command_time++;
 }
 
-void GUICommandPalette::update_command_result(const int i) {
+void GUICommandPalette::update_command_result(
+    const int i, std::string_view input_str
+) {
     // TODO: also compare alias strings, in addition to name?
     auto& command = this->commands[i];
-    auto input_str = std::string(this->input_text);
-    const auto match = string_fuzzy_match(input_str, command.name);
+    const auto match = string_fuzzy_match(
+        input_str, command.name.view(), &this->app->frame_arena
+    );
     // If there are too many characters in the search string that
     // did not match the command name, then cut it from the results
     const int unmatched_chars = input_str.size() - match.matched;
@@ -430,13 +448,15 @@ void GUICommandPalette::update_command_result(const int i) {
     const int recency_score = ImMax(0, 16 - command_age);
     const int inactivity_score = command_active ? 0 : -32;
     const int sort_score = match.score + recency_score + inactivity_score;
-    spdlog::trace(
+    UNI_LOG_TRACE(
+        LogSubsystem_GUI,
         "string_fuzzy_match: score {}, matched {}",
         match.score, match.matched
     );
-    spdlog::trace(
+    UNI_LOG_TRACE(
+        LogSubsystem_GUI,
         "GUICommandPalette sort_score is {} for input '{}' and command '{}'.",
-        sort_score, input_str, command.name
+        sort_score, input_str, command.name.c_str()
     );
     auto result = GUICommandPaletteResult{
         .command = i,
@@ -447,11 +467,13 @@ void GUICommandPalette::update_command_result(const int i) {
 }
 
 void GUICommandPalette::update_results() {
+    UNI_PROFILE_ZONE("GUICommandPalette::update_results");
     IM_ASSERT(
         this->commands.size() ==
         this->command_activated_times.size()
     );
-    spdlog::trace(
+    UNI_LOG_TRACE(
+        LogSubsystem_GUI,
         "Updating GUICommandPalette results for input text '{}'.",
         this->input_text
     );
@@ -467,8 +489,9 @@ void GUICommandPalette::update_results() {
         }
     }
     else {
+        const std::string_view input_str = this->input_text;
         for(int i = 0; i < this->commands.size(); ++i) {
-            this->update_command_result(i);
+            this->update_command_result(i, input_str);
         }
         auto comparator = [](
             const GUICommandPaletteResult& a,
@@ -2,10 +2,13 @@
 
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "context.hpp"
 #include "input/controller.hpp"
+#include "jobs/task.hpp"
+#include "util/symbol.hpp"
 
 // Forward declaration for GUICommandPaletteCommand_AlwaysActiveCallback.
 struct GUICommandPaletteCommand;
@@ -19,7 +22,7 @@ bool GUICommandPaletteCommand_AlwaysActiveCallback(
 // TODO array of aliases for easier search
 struct GUICommandPaletteCommand {
     // Readable, uniquely identifying title for the command
-    std::string name;
+    Symbol name;
     // Brief help text explaining the command
     std::string summary;
     // Callback is invoked when the command is selected
@@ -31,6 +34,10 @@ struct GUICommandPaletteCommand {
     std::function<bool(GUICommandPaletteCommand* command)> get_active_callback = (
         GUICommandPaletteCommand_AlwaysActiveCallback
     );
+    // Optional coroutine started on the App's TaskRunner when the
+    // command is selected, for commands which take a long time.
+    // Used instead of activated_callback when set.
+    TaskFunction activated_task = nullptr;
 };
 
 // TODO: give better score to recently used commands
@@ -102,5 +109,5 @@ public:
     );
     void activate_result(GUICommandPaletteResult& result);
     void update_results();
-    void update_command_result(const int i);
+    void update_command_result(const int i, std::string_view input_str);
 };
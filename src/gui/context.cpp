@@ -1,62 +1,208 @@
 #include "context.hpp"
 
-#include "imgui_freetype.h"
-#include "rlImGui.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+#include "imgui_internal.h"
+#include "raylib.h"
 
 #include "app.hpp"
 #include "input/controller.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// System fonts covering the scripts PublicSans lacks, especially
+// CJK, in order of preference. Only the first installed one is
+// used, since each is loaded once per face and size.
+static const char* const GUIContext_FontFallbackCandidates[] = {
+#if defined(PLATFORM_WINDOWS)
+    "C:/Windows/Fonts/msyh.ttc",
+    "C:/Windows/Fonts/YuGothM.ttc",
+    "C:/Windows/Fonts/malgun.ttf",
+    "C:/Windows/Fonts/arialuni.ttf",
+#elif defined(PLATFORM_DARWIN)
+    "/System/Library/Fonts/PingFang.ttc",
+    "/System/Library/Fonts/Hiragino Sans GB.ttc",
+    "/Library/Fonts/Arial Unicode.ttf",
+#else
+    "/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc",
+    "/usr/share/fonts/noto-cjk/NotoSansCJK-Regular.ttc",
+    "/usr/share/fonts/google-noto-cjk/NotoSansCJK-Regular.ttc",
+    "/usr/share/fonts/truetype/droid/DroidSansFallbackFull.ttf",
+#endif
+};
 
 void GUIContext::init() {
+    this->style_unscaled = ImGui::GetStyle();
+    this->dpi_scale = RaylibGetWindowScaleDPI().x;
+    for(auto& bucket : this->font_buckets) {
+        bucket = std::make_unique<GUIFontBucket>();
+    }
+    // Characters in the default ranges are always loaded
+    this->glyph_cache.base_ranges = ImGui::GetIO().Fonts->GetGlyphRangesDefault();
+    this->glyph_cache.get_build_ranges(this->get_glyph_size_bytes());
+    if(this->font_fallback_paths.empty()) {
+        std::error_code error;
+        for(const char* path : GUIContext_FontFallbackCandidates) {
+            if(std::filesystem::exists(path, error)) {
+                this->font_fallback_paths.push_back(path);
+                break;
+            }
+        }
+    }
+    if(this->font_fallback_paths.empty()) {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "No fallback font found; only PublicSans glyphs will be drawn.");
+    }
+    else {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "Using fallback font '{}'.", this->font_fallback_paths[0]);
+    }
     this->init_fonts();
 }
 
 void GUIContext::init_fonts() {
-    // TODO: don't hardcode font paths
-    // looks good at 18px
-    const auto font_path_regular = "assets/fonts/PublicSans/PublicSans-Regular.ttf";
-    const auto font_path_bold = "assets/fonts/PublicSans/PublicSans-Bold.ttf";
-    // looks alright at 16px
-    // const auto font_path_regular = "assets/fonts/Atkinson-Hyperlegible/Atkinson-Hyperlegible-Regular-102.ttf";
-    // const auto font_path_bold = "assets/fonts/Atkinson-Hyperlegible/Atkinson-Hyperlegible-Bold-102.ttf";
-    ImFontConfig font_config;
-    font_config.FontBuilderFlags = (
-        ImGuiFreeTypeBuilderFlags_ForceAutoHint
-    );
-    ImGuiIO& io = ImGui::GetIO();
-    this->font_small = io.Fonts->AddFontFromFileTTF(
-        font_path_regular,
-        this->font_small_size_px,
-        &font_config
-    );
-    this->font_small_bold = io.Fonts->AddFontFromFileTTF(
-        font_path_bold,
-        this->font_small_size_px,
-        &font_config
-    );
-    this->font_normal = io.Fonts->AddFontFromFileTTF(
-        font_path_regular,
-        this->font_normal_size_px,
-        &font_config
-    );
-    this->font_normal_bold = io.Fonts->AddFontFromFileTTF(
-        font_path_bold,
-        this->font_normal_size_px,
-        &font_config
-    );
-    this->font_big = io.Fonts->AddFontFromFileTTF(
-        font_path_regular,
-        this->font_big_size_px,
-        &font_config
-    );
-    this->font_big_bold = io.Fonts->AddFontFromFileTTF(
-        font_path_bold,
-        this->font_big_size_px,
-        &font_config
+    UNI_PROFILE_ZONE("GUIContext::init_fonts");
+    const uint64_t time_begin_ns = Profiler_Now();
+    // Sizes are built in parallel, and waited for, so that there
+    // are fonts to draw with on the first frame.
+    this->start_font_builds();
+    for(int size = GUIFontSize_Small; size < GUIFontSize_COUNT; ++size) {
+        auto build = this->font_buckets[size]->wait_build(&this->app->jobs);
+        if(build) {
+            this->finish_font_build(size, build.get());
+        }
+    }
+    this->update_style();
+    UNI_LOG_DEBUG(
+        LogSubsystem_GUI,
+        "Loaded fonts in {:.1f} ms.",
+        (double) (Profiler_Now() - time_begin_ns) * 1e-6
     );
-    rlImGuiReloadFonts();
 }
 
-int GUIContext::get_font_size_px(GUIFontSize size) {
+void GUIContext::conclude() {
+    for(auto& bucket : this->font_buckets) {
+        bucket = nullptr;
+    }
+}
+
+void GUIContext::update() {
+    UNI_PROFILE_ZONE("GUIContext::update");
+    // Moving the window to another monitor may change its scale
+    const float dpi_scale = RaylibGetWindowScaleDPI().x;
+    if(dpi_scale > 0.0f && dpi_scale != this->dpi_scale) {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "Window DPI scale changed to {}.", dpi_scale);
+        this->dpi_scale = dpi_scale;
+    }
+    this->glyph_cache.next_frame();
+    if(this->glyph_cache.needs_rebuild()) {
+        this->glyph_cache.get_build_ranges(this->get_glyph_size_bytes());
+    }
+    for(int size = GUIFontSize_Small; size < GUIFontSize_COUNT; ++size) {
+        auto build = this->font_buckets[size]->finish_build(&this->app->jobs);
+        if(build) {
+            this->finish_font_build(size, build.get());
+        }
+    }
+    this->start_font_builds();
+    if(this->style_scale != this->get_scale()) {
+        this->update_style();
+    }
+}
+
+void GUIContext::use_text(const char* text, const char* text_end) {
+    this->glyph_cache.use_text(text, text_end);
+}
+
+void GUIContext::start_font_builds() {
+    const uint32_t ranges_version = this->glyph_cache.ranges_version;
+    for(int size = GUIFontSize_Small; size < GUIFontSize_COUNT; ++size) {
+        auto& bucket = this->font_buckets[size];
+        const int size_px = this->get_scaled_font_size_px(size);
+        // Only sizes whose inputs changed are rebuilt. A build that
+        // is already running finishes first, then is redone if it
+        // became stale in the meantime.
+        if(bucket->is_building() || (
+            bucket->size_px == size_px &&
+            bucket->ranges_version == ranges_version
+        )) {
+            continue;
+        }
+        auto build = std::make_unique<GUIFontAtlasBuild>();
+        build->font_path_regular = this->font_path_regular;
+        build->font_path_bold = this->font_path_bold;
+        build->fallback_paths = this->font_fallback_paths;
+        build->size_px = size_px;
+        build->ranges = this->glyph_cache.ranges;
+        build->ranges_version = ranges_version;
+        // Only atlases with the base glyph ranges are cached, since
+        // those are what every launch starts with.
+        build->use_cache = this->glyph_cache.get_resident_count() == 0;
+        bucket->start_build(&this->app->jobs, std::move(build));
+    }
+}
+
+void GUIContext::finish_font_build(GUIFontSize size, GUIFontAtlasBuild* build) {
+    auto& bucket = this->font_buckets[size];
+    this->glyph_cache.update_after_build(bucket->font_regular, build->ranges.Data);
+    switch(size) {
+        case GUIFontSize_Small: {
+            this->font_small = bucket->font_regular;
+            this->font_small_bold = bucket->font_bold;
+            break;
+        }
+        case GUIFontSize_Normal: {
+            this->font_normal = bucket->font_regular;
+            this->font_normal_bold = bucket->font_bold;
+            break;
+        }
+        case GUIFontSize_Big: {
+            this->font_big = bucket->font_regular;
+            this->font_big_bold = bucket->font_bold;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+void GUIContext::update_style() {
+    // Wait until every size has been rebuilt, so that spacing and
+    // text change scale on the same frame.
+    for(int size = GUIFontSize_Small; size < GUIFontSize_COUNT; ++size) {
+        if(this->font_buckets[size]->size_px != this->get_scaled_font_size_px(size)) {
+            return;
+        }
+    }
+    const float scale = this->get_scale();
+    ImGuiStyle& style = ImGui::GetStyle();
+    style = this->style_unscaled;
+    style.ScaleAllSizes(scale);
+    this->style_scale = scale;
+}
+
+float GUIContext::get_scale() {
+    return this->dpi_scale * this->ui_scale;
+}
+
+void GUIContext::set_ui_scale(float scale) {
+    this->ui_scale = ImClamp(scale, 0.5f, 3.0f);
+    UNI_LOG_DEBUG(LogSubsystem_GUI, "Set UI scale to {}.", this->ui_scale);
+}
+
+size_t GUIContext::get_glyph_size_bytes() {
+    // Each glyph is rasterized once per size and weight, and kept
+    // as RGBA32 pixels in the atlas texture.
+    size_t size_bytes = 0;
+    for(int size = GUIFontSize_Small; size < GUIFontSize_COUNT; ++size) {
+        const size_t size_px = (size_t) this->get_scaled_font_size_px(size);
+        size_bytes += 2 * size_px * size_px * 4;
+    }
+    return size_bytes;
+}
+
+int GUIContext::get_base_font_size_px(GUIFontSize size) {
     switch(size) {
         case GUIFontSize_Small: {
             return this->font_small_size_px;
@@ -73,6 +219,20 @@ int GUIContext::get_font_size_px(GUIFontSize size) {
     }
 }
 
+int GUIContext::get_scaled_font_size_px(GUIFontSize size) {
+    const float size_px = (float) this->get_base_font_size_px(size) * this->get_scale();
+    return std::max(1, (int) std::lround(size_px));
+}
+
+int GUIContext::get_font_size_px(GUIFontSize size) {
+    if(size > GUIFontSize_None && size < GUIFontSize_COUNT &&
+        this->font_buckets[size] && this->font_buckets[size]->size_px > 0
+    ) {
+        return this->font_buckets[size]->size_px;
+    }
+    return this->get_scaled_font_size_px(size);
+}
+
 int GUIContext::get_font_size_px(GUIFont font) {
     return this->get_font_size_px(font.size);
 }
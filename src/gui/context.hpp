@@ -1,7 +1,14 @@
 #pragma once
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "imgui.h"
 
+#include "font_atlas.hpp"
+#include "glyph_cache.hpp"
+
 class App; // Forward declaration for App from app.hpp
 
 typedef int GUIFontSize;
@@ -31,6 +38,8 @@ public:
     GUIContext(App* app): app(app) {};
     
     App* app = nullptr;
+    // Font sizes at a scale of 1. Actual sizes also depend on the
+    // window's DPI scale and the user's UI scale.
     int font_small_size_px = 14;
     ImFont* font_small = nullptr;
     ImFont* font_small_bold = nullptr;
@@ -40,9 +49,61 @@ public:
     int font_big_size_px = 24;
     ImFont* font_big = nullptr;
     ImFont* font_big_bold = nullptr;
+    // TODO: don't hardcode font paths
+    // looks good at 18px
+    std::string font_path_regular = "assets/fonts/PublicSans/PublicSans-Regular.ttf";
+    std::string font_path_bold = "assets/fonts/PublicSans/PublicSans-Bold.ttf";
+    // looks alright at 16px
+    // std::string font_path_regular = "assets/fonts/Atkinson-Hyperlegible/Atkinson-Hyperlegible-Regular-102.ttf";
+    // std::string font_path_bold = "assets/fonts/Atkinson-Hyperlegible/Atkinson-Hyperlegible-Bold-102.ttf";
+    // Fonts merged into every face to provide glyphs which
+    // PublicSans lacks, such as CJK. Missing files are skipped. If
+    // left empty, init picks the first installed system font from
+    // a list of common ones.
+    std::vector<std::string> font_fallback_paths;
+    // Loads glyphs outside the default ranges as text needs them
+    GUIGlyphCache glyph_cache;
+    // One atlas per font size, indexed by GUIFontSize
+    std::unique_ptr<GUIFontBucket> font_buckets[GUIFontSize_COUNT];
+    // Scale chosen by the user, on top of the window's DPI scale
+    // TODO: remember between launches
+    float ui_scale = 1.0f;
+    // Content scale of the monitor the window is on
+    float dpi_scale = 1.0f;
+    // Scale which the ImGui style was last scaled to
+    float style_scale = 1.0f;
+    // ImGui style at a scale of 1
+    ImGuiStyle style_unscaled;
     
     void init();
+    // Build fonts for the current scale, blocking until done
     void init_fonts();
+    // Release fonts and their textures. Call after the JobSystem
+    // has stopped and before the window is closed.
+    void conclude();
+    // Apply finished font builds and start new ones as needed.
+    // Call once per frame, before rlImGuiBegin, while font atlases
+    // are not locked.
+    void update();
+    // Report UTF-8 text which is being drawn this frame, so that
+    // its glyphs will be loaded. ASCII text need not be reported.
+    void use_text(const char* text, const char* text_end = nullptr);
+    // Start building atlases whose size or glyphs are out of date
+    void start_font_builds();
+    // Use the fonts from a finished atlas build
+    void finish_font_build(GUIFontSize size, GUIFontAtlasBuild* build);
+    // Scale the ImGui style to match the current fonts
+    void update_style();
+    // Get the combined DPI and UI scale
+    float get_scale();
+    void set_ui_scale(float scale);
+    // Estimate atlas memory used by one glyph across all fonts.
+    size_t get_glyph_size_bytes();
+    // Get the font size at a scale of 1
+    int get_base_font_size_px(GUIFontSize size);
+    // Get the font size to build for the current scale
+    int get_scaled_font_size_px(GUIFontSize size);
+    // Get the size of the font currently used to draw text
     int get_font_size_px(GUIFontSize size);
     int get_font_size_px(GUIFont font);
     ImFont* get_imgui_font(GUIFont font);
@@ -0,0 +1,144 @@
+#include "font_atlas.hpp"
+
+#include <filesystem>
+
+#include "imgui_freetype.h"
+
+#include "gui/font_cache.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+GUIFontAtlasBuild::~GUIFontAtlasBuild() {
+    if(this->atlas) {
+        IM_DELETE(this->atlas);
+    }
+}
+
+void GUIFontAtlasBuild::run() {
+    UNI_PROFILE_ZONE("GUIFontAtlasBuild::run");
+    const uint64_t time_begin_ns = Profiler_Now();
+    // Atlases other than io.Fonts are never touched by ImGui during
+    // a frame, so building one here doesn't race with the GUI.
+    this->atlas = IM_NEW(ImFontAtlas)();
+    ImFontConfig font_config;
+    font_config.FontBuilderFlags = (
+        ImGuiFreeTypeBuilderFlags_ForceAutoHint
+    );
+    font_config.GlyphRanges = this->ranges.Data;
+    // Glyphs missing from the main fonts are taken from fallback
+    // fonts, e.g. to cover CJK scripts.
+    ImFontConfig merge_config = font_config;
+    merge_config.MergeMode = true;
+    auto add_font = [&](const std::string& path) -> ImFont* {
+        ImFont* font = this->atlas->AddFontFromFileTTF(
+            path.c_str(), (float) this->size_px, &font_config
+        );
+        for(const auto& fallback_path : this->fallback_paths) {
+            if(std::filesystem::exists(fallback_path)) {
+                this->atlas->AddFontFromFileTTF(
+                    fallback_path.c_str(), (float) this->size_px, &merge_config
+                );
+            }
+        }
+        return font;
+    };
+    this->font_regular = add_font(this->font_path_regular);
+    this->font_bold = add_font(this->font_path_bold);
+    // Adding fonts only loads their files. Rasterizing them is the
+    // slow part, and is skipped when a matching atlas was cached.
+    const std::string cache_path = GUIFontCache_GetDefaultPath(this->size_px);
+    const uint64_t atlas_key = GUIFontCache_GetAtlasKey(this->atlas);
+    this->cache_hit = this->use_cache && GUIFontCache_Load(
+        this->atlas, atlas_key, cache_path.c_str()
+    );
+    if(!this->cache_hit) {
+        this->atlas->Build();
+        if(this->use_cache) {
+            GUIFontCache_Save(this->atlas, atlas_key, cache_path.c_str());
+        }
+    }
+    this->duration_ns = Profiler_Now() - time_begin_ns;
+}
+
+GUIFontBucket::~GUIFontBucket() {
+    // Builds still reference this bucket's build, so the JobSystem
+    // must have finished them before buckets are destroyed.
+    if(this->texture.id != 0) {
+        RaylibUnloadTexture(this->texture);
+    }
+    if(this->atlas) {
+        IM_DELETE(this->atlas);
+    }
+}
+
+bool GUIFontBucket::is_building() {
+    return this->build != nullptr;
+}
+
+void GUIFontBucket::start_build(
+    JobSystem* jobs, std::unique_ptr<GUIFontAtlasBuild> build
+) {
+    IM_ASSERT(!this->build && "Font bucket is already building.");
+    this->build = std::move(build);
+    GUIFontAtlasBuild* build_ptr = this->build.get();
+    this->build_job = jobs->submit([build_ptr]() {
+        build_ptr->run();
+    });
+}
+
+std::unique_ptr<GUIFontAtlasBuild> GUIFontBucket::finish_build(JobSystem* jobs) {
+    if(!this->build || !jobs->is_done(this->build_job)) {
+        return nullptr;
+    }
+    UNI_PROFILE_ZONE("GUIFontBucket::finish_build");
+    std::unique_ptr<GUIFontAtlasBuild> build = std::move(this->build);
+    this->build_job = JobHandle_None;
+    // Failed builds are not retried until the inputs change
+    this->size_px = build->size_px;
+    this->ranges_version = build->ranges_version;
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    if(build->font_regular && build->font_bold && build->atlas->IsBuilt()) {
+        build->atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    }
+    if(!pixels) {
+        UNI_LOG_ERROR(LogSubsystem_GUI, "Failed to build {}px fonts.", build->size_px);
+        return build;
+    }
+    RaylibImage image = RaylibImage{
+        pixels, width, height, 1, RAYLIB_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+    };
+    if(this->texture.id != 0) {
+        RaylibUnloadTexture(this->texture);
+    }
+    // The texture is replaced in place, keeping its address valid
+    // as the atlas's texture ID.
+    this->texture = RaylibLoadTextureFromImage(image);
+    build->atlas->SetTexID((ImTextureID) &this->texture);
+    // Once uploaded, the pixels are only needed by the GPU
+    build->atlas->ClearTexData();
+    if(this->atlas) {
+        IM_DELETE(this->atlas);
+    }
+    this->atlas = build->atlas;
+    this->font_regular = build->font_regular;
+    this->font_bold = build->font_bold;
+    build->atlas = nullptr;
+    UNI_LOG_DEBUG(
+        LogSubsystem_GUI,
+        "Built {}px fonts in {:.1f} ms ({}).",
+        build->size_px,
+        (double) build->duration_ns * 1e-6,
+        build->cache_hit ? "from atlas cache" : "rasterized"
+    );
+    return build;
+}
+
+std::unique_ptr<GUIFontAtlasBuild> GUIFontBucket::wait_build(JobSystem* jobs) {
+    if(!this->build) {
+        return nullptr;
+    }
+    jobs->wait(this->build_job);
+    return this->finish_build(jobs);
+}
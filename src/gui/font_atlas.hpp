@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "imgui.h"
+#include "raylib.h"
+
+#include "jobs/job_system.hpp"
+
+/**
+ * Inputs and outputs for building one font atlas, holding a regular
+ * and a bold face of the same size.
+ * 
+ * Builds keep their own copies of paths and glyph ranges, so that
+ * they can run on a worker thread while the GUIContext that started
+ * them keeps changing.
+ */
+struct GUIFontAtlasBuild {
+    std::string font_path_regular;
+    std::string font_path_bold;
+    std::vector<std::string> fallback_paths;
+    int size_px = 0;
+    // Zero-terminated glyph ranges, and the GUIGlyphCache version
+    // they were taken from
+    ImVector<ImWchar> ranges;
+    uint32_t ranges_version = 0;
+    // Try the disk cache before rasterizing
+    bool use_cache = false;
+    // Outputs. The atlas is owned by the build until it is applied.
+    ImFontAtlas* atlas = nullptr;
+    ImFont* font_regular = nullptr;
+    ImFont* font_bold = nullptr;
+    bool cache_hit = false;
+    uint64_t duration_ns = 0;
+    
+    GUIFontAtlasBuild() {};
+    GUIFontAtlasBuild(const GUIFontAtlasBuild&) = delete;
+    GUIFontAtlasBuild& operator=(const GUIFontAtlasBuild&) = delete;
+    ~GUIFontAtlasBuild();
+    
+    // Load fonts and rasterize the atlas. May run on any thread.
+    void run();
+};
+
+/**
+ * The fonts of one GUIFontSize, baked into their own atlas and
+ * texture so that each size can be rebuilt without the others.
+ * 
+ * Builds run on the JobSystem. Once one has finished, its atlas
+ * replaces the current one between frames, so text keeps drawing
+ * with the old atlas until the new one is ready.
+ */
+class GUIFontBucket {
+public:
+    GUIFontBucket() {};
+    GUIFontBucket(const GUIFontBucket&) = delete;
+    GUIFontBucket& operator=(const GUIFontBucket&) = delete;
+    ~GUIFontBucket();
+    
+    ImFontAtlas* atlas = nullptr;
+    ImFont* font_regular = nullptr;
+    ImFont* font_bold = nullptr;
+    // rlImGui draws ImTextureID values as Texture pointers, so the
+    // atlas texture must stay at a stable address.
+    RaylibTexture2D texture = {};
+    // Size and glyph ranges version of the current atlas
+    int size_px = 0;
+    uint32_t ranges_version = 0;
+    
+    // Returns true while a build is running or waiting to be applied.
+    bool is_building();
+    // Start building a replacement atlas on the JobSystem.
+    void start_build(JobSystem* jobs, std::unique_ptr<GUIFontAtlasBuild> build);
+    // Apply a finished build, if any, and return it for inspection.
+    // Returns nullptr while no build has finished. Call from the
+    // main thread, outside of a frame.
+    std::unique_ptr<GUIFontAtlasBuild> finish_build(JobSystem* jobs);
+    // Block until the running build, if any, has finished, then
+    // apply it as finish_build does.
+    std::unique_ptr<GUIFontAtlasBuild> wait_build(JobSystem* jobs);
+    
+private:
+    std::unique_ptr<GUIFontAtlasBuild> build;
+    JobHandle build_job = JobHandle_None;
+};
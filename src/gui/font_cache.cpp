@@ -0,0 +1,317 @@
+#include "font_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+
+#include "imgui_internal.h"
+
+#include "util/hash.hpp"
+#include "util/log.hpp"
+#include "util/mapped_file.hpp"
+
+// Increment when the cache file layout changes.
+const uint32_t GUIFontCache_Version = 1;
+const char GUIFontCache_Magic[8] = {'U', 'N', 'I', 'F', 'O', 'N', 'T', '\0'};
+
+static_assert(std::is_trivially_copyable<ImFontGlyph>::value);
+
+struct GUIFontCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t imgui_version;
+    uint64_t key;
+    int32_t tex_width;
+    int32_t tex_height;
+    ImVec2 tex_uv_scale;
+    ImVec2 tex_uv_white_pixel;
+    ImVec4 tex_uv_lines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+    int32_t tex_pixels_use_colors;
+    int32_t font_count;
+    int32_t custom_rect_count;
+    int32_t pack_id_mouse_cursor;
+    int32_t pack_id_lines;
+    uint32_t reserved;
+    // Offset in bytes from the start of the file to RGBA32 pixels
+    uint64_t pixels_offset;
+};
+
+struct GUIFontCacheFont {
+    float font_size;
+    float ascent;
+    float descent;
+    uint32_t fallback_char;
+    int32_t glyph_count;
+    // Offset in bytes from the start of the file to ImFontGlyph data
+    uint64_t glyphs_offset;
+};
+
+// ImFontAtlasCustomRect, with its font pointer stored as an index.
+struct GUIFontCacheCustomRect {
+    uint16_t width;
+    uint16_t height;
+    uint16_t x;
+    uint16_t y;
+    uint32_t glyph_id;
+    float glyph_advance_x;
+    ImVec2 glyph_offset;
+    int32_t font_index;
+};
+
+std::string GUIFontCache_GetDefaultPath(int size_px) {
+    return "cache/font_atlas_" + std::to_string(size_px) + "px.bin";
+}
+
+uint64_t GUIFontCache_GetAtlasKey(ImFontAtlas* atlas) {
+    Hasher hasher;
+    hasher.add(GUIFontCache_Version);
+    hasher.add((uint32_t) IMGUI_VERSION_NUM);
+    hasher.add((uint32_t) sizeof(ImWchar));
+    hasher.add((uint32_t) sizeof(ImFontGlyph));
+    hasher.add(atlas->Flags);
+    hasher.add(atlas->FontBuilderFlags);
+    hasher.add(atlas->TexDesiredWidth);
+    hasher.add(atlas->TexGlyphPadding);
+    hasher.add(atlas->ConfigData.Size);
+    for(const ImFontConfig& config : atlas->ConfigData) {
+        hasher.add_bytes(config.FontData, (size_t) config.FontDataSize);
+        hasher.add(config.FontNo);
+        hasher.add(config.SizePixels);
+        hasher.add(config.OversampleH);
+        hasher.add(config.OversampleV);
+        hasher.add(config.PixelSnapH);
+        hasher.add(config.GlyphExtraSpacing);
+        hasher.add(config.GlyphOffset);
+        hasher.add(config.GlyphMinAdvanceX);
+        hasher.add(config.GlyphMaxAdvanceX);
+        hasher.add(config.MergeMode);
+        hasher.add(config.FontBuilderFlags);
+        hasher.add(config.RasterizerMultiply);
+        hasher.add(config.EllipsisChar);
+        const ImWchar* ranges = (
+            config.GlyphRanges ? config.GlyphRanges : atlas->GetGlyphRangesDefault()
+        );
+        for(; ranges[0]; ranges += 2) {
+            hasher.add(ranges[0]);
+            hasher.add(ranges[1]);
+        }
+    }
+    return hasher.hash;
+}
+
+bool GUIFontCache_Load(ImFontAtlas* atlas, uint64_t key, const char* path) {
+    MappedFile file;
+    if(!file.open(path)) {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "No font atlas cache found at '{}'.", path);
+        return false;
+    }
+    const uint8_t* data = file.data();
+    const size_t size = file.size();
+    if(size < sizeof(GUIFontCacheHeader)) {
+        UNI_LOG_WARN(LogSubsystem_GUI, "Font atlas cache '{}' is truncated.", path);
+        return false;
+    }
+    GUIFontCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, GUIFontCache_Magic, sizeof(header.magic)) != 0 ||
+        header.version != GUIFontCache_Version ||
+        header.imgui_version != IMGUI_VERSION_NUM
+    ) {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "Font atlas cache '{}' has an unsupported format.", path);
+        return false;
+    }
+    if(header.key != key) {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "Font atlas cache '{}' is stale.", path);
+        return false;
+    }
+    // Validate all offsets and sizes before touching the atlas
+    const size_t fonts_offset = sizeof(GUIFontCacheHeader);
+    const size_t rects_offset = (
+        fonts_offset + sizeof(GUIFontCacheFont) * (size_t) header.font_count
+    );
+    const size_t pixels_size = (size_t) header.tex_width * (size_t) header.tex_height * 4;
+    if(header.font_count != atlas->Fonts.Size ||
+        header.custom_rect_count < 0 ||
+        header.tex_width <= 0 || header.tex_height <= 0 ||
+        rects_offset + sizeof(GUIFontCacheCustomRect) * (size_t) header.custom_rect_count > size ||
+        header.pixels_offset > size || size - header.pixels_offset < pixels_size
+    ) {
+        UNI_LOG_WARN(LogSubsystem_GUI, "Font atlas cache '{}' is invalid.", path);
+        return false;
+    }
+    const GUIFontCacheFont* fonts = (const GUIFontCacheFont*) (data + fonts_offset);
+    for(int i = 0; i < header.font_count; ++i) {
+        const auto& font = fonts[i];
+        if(font.glyph_count < 0 || font.glyphs_offset > size ||
+            (size - font.glyphs_offset) / sizeof(ImFontGlyph) < (size_t) font.glyph_count
+        ) {
+            UNI_LOG_WARN(LogSubsystem_GUI, "Font atlas cache '{}' is invalid.", path);
+            return false;
+        }
+    }
+    atlas->ClearTexData();
+    atlas->TexWidth = header.tex_width;
+    atlas->TexHeight = header.tex_height;
+    atlas->TexUvScale = header.tex_uv_scale;
+    atlas->TexUvWhitePixel = header.tex_uv_white_pixel;
+    for(int i = 0; i <= IM_DRAWLIST_TEX_LINES_WIDTH_MAX; ++i) {
+        atlas->TexUvLines[i] = header.tex_uv_lines[i];
+    }
+    atlas->TexPixelsUseColors = header.tex_pixels_use_colors != 0;
+    // The atlas frees its pixels with IM_FREE, so they are copied
+    // out of the mapping rather than referenced directly.
+    atlas->TexPixelsRGBA32 = (unsigned int*) IM_ALLOC(pixels_size);
+    std::memcpy(atlas->TexPixelsRGBA32, data + header.pixels_offset, pixels_size);
+    for(int i = 0; i < header.font_count; ++i) {
+        const auto& cached = fonts[i];
+        ImFont* font = atlas->Fonts[i];
+        // ClearOutputData also forgets the font's config, which is
+        // still needed if the atlas is ever rebuilt.
+        ImFontConfig* config_data = font->ConfigData;
+        const short config_data_count = font->ConfigDataCount;
+        font->ClearOutputData();
+        font->ConfigData = config_data;
+        font->ConfigDataCount = config_data_count;
+        font->ContainerAtlas = atlas;
+        font->FontSize = cached.font_size;
+        font->Ascent = cached.ascent;
+        font->Descent = cached.descent;
+        font->FallbackChar = (ImWchar) cached.fallback_char;
+        // Let BuildLookupTable pick the ellipsis the same way a
+        // full build would.
+        font->EllipsisChar = config_data ? config_data->EllipsisChar : (ImWchar) -1;
+        font->Glyphs.resize(cached.glyph_count);
+        if(cached.glyph_count > 0) {
+            std::memcpy(
+                font->Glyphs.Data,
+                data + cached.glyphs_offset,
+                sizeof(ImFontGlyph) * (size_t) cached.glyph_count
+            );
+        }
+        font->BuildLookupTable();
+    }
+    const GUIFontCacheCustomRect* rects = (const GUIFontCacheCustomRect*) (data + rects_offset);
+    atlas->CustomRects.resize(header.custom_rect_count);
+    for(int i = 0; i < header.custom_rect_count; ++i) {
+        const auto& cached = rects[i];
+        ImFontAtlasCustomRect& rect = atlas->CustomRects[i];
+        rect.Width = cached.width;
+        rect.Height = cached.height;
+        rect.X = cached.x;
+        rect.Y = cached.y;
+        rect.GlyphID = cached.glyph_id;
+        rect.GlyphAdvanceX = cached.glyph_advance_x;
+        rect.GlyphOffset = cached.glyph_offset;
+        rect.Font = (
+            cached.font_index >= 0 && cached.font_index < atlas->Fonts.Size ?
+            atlas->Fonts[cached.font_index] : nullptr
+        );
+    }
+    atlas->PackIdMouseCursor = header.pack_id_mouse_cursor;
+    atlas->PackIdLines = header.pack_id_lines;
+    atlas->TexReady = true;
+    return true;
+}
+
+bool GUIFontCache_Save(ImFontAtlas* atlas, uint64_t key, const char* path) {
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    if(!pixels || !atlas->IsBuilt()) {
+        return false;
+    }
+    std::error_code error;
+    const auto parent = std::filesystem::path(path).parent_path();
+    if(!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+    }
+    // Write to a temporary file first so that a partially written
+    // cache is never picked up by a later launch.
+    const std::string temp_path = std::string(path) + ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if(!file) {
+        UNI_LOG_WARN(LogSubsystem_GUI, "Failed to open font atlas cache '{}' for writing.", temp_path);
+        return false;
+    }
+    GUIFontCacheHeader header = {};
+    std::memcpy(header.magic, GUIFontCache_Magic, sizeof(header.magic));
+    header.version = GUIFontCache_Version;
+    header.imgui_version = IMGUI_VERSION_NUM;
+    header.key = key;
+    header.tex_width = width;
+    header.tex_height = height;
+    header.tex_uv_scale = atlas->TexUvScale;
+    header.tex_uv_white_pixel = atlas->TexUvWhitePixel;
+    for(int i = 0; i <= IM_DRAWLIST_TEX_LINES_WIDTH_MAX; ++i) {
+        header.tex_uv_lines[i] = atlas->TexUvLines[i];
+    }
+    header.tex_pixels_use_colors = atlas->TexPixelsUseColors ? 1 : 0;
+    header.font_count = atlas->Fonts.Size;
+    header.custom_rect_count = atlas->CustomRects.Size;
+    header.pack_id_mouse_cursor = atlas->PackIdMouseCursor;
+    header.pack_id_lines = atlas->PackIdLines;
+    // Layout: header, font records, custom rects, glyphs, pixels
+    uint64_t offset = (
+        sizeof(GUIFontCacheHeader) +
+        sizeof(GUIFontCacheFont) * (size_t) atlas->Fonts.Size +
+        sizeof(GUIFontCacheCustomRect) * (size_t) atlas->CustomRects.Size
+    );
+    ImVector<GUIFontCacheFont> fonts;
+    for(ImFont* font : atlas->Fonts) {
+        fonts.push_back(GUIFontCacheFont{
+            .font_size = font->FontSize,
+            .ascent = font->Ascent,
+            .descent = font->Descent,
+            .fallback_char = (uint32_t) font->FallbackChar,
+            .glyph_count = font->Glyphs.Size,
+            .glyphs_offset = offset
+        });
+        offset += sizeof(ImFontGlyph) * (size_t) font->Glyphs.Size;
+    }
+    // Align pixel data for direct use from a mapping
+    offset = (offset + 63) & ~(uint64_t) 63;
+    header.pixels_offset = offset;
+    std::fwrite(&header, sizeof(header), 1, file);
+    if(fonts.Size > 0) {
+        std::fwrite(fonts.Data, sizeof(GUIFontCacheFont), (size_t) fonts.Size, file);
+    }
+    for(const ImFontAtlasCustomRect& rect : atlas->CustomRects) {
+        const GUIFontCacheCustomRect cached = {
+            .width = rect.Width,
+            .height = rect.Height,
+            .x = rect.X,
+            .y = rect.Y,
+            .glyph_id = rect.GlyphID,
+            .glyph_advance_x = rect.GlyphAdvanceX,
+            .glyph_offset = rect.GlyphOffset,
+            .font_index = rect.Font ? atlas->Fonts.index_from_ptr(
+                atlas->Fonts.find(rect.Font)
+            ) : -1
+        };
+        std::fwrite(&cached, sizeof(cached), 1, file);
+    }
+    for(ImFont* font : atlas->Fonts) {
+        if(font->Glyphs.Size > 0) {
+            std::fwrite(font->Glyphs.Data, sizeof(ImFontGlyph), (size_t) font->Glyphs.Size, file);
+        }
+    }
+    const long padding = (long) header.pixels_offset - std::ftell(file);
+    for(long i = 0; i < padding; ++i) {
+        std::fputc(0, file);
+    }
+    std::fwrite(pixels, 4, (size_t) width * (size_t) height, file);
+    const bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    if(ok) {
+        std::filesystem::rename(temp_path, path, error);
+    }
+    if(!ok || error) {
+        UNI_LOG_WARN(LogSubsystem_GUI, "Failed to write font atlas cache '{}'.", path);
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    UNI_LOG_DEBUG(LogSubsystem_GUI, "Wrote font atlas cache '{}'.", path);
+    return true;
+}
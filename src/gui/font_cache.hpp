@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "imgui.h"
+
+// Get the default location of the baked font atlas cache file
+// for fonts of a given size.
+std::string GUIFontCache_GetDefaultPath(int size_px);
+
+/**
+ * Compute a key identifying everything which affects the output
+ * of building a font atlas: the font file contents, sizes, builder
+ * flags, and glyph ranges of every font added to it.
+ */
+uint64_t GUIFontCache_GetAtlasKey(ImFontAtlas* atlas);
+
+/**
+ * Restore a previously built atlas from a cache file, skipping
+ * FreeType rasterization entirely.
+ * 
+ * Fonts must already have been added to the atlas, in the same
+ * order as when the cache was saved. Existing ImFont pointers are
+ * kept and filled in with cached glyphs. Returns false, leaving the
+ * atlas unbuilt, if the file is missing or its key does not match.
+ */
+bool GUIFontCache_Load(ImFontAtlas* atlas, uint64_t key, const char* path);
+
+/**
+ * Write a built atlas's pixels and glyph tables to a cache file.
+ * Returns false if the file could not be written.
+ */
+bool GUIFontCache_Save(ImFontAtlas* atlas, uint64_t key, const char* path);
@@ -0,0 +1,143 @@
+#include "glyph_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "imgui_internal.h"
+
+#include "util/log.hpp"
+
+bool GUIGlyphCache::is_in_ranges(const ImWchar* ranges, unsigned int codepoint) {
+    if(!ranges) {
+        return false;
+    }
+    for(const ImWchar* range = ranges; range[0]; range += 2) {
+        if(codepoint >= range[0] && codepoint <= range[1]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GUIGlyphCache::use_text(const char* text, const char* text_end) {
+    if(!text_end) {
+        text_end = text + std::strlen(text);
+    }
+    while(text < text_end) {
+        // Fast path for ASCII, which is always in the base ranges
+        if((unsigned char) *text < 0x80) {
+            text++;
+            continue;
+        }
+        unsigned int codepoint = 0;
+        const int length = ImTextCharFromUtf8(&codepoint, text, text_end);
+        if(length <= 0) {
+            break;
+        }
+        text += length;
+        this->use_char(codepoint);
+    }
+}
+
+void GUIGlyphCache::use_char(unsigned int codepoint) {
+    if(codepoint < 0x80 || codepoint > IM_UNICODE_CODEPOINT_MAX ||
+        this->is_in_ranges(this->base_ranges, codepoint)
+    ) {
+        return;
+    }
+    auto [entry, inserted] = this->glyphs.try_emplace((ImWchar) codepoint);
+    if(inserted) {
+        this->has_new_glyphs = true;
+    }
+    entry->second.last_used_frame = this->frame + 1;
+}
+
+void GUIGlyphCache::next_frame() {
+    this->frame++;
+}
+
+bool GUIGlyphCache::needs_rebuild() {
+    return this->has_new_glyphs && (
+        this->frame - this->last_rebuild_frame >=
+        (uint64_t) this->rebuild_interval_frames
+    );
+}
+
+int GUIGlyphCache::get_resident_count() {
+    int resident_count = 0;
+    for(const auto& entry : this->glyphs) {
+        resident_count += entry.second.available ? 1 : 0;
+    }
+    return resident_count;
+}
+
+const ImWchar* GUIGlyphCache::get_build_ranges(size_t bytes_per_glyph) {
+    const size_t max_glyphs = this->memory_budget_bytes / std::max<size_t>(1, bytes_per_glyph);
+    const size_t resident_count = (size_t) this->get_resident_count();
+    if(resident_count > max_glyphs) {
+        // Evict the least recently drawn glyphs, oldest first
+        std::vector<std::pair<uint64_t, ImWchar>> candidates;
+        for(const auto& entry : this->glyphs) {
+            const uint64_t age = this->frame + 1 - entry.second.last_used_frame;
+            if(entry.second.available && age >= (uint64_t) this->eviction_min_age_frames) {
+                candidates.emplace_back(entry.second.last_used_frame, entry.first);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        const size_t evict_count = std::min(candidates.size(), resident_count - max_glyphs);
+        for(size_t i = 0; i < evict_count; ++i) {
+            this->glyphs.erase(candidates[i].second);
+        }
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "GUIGlyphCache evicted {} glyphs.", evict_count);
+    }
+    // Ranges are built from sorted codepoints, merging runs
+    std::vector<ImWchar> codepoints;
+    for(const auto& entry : this->glyphs) {
+        if(entry.second.available) {
+            codepoints.push_back(entry.first);
+        }
+    }
+    std::sort(codepoints.begin(), codepoints.end());
+    this->ranges.clear();
+    if(this->base_ranges) {
+        for(const ImWchar* range = this->base_ranges; range[0]; range += 2) {
+            this->ranges.push_back(range[0]);
+            this->ranges.push_back(range[1]);
+        }
+    }
+    for(size_t i = 0; i < codepoints.size(); ++i) {
+        if(i > 0 && codepoints[i] == this->ranges.back() + 1) {
+            this->ranges.back() = codepoints[i];
+        }
+        else {
+            this->ranges.push_back(codepoints[i]);
+            this->ranges.push_back(codepoints[i]);
+        }
+    }
+    this->ranges.push_back(0);
+    this->ranges_version++;
+    this->has_new_glyphs = false;
+    this->last_rebuild_frame = this->frame;
+    return this->ranges.Data;
+}
+
+void GUIGlyphCache::update_after_build(ImFont* font, const ImWchar* build_ranges) {
+    int missing_count = 0;
+    for(auto& entry : this->glyphs) {
+        // Glyphs first drawn after the build started weren't in it
+        if(entry.second.built || !entry.second.available ||
+            !this->is_in_ranges(build_ranges, entry.first)
+        ) {
+            continue;
+        }
+        entry.second.built = true;
+        if(!font || !font->FindGlyphNoFallback(entry.first)) {
+            entry.second.available = false;
+            missing_count++;
+        }
+    }
+    if(missing_count > 0) {
+        UNI_LOG_DEBUG(LogSubsystem_GUI, "GUIGlyphCache found {} glyphs not provided by any font.", missing_count);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "imgui.h"
+
+struct GUIGlyphCacheEntry {
+    // Frame on which text containing the glyph was last drawn
+    uint64_t last_used_frame = 0;
+    // False once a build showed that no font provides the glyph
+    bool available = true;
+    // False until the glyph has been through an atlas build
+    bool built = false;
+};
+
+/**
+ * Tracks which characters outside the always-loaded base ranges
+ * are actually being drawn, so that the font atlas only needs to
+ * contain those glyphs.
+ * 
+ * Text is reported with use_text as it is drawn. When new glyphs
+ * appear, the atlas is rebuilt between frames with the base ranges
+ * plus every resident glyph. Glyphs which have not been drawn for a
+ * while are evicted on the next rebuild once the estimated atlas
+ * memory exceeds the budget. Startup cost and atlas size therefore
+ * depend on the glyphs in use rather than on script coverage.
+ */
+class GUIGlyphCache {
+public:
+    // Approximate limit for atlas memory spent on non-base glyphs
+    size_t memory_budget_bytes = 16 << 20;
+    // Minimum number of frames between two atlas rebuilds
+    int rebuild_interval_frames = 6;
+    // Glyphs drawn this recently are never evicted
+    int eviction_min_age_frames = 120;
+    // Characters which are always loaded, as ImGui glyph ranges
+    const ImWchar* base_ranges = nullptr;
+    uint64_t frame = 0;
+    uint64_t last_rebuild_frame = 0;
+    std::unordered_map<ImWchar, GUIGlyphCacheEntry> glyphs;
+    // Ranges for atlas builds, from the last get_build_ranges
+    ImVector<ImWchar> ranges;
+    // Incremented whenever the ranges change
+    uint32_t ranges_version = 0;
+    
+    // Record that some UTF-8 text is being drawn this frame.
+    void use_text(const char* text, const char* text_end = nullptr);
+    // Record that a character is being drawn this frame.
+    void use_char(unsigned int codepoint);
+    // Advance the frame counter. Call once per frame.
+    void next_frame();
+    // Returns true when glyphs are missing from the atlas and
+    // enough frames have passed since the last rebuild.
+    bool needs_rebuild();
+    // Get the number of non-base glyphs which will be included in
+    // the next build.
+    int get_resident_count();
+    // Compute glyph ranges for a rebuild, first evicting cold
+    // glyphs if resident glyphs would exceed the memory budget.
+    const ImWchar* get_build_ranges(size_t bytes_per_glyph);
+    // Mark glyphs which a finished build with the given ranges
+    // could not provide, so that they don't cause further rebuilds.
+    void update_after_build(ImFont* font, const ImWchar* build_ranges);
+    
+private:
+    bool has_new_glyphs = false;
+    
+    bool is_in_ranges(const ImWchar* ranges, unsigned int codepoint);
+};
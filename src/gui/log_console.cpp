@@ -0,0 +1,256 @@
+#include "log_console.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "imgui.h"
+
+#include "app.hpp"
+#include "util/profiler.hpp"
+#include "util/string.hpp"
+
+// Number of history entries checked between looks at the clock.
+const uint32_t GUILogConsole_IndexBatchSize = 1024;
+
+// Get the color used to show a level's name.
+static ImVec4 GUILogConsole_LevelColor(LogLevel level) {
+    switch(level) {
+        case LogLevel_Trace: return ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
+        case LogLevel_Debug: return ImVec4(0.5f, 0.7f, 0.9f, 1.0f);
+        case LogLevel_Info: return ImVec4(0.5f, 0.9f, 0.5f, 1.0f);
+        case LogLevel_Warn: return ImVec4(1.0f, 0.8f, 0.3f, 1.0f);
+        case LogLevel_Error: return ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
+        default: return ImVec4(1.0f, 0.2f, 0.6f, 1.0f);
+    }
+}
+
+// Returns true if every character of the needle appears in the
+// haystack in order, ignoring ASCII case.
+static bool GUILogConsole_IsSubsequence(std::string_view needle, std::string_view haystack) {
+    size_t i = 0;
+    for(size_t j = 0; i < needle.size() && j < haystack.size(); ++j) {
+        if(std::toupper((unsigned char) needle[i]) == std::toupper((unsigned char) haystack[j])) {
+            i++;
+        }
+    }
+    return i == needle.size();
+}
+
+// Count the needle characters which appear anywhere in the
+// haystack, ignoring ASCII case. No fuzzy match can match more.
+static int GUILogConsole_CountPresent(std::string_view needle, std::string_view haystack) {
+    uint64_t present[4] = {};
+    for(const char c : haystack) {
+        const unsigned char upper = (unsigned char) std::toupper((unsigned char) c);
+        present[upper >> 6] |= (uint64_t) 1 << (upper & 63);
+    }
+    int count = 0;
+    for(const char c : needle) {
+        const unsigned char upper = (unsigned char) std::toupper((unsigned char) c);
+        count += (int) ((present[upper >> 6] >> (upper & 63)) & 1);
+    }
+    return count;
+}
+
+void GUILogConsole::init() {
+    // Enough for a full length search over a full length message
+    this->search_arena = std::make_unique<Arena>();
+    this->search_arena->init(1 << 22);
+}
+
+void GUILogConsole::toggle() {
+    this->showing = !this->showing;
+}
+
+void GUILogConsole::draw() {
+    if(!this->showing) {
+        return;
+    }
+    UNI_PROFILE_ZONE("GUILogConsole::draw");
+    ImGui::PushFont(this->context->get_imgui_font(this->font));
+    ImGui::SetNextWindowSize(ImVec2(800.0f, 400.0f), ImGuiCond_FirstUseEver);
+    if(!ImGui::Begin("Log", &this->showing)) {
+        ImGui::End();
+        ImGui::PopFont();
+        return;
+    }
+    this->draw_toolbar();
+    this->update_index();
+    this->draw_lines();
+    ImGui::End();
+    ImGui::PopFont();
+}
+
+void GUILogConsole::draw_toolbar() {
+    bool filter_changed = false;
+    ImGui::SetNextItemWidth(8.0f * ImGui::GetFontSize());
+    if(ImGui::BeginCombo("##Level", LogLevel_GetName(this->min_level))) {
+        for(int i = 0; i < LogLevel_Off; ++i) {
+            const bool selected = (i == (int) this->min_level);
+            if(ImGui::Selectable(LogLevel_GetName((LogLevel) i), selected)) {
+                filter_changed = filter_changed || !selected;
+                this->min_level = (LogLevel) i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    for(int i = 0; i < LogSubsystem_COUNT; ++i) {
+        ImGui::SameLine();
+        filter_changed |= ImGui::CheckboxFlags(
+            LogSubsystem_GetName((LogSubsystem) i),
+            &this->subsystem_mask,
+            1u << i
+        );
+    }
+    ImGui::SetNextItemWidth(-1.0f);
+    if(ImGui::InputTextWithHint(
+        "##Search", "Search", this->search_text, sizeof(this->search_text)
+    )) {
+        filter_changed = true;
+    }
+    if(filter_changed) {
+        this->reset_index();
+    }
+    if(ImGui::Button("Clear")) {
+        this->first_index = Log_GetHistoryCount();
+        this->reset_index();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Auto-scroll", &this->auto_scroll);
+    ImGui::SameLine();
+    const uint32_t history_count = Log_GetHistoryCount();
+    ImGui::TextDisabled(
+        "%u of %u lines", (unsigned) this->filtered_indexes.size(),
+        (unsigned) (history_count - this->first_index)
+    );
+    if(this->indexed_count < history_count) {
+        ImGui::SameLine();
+        ImGui::TextDisabled(
+            "(searching, %d%%)",
+            (int) (100.0 * (this->indexed_count - this->first_index) /
+                (double) (history_count - this->first_index))
+        );
+    }
+    if(history_count >= Log_HistoryMaxEntries) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(history full)");
+    }
+    const uint64_t dropped_count = Log_GetDroppedCount();
+    if(dropped_count > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%llu dropped", (unsigned long long) dropped_count);
+    }
+}
+
+void GUILogConsole::draw_lines() {
+    if(!ImGui::BeginChild("##Lines", ImVec2(0.0f, 0.0f), true, ImGuiWindowFlags_HorizontalScrollbar)) {
+        ImGui::EndChild();
+        return;
+    }
+    const bool at_bottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+    const float level_width = ImGui::CalcTextSize("critical").x;
+    const float subsystem_width = ImGui::CalcTextSize("Assets").x;
+    ImGuiListClipper clipper;
+    clipper.Begin((int) this->filtered_indexes.size());
+    while(clipper.Step()) {
+        for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const LogHistoryEntry& entry = Log_GetHistoryEntry(this->filtered_indexes[i]);
+            const std::time_t seconds = (std::time_t) (entry.time_ns / 1000000000);
+            const int milliseconds = (int) ((entry.time_ns / 1000000) % 1000);
+            char time_text[32];
+            const size_t time_length = std::strftime(
+                time_text, sizeof(time_text), "%H:%M:%S", std::localtime(&seconds)
+            );
+            std::snprintf(
+                time_text + time_length, sizeof(time_text) - time_length,
+                ".%03d", milliseconds
+            );
+            ImGui::TextDisabled("%s", time_text);
+            ImGui::SameLine();
+            const float level_x = ImGui::GetCursorPosX();
+            ImGui::TextColored(
+                GUILogConsole_LevelColor(entry.level), "%s", LogLevel_GetName(entry.level)
+            );
+            ImGui::SameLine(level_x + level_width + ImGui::GetStyle().ItemSpacing.x);
+            const float subsystem_x = ImGui::GetCursorPosX();
+            ImGui::TextDisabled("%s", LogSubsystem_GetName(entry.subsystem));
+            ImGui::SameLine(subsystem_x + subsystem_width + ImGui::GetStyle().ItemSpacing.x);
+            // Rows must all have the same height for the clipper,
+            // so only the first line of a message is shown inline.
+            const char* text_end = (const char*) std::memchr(entry.text, '\n', entry.length);
+            if(!text_end) {
+                text_end = entry.text + entry.length;
+            }
+            this->context->use_text(entry.text, text_end);
+            ImGui::TextUnformatted(entry.text, text_end);
+            if(text_end != entry.text + entry.length && ImGui::IsItemHovered()) {
+                this->context->use_text(entry.text, entry.text + entry.length);
+                ImGui::BeginTooltip();
+                ImGui::TextUnformatted(entry.text, entry.text + entry.length);
+                ImGui::EndTooltip();
+            }
+        }
+    }
+    clipper.End();
+    if(this->auto_scroll && at_bottom) {
+        ImGui::SetScrollHereY(1.0f);
+    }
+    ImGui::EndChild();
+}
+
+void GUILogConsole::update_index() {
+    UNI_PROFILE_ZONE("GUILogConsole::update_index");
+    const uint32_t count = Log_GetHistoryCount();
+    const uint64_t deadline = (
+        Profiler_Now() + (uint64_t) (this->index_budget_ms * 1000000.0f)
+    );
+    while(this->indexed_count < count) {
+        const uint32_t end = std::min(
+            count, this->indexed_count + GUILogConsole_IndexBatchSize
+        );
+        for(uint32_t i = this->indexed_count; i < end; ++i) {
+            if(this->matches(Log_GetHistoryEntry(i))) {
+                this->filtered_indexes.push_back(i);
+            }
+        }
+        this->indexed_count = end;
+        if(Profiler_Now() >= deadline) {
+            break;
+        }
+    }
+}
+
+void GUILogConsole::reset_index() {
+    this->filtered_indexes.clear();
+    this->indexed_count = this->first_index;
+    this->search_length = (int) std::strlen(this->search_text);
+}
+
+bool GUILogConsole::matches(const LogHistoryEntry& entry) {
+    if(entry.level < this->min_level ||
+        !(this->subsystem_mask & (1u << entry.subsystem))
+    ) {
+        return false;
+    }
+    if(this->search_length <= 0) {
+        return true;
+    }
+    const std::string_view needle(this->search_text, this->search_length);
+    const std::string_view haystack(entry.text, entry.length);
+    // Like the command palette, tolerate a few unmatched characters,
+    // but scale the allowance with the search length so that short
+    // searches still narrow down the log.
+    const int required = this->search_length - this->search_length / 4;
+    if(GUILogConsole_CountPresent(needle, haystack) < required) {
+        return false;
+    }
+    if(GUILogConsole_IsSubsequence(needle, haystack)) {
+        return true;
+    }
+    const auto result = string_fuzzy_match(needle, haystack, this->search_arena.get());
+    this->search_arena->reset();
+    return result.matched >= required;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "context.hpp"
+#include "util/arena.hpp"
+#include "util/log.hpp"
+
+/**
+ * Window which shows the log history.
+ *
+ * Lines are read straight from the history kept by util/log, and
+ * only the visible ones are drawn. The console keeps an index of
+ * the history entries which pass the current level, subsystem, and
+ * search filters. New entries are added to it as they arrive, and
+ * a changed filter rebuilds it over several frames if needed, so
+ * that neither busy logging nor a long history can stall a frame.
+ */
+class GUILogConsole {
+public:
+    GUILogConsole() {};
+    GUILogConsole(App* app, GUIContext* context):
+        app(app),
+        context(context)
+    {};
+    
+    App* app = nullptr;
+    GUIContext* context = nullptr;
+    GUIFont font = GUIFont_Small;
+    bool showing = false;
+    // Keep the newest line in view while scrolled to the bottom
+    bool auto_scroll = true;
+    // Lowest level of message shown
+    LogLevel min_level = LogLevel_Trace;
+    // One bit per LogSubsystem which is shown
+    uint32_t subsystem_mask = (1u << LogSubsystem_COUNT) - 1;
+    // Fuzzy search text. Lines must match all but a quarter of its
+    // characters, rounded down, in order and ignoring case.
+    char search_text[128] = {};
+    // Time spent updating the index each frame, at most
+    float index_budget_ms = 2.0f;
+    // History entries before this one are hidden by "Clear"
+    uint32_t first_index = 0;
+    
+    void init();
+    // Show the console if hidden, or hide it if shown
+    void toggle();
+    // Draw the console window
+    void draw();
+    
+    void draw_toolbar();
+    void draw_lines();
+    // Check more history entries against the filters, within the
+    // per-frame time budget.
+    void update_index();
+    // Forget the index, so that it is rebuilt from first_index.
+    void reset_index();
+    bool matches(const LogHistoryEntry& entry);
+    
+private:
+    // History indexes of the entries which pass the filters
+    std::vector<uint32_t> filtered_indexes;
+    // Every history entry before this one has been checked
+    uint32_t indexed_count = 0;
+    // Scratch memory for string_fuzzy_match, reset after each line
+    std::unique_ptr<Arena> search_arena;
+    int search_length = 0;
+};
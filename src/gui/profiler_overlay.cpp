@@ -0,0 +1,304 @@
+#include "profiler_overlay.hpp"
+
+#include <algorithm>
+
+#include "imgui.h"
+#include "imgui_internal.h"
+
+#include "app.hpp"
+#include "util/alloc_counter.hpp"
+
+// Get the value at a given fraction through an already sorted list.
+static float GUIProfiler_Percentile(const std::vector<float>& sorted, float fraction) {
+    if(sorted.empty()) {
+        return 0.0f;
+    }
+    const int i = ImClamp(
+        (int) (fraction * (float) (sorted.size() - 1) + 0.5f),
+        0, (int) sorted.size() - 1
+    );
+    return sorted[i];
+}
+
+// Get a stable color for a zone name.
+static ImU32 GUIProfiler_ZoneColor(const char* name) {
+    const ImU32 hash = ImHashStr(name);
+    const float hue = (float) (hash % 360) / 360.0f;
+    return ImColor::HSV(hue, 0.45f, 0.65f);
+}
+
+void GUIProfilerOverlay::toggle() {
+    this->showing = !this->showing;
+    this->stats_age_frames = this->stats_interval_frames;
+}
+
+void GUIProfilerOverlay::draw() {
+    if(!this->showing) {
+        return;
+    }
+    ImGui::PushFont(this->context->get_imgui_font(GUIFont_Small));
+    ImGui::SetNextWindowSize(ImVec2(720.0f, 480.0f), ImGuiCond_FirstUseEver);
+    if(!ImGui::Begin("Profiler", &this->showing)) {
+        ImGui::End();
+        ImGui::PopFont();
+        return;
+    }
+#if !defined(UNI_PROFILER)
+    ImGui::TextDisabled(
+        "Profiler zones are disabled in this build. "
+        "Rebuild with `scons profile=1` to record zones."
+    );
+#endif
+    ImGui::Checkbox("Pause", &this->profiler->paused);
+    ImGui::SameLine();
+    ImGui::Text(
+        "p50 %.2f ms   p95 %.2f ms   p99 %.2f ms   dropped %llu",
+        this->frame_p50_ms, this->frame_p95_ms, this->frame_p99_ms,
+        (unsigned long long) this->profiler->dropped_count
+    );
+    this->draw_frame_times();
+    const auto frame = this->profiler->get_frame(this->selected_frame_age);
+    if(frame) {
+        ImGui::Text(
+            "Frame %d of %d: %.3f ms, %d zones",
+            this->selected_frame_age,
+            this->profiler->get_frame_count(),
+            frame->get_duration_ms(),
+            (int) frame->events.size()
+        );
+        if(AllocCounter_IsEnabled()) {
+            ImGui::SameLine(0.0f, 0.0f);
+            ImGui::Text(
+                ", %llu main thread heap allocations",
+                (unsigned long long) frame->alloc_count
+            );
+        }
+        for(size_t i = 0; i < frame->counters.size(); ++i) {
+            if(i > 0) {
+                ImGui::SameLine(0.0f, 0.0f);
+                ImGui::TextUnformatted(",  ");
+                ImGui::SameLine(0.0f, 0.0f);
+            }
+            ImGui::Text("%s: %g", frame->counters[i].name, frame->counters[i].value);
+        }
+        this->draw_flame_graph(*frame);
+    }
+    if(!this->profiler->paused) {
+        this->stats_age_frames++;
+    }
+    if(this->stats_age_frames >= this->stats_interval_frames) {
+        this->update_zone_stats();
+        this->stats_age_frames = 0;
+    }
+    this->draw_zone_stats();
+    ImGui::End();
+    ImGui::PopFont();
+}
+
+void GUIProfilerOverlay::draw_frame_times() {
+    const int frame_count = this->profiler->get_frame_count();
+    this->frame_durations.resize(frame_count);
+    float max_ms = 1000.0f / 60.0f;
+    for(int i = 0; i < frame_count; ++i) {
+        const float ms = this->profiler->get_frame(frame_count - 1 - i)->get_duration_ms();
+        this->frame_durations[i] = ms;
+        max_ms = ImMax(max_ms, ms);
+    }
+    const ImVec2 size = ImVec2(ImGui::GetContentRegionAvail().x, 64.0f);
+    ImGui::PlotHistogram(
+        "##FrameTimes",
+        this->frame_durations.data(),
+        frame_count,
+        0,
+        nullptr,
+        0.0f,
+        max_ms,
+        size
+    );
+    // Clicking on the histogram selects a frame for the flame graph
+    if(frame_count > 0 && ImGui::IsItemHovered() &&
+        ImGui::IsMouseClicked(ImGuiMouseButton_Left)
+    ) {
+        const float t = (
+            (ImGui::GetIO().MousePos.x - ImGui::GetItemRectMin().x) /
+            ImMax(1.0f, ImGui::GetItemRectSize().x)
+        );
+        const int i = ImClamp((int) (t * frame_count), 0, frame_count - 1);
+        this->selected_frame_age = frame_count - 1 - i;
+        this->profiler->paused = true;
+    }
+    if(!this->profiler->paused) {
+        this->selected_frame_age = 0;
+    }
+}
+
+void GUIProfilerOverlay::draw_flame_graph(const ProfilerFrame& frame) {
+    const float row_height = ImGui::GetTextLineHeight() + 2.0f;
+    // Count rows needed for each thread, by maximum zone depth
+    int row_count = 0;
+    uint32_t last_thread = (uint32_t) -1;
+    uint32_t thread_depth = 0;
+    for(const auto& event : frame.events) {
+        if(event.thread_index != last_thread) {
+            row_count += (last_thread == (uint32_t) -1) ? 0 : (int) thread_depth + 2;
+            last_thread = event.thread_index;
+            thread_depth = 0;
+        }
+        thread_depth = ImMax(thread_depth, event.depth);
+    }
+    if(last_thread != (uint32_t) -1) {
+        row_count += (int) thread_depth + 2;
+    }
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const ImVec2 size = ImVec2(
+        ImGui::GetContentRegionAvail().x,
+        ImMax(1, row_count) * row_height
+    );
+    ImGui::InvisibleButton("##FlameGraph", size);
+    const bool hovered = ImGui::IsItemHovered();
+    const ImVec2 mouse = ImGui::GetIO().MousePos;
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const double frame_ns = (double) ImMax<uint64_t>(1, frame.end_ns - frame.begin_ns);
+    const ImU32 text_color = ImGui::GetColorU32(ImGuiCol_Text);
+    const ImU32 label_color = ImGui::GetColorU32(ImGuiCol_TextDisabled);
+    int row_base = 0;
+    last_thread = (uint32_t) -1;
+    const ProfilerEvent* hovered_event = nullptr;
+    for(const auto& event : frame.events) {
+        if(event.thread_index != last_thread) {
+            if(last_thread != (uint32_t) -1) {
+                row_base += (int) thread_depth + 2;
+            }
+            last_thread = event.thread_index;
+            // Find this thread's maximum depth for the next row base
+            thread_depth = 0;
+            for(const auto* other = &event; other != frame.events.data() + frame.events.size(); ++other) {
+                if(other->thread_index != event.thread_index) {
+                    break;
+                }
+                thread_depth = ImMax(thread_depth, other->depth);
+            }
+            char thread_name[32];
+            Profiler_GetThreadName(event.thread_index, thread_name, sizeof(thread_name));
+            draw_list->AddText(
+                ImVec2(origin.x, origin.y + row_base * row_height),
+                label_color,
+                thread_name
+            );
+        }
+        // Clamp zones which straddle the frame's bounds
+        const double begin = ImMax(0.0, (double) ((int64_t) (event.begin_ns - frame.begin_ns)));
+        const double end = ImMin(frame_ns, (double) ((int64_t) (event.end_ns - frame.begin_ns)));
+        if(end < begin) {
+            continue;
+        }
+        const float y = origin.y + (row_base + 1 + (int) event.depth) * row_height;
+        const ImVec2 box_min = ImVec2(
+            origin.x + (float) (begin / frame_ns) * size.x, y
+        );
+        const ImVec2 box_max = ImVec2(
+            ImMax(box_min.x + 1.0f, origin.x + (float) (end / frame_ns) * size.x),
+            y + row_height - 1.0f
+        );
+        draw_list->AddRectFilled(box_min, box_max, GUIProfiler_ZoneColor(event.name));
+        if(box_max.x - box_min.x > 8.0f) {
+            draw_list->PushClipRect(box_min, box_max, true);
+            draw_list->AddText(ImVec2(box_min.x + 2.0f, box_min.y), text_color, event.name);
+            draw_list->PopClipRect();
+        }
+        if(hovered &&
+            mouse.x >= box_min.x && mouse.x < box_max.x &&
+            mouse.y >= box_min.y && mouse.y < box_max.y
+        ) {
+            hovered_event = &event;
+        }
+    }
+    if(hovered_event) {
+        ImGui::SetTooltip(
+            "%s\n%.3f ms",
+            hovered_event->name,
+            (double) (hovered_event->end_ns - hovered_event->begin_ns) * 1e-6
+        );
+    }
+}
+
+void GUIProfilerOverlay::draw_zone_stats() {
+    const ImGuiTableFlags flags = (
+        ImGuiTableFlags_Borders |
+        ImGuiTableFlags_RowBg |
+        ImGuiTableFlags_ScrollY |
+        ImGuiTableFlags_SizingStretchProp
+    );
+    if(!ImGui::BeginTable("##ZoneStats", 6, flags)) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Zone", ImGuiTableColumnFlags_WidthStretch, 3.0f);
+    ImGui::TableSetupColumn("Calls/frame");
+    ImGui::TableSetupColumn("p50 ms");
+    ImGui::TableSetupColumn("p95 ms");
+    ImGui::TableSetupColumn("p99 ms");
+    ImGui::TableSetupColumn("Max ms");
+    ImGui::TableHeadersRow();
+    for(const auto& stats : this->zone_stats) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(stats.name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", stats.calls_per_frame);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.p50_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.p95_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.p99_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.max_ms);
+    }
+    ImGui::EndTable();
+}
+
+void GUIProfilerOverlay::update_zone_stats() {
+    const int frame_count = this->profiler->get_frame_count();
+    for(auto& entry : this->zone_durations) {
+        entry.second.clear();
+    }
+    this->frame_durations.clear();
+    for(int age = 0; age < frame_count; ++age) {
+        const auto frame = this->profiler->get_frame(age);
+        this->frame_durations.push_back(frame->get_duration_ms());
+        for(const auto& event : frame->events) {
+            this->zone_durations[event.name].push_back(
+                (float) (event.end_ns - event.begin_ns) * 1e-6f
+            );
+        }
+    }
+    std::sort(this->frame_durations.begin(), this->frame_durations.end());
+    this->frame_p50_ms = GUIProfiler_Percentile(this->frame_durations, 0.50f);
+    this->frame_p95_ms = GUIProfiler_Percentile(this->frame_durations, 0.95f);
+    this->frame_p99_ms = GUIProfiler_Percentile(this->frame_durations, 0.99f);
+    this->zone_stats.clear();
+    for(auto& entry : this->zone_durations) {
+        auto& durations = entry.second;
+        if(durations.empty()) {
+            continue;
+        }
+        std::sort(durations.begin(), durations.end());
+        this->zone_stats.push_back(GUIProfilerZoneStats{
+            .name = entry.first,
+            .calls_per_frame = (float) durations.size() / (float) ImMax(1, frame_count),
+            .p50_ms = GUIProfiler_Percentile(durations, 0.50f),
+            .p95_ms = GUIProfiler_Percentile(durations, 0.95f),
+            .p99_ms = GUIProfiler_Percentile(durations, 0.99f),
+            .max_ms = durations.back()
+        });
+    }
+    // Most expensive zones first
+    std::sort(
+        this->zone_stats.begin(),
+        this->zone_stats.end(),
+        [](const GUIProfilerZoneStats& a, const GUIProfilerZoneStats& b) -> bool {
+            return a.p95_ms * a.calls_per_frame > b.p95_ms * b.calls_per_frame;
+        }
+    );
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "context.hpp"
+#include "util/profiler.hpp"
+
+// Rolling timing statistics for one named zone.
+struct GUIProfilerZoneStats {
+    const char* name;
+    // Average number of calls per frame
+    float calls_per_frame;
+    // Per-call duration percentiles, in milliseconds
+    float p50_ms;
+    float p95_ms;
+    float p99_ms;
+    float max_ms;
+};
+
+class GUIProfilerOverlay {
+public:
+    GUIProfilerOverlay() {};
+    GUIProfilerOverlay(App* app, GUIContext* context, Profiler* profiler):
+        app(app),
+        context(context),
+        profiler(profiler)
+    {};
+    
+    App* app = nullptr;
+    GUIContext* context = nullptr;
+    Profiler* profiler = nullptr;
+    bool showing = false;
+    // Age of the frame shown in the flame graph. 0 is most recent.
+    int selected_frame_age = 0;
+    // Statistics are recomputed once per this many frames
+    int stats_interval_frames = 30;
+    int stats_age_frames = 0;
+    std::vector<GUIProfilerZoneStats> zone_stats;
+    float frame_p50_ms = 0.0f;
+    float frame_p95_ms = 0.0f;
+    float frame_p99_ms = 0.0f;
+    
+    // Show the overlay if hidden, or hide it if shown
+    void toggle();
+    // Draw the overlay window
+    void draw();
+    
+    void draw_frame_times();
+    void draw_flame_graph(const ProfilerFrame& frame);
+    void draw_zone_stats();
+    void update_zone_stats();
+    
+private:
+    std::unordered_map<const char*, std::vector<float>> zone_durations;
+    std::vector<float> frame_durations;
+};
@@ -0,0 +1,70 @@
+#include "task_progress.hpp"
+
+#include "imgui.h"
+
+#include "app.hpp"
+#include "util/profiler.hpp"
+
+void GUITaskProgress::draw() {
+    if(this->runner->tasks.empty()) {
+        return;
+    }
+    UNI_PROFILE_ZONE("GUITaskProgress::draw");
+    const float font_size_px = (float) this->context->get_font_size_px(this->font);
+    const ImVec2 viewport = ImGui::GetMainViewport()->Size;
+    const float margin = 0.5f * font_size_px;
+    ImGui::SetNextWindowPos(
+        ImVec2(viewport.x - margin, viewport.y - margin),
+        ImGuiCond_Always,
+        ImVec2(1.0f, 1.0f)
+    );
+    ImGui::SetNextWindowSize(ImVec2(20.0f * font_size_px, 0.0f));
+    ImGui::PushFont(this->context->get_imgui_font(this->font));
+    const bool visible = ImGui::Begin(
+        "Tasks",
+        nullptr,
+        ImGuiWindowFlags_NoMove |
+        ImGuiWindowFlags_NoResize |
+        ImGuiWindowFlags_NoTitleBar |
+        ImGuiWindowFlags_NoFocusOnAppearing |
+        ImGuiWindowFlags_NoSavedSettings
+    );
+    if(visible) {
+        for(auto& task : this->runner->tasks) {
+            ImGui::PushID(task.get());
+            ImGui::TextUnformatted(task->name.c_str());
+            const auto status = task->get_status();
+            if(!status.empty()) {
+                ImGui::TextDisabled("%s", status.c_str());
+            }
+            const float cancel_width = (
+                ImGui::CalcTextSize("Cancel").x +
+                2.0f * ImGui::GetStyle().FramePadding.x
+            );
+            const float bar_width = (
+                ImGui::GetContentRegionAvail().x - cancel_width -
+                ImGui::GetStyle().ItemSpacing.x
+            );
+            const float progress = task->progress.load();
+            if(progress >= 0.0f) {
+                ImGui::ProgressBar(progress, ImVec2(bar_width, 0.0f));
+            }
+            else {
+                // Indeterminate: animate a sweep over the bar
+                const float t = (float) ImGui::GetTime();
+                ImGui::ProgressBar(
+                    t - (float) (int) t, ImVec2(bar_width, 0.0f), "..."
+                );
+            }
+            ImGui::SameLine();
+            ImGui::BeginDisabled(task->is_cancelled());
+            if(ImGui::Button("Cancel")) {
+                task->cancel_requested = true;
+            }
+            ImGui::EndDisabled();
+            ImGui::PopID();
+        }
+    }
+    ImGui::End();
+    ImGui::PopFont();
+}
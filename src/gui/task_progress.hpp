@@ -0,0 +1,23 @@
+#pragma once
+
+#include "context.hpp"
+#include "jobs/task.hpp"
+
+// Shows running tasks with their progress and a cancel button.
+class GUITaskProgress {
+public:
+    GUITaskProgress() {};
+    GUITaskProgress(App* app, GUIContext* context, TaskRunner* runner):
+        app(app),
+        context(context),
+        runner(runner)
+    {};
+    
+    App* app = nullptr;
+    GUIContext* context = nullptr;
+    TaskRunner* runner = nullptr;
+    GUIFont font = GUIFont_Small;
+    
+    // Draw the task list, if any tasks are running
+    void draw();
+};
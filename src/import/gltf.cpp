@@ -0,0 +1,589 @@
+#include "gltf.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "json.hpp"
+#include "mesh_import.hpp"
+#include "util/log.hpp"
+#include "util/mapped_file.hpp"
+#include "util/profiler.hpp"
+
+// Chunk types of a binary glTF file
+const uint32_t ImportGltf_JsonChunkType = 0x4e4f534a;
+const uint32_t ImportGltf_BinaryChunkType = 0x004e4942;
+// Elements converted by one job
+const size_t ImportGltf_CopyChunkSize = 1 << 16;
+// Base64 characters decoded by one job, as a multiple of four
+const size_t ImportGltf_DecodeChunkSize = 1 << 20;
+// Accessor component types
+const uint32_t ImportGltf_Byte = 5120;
+const uint32_t ImportGltf_UnsignedByte = 5121;
+const uint32_t ImportGltf_Short = 5122;
+const uint32_t ImportGltf_UnsignedShort = 5123;
+const uint32_t ImportGltf_UnsignedInt = 5125;
+const uint32_t ImportGltf_Float = 5126;
+// Primitive mode of triangle lists, the only one imported
+const uint32_t ImportGltf_Triangles = 4;
+
+// Bytes of one of the file's buffers.
+struct ImportGltfBuffer {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Where the elements of an accessor lie, after checking that they
+// are all inside their buffer.
+struct ImportGltfAccessor {
+    // Null for accessors without a buffer view, whose elements
+    // are all zero
+    const uint8_t* data = nullptr;
+    size_t count = 0;
+    // Bytes from one element to the next
+    size_t stride = 0;
+    uint32_t component_type = 0;
+    uint32_t component_count = 0;
+    bool normalized = false;
+};
+
+// Accessors of one triangle list primitive, and where it goes in
+// its mesh.
+struct ImportGltfPrimitive {
+    ImportGltfAccessor positions;
+    ImportGltfAccessor normals;
+    ImportGltfAccessor uvs;
+    ImportGltfAccessor indices;
+    bool has_normals = false;
+    bool has_uvs = false;
+    bool has_indices = false;
+    uint32_t first_vertex = 0;
+    uint32_t first_index = 0;
+    // Whole triangles only
+    uint32_t index_count = 0;
+};
+
+struct ImportGltfFile {
+    const char* path = nullptr;
+    ImportJsonValue json;
+    std::vector<ImportGltfBuffer> buffers;
+    // Storage for buffers which aren't inside the file itself
+    std::vector<MappedFile> mapped_files;
+    std::vector<std::vector<uint8_t>> decoded_buffers;
+};
+
+static bool ImportGltf_Fail(const char* path, std::string_view reason) {
+    UNI_LOG_WARN(LogSubsystem_Assets, "Failed to import '{}': {}.", path, reason);
+    return false;
+}
+
+static uint32_t ImportGltf_ReadUint32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint32_t ImportGltf_GetComponentSize(uint32_t component_type) {
+    switch(component_type) {
+        case ImportGltf_Byte:
+        case ImportGltf_UnsignedByte:
+            return 1;
+        case ImportGltf_Short:
+        case ImportGltf_UnsignedShort:
+            return 2;
+        case ImportGltf_UnsignedInt:
+        case ImportGltf_Float:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t ImportGltf_GetComponentCount(std::string_view type) {
+    if(type == "SCALAR") {
+        return 1;
+    }
+    if(type.size() == 4 && type.starts_with("VEC") && type[3] >= '2' && type[3] <= '4') {
+        return (uint32_t) (type[3] - '0');
+    }
+    return 0;
+}
+
+static int ImportGltf_GetBase64Digit(char c) {
+    if(c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if(c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if(c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    if(c == '+') {
+        return 62;
+    }
+    if(c == '/') {
+        return 63;
+    }
+    return -1;
+}
+
+// Decode base64 text in parallel, each job taking a run of whole
+// groups of four characters.
+static bool ImportGltf_DecodeBase64(std::string_view text, JobSystem* jobs, std::vector<uint8_t>* bytes) {
+    while(!text.empty() && text.back() == '=') {
+        text.remove_suffix(1);
+    }
+    if(text.size() % 4 == 1) {
+        return false;
+    }
+    bytes->resize(text.size() / 4 * 3 + (text.size() % 4 == 0 ? 0 : text.size() % 4 - 1));
+    std::atomic<bool> valid = true;
+    const size_t group_count = (text.size() + 3) / 4;
+    Import_ParallelFor(jobs, group_count, ImportGltf_DecodeChunkSize / 4, [&](size_t begin, size_t end) {
+        bool chunk_valid = true;
+        for(size_t group = begin; group < end; ++group) {
+            const size_t first = group * 4;
+            const size_t length = std::min((size_t) 4, text.size() - first);
+            uint32_t bits = 0;
+            for(size_t i = 0; i < 4; ++i) {
+                const int digit = i < length ? ImportGltf_GetBase64Digit(text[first + i]) : 0;
+                chunk_valid = chunk_valid && digit >= 0;
+                bits = (bits << 6) | (uint32_t) std::max(digit, 0);
+            }
+            uint8_t* out = bytes->data() + group * 3;
+            for(size_t i = 0; i + 1 < length; ++i) {
+                out[i] = (uint8_t) (bits >> (16 - 8 * i));
+            }
+        }
+        if(!chunk_valid) {
+            valid = false;
+        }
+    });
+    return valid;
+}
+
+static int ImportGltf_GetHexDigit(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Turn a URI relative to the file into a path, undoing percent
+// encoding.
+static std::filesystem::path ImportGltf_GetUriPath(const char* path, std::string_view uri) {
+    std::string decoded;
+    for(size_t i = 0; i < uri.size(); ++i) {
+        const int high = uri[i] == '%' && i + 2 < uri.size() ? ImportGltf_GetHexDigit(uri[i + 1]) : -1;
+        const int low = high >= 0 ? ImportGltf_GetHexDigit(uri[i + 2]) : -1;
+        if(low >= 0) {
+            decoded.push_back((char) (high * 16 + low));
+            i += 2;
+        }
+        else {
+            decoded.push_back(uri[i]);
+        }
+    }
+    return std::filesystem::path(path).parent_path() / std::filesystem::path(decoded);
+}
+
+// Find the bytes of every buffer the JSON lists.
+static bool ImportGltf_LoadBuffers(ImportGltfFile* file, ImportGltfBuffer binary_chunk, JobSystem* jobs) {
+    const ImportJsonValue* buffers = file->json.find("buffers");
+    if(!buffers) {
+        return true;
+    }
+    for(size_t i = 0; i < buffers->items.size(); ++i) {
+        const ImportJsonValue& buffer = buffers->items[i];
+        const uint64_t size = buffer.get_uint("byteLength", UINT64_MAX);
+        const ImportJsonValue* uri_value = buffer.find("uri");
+        ImportGltfBuffer bytes;
+        if(!uri_value) {
+            // Only the first buffer of a GLB may omit its URI, to
+            // refer to the binary chunk
+            if(i != 0 || !binary_chunk.data) {
+                return ImportGltf_Fail(file->path, "buffer without data");
+            }
+            bytes = binary_chunk;
+        }
+        else if(uri_value->string.starts_with("data:")) {
+            const std::string_view uri = uri_value->string;
+            const size_t marker = uri.find(";base64,");
+            if(marker == std::string_view::npos) {
+                return ImportGltf_Fail(file->path, "buffer data URI isn't base64");
+            }
+            std::vector<uint8_t>& decoded = file->decoded_buffers.emplace_back();
+            if(!ImportGltf_DecodeBase64(uri.substr(marker + 8), jobs, &decoded)) {
+                return ImportGltf_Fail(file->path, "invalid base64 in buffer data URI");
+            }
+            bytes = ImportGltfBuffer{decoded.data(), decoded.size()};
+        }
+        else {
+            const std::filesystem::path buffer_path = ImportGltf_GetUriPath(file->path, uri_value->string);
+            MappedFile& mapped = file->mapped_files.emplace_back();
+            if(!mapped.open(buffer_path.string().c_str())) {
+                return ImportGltf_Fail(file->path, "can't open buffer " + buffer_path.string());
+            }
+            bytes = ImportGltfBuffer{mapped.data(), mapped.size()};
+        }
+        if(size > bytes.size) {
+            return ImportGltf_Fail(file->path, "buffer is shorter than its byteLength");
+        }
+        bytes.size = (size_t) size;
+        file->buffers.push_back(bytes);
+    }
+    return true;
+}
+
+// Find an accessor's elements, checking that they lie inside its
+// buffer view and buffer.
+static bool ImportGltf_GetAccessor(const ImportGltfFile& file, uint64_t index, ImportGltfAccessor* accessor) {
+    const ImportJsonValue* accessors = file.json.find("accessors");
+    const ImportJsonValue* json = accessors ? accessors->get_item(index) : nullptr;
+    if(!json) {
+        return false;
+    }
+    if(json->find("sparse")) {
+        UNI_LOG_WARN(LogSubsystem_Assets, "Sparse accessors aren't supported, in '{}'.", file.path);
+        return false;
+    }
+    *accessor = ImportGltfAccessor{};
+    accessor->count = json->get_uint("count", 0);
+    accessor->component_type = (uint32_t) json->get_uint("componentType", 0);
+    accessor->component_count = ImportGltf_GetComponentCount(json->get_string("type"));
+    accessor->normalized = json->get_bool("normalized", false);
+    const size_t element_size = (size_t) ImportGltf_GetComponentSize(accessor->component_type) * accessor->component_count;
+    if(element_size == 0) {
+        return false;
+    }
+    const ImportJsonValue* view_index = json->find("bufferView");
+    if(!view_index) {
+        return true;
+    }
+    const ImportJsonValue* views = file.json.find("bufferViews");
+    const ImportJsonValue* view = (
+        views && view_index->type == ImportJsonType_Number ?
+        views->get_item((size_t) view_index->number) : nullptr
+    );
+    if(!view) {
+        return false;
+    }
+    const uint64_t buffer_index = view->get_uint("buffer", UINT64_MAX);
+    const uint64_t view_offset = view->get_uint("byteOffset", 0);
+    const uint64_t view_length = view->get_uint("byteLength", 0);
+    const uint64_t offset = json->get_uint("byteOffset", 0);
+    accessor->stride = view->get_uint("byteStride", element_size);
+    if(
+        buffer_index >= file.buffers.size() ||
+        accessor->stride < element_size ||
+        view_offset + view_length > file.buffers[buffer_index].size
+    ) {
+        return false;
+    }
+    if(accessor->count > 0 && offset + accessor->stride * (accessor->count - 1) + element_size > view_length) {
+        return false;
+    }
+    accessor->data = file.buffers[buffer_index].data + view_offset + offset;
+    return true;
+}
+
+// Read the first components of an element as floats, converting
+// normalized integers to [0, 1] or [-1, 1].
+static void ImportGltf_ReadFloats(const ImportGltfAccessor& accessor, size_t index, float* values, uint32_t count) {
+    if(!accessor.data) {
+        std::fill(values, values + count, 0.0f);
+        return;
+    }
+    const uint8_t* element = accessor.data + accessor.stride * index;
+    for(uint32_t i = 0; i < count; ++i) {
+        float value = 0.0f;
+        switch(accessor.component_type) {
+            case ImportGltf_Float:
+                std::memcpy(&value, element + i * 4, sizeof(value));
+                break;
+            case ImportGltf_UnsignedByte:
+                value = (float) element[i];
+                value = accessor.normalized ? value / 255.0f : value;
+                break;
+            case ImportGltf_Byte:
+                value = (float) (int8_t) element[i];
+                value = accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+                break;
+            case ImportGltf_UnsignedShort: {
+                uint16_t bits;
+                std::memcpy(&bits, element + i * 2, sizeof(bits));
+                value = accessor.normalized ? (float) bits / 65535.0f : (float) bits;
+                break;
+            }
+            case ImportGltf_Short: {
+                int16_t bits;
+                std::memcpy(&bits, element + i * 2, sizeof(bits));
+                value = accessor.normalized ? std::max((float) bits / 32767.0f, -1.0f) : (float) bits;
+                break;
+            }
+            default:
+                break;
+        }
+        values[i] = value;
+    }
+}
+
+static uint32_t ImportGltf_ReadIndex(const ImportGltfAccessor& accessor, size_t index) {
+    const uint8_t* element = accessor.data + accessor.stride * index;
+    switch(accessor.component_type) {
+        case ImportGltf_UnsignedByte:
+            return element[0];
+        case ImportGltf_UnsignedShort: {
+            uint16_t value;
+            std::memcpy(&value, element, sizeof(value));
+            return value;
+        }
+        default:
+            return ImportGltf_ReadUint32(element);
+    }
+}
+
+// Check a primitive's accessors, and find where it goes in its mesh.
+static bool ImportGltf_GetPrimitive(
+    const ImportGltfFile& file,
+    const ImportJsonValue& json,
+    ImportGltfPrimitive* primitive
+) {
+    const ImportJsonValue* attributes = json.find("attributes");
+    if(
+        !attributes ||
+        !ImportGltf_GetAccessor(file, attributes->get_uint("POSITION", UINT64_MAX), &primitive->positions) ||
+        primitive->positions.component_type != ImportGltf_Float ||
+        primitive->positions.component_count != 3
+    ) {
+        return false;
+    }
+    const size_t vertex_count = primitive->positions.count;
+    if(attributes->find("NORMAL")) {
+        primitive->has_normals = true;
+        if(
+            !ImportGltf_GetAccessor(file, attributes->get_uint("NORMAL", UINT64_MAX), &primitive->normals) ||
+            primitive->normals.component_type != ImportGltf_Float ||
+            primitive->normals.component_count != 3 ||
+            primitive->normals.count != vertex_count
+        ) {
+            return false;
+        }
+    }
+    if(attributes->find("TEXCOORD_0")) {
+        primitive->has_uvs = true;
+        if(
+            !ImportGltf_GetAccessor(file, attributes->get_uint("TEXCOORD_0", UINT64_MAX), &primitive->uvs) ||
+            primitive->uvs.component_count != 2 ||
+            primitive->uvs.count != vertex_count
+        ) {
+            return false;
+        }
+    }
+    size_t index_count = vertex_count;
+    if(json.find("indices")) {
+        primitive->has_indices = true;
+        if(
+            !ImportGltf_GetAccessor(file, json.get_uint("indices", UINT64_MAX), &primitive->indices) ||
+            primitive->indices.component_count != 1 ||
+            !primitive->indices.data
+        ) {
+            return false;
+        }
+        const uint32_t component_type = primitive->indices.component_type;
+        if(
+            component_type != ImportGltf_UnsignedByte &&
+            component_type != ImportGltf_UnsignedShort &&
+            component_type != ImportGltf_UnsignedInt
+        ) {
+            return false;
+        }
+        index_count = primitive->indices.count;
+    }
+    if(index_count >= UINT32_MAX) {
+        return false;
+    }
+    primitive->index_count = (uint32_t) (index_count - index_count % 3);
+    return true;
+}
+
+// Copy and convert a primitive's accessors into its part of a
+// mesh. Returns false if any index is out of range.
+static bool ImportGltf_CopyPrimitive(
+    const ImportGltfPrimitive& primitive,
+    JobSystem* jobs,
+    LevelMesh* mesh
+) {
+    const uint32_t first_vertex = primitive.first_vertex;
+    const size_t vertex_count = primitive.positions.count;
+    std::mutex bounds_mutex;
+    Import_ParallelFor(jobs, vertex_count, ImportGltf_CopyChunkSize, [&](size_t begin, size_t end) {
+        Bounds3 bounds = Bounds3_Empty;
+        for(size_t i = begin; i < end; ++i) {
+            Vec3& position = mesh->positions[first_vertex + i];
+            ImportGltf_ReadFloats(primitive.positions, i, &position.x, 3);
+            bounds = Bounds3_Grow(bounds, position);
+        }
+        if(primitive.has_normals) {
+            for(size_t i = begin; i < end; ++i) {
+                ImportGltf_ReadFloats(primitive.normals, i, &mesh->normals[first_vertex + i].x, 3);
+            }
+        }
+        if(primitive.has_uvs) {
+            for(size_t i = begin; i < end; ++i) {
+                ImportGltf_ReadFloats(primitive.uvs, i, &mesh->uvs[first_vertex + i].x, 2);
+            }
+        }
+        std::lock_guard<std::mutex> lock(bounds_mutex);
+        mesh->bounds = Bounds3_Union(mesh->bounds, bounds);
+    });
+    std::atomic<bool> valid = true;
+    uint32_t* indices = mesh->indices.data() + primitive.first_index;
+    Import_ParallelFor(jobs, primitive.index_count, ImportGltf_CopyChunkSize, [&](size_t begin, size_t end) {
+        if(!primitive.has_indices) {
+            for(size_t i = begin; i < end; ++i) {
+                indices[i] = first_vertex + (uint32_t) i;
+            }
+            return;
+        }
+        bool chunk_valid = true;
+        for(size_t i = begin; i < end; ++i) {
+            const uint32_t index = ImportGltf_ReadIndex(primitive.indices, i);
+            chunk_valid = chunk_valid && index < vertex_count;
+            indices[i] = first_vertex + (index < vertex_count ? index : 0);
+        }
+        if(!chunk_valid) {
+            valid = false;
+        }
+    });
+    return valid;
+}
+
+bool ImportGltf_Read(
+    const uint8_t* data,
+    size_t size,
+    const char* path,
+    JobSystem* jobs,
+    std::vector<LevelMesh>* meshes
+) {
+    UNI_PROFILE_ZONE("ImportGltf_Read");
+    ImportGltfFile file;
+    file.path = path;
+    // Find the JSON, and in a GLB, the binary chunk
+    std::string_view json_text = std::string_view((const char*) data, size);
+    ImportGltfBuffer binary_chunk;
+    if(size >= 12 && std::memcmp(data, ImportGltf_BinaryMagic, sizeof(ImportGltf_BinaryMagic)) == 0) {
+        const uint32_t version = ImportGltf_ReadUint32(data + 4);
+        const size_t length = std::min((size_t) ImportGltf_ReadUint32(data + 8), size);
+        if(version != 2) {
+            return ImportGltf_Fail(path, fmt::format("unsupported glTF version {}", version));
+        }
+        json_text = std::string_view();
+        for(size_t offset = 12; offset + 8 <= length;) {
+            const size_t chunk_length = ImportGltf_ReadUint32(data + offset);
+            const uint32_t chunk_type = ImportGltf_ReadUint32(data + offset + 4);
+            if(chunk_length > length - offset - 8) {
+                return ImportGltf_Fail(path, "truncated chunk");
+            }
+            const uint8_t* chunk_data = data + offset + 8;
+            if(chunk_type == ImportGltf_JsonChunkType && json_text.empty()) {
+                json_text = std::string_view((const char*) chunk_data, chunk_length);
+            }
+            else if(chunk_type == ImportGltf_BinaryChunkType && !binary_chunk.data) {
+                binary_chunk = ImportGltfBuffer{chunk_data, chunk_length};
+            }
+            // Chunks are padded to four bytes
+            offset += 8 + (chunk_length + 3) / 4 * 4;
+        }
+    }
+    else if(json_text.starts_with("\xef\xbb\xbf")) {
+        // Skip the UTF-8 byte order mark
+        json_text.remove_prefix(3);
+    }
+    size_t error_offset = 0;
+    if(!ImportJson_Parse(json_text, &file.json, &error_offset)) {
+        return ImportGltf_Fail(path, fmt::format("invalid JSON at byte {}", error_offset));
+    }
+    if(!ImportGltf_LoadBuffers(&file, binary_chunk, jobs)) {
+        return false;
+    }
+    const ImportJsonValue* mesh_values = file.json.find("meshes");
+    if(!mesh_values || mesh_values->items.empty()) {
+        return ImportGltf_Fail(path, "no meshes");
+    }
+    const std::string stem = std::filesystem::path(path).stem().string();
+    std::vector<LevelMesh> imported;
+    uint32_t skipped_count = 0;
+    for(size_t mesh_index = 0; mesh_index < mesh_values->items.size(); ++mesh_index) {
+        const ImportJsonValue& mesh_value = mesh_values->items[mesh_index];
+        const ImportJsonValue* primitive_values = mesh_value.find("primitives");
+        if(!primitive_values) {
+            return ImportGltf_Fail(path, fmt::format("mesh {} has no primitives", mesh_index));
+        }
+        // Size the mesh for every primitive up front
+        std::vector<ImportGltfPrimitive> primitives;
+        uint64_t vertex_count = 0;
+        uint64_t index_count = 0;
+        bool has_normals = false;
+        bool has_uvs = false;
+        for(const auto& primitive_value : primitive_values->items) {
+            if(primitive_value.get_uint("mode", ImportGltf_Triangles) != ImportGltf_Triangles) {
+                skipped_count++;
+                continue;
+            }
+            ImportGltfPrimitive& primitive = primitives.emplace_back();
+            if(!ImportGltf_GetPrimitive(file, primitive_value, &primitive)) {
+                return ImportGltf_Fail(path, fmt::format("mesh {} has an invalid primitive", mesh_index));
+            }
+            primitive.first_vertex = (uint32_t) vertex_count;
+            primitive.first_index = (uint32_t) index_count;
+            vertex_count += primitive.positions.count;
+            index_count += primitive.index_count;
+            has_normals = has_normals || primitive.has_normals;
+            has_uvs = has_uvs || primitive.has_uvs;
+            if(vertex_count >= UINT32_MAX || index_count >= UINT32_MAX) {
+                return ImportGltf_Fail(path, fmt::format("mesh {} has too many vertexes", mesh_index));
+            }
+        }
+        LevelMesh& mesh = imported.emplace_back();
+        const std::string_view name = mesh_value.get_string("name");
+        mesh.name = Symbol(
+            !name.empty() ? std::string(name) :
+            mesh_values->items.size() == 1 ? stem :
+            fmt::format("{}_{}", stem, mesh_index)
+        );
+        mesh.positions.resize(vertex_count);
+        mesh.indices.resize(index_count);
+        if(has_normals) {
+            mesh.normals.resize(vertex_count);
+        }
+        if(has_uvs) {
+            mesh.uvs.resize(vertex_count);
+        }
+        for(const auto& primitive : primitives) {
+            if(!ImportGltf_CopyPrimitive(primitive, jobs, &mesh)) {
+                return ImportGltf_Fail(path, fmt::format("mesh {} has an index out of range", mesh_index));
+            }
+        }
+    }
+    if(skipped_count > 0) {
+        UNI_LOG_WARN(
+            LogSubsystem_Assets, "Skipped {} primitives of '{}' which aren't triangle lists.",
+            skipped_count, path
+        );
+    }
+    for(auto& mesh : imported) {
+        meshes->push_back(std::move(mesh));
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/mesh.hpp"
+
+// First four bytes of a binary glTF file.
+const char ImportGltf_BinaryMagic[4] = {'g', 'l', 'T', 'F'};
+
+/**
+ * Read the meshes of a glTF 2.0 file, either JSON or binary GLB,
+ * appending one LevelMesh per glTF mesh.
+ * 
+ * The JSON is parsed into a tree, as it is small, while buffers
+ * are used where they lie: in the GLB's binary chunk, or in
+ * external files, which are memory-mapped. Only base64 data URIs
+ * are decoded into memory first. The triangles of all of a mesh's
+ * primitives are concatenated, and each accessor is copied and
+ * converted into the mesh's arrays by several jobs at once.
+ * 
+ * Node transforms, materials and other primitive modes than
+ * triangle lists are ignored. Returns false, logging why, if the
+ * file is malformed, in which case nothing is appended.
+ */
+bool ImportGltf_Read(
+    const uint8_t* data,
+    size_t size,
+    const char* path,
+    JobSystem* jobs,
+    std::vector<LevelMesh>* meshes
+);
@@ -0,0 +1,279 @@
+#include "json.hpp"
+
+#include <charconv>
+
+// Deepest nesting of arrays and objects accepted, so that hostile
+// files can't overflow the stack
+const int ImportJson_MaxDepth = 256;
+
+struct ImportJsonParser {
+    const char* begin;
+    const char* at;
+    const char* end;
+    
+    void skip_spaces() {
+        while(this->at < this->end && (
+            *this->at == ' ' || *this->at == '\t' || *this->at == '\n' || *this->at == '\r'
+        )) {
+            ++this->at;
+        }
+    }
+    
+    bool consume(std::string_view word) {
+        if((size_t) (this->end - this->at) < word.size() || std::string_view(this->at, word.size()) != word) {
+            return false;
+        }
+        this->at += word.size();
+        return true;
+    }
+    
+    static int get_hex_digit(char c) {
+        if(c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if(c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if(c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+    
+    bool parse_hex4(uint32_t* value) {
+        if(this->end - this->at < 4) {
+            return false;
+        }
+        *value = 0;
+        for(int i = 0; i < 4; ++i) {
+            const int digit = get_hex_digit(this->at[i]);
+            if(digit < 0) {
+                return false;
+            }
+            *value = (*value << 4) | (uint32_t) digit;
+        }
+        this->at += 4;
+        return true;
+    }
+    
+    static void append_utf8(std::string* string, uint32_t code) {
+        if(code < 0x80) {
+            string->push_back((char) code);
+        }
+        else if(code < 0x800) {
+            string->push_back((char) (0xc0 | (code >> 6)));
+            string->push_back((char) (0x80 | (code & 0x3f)));
+        }
+        else if(code < 0x10000) {
+            string->push_back((char) (0xe0 | (code >> 12)));
+            string->push_back((char) (0x80 | ((code >> 6) & 0x3f)));
+            string->push_back((char) (0x80 | (code & 0x3f)));
+        }
+        else {
+            string->push_back((char) (0xf0 | (code >> 18)));
+            string->push_back((char) (0x80 | ((code >> 12) & 0x3f)));
+            string->push_back((char) (0x80 | ((code >> 6) & 0x3f)));
+            string->push_back((char) (0x80 | (code & 0x3f)));
+        }
+    }
+    
+    bool parse_string(std::string* string) {
+        if(this->at >= this->end || *this->at != '"') {
+            return false;
+        }
+        ++this->at;
+        while(this->at < this->end) {
+            // Copy runs without escapes at once
+            const char* run = this->at;
+            while(this->at < this->end && *this->at != '"' && *this->at != '\\') {
+                ++this->at;
+            }
+            string->append(run, this->at);
+            if(this->at >= this->end) {
+                return false;
+            }
+            if(*this->at == '"') {
+                ++this->at;
+                return true;
+            }
+            ++this->at;
+            if(this->at >= this->end) {
+                return false;
+            }
+            const char escape = *this->at++;
+            switch(escape) {
+                case '"':
+                    string->push_back('"');
+                    break;
+                case '\\':
+                    string->push_back('\\');
+                    break;
+                case '/':
+                    string->push_back('/');
+                    break;
+                case 'b':
+                    string->push_back('\b');
+                    break;
+                case 'f':
+                    string->push_back('\f');
+                    break;
+                case 'n':
+                    string->push_back('\n');
+                    break;
+                case 'r':
+                    string->push_back('\r');
+                    break;
+                case 't':
+                    string->push_back('\t');
+                    break;
+                case 'u': {
+                    uint32_t code;
+                    if(!this->parse_hex4(&code)) {
+                        return false;
+                    }
+                    // Join surrogate pairs
+                    uint32_t low;
+                    if(
+                        code >= 0xd800 && code < 0xdc00 && this->consume("\\u") &&
+                        this->parse_hex4(&low) && low >= 0xdc00 && low < 0xe000
+                    ) {
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(string, code);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+    
+    bool parse_value(ImportJsonValue* value, int depth) {
+        this->skip_spaces();
+        if(this->at >= this->end || depth > ImportJson_MaxDepth) {
+            return false;
+        }
+        switch(*this->at) {
+            case '{': {
+                ++this->at;
+                value->type = ImportJsonType_Object;
+                this->skip_spaces();
+                if(this->at < this->end && *this->at == '}') {
+                    ++this->at;
+                    return true;
+                }
+                while(true) {
+                    this->skip_spaces();
+                    ImportJsonMember& member = value->members.emplace_back();
+                    if(!this->parse_string(&member.key)) {
+                        return false;
+                    }
+                    this->skip_spaces();
+                    if(!this->consume(":") || !this->parse_value(&member.value, depth + 1)) {
+                        return false;
+                    }
+                    this->skip_spaces();
+                    if(this->consume("}")) {
+                        return true;
+                    }
+                    if(!this->consume(",")) {
+                        return false;
+                    }
+                }
+            }
+            case '[': {
+                ++this->at;
+                value->type = ImportJsonType_Array;
+                this->skip_spaces();
+                if(this->at < this->end && *this->at == ']') {
+                    ++this->at;
+                    return true;
+                }
+                while(true) {
+                    if(!this->parse_value(&value->items.emplace_back(), depth + 1)) {
+                        return false;
+                    }
+                    this->skip_spaces();
+                    if(this->consume("]")) {
+                        return true;
+                    }
+                    if(!this->consume(",")) {
+                        return false;
+                    }
+                }
+            }
+            case '"':
+                value->type = ImportJsonType_String;
+                return this->parse_string(&value->string);
+            case 't':
+                value->type = ImportJsonType_Bool;
+                value->boolean = true;
+                return this->consume("true");
+            case 'f':
+                value->type = ImportJsonType_Bool;
+                return this->consume("false");
+            case 'n':
+                return this->consume("null");
+            default: {
+                value->type = ImportJsonType_Number;
+                const auto result = std::from_chars(this->at, this->end, value->number);
+                if(result.ec != std::errc() || result.ptr == this->at) {
+                    return false;
+                }
+                this->at = result.ptr;
+                return true;
+            }
+        }
+    }
+};
+
+const ImportJsonValue* ImportJsonValue::find(std::string_view key) const {
+    for(const auto& member : this->members) {
+        if(member.key == key) {
+            return &member.value;
+        }
+    }
+    return nullptr;
+}
+
+const ImportJsonValue* ImportJsonValue::get_item(size_t index) const {
+    return index < this->items.size() ? &this->items[index] : nullptr;
+}
+
+double ImportJsonValue::get_number(std::string_view key, double fallback) const {
+    const ImportJsonValue* member = this->find(key);
+    return member && member->type == ImportJsonType_Number ? member->number : fallback;
+}
+
+uint64_t ImportJsonValue::get_uint(std::string_view key, uint64_t fallback) const {
+    const ImportJsonValue* member = this->find(key);
+    if(!member || member->type != ImportJsonType_Number || member->number < 0.0 || member->number >= 0x1p64) {
+        return fallback;
+    }
+    return (uint64_t) member->number;
+}
+
+bool ImportJsonValue::get_bool(std::string_view key, bool fallback) const {
+    const ImportJsonValue* member = this->find(key);
+    return member && member->type == ImportJsonType_Bool ? member->boolean : fallback;
+}
+
+std::string_view ImportJsonValue::get_string(std::string_view key, std::string_view fallback) const {
+    const ImportJsonValue* member = this->find(key);
+    return member && member->type == ImportJsonType_String ? std::string_view(member->string) : fallback;
+}
+
+bool ImportJson_Parse(std::string_view text, ImportJsonValue* value, size_t* error_offset) {
+    *value = ImportJsonValue{};
+    ImportJsonParser parser = ImportJsonParser{text.data(), text.data(), text.data() + text.size()};
+    bool valid = parser.parse_value(value, 0);
+    if(valid) {
+        parser.skip_spaces();
+        valid = parser.at == parser.end;
+    }
+    if(!valid && error_offset) {
+        *error_offset = (size_t) (parser.at - parser.begin);
+    }
+    return valid;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum ImportJsonType : int {
+    ImportJsonType_Null = 0,
+    ImportJsonType_Bool,
+    ImportJsonType_Number,
+    ImportJsonType_String,
+    ImportJsonType_Array,
+    ImportJsonType_Object,
+};
+
+struct ImportJsonMember;
+
+/**
+ * Parsed JSON value, as a tree. Meant for the small descriptions
+ * which come with bulk data, such as a glTF file's JSON chunk,
+ * not for large documents.
+ */
+struct ImportJsonValue {
+    ImportJsonType type = ImportJsonType_Null;
+    bool boolean = false;
+    double number = 0.0;
+    // With escapes decoded
+    std::string string;
+    std::vector<ImportJsonValue> items;
+    // In the order they appear
+    std::vector<ImportJsonMember> members;
+    
+    // Get an object's member by key, or nullptr if there is none
+    // or this isn't an object.
+    const ImportJsonValue* find(std::string_view key) const;
+    // Get an array's item, or nullptr if out of range or this
+    // isn't an array.
+    const ImportJsonValue* get_item(size_t index) const;
+    // Get a member's value, or the fallback if the member is
+    // missing or of another type.
+    double get_number(std::string_view key, double fallback) const;
+    uint64_t get_uint(std::string_view key, uint64_t fallback) const;
+    bool get_bool(std::string_view key, bool fallback) const;
+    std::string_view get_string(std::string_view key, std::string_view fallback = {}) const;
+};
+
+struct ImportJsonMember {
+    std::string key;
+    ImportJsonValue value;
+};
+
+/**
+ * Parse JSON text. Returns false if the text is malformed, with
+ * the offset of the problem in error_offset if given.
+ */
+bool ImportJson_Parse(std::string_view text, ImportJsonValue* value, size_t* error_offset = nullptr);
@@ -0,0 +1,71 @@
+#include "mesh_import.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "gltf.hpp"
+#include "obj.hpp"
+#include "util/log.hpp"
+#include "util/mapped_file.hpp"
+#include "util/profiler.hpp"
+#include "util/string.hpp"
+
+ImportFormat Import_GetFormat(std::string_view path) {
+    const size_t dot = path.rfind('.');
+    if(dot == std::string_view::npos) {
+        return ImportFormat_Unknown;
+    }
+    const std::string_view extension = path.substr(dot);
+    if(extension.size() == 4 && string_starts_with_insensitive(extension, ".obj")) {
+        return ImportFormat_Obj;
+    }
+    if(
+        (extension.size() == 5 && string_starts_with_insensitive(extension, ".gltf")) ||
+        (extension.size() == 4 && string_starts_with_insensitive(extension, ".glb"))
+    ) {
+        return ImportFormat_Gltf;
+    }
+    return ImportFormat_Unknown;
+}
+
+bool Import_Meshes(const char* path, JobSystem* jobs, std::vector<LevelMesh>* meshes) {
+    UNI_PROFILE_ZONE("Import_Meshes");
+    const ImportFormat format = Import_GetFormat(path);
+    if(format == ImportFormat_Unknown) {
+        UNI_LOG_WARN(LogSubsystem_Assets, "Can't import '{}': unknown file type.", path);
+        return false;
+    }
+    MappedFile file;
+    if(!file.open(path)) {
+        UNI_LOG_WARN(LogSubsystem_Assets, "Can't import '{}': failed to open the file.", path);
+        return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const size_t first = meshes->size();
+    if(format == ImportFormat_Obj) {
+        LevelMesh mesh;
+        mesh.name = Symbol(std::filesystem::path(path).stem().string());
+        if(!ImportObj_Read(file.data(), file.size(), path, jobs, &mesh)) {
+            return false;
+        }
+        meshes->push_back(std::move(mesh));
+    }
+    else if(!ImportGltf_Read(file.data(), file.size(), path, jobs, meshes)) {
+        return false;
+    }
+    size_t vertex_count = 0;
+    size_t triangle_count = 0;
+    for(size_t i = first; i < meshes->size(); ++i) {
+        vertex_count += (*meshes)[i].positions.size();
+        triangle_count += (*meshes)[i].indices.size() / 3;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    UNI_LOG_INFO(
+        LogSubsystem_Assets,
+        "Imported {} meshes with {} vertexes and {} triangles from '{}' in {:.1f} ms ({:.0f} MB/s).",
+        meshes->size() - first, vertex_count, triangle_count, path,
+        seconds * 1000.0, (double) file.size() / (1 << 20) / std::max(seconds, 1e-9)
+    );
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/mesh.hpp"
+
+enum ImportFormat : int {
+    ImportFormat_Unknown = 0,
+    // Wavefront OBJ text
+    ImportFormat_Obj,
+    // glTF 2.0, as JSON with separate or embedded buffers, or as
+    // a binary GLB container
+    ImportFormat_Gltf,
+};
+
+// Guess the format of a file from its extension.
+ImportFormat Import_GetFormat(std::string_view path);
+
+/**
+ * Read the meshes of a model file, appending them to meshes.
+ * 
+ * The file is memory-mapped rather than read, and large arrays in
+ * it are parsed or converted by several jobs at once, each writing
+ * straight into the final arrays of the LevelMesh, which are sized
+ * once up front. Meshes are in the model's own space, and names
+ * come from the file where it has them.
+ * 
+ * Runs on the calling thread, with help from the job system if
+ * one is given. Returns false, logging why, if the file can't be
+ * read, in which case nothing is appended.
+ */
+bool Import_Meshes(const char* path, JobSystem* jobs, std::vector<LevelMesh>* meshes);
+
+// Run fn(begin, end) over [0, count) in chunks, on the job system
+// if there is one, and otherwise on the calling thread.
+inline void Import_ParallelFor(
+    JobSystem* jobs,
+    size_t count,
+    size_t chunk_size,
+    const std::function<void(size_t begin, size_t end)>& fn
+) {
+    if(!jobs) {
+        fn(0, count);
+        return;
+    }
+    // Chunks are indexed by int, so huge counts get larger chunks
+    chunk_size = std::max(chunk_size, count / (size_t) INT32_MAX + 1);
+    const int chunk_count = (int) ((count + chunk_size - 1) / chunk_size);
+    jobs->parallel_for(chunk_count, 1, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            const size_t first = (size_t) i * chunk_size;
+            fn(first, std::min(count, first + chunk_size));
+        }
+    });
+}
@@ -0,0 +1,548 @@
+#include "obj.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_import.hpp"
+#include "util/hash.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Chunks of text are at least this large, so that small files
+// are read by one job
+const size_t ImportObj_MinChunkSize = 256 << 10;
+// Chunks per thread, so that threads which finish early find
+// more work
+const size_t ImportObj_ChunksPerThread = 4;
+// Corners and vertexes handled by one job when resolving vertexes
+const size_t ImportObj_ResolveChunkSize = 1 << 16;
+// Index of an attribute which a corner doesn't have
+const uint32_t ImportObj_NoIndex = UINT32_MAX;
+
+enum ImportObjLineKind : int {
+    ImportObjLineKind_Other = 0,
+    ImportObjLineKind_Position,
+    ImportObjLineKind_Uv,
+    ImportObjLineKind_Normal,
+    ImportObjLineKind_Face,
+};
+
+// Range of whole lines read by one job.
+struct ImportObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    uint32_t position_count = 0;
+    uint32_t uv_count = 0;
+    uint32_t normal_count = 0;
+    uint32_t triangle_count = 0;
+    // Index of the chunk's first element of each kind among the
+    // whole file's. Set between counting and parsing.
+    uint32_t first_position = 0;
+    uint32_t first_uv = 0;
+    uint32_t first_normal = 0;
+    uint32_t first_triangle = 0;
+    Bounds3 bounds = Bounds3_Empty;
+    // First malformed line, and what is wrong with it
+    const char* error = nullptr;
+    const char* error_message = nullptr;
+};
+
+// Indexes of one corner of a face, into the file's positions,
+// texture coordinates and normals.
+struct ImportObjCorner {
+    uint32_t position = 0;
+    uint32_t uv = ImportObj_NoIndex;
+    uint32_t normal = ImportObj_NoIndex;
+    
+    bool operator==(const ImportObjCorner& other) const {
+        return (
+            this->position == other.position &&
+            this->uv == other.uv &&
+            this->normal == other.normal
+        );
+    }
+};
+
+struct ImportObjCornerHash {
+    size_t operator()(const ImportObjCorner& corner) const {
+        uint64_t hash = hash_combine(Hash_DefaultSeed, corner.position);
+        hash = hash_combine(hash, corner.uv);
+        return (size_t) hash_combine(hash, corner.normal);
+    }
+};
+
+// What the parsing pass writes. Positions and triangles go
+// straight into the mesh. Texture coordinates and normals are
+// kept aside until every corner's are known, since OBJ indexes
+// them separately from positions.
+struct ImportObjOutput {
+    LevelMesh* mesh = nullptr;
+    uint32_t position_count = 0;
+    uint32_t uv_count = 0;
+    uint32_t normal_count = 0;
+    std::unique_ptr<Vec2[]> uvs;
+    std::unique_ptr<Vec3[]> normals;
+    // Texture coordinate and normal index of each element of the
+    // mesh's indices. Null if the file has none of that attribute.
+    std::unique_ptr<uint32_t[]> corner_uvs;
+    std::unique_ptr<uint32_t[]> corner_normals;
+};
+
+static bool ImportObj_IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* ImportObj_SkipSpaces(const char* at, const char* end) {
+    while(at < end && ImportObj_IsSpace(*at)) {
+        ++at;
+    }
+    return at;
+}
+
+// Classify a line by its keyword, and return where the values
+// after the keyword start.
+static ImportObjLineKind ImportObj_GetLineKind(const char* at, const char* end, const char** values) {
+    at = ImportObj_SkipSpaces(at, end);
+    const size_t length = (size_t) (end - at);
+    ImportObjLineKind kind = ImportObjLineKind_Other;
+    size_t keyword_length = 0;
+    if(length >= 2 && at[0] == 'v' && ImportObj_IsSpace(at[1])) {
+        kind = ImportObjLineKind_Position;
+        keyword_length = 1;
+    }
+    else if(length >= 3 && at[0] == 'v' && at[1] == 't' && ImportObj_IsSpace(at[2])) {
+        kind = ImportObjLineKind_Uv;
+        keyword_length = 2;
+    }
+    else if(length >= 3 && at[0] == 'v' && at[1] == 'n' && ImportObj_IsSpace(at[2])) {
+        kind = ImportObjLineKind_Normal;
+        keyword_length = 2;
+    }
+    else if(length >= 2 && at[0] == 'f' && ImportObj_IsSpace(at[1])) {
+        kind = ImportObjLineKind_Face;
+        keyword_length = 1;
+    }
+    *values = at + keyword_length;
+    return kind;
+}
+
+// Get the end of the line starting at a point, not counting its
+// line break.
+static const char* ImportObj_GetLineEnd(const char* at, const char* end) {
+    const char* line_end = (const char*) std::memchr(at, '\n', (size_t) (end - at));
+    return line_end ? line_end : end;
+}
+
+// Count the corners of a face: each run of characters between
+// spaces, up to any comment.
+static uint32_t ImportObj_CountCorners(const char* at, const char* end) {
+    uint32_t count = 0;
+    while(true) {
+        at = ImportObj_SkipSpaces(at, end);
+        if(at >= end || *at == '#') {
+            return count;
+        }
+        count++;
+        while(at < end && !ImportObj_IsSpace(*at)) {
+            ++at;
+        }
+    }
+}
+
+static bool ImportObj_ParseFloat(const char** at, const char* end, float* value) {
+    const char* start = ImportObj_SkipSpaces(*at, end);
+    // from_chars doesn't accept a plus sign, which some exporters
+    // write
+    if(start < end && *start == '+') {
+        ++start;
+    }
+    auto result = std::from_chars(start, end, *value);
+    if(result.ec == std::errc::result_out_of_range) {
+        // Too small or large for a float, such as a denormal.
+        // Parse at double precision and let the cast round it.
+        double wide;
+        result = std::from_chars(start, end, wide);
+        *value = (float) wide;
+    }
+    if(result.ec != std::errc() || (result.ptr < end && !ImportObj_IsSpace(*result.ptr))) {
+        return false;
+    }
+    *at = result.ptr;
+    return true;
+}
+
+// Parse a one-based or, if negative, relative index, and check it
+// against the number of elements which came before it in the file.
+static bool ImportObj_ParseIndex(const char** at, const char* end, uint32_t preceding, uint32_t* index) {
+    int64_t value = 0;
+    const auto result = std::from_chars(*at, end, value);
+    if(result.ec != std::errc()) {
+        return false;
+    }
+    *at = result.ptr;
+    const int64_t resolved = value > 0 ? value - 1 : (int64_t) preceding + value;
+    if(value == 0 || resolved < 0 || resolved >= (int64_t) preceding) {
+        return false;
+    }
+    *index = (uint32_t) resolved;
+    return true;
+}
+
+// Parse a corner of a face: a position index, optionally followed
+// by a texture coordinate index and a normal index, separated by
+// slashes, either of which may be empty.
+static bool ImportObj_ParseCorner(
+    const char** at,
+    const char* end,
+    const uint32_t preceding[3],
+    ImportObjCorner* corner
+) {
+    const char* cursor = *at;
+    *corner = ImportObjCorner{};
+    if(!ImportObj_ParseIndex(&cursor, end, preceding[0], &corner->position)) {
+        return false;
+    }
+    if(cursor < end && *cursor == '/') {
+        ++cursor;
+        if(cursor < end && *cursor != '/' && !ImportObj_ParseIndex(&cursor, end, preceding[1], &corner->uv)) {
+            return false;
+        }
+        if(cursor < end && *cursor == '/') {
+            ++cursor;
+            if(!ImportObj_ParseIndex(&cursor, end, preceding[2], &corner->normal)) {
+                return false;
+            }
+        }
+    }
+    if(cursor < end && !ImportObj_IsSpace(*cursor)) {
+        return false;
+    }
+    *at = cursor;
+    return true;
+}
+
+static void ImportObj_CountChunk(ImportObjChunk* chunk) {
+    const char* at = chunk->begin;
+    while(at < chunk->end) {
+        const char* line_end = ImportObj_GetLineEnd(at, chunk->end);
+        const char* values;
+        switch(ImportObj_GetLineKind(at, line_end, &values)) {
+            case ImportObjLineKind_Position:
+                chunk->position_count++;
+                break;
+            case ImportObjLineKind_Uv:
+                chunk->uv_count++;
+                break;
+            case ImportObjLineKind_Normal:
+                chunk->normal_count++;
+                break;
+            case ImportObjLineKind_Face: {
+                const uint32_t corner_count = ImportObj_CountCorners(values, line_end);
+                if(corner_count >= 3) {
+                    chunk->triangle_count += corner_count - 2;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        at = line_end + 1;
+    }
+}
+
+static void ImportObj_ParseChunk(ImportObjChunk* chunk, ImportObjOutput* output) {
+    LevelMesh* mesh = output->mesh;
+    uint32_t position = chunk->first_position;
+    uint32_t uv = chunk->first_uv;
+    uint32_t normal = chunk->first_normal;
+    uint32_t corner_index = chunk->first_triangle * 3;
+    const char* at = chunk->begin;
+    while(at < chunk->end) {
+        const char* line_end = ImportObj_GetLineEnd(at, chunk->end);
+        const char* values;
+        const ImportObjLineKind kind = ImportObj_GetLineKind(at, line_end, &values);
+        bool valid = true;
+        if(kind == ImportObjLineKind_Position) {
+            Vec3 value;
+            valid = (
+                ImportObj_ParseFloat(&values, line_end, &value.x) &&
+                ImportObj_ParseFloat(&values, line_end, &value.y) &&
+                ImportObj_ParseFloat(&values, line_end, &value.z)
+            );
+            // Any weight or vertex color which follows is ignored
+            mesh->positions[position++] = value;
+            chunk->bounds = Bounds3_Grow(chunk->bounds, value);
+        }
+        else if(kind == ImportObjLineKind_Uv) {
+            float u = 0.0f;
+            float v = 0.0f;
+            valid = ImportObj_ParseFloat(&values, line_end, &u);
+            // The second coordinate is optional
+            const char* rest = ImportObj_SkipSpaces(values, line_end);
+            if(valid && rest < line_end && *rest != '#') {
+                valid = ImportObj_ParseFloat(&values, line_end, &v);
+            }
+            output->uvs[uv++] = Vec2{u, 1.0f - v};
+        }
+        else if(kind == ImportObjLineKind_Normal) {
+            Vec3 value;
+            valid = (
+                ImportObj_ParseFloat(&values, line_end, &value.x) &&
+                ImportObj_ParseFloat(&values, line_end, &value.y) &&
+                ImportObj_ParseFloat(&values, line_end, &value.z)
+            );
+            output->normals[normal++] = value;
+        }
+        else if(kind == ImportObjLineKind_Face) {
+            // Fan out from the first corner, as the counting pass
+            // assumed
+            const uint32_t preceding[3] = {position, uv, normal};
+            ImportObjCorner first;
+            ImportObjCorner previous;
+            uint32_t corner_count = 0;
+            while(valid) {
+                values = ImportObj_SkipSpaces(values, line_end);
+                if(values >= line_end || *values == '#') {
+                    break;
+                }
+                ImportObjCorner corner;
+                valid = ImportObj_ParseCorner(&values, line_end, preceding, &corner);
+                if(valid && corner_count >= 2) {
+                    const ImportObjCorner triangle[3] = {first, previous, corner};
+                    for(const auto& vertex : triangle) {
+                        mesh->indices[corner_index] = vertex.position;
+                        if(output->corner_uvs) {
+                            output->corner_uvs[corner_index] = vertex.uv;
+                        }
+                        if(output->corner_normals) {
+                            output->corner_normals[corner_index] = vertex.normal;
+                        }
+                        corner_index++;
+                    }
+                }
+                if(corner_count == 0) {
+                    first = corner;
+                }
+                previous = corner;
+                corner_count++;
+            }
+        }
+        if(!valid) {
+            chunk->error = at;
+            chunk->error_message = (
+                kind == ImportObjLineKind_Face ? "Invalid face" : "Invalid vertex"
+            );
+            return;
+        }
+        at = line_end + 1;
+    }
+}
+
+// Give each position the attributes of the first corner using it,
+// and add a vertex for each other combination of position and
+// attributes, pointing the corners using it at the new vertex.
+static void ImportObj_ResolveVertexes(JobSystem* jobs, ImportObjOutput* output) {
+    UNI_PROFILE_ZONE("ImportObj_ResolveVertexes");
+    LevelMesh* mesh = output->mesh;
+    const uint32_t position_count = output->position_count;
+    const size_t corner_count = mesh->indices.size();
+    const uint32_t* corner_uvs = output->corner_uvs.get();
+    const uint32_t* corner_normals = output->corner_normals.get();
+    // Lowest corner index using each position. The lowest, rather
+    // than any, so that the result doesn't depend on timing.
+    std::unique_ptr<std::atomic<uint32_t>[]> claims(new std::atomic<uint32_t>[position_count]);
+    Import_ParallelFor(jobs, position_count, ImportObj_ResolveChunkSize, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            claims[i].store(ImportObj_NoIndex, std::memory_order_relaxed);
+        }
+    });
+    Import_ParallelFor(jobs, corner_count, ImportObj_ResolveChunkSize, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            std::atomic<uint32_t>& claim = claims[mesh->indices[i]];
+            uint32_t current = claim.load(std::memory_order_relaxed);
+            while((uint32_t) i < current && !claim.compare_exchange_weak(
+                current, (uint32_t) i, std::memory_order_relaxed
+            )) {}
+        }
+    });
+    auto has_same_attributes = [&](size_t a, size_t b) {
+        return (
+            (!corner_uvs || corner_uvs[a] == corner_uvs[b]) &&
+            (!corner_normals || corner_normals[a] == corner_normals[b])
+        );
+    };
+    // Find which ranges of corners have any which need a vertex of
+    // their own, so that meshes without seams skip the serial pass
+    const size_t range_count = (corner_count + ImportObj_ResolveChunkSize - 1) / ImportObj_ResolveChunkSize;
+    std::unique_ptr<uint8_t[]> range_splits(new uint8_t[range_count]());
+    Import_ParallelFor(jobs, range_count, 1, [&](size_t begin, size_t end) {
+        for(size_t range = begin; range < end; ++range) {
+            const size_t first = range * ImportObj_ResolveChunkSize;
+            const size_t last = std::min(corner_count, first + ImportObj_ResolveChunkSize);
+            for(size_t i = first; i < last && !range_splits[range]; ++i) {
+                const uint32_t claim = claims[mesh->indices[i]].load(std::memory_order_relaxed);
+                range_splits[range] = !has_same_attributes(i, claim);
+            }
+        }
+    });
+    // Corners whose combination of attributes was seen first, in
+    // the order their vertexes are added
+    std::unordered_map<ImportObjCorner, uint32_t, ImportObjCornerHash> split_vertexes;
+    std::vector<ImportObjCorner> split_sources;
+    std::vector<uint32_t> split_corners;
+    for(size_t range = 0; range < range_count; ++range) {
+        if(!range_splits[range]) {
+            continue;
+        }
+        const size_t first = range * ImportObj_ResolveChunkSize;
+        const size_t last = std::min(corner_count, first + ImportObj_ResolveChunkSize);
+        for(size_t i = first; i < last; ++i) {
+            const uint32_t position = mesh->indices[i];
+            if(has_same_attributes(i, claims[position].load(std::memory_order_relaxed))) {
+                continue;
+            }
+            const ImportObjCorner key = ImportObjCorner{
+                position,
+                corner_uvs ? corner_uvs[i] : ImportObj_NoIndex,
+                corner_normals ? corner_normals[i] : ImportObj_NoIndex
+            };
+            const auto [entry, inserted] = split_vertexes.try_emplace(
+                key, position_count + (uint32_t) split_sources.size()
+            );
+            if(inserted) {
+                split_sources.push_back(key);
+                split_corners.push_back((uint32_t) i);
+            }
+            mesh->indices[i] = entry->second;
+        }
+    }
+    const size_t vertex_count = position_count + split_sources.size();
+    mesh->positions.resize(vertex_count);
+    if(corner_uvs) {
+        mesh->uvs.resize(vertex_count);
+    }
+    if(corner_normals) {
+        mesh->normals.resize(vertex_count);
+    }
+    Import_ParallelFor(jobs, vertex_count, ImportObj_ResolveChunkSize, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            uint32_t corner;
+            if(i < position_count) {
+                // Positions used by no face keep zero attributes
+                corner = claims[i].load(std::memory_order_relaxed);
+            }
+            else {
+                corner = split_corners[i - position_count];
+                mesh->positions[i] = mesh->positions[split_sources[i - position_count].position];
+            }
+            if(corner == ImportObj_NoIndex) {
+                continue;
+            }
+            if(corner_uvs && corner_uvs[corner] != ImportObj_NoIndex) {
+                mesh->uvs[i] = output->uvs[corner_uvs[corner]];
+            }
+            if(corner_normals && corner_normals[corner] != ImportObj_NoIndex) {
+                mesh->normals[i] = output->normals[corner_normals[corner]];
+            }
+        }
+    });
+}
+
+bool ImportObj_Read(
+    const uint8_t* data,
+    size_t size,
+    const char* path,
+    JobSystem* jobs,
+    LevelMesh* mesh
+) {
+    UNI_PROFILE_ZONE("ImportObj_Read");
+    const char* text = (const char*) data;
+    const char* text_end = text + size;
+    // Split into chunks at line breaks
+    const size_t thread_count = jobs ? (size_t) jobs->get_worker_count() + 1 : 1;
+    const size_t chunk_size = std::max(
+        ImportObj_MinChunkSize, size / (thread_count * ImportObj_ChunksPerThread) + 1
+    );
+    std::vector<ImportObjChunk> chunks;
+    for(const char* at = text; at < text_end;) {
+        const char* chunk_end = at + std::min(chunk_size, (size_t) (text_end - at));
+        if(chunk_end < text_end) {
+            const char* line_end = ImportObj_GetLineEnd(chunk_end, text_end);
+            chunk_end = line_end < text_end ? line_end + 1 : text_end;
+        }
+        ImportObjChunk& chunk = chunks.emplace_back();
+        chunk.begin = at;
+        chunk.end = chunk_end;
+        at = chunk_end;
+    }
+    Import_ParallelFor(jobs, chunks.size(), 1, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            ImportObj_CountChunk(&chunks[i]);
+        }
+    });
+    // Each chunk's elements follow the previous chunk's
+    uint64_t position_count = 0;
+    uint64_t uv_count = 0;
+    uint64_t normal_count = 0;
+    uint64_t triangle_count = 0;
+    for(auto& chunk : chunks) {
+        chunk.first_position = (uint32_t) position_count;
+        chunk.first_uv = (uint32_t) uv_count;
+        chunk.first_normal = (uint32_t) normal_count;
+        chunk.first_triangle = (uint32_t) triangle_count;
+        position_count += chunk.position_count;
+        uv_count += chunk.uv_count;
+        normal_count += chunk.normal_count;
+        triangle_count += chunk.triangle_count;
+    }
+    // Indexes are 32-bit, and split vertexes are added after the
+    // positions
+    if(position_count + triangle_count * 3 >= UINT32_MAX || triangle_count * 3 >= UINT32_MAX) {
+        UNI_LOG_WARN(LogSubsystem_Assets, "Failed to import '{}': too many vertexes.", path);
+        return false;
+    }
+    ImportObjOutput output;
+    output.mesh = mesh;
+    output.position_count = (uint32_t) position_count;
+    output.uv_count = (uint32_t) uv_count;
+    output.normal_count = (uint32_t) normal_count;
+    mesh->positions.resize(position_count);
+    mesh->indices.resize(triangle_count * 3);
+    mesh->uvs.clear();
+    mesh->normals.clear();
+    if(uv_count > 0) {
+        output.uvs.reset(new Vec2[uv_count]);
+        output.corner_uvs.reset(new uint32_t[triangle_count * 3]);
+    }
+    if(normal_count > 0) {
+        output.normals.reset(new Vec3[normal_count]);
+        output.corner_normals.reset(new uint32_t[triangle_count * 3]);
+    }
+    Import_ParallelFor(jobs, chunks.size(), 1, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            ImportObj_ParseChunk(&chunks[i], &output);
+        }
+    });
+    mesh->bounds = Bounds3_Empty;
+    for(const auto& chunk : chunks) {
+        if(chunk.error) {
+            const size_t line = 1 + (size_t) std::count(text, chunk.error, '\n');
+            UNI_LOG_WARN(
+                LogSubsystem_Assets, "Failed to import '{}': {} on line {}.",
+                path, chunk.error_message, line
+            );
+            *mesh = LevelMesh{};
+            return false;
+        }
+        mesh->bounds = Bounds3_Union(mesh->bounds, chunk.bounds);
+    }
+    if(output.corner_uvs || output.corner_normals) {
+        ImportObj_ResolveVertexes(jobs, &output);
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "jobs/job_system.hpp"
+#include "level/mesh.hpp"
+
+/**
+ * Read Wavefront OBJ text into a mesh, in parallel.
+ * 
+ * The text is split at line breaks into chunks, one job each. A
+ * first pass counts the vertexes and triangles of every chunk,
+ * which gives each chunk the index of its first element in the
+ * mesh, and the mesh's arrays are sized once. A second pass parses
+ * every chunk straight into its place in those arrays. Faces are
+ * split into fans of triangles, and objects, groups and materials
+ * are ignored, so the whole file becomes one mesh.
+ * 
+ * OBJ faces index positions, texture coordinates and normals
+ * separately, where a mesh has one index per vertex. Each position
+ * becomes the vertex of the same index, with the attributes of the
+ * first corner which uses it, and a copy of the position is added
+ * for every other combination of attributes it is used with.
+ * Texture coordinates are flipped to start at the top of the image.
+ * 
+ * Returns false, logging why, if the text is malformed.
+ */
+bool ImportObj_Read(
+    const uint8_t* data,
+    size_t size,
+    const char* path,
+    JobSystem* jobs,
+    LevelMesh* mesh
+);
@@ -1,6 +1,7 @@
 #include "controller.hpp"
 
-#include "spdlog/spdlog.h"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
 
 void InputAction_NoCallback(InputAction* action) {}
 
@@ -17,16 +18,17 @@ InputActionKeyBind::InputActionKeyBind(
 
 InputActionKeyBind::InputActionKeyBind(
     InputActionHandle action,
-    std::string key_name,
+    Symbol key_name,
     InputKeyState key_state
 ) {
     this->action = action;
-    this->key = InputModifiedKey_Parse(key_name);
+    this->key = InputModifiedKey_Parse(std::string(key_name.view()));
     this->key_state = key_state;
     this->key_name = key_name;
 }
 
 void InputController::update() {
+    UNI_PROFILE_ZONE("InputController::update");
     InputContext current_context = this->get_current_context();
     for(auto& action : this->actions) {
         action.active = false;
@@ -41,23 +43,26 @@ void InputController::update() {
         );
         if(active) {
             if(bind.key_state == InputKeyState_Pressed) {
-                spdlog::trace(
+                UNI_LOG_TRACE(
+                    LogSubsystem_Input,
                     "Action '{}' activated by key press '{}'.",
-                    this->get_action_name(bind.action), bind.key_name
+                    this->get_action_name(bind.action).c_str(), bind.key_name.c_str()
                 );
             }
             else if(bind.key_state == InputKeyState_Released) {
-                spdlog::trace(
+                UNI_LOG_TRACE(
+                    LogSubsystem_Input,
                     "Action '{}' activated by key release '{}'.",
-                    this->get_action_name(bind.action), bind.key_name
+                    this->get_action_name(bind.action).c_str(), bind.key_name.c_str()
                 );
             }
             else if(bind.key_state == InputKeyState_Down &&
                 this->is_key_pressed(bind.key)
             ) {
-                spdlog::trace(
+                UNI_LOG_TRACE(
+                    LogSubsystem_Input,
                     "Action '{}' activated by key down '{}'.",
-                    this->get_action_name(bind.action), bind.key_name
+                    this->get_action_name(bind.action).c_str(), bind.key_name.c_str()
                 );
             }
             this->activate_action(bind.action);
@@ -66,9 +71,9 @@ void InputController::update() {
 }
 
 InputActionHandle InputController::add_action(InputAction action) {
-    auto handle = this->actions.size();
-    this->actions.push_back(action);
-    return (InputActionHandle) handle;
+    auto handle = (InputActionHandle) this->actions.size();
+    this->actions.push_back(std::move(action));
+    return handle;
 }
 
 InputActionKeyBindHandle InputController::add_action_key_bind(
@@ -76,10 +81,11 @@ InputActionKeyBindHandle InputController::add_action_key_bind(
 ) {
     auto handle = this->action_key_binds.size();
     this->action_key_binds.push_back(bind);
-    spdlog::debug(
+    UNI_LOG_DEBUG(
+        LogSubsystem_Input,
         "Added key bind: Action '{}' bound to key '{}' {}.",
-        this->get_action_name(bind.action),
-        bind.key_name,
+        this->get_action_name(bind.action).c_str(),
+        bind.key_name.c_str(),
         InputKeyState_GetName(bind.key_state)
     );
     return (InputActionKeyBindHandle) handle;
@@ -91,7 +97,7 @@ InputAction* InputController::get_action(
     return &this->actions.at(handle);
 }
 
-std::string InputController::get_action_name(
+Symbol InputController::get_action_name(
     InputActionHandle handle
 ) {
     return this->actions.at(handle).name;
@@ -134,7 +140,7 @@ InputContext InputController::get_current_context() {
 
 void InputController::push_context(InputContext context) {
     this->context_stack.push_back(context);
-    spdlog::trace("Pushed InputController context {}.", context);
+    UNI_LOG_TRACE(LogSubsystem_Input, "Pushed InputController context {}.", context);
 }
 
 void InputController::pop_context(InputContext context) {
@@ -142,7 +148,7 @@ void InputController::pop_context(InputContext context) {
         this->context_stack.back() == context
     ) {
         this->context_stack.pop_back();
-        spdlog::trace("Popped InputController context {}.", context);
+        UNI_LOG_TRACE(LogSubsystem_Input, "Popped InputController context {}.", context);
     }
 }
 
@@ -1,12 +1,12 @@
 #pragma once
 
 #include <functional>
-#include <string>
 #include <vector>
 
 #include "imgui.h"
 
 #include "key.hpp"
+#include "util/symbol.hpp"
 
 class App; // Forward declaration for App from app.hpp
 
@@ -38,7 +38,7 @@ void InputAction_NoCallback(InputAction* action);
 
 struct InputAction {
     // Readable and uniquely identifying name for this action
-    std::string name;
+    Symbol name;
     // Action is registered during any of the given contexts.
     InputContext context = InputContext_All;
     // Callback function to run when the input occurs or is occurring.
@@ -56,7 +56,7 @@ struct InputActionKeyBind {
     InputActionHandle action;
     InputModifiedKey key;
     InputKeyState key_state;
-    std::string key_name;
+    Symbol key_name;
     
     InputActionKeyBind(
         InputActionHandle action,
@@ -65,7 +65,7 @@ struct InputActionKeyBind {
     );
     InputActionKeyBind(
         InputActionHandle action,
-        std::string key_name,
+        Symbol key_name,
         InputKeyState key_state = InputKeyState_Pressed
     );
     
@@ -73,7 +73,7 @@ struct InputActionKeyBind {
         InputActionHandle action,
         InputModifiedKey key,
         InputKeyState key_state,
-        std::string key_name
+        Symbol key_name
     ):
         action(action),
         key(key),
@@ -111,7 +111,7 @@ public:
     InputActionHandle add_action(InputAction action);
     InputActionKeyBindHandle add_action_key_bind(InputActionKeyBind bind);
     InputAction* get_action(InputActionHandle handle);
-    std::string get_action_name(InputActionHandle handle);
+    Symbol get_action_name(InputActionHandle handle);
     InputContext get_action_context(InputActionHandle handle);
     InputActionKeyBind* get_action_key_bind(InputActionKeyBindHandle handle);
     bool is_action_active(InputActionHandle handle);
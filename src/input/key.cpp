@@ -1,6 +1,7 @@
 #include "key.hpp"
 
 #include <array>
+#include <cstring>
 
 const char* InputKeyState_GetName(InputKeyState state) {
     if(state < 0 || state >= std::size(InputKeyState_Names)) {
@@ -79,17 +80,23 @@ InputModifiedKey InputModifiedKey_Parse(std::string text) {
     return InputModifiedKey{key, (InputModifierKey) modifier};
 }
 
-std::string InputModifiedKey_ToString(InputModifiedKey& key) {
+std::string InputModifiedKey_ToString(const InputModifiedKey& key) {
     auto key_name = InputKey_GetName(key.key);
     auto mod_name = InputModifierKey_GetName(key.modifier);
+    std::string text;
     if(mod_name == nullptr || *mod_name == '\0')  {
-        return std::string(key_name);
+        text.append(key_name);
     }
     else {
-        return (
-            std::string(mod_name) +
-            std::string(InputModifierKey_Separator) +
-            std::string(key_name)
+        // Reserved up front, so that building allocates only once
+        text.reserve(
+            std::strlen(mod_name) +
+            std::strlen(InputModifierKey_Separator) +
+            std::strlen(key_name)
         );
+        text.append(mod_name);
+        text.append(InputModifierKey_Separator);
+        text.append(key_name);
     }
+    return text;
 }
@@ -219,7 +219,7 @@ InputModifiedKey InputModifiedKey_Parse(std::string text);
 
 // Given a key with modifier, get a string representing that key
 // combination in a readable way, e.g. "Ctrl+Shift+Z".
-std::string InputModifiedKey_ToString(InputModifiedKey& key);
+std::string InputModifiedKey_ToString(const InputModifiedKey& key);
 
 const char* const InputKeyState_Unknown_Name = "[Unknown]";
 
@@ -0,0 +1,316 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// The JobSystem which the calling thread is a worker of, if any,
+// and the index of its own queue there.
+static thread_local const JobSystem* job_queue_owner = nullptr;
+static thread_local int job_queue_index = -1;
+
+// Get the calling thread's own queue in a JobSystem, or -1 if the
+// thread isn't one of its workers. A worker of another JobSystem
+// is treated like any other outside thread.
+static int job_get_queue_index(const JobSystem* jobs) {
+    return job_queue_owner == jobs ? job_queue_index : -1;
+}
+
+JobSystem::~JobSystem() {
+    this->conclude();
+}
+
+void JobSystem::init(int worker_count) {
+    if(worker_count <= 0) {
+        worker_count = std::max(1, (int) std::thread::hardware_concurrency() - 1);
+    }
+    UNI_LOG_DEBUG(LogSubsystem_Jobs, "Initializing JobSystem with {} workers.", worker_count);
+    this->main_thread_id = std::this_thread::get_id();
+    this->stopping = false;
+    this->queues.clear();
+    for(int i = 0; i <= worker_count; ++i) {
+        this->queues.push_back(std::make_unique<JobWorkerQueue>());
+    }
+    for(int i = 0; i < worker_count; ++i) {
+        this->workers.emplace_back(&JobSystem::worker_main, this, i);
+    }
+}
+
+void JobSystem::conclude() {
+    if(this->workers.empty()) {
+        return;
+    }
+    UNI_LOG_DEBUG(LogSubsystem_Jobs, "Stopping JobSystem workers.");
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        this->stopping = true;
+    }
+    this->sleep_condition.notify_all();
+    for(auto& worker : this->workers) {
+        worker.join();
+    }
+    this->workers.clear();
+}
+
+void JobSystem::update() {
+    UNI_PROFILE_ZONE("JobSystem::update");
+    {
+        std::lock_guard<std::mutex> lock(this->main_queue_mutex);
+        std::swap(this->main_queue, this->main_queue_running);
+    }
+    for(auto& fn : this->main_queue_running) {
+        fn();
+    }
+    this->main_queue_running.clear();
+}
+
+JobHandle JobSystem::submit(
+    std::function<void()> run,
+    std::initializer_list<JobHandle> dependencies,
+    std::function<void()> complete
+) {
+    return this->submit(
+        std::move(run),
+        dependencies.begin(),
+        (int) dependencies.size(),
+        std::move(complete)
+    );
+}
+
+JobHandle JobSystem::submit(
+    std::function<void()> run,
+    const JobHandle* dependencies,
+    int dependency_count,
+    std::function<void()> complete
+) {
+    const uint32_t index = this->allocate_slot();
+    JobSlot& slot = this->get_slot(index);
+    const JobHandle handle = JobHandle{
+        index, slot.generation.load(std::memory_order_acquire)
+    };
+    slot.run = std::move(run);
+    slot.complete = std::move(complete);
+    // Hold one extra count so that the job can't be queued by a
+    // dependency finishing before all dependencies are registered.
+    slot.pending.store(1, std::memory_order_relaxed);
+    for(int i = 0; i < dependency_count; ++i) {
+        const JobHandle dependency = dependencies[i];
+        if(dependency.index >= JobSystem_MaxJobs) {
+            continue;
+        }
+        JobSlot& dependency_slot = this->get_slot(dependency.index);
+        std::lock_guard<std::mutex> lock(dependency_slot.mutex);
+        if(dependency_slot.generation.load(std::memory_order_relaxed) == dependency.generation) {
+            dependency_slot.dependents.push_back(index);
+            slot.pending.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if(slot.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->enqueue(index);
+    }
+    return handle;
+}
+
+void JobSystem::run_on_main_thread(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(this->main_queue_mutex);
+    this->main_queue.push_back(std::move(fn));
+}
+
+bool JobSystem::is_done(JobHandle handle) {
+    if(handle.index >= JobSystem_MaxJobs) {
+        return true;
+    }
+    return (
+        this->get_slot(handle.index).generation.load(std::memory_order_acquire) !=
+        handle.generation
+    );
+}
+
+void JobSystem::wait(JobHandle handle) {
+    UNI_PROFILE_ZONE("JobSystem::wait");
+    const int own_queue_index = job_get_queue_index(this);
+    const int queue_index = (
+        own_queue_index >= 0 ? own_queue_index : (int) this->queues.size() - 1
+    );
+    while(!this->is_done(handle)) {
+        if(!this->try_run_one(queue_index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallel_for(
+    int count,
+    int chunk_size,
+    const std::function<void(int begin, int end)>& fn
+) {
+    if(count <= 0) {
+        return;
+    }
+    chunk_size = std::max(1, chunk_size);
+    if(count <= chunk_size || this->workers.empty()) {
+        fn(0, count);
+        return;
+    }
+    const int chunk_count = (count + chunk_size - 1) / chunk_size;
+    // Submit all but the first chunk, which runs on this thread
+    std::vector<JobHandle> handles;
+    handles.reserve(chunk_count);
+    for(int i = 1; i < chunk_count; ++i) {
+        const int begin = i * chunk_size;
+        const int end = std::min(count, begin + chunk_size);
+        handles.push_back(this->submit([&fn, begin, end]() {
+            fn(begin, end);
+        }));
+    }
+    fn(0, std::min(count, chunk_size));
+    for(const auto handle : handles) {
+        this->wait(handle);
+    }
+}
+
+int JobSystem::get_worker_count() {
+    return (int) this->workers.size();
+}
+
+bool JobSystem::is_main_thread() {
+    return std::this_thread::get_id() == this->main_thread_id;
+}
+
+JobSlot& JobSystem::get_slot(uint32_t index) {
+    return this->slot_blocks[index / JobSystem_SlotBlockSize][index % JobSystem_SlotBlockSize];
+}
+
+uint32_t JobSystem::allocate_slot() {
+    while(true) {
+        {
+            std::lock_guard<std::mutex> lock(this->slots_mutex);
+            if(!this->free_slots.empty()) {
+                const uint32_t index = this->free_slots.back();
+                this->free_slots.pop_back();
+                return index;
+            }
+            if(this->slot_count < JobSystem_MaxJobs) {
+                const uint32_t index = this->slot_count;
+                const uint32_t block = index / JobSystem_SlotBlockSize;
+                if(!this->slot_blocks[block]) {
+                    this->slot_blocks[block] = std::make_unique<JobSlot[]>(
+                        JobSystem_SlotBlockSize
+                    );
+                }
+                this->slot_count++;
+                return index;
+            }
+        }
+        // Every slot is in use: help finish some jobs, then retry
+        const int own_queue_index = job_get_queue_index(this);
+        const int queue_index = (
+            own_queue_index >= 0 ? own_queue_index : (int) this->queues.size() - 1
+        );
+        if(!this->try_run_one(queue_index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::enqueue(uint32_t index) {
+    int queue_index = job_get_queue_index(this);
+    if(queue_index < 0) {
+        // Spread jobs submitted from outside the pool across workers
+        queue_index = (int) (
+            this->next_queue.fetch_add(1, std::memory_order_relaxed) %
+            this->queues.size()
+        );
+    }
+    auto& queue = *this->queues[queue_index];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(index);
+    }
+    this->queued_count.fetch_add(1, std::memory_order_release);
+    {
+        // Taking the lock orders this with a worker's predicate
+        // check, so the wakeup can't be lost.
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+    }
+    this->sleep_condition.notify_one();
+}
+
+bool JobSystem::try_run_one(int queue_index) {
+    uint32_t index = UINT32_MAX;
+    {
+        auto& queue = *this->queues[queue_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty()) {
+            index = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+    }
+    const int queue_count = (int) this->queues.size();
+    for(int i = 1; index == UINT32_MAX && i < queue_count; ++i) {
+        auto& queue = *this->queues[(queue_index + i) % queue_count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty()) {
+            index = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+    }
+    if(index == UINT32_MAX) {
+        return false;
+    }
+    this->queued_count.fetch_sub(1, std::memory_order_acq_rel);
+    this->execute(index);
+    return true;
+}
+
+void JobSystem::execute(uint32_t index) {
+    JobSlot& slot = this->get_slot(index);
+    {
+        UNI_PROFILE_ZONE("Job");
+        slot.run();
+    }
+    slot.run = nullptr;
+    std::function<void()> complete = std::move(slot.complete);
+    slot.complete = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        for(const uint32_t dependent : slot.dependents) {
+            auto& dependent_slot = this->get_slot(dependent);
+            if(dependent_slot.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                this->enqueue(dependent);
+            }
+        }
+        slot.dependents.clear();
+        // Invalidates outstanding handles, marking the job done
+        slot.generation.fetch_add(1, std::memory_order_release);
+    }
+    if(complete) {
+        this->run_on_main_thread(std::move(complete));
+    }
+    std::lock_guard<std::mutex> lock(this->slots_mutex);
+    this->free_slots.push_back(index);
+}
+
+void JobSystem::worker_main(int worker_index) {
+    char thread_name[32];
+    std::snprintf(thread_name, sizeof(thread_name), "Job Worker %d", worker_index);
+    UNI_PROFILE_THREAD(thread_name);
+    job_queue_owner = this;
+    job_queue_index = worker_index;
+    while(true) {
+        if(this->try_run_one(worker_index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        this->sleep_condition.wait(lock, [this]() -> bool {
+            return this->stopping || this->queued_count.load(std::memory_order_acquire) > 0;
+        });
+        if(this->stopping && this->queued_count.load(std::memory_order_acquire) <= 0) {
+            break;
+        }
+    }
+    job_queue_owner = nullptr;
+    job_queue_index = -1;
+}
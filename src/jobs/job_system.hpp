@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Identifies a job submitted to a JobSystem.
+ * Handles stay valid after the job has completed and its slot
+ * has been reused; they simply report the job as done.
+ */
+struct JobHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+const JobHandle JobHandle_None = JobHandle{};
+
+// Maximum number of jobs which may be pending at once.
+const uint32_t JobSystem_MaxJobs = 1 << 16;
+// Job slots are allocated in blocks of this size.
+const uint32_t JobSystem_SlotBlockSize = 1 << 10;
+
+// Storage for one submitted job. Slots are pooled and reused.
+struct JobSlot {
+    std::mutex mutex;
+    // Incremented each time the job completes, invalidating handles
+    std::atomic<uint32_t> generation = 0;
+    // Number of unfinished dependencies, plus one while submitting
+    std::atomic<int> pending = 0;
+    // Work to run on any thread
+    std::function<void()> run;
+    // Optional work to run on the main thread after completion
+    std::function<void()> complete;
+    // Slot indexes of jobs waiting on this one
+    std::vector<uint32_t> dependents;
+};
+
+// Per-thread deque. The owning worker pushes and pops at the back,
+// other threads steal from the front.
+struct JobWorkerQueue {
+    std::mutex mutex;
+    std::deque<uint32_t> jobs;
+};
+
+/**
+ * Work-stealing job scheduler owned by App.
+ *
+ * Jobs may depend on other jobs, and may have a completion callback
+ * which is queued to run on the main thread when the job finishes.
+ * The main thread drains that queue in JobSystem::update, which App
+ * calls at a fixed point at the top of each frame.
+ */
+class JobSystem {
+public:
+    JobSystem() {};
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem();
+    
+    // Start worker threads. A worker count of zero picks one
+    // fewer than the number of hardware threads.
+    void init(int worker_count = 0);
+    // Finish outstanding jobs and join worker threads.
+    void conclude();
+    // Run main-thread completion callbacks. Call once per frame,
+    // from the main thread.
+    void update();
+    
+    // Submit a job which runs once all of its dependencies are done.
+    // The complete callback, if any, runs later on the main thread.
+    JobHandle submit(
+        std::function<void()> run,
+        std::initializer_list<JobHandle> dependencies = {},
+        std::function<void()> complete = nullptr
+    );
+    JobHandle submit(
+        std::function<void()> run,
+        const JobHandle* dependencies,
+        int dependency_count,
+        std::function<void()> complete = nullptr
+    );
+    // Queue a function to run on the main thread during update.
+    // May be called from any thread.
+    void run_on_main_thread(std::function<void()> fn);
+    // Returns true once the job has finished running.
+    bool is_done(JobHandle handle);
+    // Block until the job has finished. The calling thread runs
+    // other pending jobs while it waits.
+    void wait(JobHandle handle);
+    // Run fn(begin, end) over [0, count) in chunks, in parallel,
+    // and block until every chunk has finished.
+    void parallel_for(
+        int count,
+        int chunk_size,
+        const std::function<void(int begin, int end)>& fn
+    );
+    // Get the number of worker threads, not counting the main thread.
+    int get_worker_count();
+    // Returns true when called from the main thread.
+    bool is_main_thread();
+    
+private:
+    std::vector<std::thread> workers;
+    // One queue per worker, plus a final queue for other threads
+    std::vector<std::unique_ptr<JobWorkerQueue>> queues;
+    std::unique_ptr<JobSlot[]> slot_blocks[JobSystem_MaxJobs / JobSystem_SlotBlockSize];
+    uint32_t slot_count = 0;
+    std::vector<uint32_t> free_slots;
+    std::mutex slots_mutex;
+    std::atomic<int> queued_count = 0;
+    std::atomic<bool> stopping = false;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_condition;
+    std::mutex main_queue_mutex;
+    std::vector<std::function<void()>> main_queue;
+    std::vector<std::function<void()>> main_queue_running;
+    std::thread::id main_thread_id;
+    std::atomic<uint32_t> next_queue = 0;
+    
+    JobSlot& get_slot(uint32_t index);
+    uint32_t allocate_slot();
+    void enqueue(uint32_t index);
+    bool try_run_one(int queue_index);
+    void execute(uint32_t index);
+    void worker_main(int worker_index);
+};
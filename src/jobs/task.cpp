@@ -0,0 +1,88 @@
+#include "task.hpp"
+
+#include <algorithm>
+
+#include "util/log.hpp"
+
+TaskBackgroundAwaiter TaskContext::background(std::function<void()> run) {
+    return TaskBackgroundAwaiter{this->runner->jobs, std::move(run)};
+}
+
+TaskNextFrameAwaiter TaskContext::next_frame() {
+    return TaskNextFrameAwaiter{this->runner->jobs};
+}
+
+bool TaskContext::is_cancelled() {
+    return this->cancel_requested.load(std::memory_order_relaxed);
+}
+
+void TaskContext::set_progress(float progress) {
+    this->progress.store(progress, std::memory_order_relaxed);
+}
+
+void TaskContext::set_status(std::string status) {
+    std::lock_guard<std::mutex> lock(this->status_mutex);
+    this->status = std::move(status);
+}
+
+std::string TaskContext::get_status() {
+    std::lock_guard<std::mutex> lock(this->status_mutex);
+    return this->status;
+}
+
+TaskContext* TaskRunner::start(std::string name, TaskFunction function) {
+    UNI_LOG_DEBUG(LogSubsystem_Jobs, "Starting task '{}'.", name);
+    auto context = std::make_unique<TaskContext>();
+    context->runner = this;
+    context->name = std::move(name);
+    context->function = std::move(function);
+    context->task = context->function(context.get());
+    TaskContext* context_ptr = context.get();
+    this->tasks.push_back(std::move(context));
+    if(context_ptr->task.handle) {
+        context_ptr->task.handle.resume();
+    }
+    return context_ptr;
+}
+
+void TaskRunner::update() {
+    auto finished = [](const std::unique_ptr<TaskContext>& context) -> bool {
+        auto handle = context->task.handle;
+        if(handle && !handle.done()) {
+            return false;
+        }
+        if(handle && handle.promise().exception) {
+            try {
+                std::rethrow_exception(handle.promise().exception);
+            }
+            catch(const std::exception& error) {
+                UNI_LOG_ERROR(LogSubsystem_Jobs, "Task '{}' failed: {}", context->name, error.what());
+            }
+            catch(...) {
+                UNI_LOG_ERROR(LogSubsystem_Jobs, "Task '{}' failed with an unknown error.", context->name);
+            }
+        }
+        else if(context->is_cancelled()) {
+            UNI_LOG_DEBUG(LogSubsystem_Jobs, "Task '{}' was cancelled.", context->name);
+        }
+        else {
+            UNI_LOG_DEBUG(LogSubsystem_Jobs, "Task '{}' finished.", context->name);
+        }
+        return true;
+    };
+    this->tasks.erase(
+        std::remove_if(this->tasks.begin(), this->tasks.end(), finished),
+        this->tasks.end()
+    );
+}
+
+void TaskRunner::cancel_all() {
+    for(auto& context : this->tasks) {
+        context->cancel_requested = true;
+    }
+}
+
+void TaskRunner::conclude() {
+    this->cancel_all();
+    this->tasks.clear();
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "job_system.hpp"
+
+class TaskRunner; // Forward declaration for TaskContext
+struct TaskContext; // Forward declaration for Task
+
+/**
+ * Return type for long-running coroutines started by a TaskRunner.
+ *
+ * The coroutine body always runs on the main thread. It can hand
+ * work to the JobSystem with `co_await context->background(...)`,
+ * and is resumed on the main thread once that work is done, so a
+ * long operation never blocks the frame loop.
+ */
+struct Task {
+    struct promise_type {
+        std::exception_ptr exception;
+        
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        // Tasks start suspended; TaskRunner::start resumes them
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        // Tasks stay suspended at the end so the runner can see
+        // that they are done before destroying them.
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {
+            this->exception = std::current_exception();
+        }
+    };
+    
+    std::coroutine_handle<promise_type> handle = nullptr;
+    
+    Task() {};
+    explicit Task(std::coroutine_handle<promise_type> handle): handle(handle) {};
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    Task(Task&& other) noexcept: handle(other.handle) {
+        other.handle = nullptr;
+    };
+    Task& operator=(Task&& other) noexcept {
+        if(this != &other) {
+            if(this->handle) {
+                this->handle.destroy();
+            }
+            this->handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+    ~Task() {
+        if(this->handle) {
+            this->handle.destroy();
+        }
+    }
+};
+
+// Awaitable which runs a function on the JobSystem and then
+// resumes the awaiting coroutine on the main thread.
+struct TaskBackgroundAwaiter {
+    JobSystem* jobs;
+    std::function<void()> run;
+    
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        this->jobs->submit(std::move(this->run), {}, [handle]() {
+            handle.resume();
+        });
+    }
+    void await_resume() noexcept {}
+};
+
+// Awaitable which resumes the awaiting coroutine on the next frame.
+struct TaskNextFrameAwaiter {
+    JobSystem* jobs;
+    
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        this->jobs->run_on_main_thread([handle]() {
+            handle.resume();
+        });
+    }
+    void await_resume() noexcept {}
+};
+
+typedef std::function<Task(TaskContext* context)> TaskFunction;
+
+/**
+ * State shared between a running Task, the background work it
+ * awaits, and the GUI which displays it.
+ * Progress, status, and cancellation may be used from any thread.
+ */
+struct TaskContext {
+    TaskRunner* runner = nullptr;
+    std::string name;
+    // Copy of the function the task was started with. Coroutine
+    // lambdas keep their captures in the function object, so it
+    // must live at least as long as the task.
+    TaskFunction function;
+    Task task;
+    // Set when the user asks for the task to stop. Tasks should
+    // check is_cancelled regularly and return early.
+    std::atomic<bool> cancel_requested = false;
+    // Completion fraction in [0, 1], or negative if unknown
+    std::atomic<float> progress = -1.0f;
+    
+    // Run a function on a worker thread. Use with co_await.
+    TaskBackgroundAwaiter background(std::function<void()> run);
+    // Wait until the next frame. Use with co_await.
+    TaskNextFrameAwaiter next_frame();
+    // Returns true when cancellation has been requested.
+    bool is_cancelled();
+    void set_progress(float progress);
+    void set_status(std::string status);
+    std::string get_status();
+    
+private:
+    std::mutex status_mutex;
+    std::string status;
+};
+
+class TaskRunner {
+public:
+    TaskRunner() {};
+    TaskRunner(JobSystem* jobs): jobs(jobs) {};
+    
+    JobSystem* jobs = nullptr;
+    // Tasks which have been started and have not yet finished
+    std::vector<std::unique_ptr<TaskContext>> tasks;
+    
+    // Start a task. Its body runs on the main thread immediately,
+    // up to its first suspension point.
+    TaskContext* start(std::string name, TaskFunction function);
+    // Remove finished tasks. Call once per frame, after
+    // JobSystem::update.
+    void update();
+    // Request cancellation of every running task.
+    void cancel_all();
+    // Destroy all tasks. Call after the JobSystem has stopped.
+    void conclude();
+};
@@ -0,0 +1,176 @@
+#include "autosave.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Room left for more entities when the whole file is written, as
+// a fraction of the entity count, rounded up to whole pages.
+const uint32_t LevelAutosaver_RoomDivisor = 4;
+
+static bool LevelAutosaver_MaterialsEqual(const LevelMaterial& a, const LevelMaterial& b) {
+    return a.name == b.name && std::memcmp(a.color, b.color, sizeof(a.color)) == 0;
+}
+
+void LevelAutosaver::update(const LevelDocument& document, double time) {
+    if(!this->enabled || this->saving || time - this->last_time < this->interval) {
+        return;
+    }
+    if(this->snapshot && document.revision == this->snapshot_revision) {
+        return;
+    }
+    if(this->save(document)) {
+        this->last_time = time;
+    }
+}
+
+bool LevelAutosaver::save(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelAutosaver::save");
+    if(this->saving || this->path.empty()) {
+        return false;
+    }
+    std::vector<LevelFileRowRange> ranges;
+    const bool whole = this->freeze(document, &ranges);
+    const uint32_t count = this->snapshot->get_count();
+    uint32_t row_count = 0;
+    for(const LevelFileRowRange& range : ranges) {
+        row_count += range.count;
+    }
+    // Rows of room, rounded up to whole pages
+    const uint32_t capacity = (
+        (count + count / LevelAutosaver_RoomDivisor) / LevelDocument_PageRows + 1
+    ) * LevelDocument_PageRows;
+    LevelDocument* snapshot = this->snapshot.get();
+    auto layout = std::make_shared<LevelFileLayout>(this->layout);
+    auto written = std::make_shared<bool>(false);
+    auto write = [snapshot, layout, written, whole, capacity, path = this->path, ranges = std::move(ranges)]() {
+        if(whole) {
+            *written = LevelFile_SaveWithRoom(*snapshot, path.c_str(), capacity, layout.get());
+        } else {
+            *written = LevelFile_WriteRows(
+                *snapshot, path.c_str(), layout.get(), ranges.data(), (uint32_t) ranges.size()
+            );
+        }
+    };
+    auto complete = [this, layout, written, whole, count, row_count, path = this->path, generation = this->generation]() {
+        if(generation != this->generation) {
+            return;
+        }
+        this->saving = false;
+        this->layout = *layout;
+        this->layout_valid = *written;
+        this->layout_path = path;
+        if(!*written) {
+            return;
+        }
+        if(whole) {
+            UNI_LOG_INFO(LogSubsystem_Level, "Autosaved {} entities to '{}'.", count, path);
+        } else {
+            UNI_LOG_DEBUG(
+                LogSubsystem_Level, "Autosaved {} changed rows of {} entities to '{}'.",
+                std::min(row_count, count), count, path
+            );
+        }
+    };
+    this->saving = true;
+    if(this->jobs) {
+        this->save_job = this->jobs->submit(std::move(write), {}, std::move(complete));
+    } else {
+        write();
+        complete();
+    }
+    return true;
+}
+
+void LevelAutosaver::cancel() {
+    if(this->saving && this->jobs) {
+        this->jobs->wait(this->save_job);
+    }
+    this->saving = false;
+    this->layout_valid = false;
+    this->generation++;
+}
+
+bool LevelAutosaver::freeze(const LevelDocument& document, std::vector<LevelFileRowRange>* ranges) {
+    UNI_PROFILE_ZONE("LevelAutosaver::freeze");
+    bool whole = !this->layout_valid || this->layout_path != this->path;
+    bool all_pages = false;
+    if(
+        !this->snapshot ||
+        document.clear_revision > this->snapshot_revision ||
+        document.mesh_assets.size() < this->snapshot->mesh_assets.size()
+    ) {
+        // The level was replaced, so nothing can be kept
+        this->snapshot = std::make_unique<LevelDocument>();
+        whole = true;
+        all_pages = true;
+    }
+    LevelDocument* snapshot = this->snapshot.get();
+    // Meshes are only ever added, so only new ones are copied, but
+    // any change to them or to materials moves the file's sections
+    if(snapshot->mesh_assets.size() != document.mesh_assets.size()) {
+        snapshot->mesh_assets.insert(
+            snapshot->mesh_assets.end(),
+            document.mesh_assets.begin() + snapshot->mesh_assets.size(),
+            document.mesh_assets.end()
+        );
+        whole = true;
+    }
+    if(!std::equal(
+        snapshot->material_assets.begin(), snapshot->material_assets.end(),
+        document.material_assets.begin(), document.material_assets.end(),
+        LevelAutosaver_MaterialsEqual
+    )) {
+        snapshot->material_assets = document.material_assets;
+        whole = true;
+    }
+    const uint32_t count = document.get_count();
+    if(count > this->layout.capacity) {
+        whole = true;
+    }
+    // Row slots are written fresh, so they aren't copied
+    uint8_t* targets[LevelColumnId_COUNT] = {};
+    const uint8_t* sources[LevelColumnId_COUNT] = {};
+    uint32_t value_sizes[LevelColumnId_COUNT] = {};
+    for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+        if(i == LevelColumnId_RowSlots) {
+            continue;
+        }
+        targets[i] = (uint8_t*) snapshot->visit_column((LevelColumnId) i, [count](auto& values) {
+            // Grow with room to spare, so creating a few entities
+            // doesn't copy every row
+            if(values.get_capacity() < count) {
+                values.reserve(count + count / LevelAutosaver_RoomDivisor);
+            }
+            values.resize(count);
+            return (void*) values.data();
+        });
+        sources[i] = (const uint8_t*) document.visit_column((LevelColumnId) i, [](const auto& values) {
+            return (const void*) values.data();
+        });
+        value_sizes[i] = document.get_value_size((LevelColumnId) i);
+    }
+    const uint32_t page_count = document.get_page_count();
+    for(uint32_t page = 0; page < page_count; ++page) {
+        if(!all_pages && document.get_page_revision(page) <= this->snapshot_revision) {
+            continue;
+        }
+        const uint32_t first = page * LevelDocument_PageRows;
+        const uint32_t end = std::min(count, first + LevelDocument_PageRows);
+        for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+            if(i != LevelColumnId_RowSlots) {
+                const size_t offset = (size_t) value_sizes[i] * first;
+                std::memcpy(targets[i] + offset, sources[i] + offset, (size_t) value_sizes[i] * (end - first));
+            }
+        }
+        if(!ranges->empty() && ranges->back().first + ranges->back().count == first) {
+            ranges->back().count += end - first;
+        } else {
+            ranges->push_back(LevelFileRowRange{first, end - first});
+        }
+    }
+    this->snapshot_revision = document.revision;
+    return whole;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+#include "level_file.hpp"
+
+/**
+ * Saves the level every so often in the background, so that big
+ * levels are autosaved without the editor stalling.
+ * 
+ * At a frame boundary, update freezes a snapshot of the level for
+ * a job to write while editing goes on. The snapshot is a second
+ * document kept by the autosaver, into which only the pages of
+ * rows changed since the last autosave are copied, so freezing
+ * costs as much as the edits, not the level. It isn't touched
+ * again until the job finishes, so the job never sees half an
+ * edit, and edits made meanwhile go into the next autosave.
+ * 
+ * The autosave file is written with room for more entities, and
+ * later autosaves rewrite only the changed pages in place. The
+ * whole file is written again, under a temporary name, when the
+ * level is replaced, gains meshes or materials, outgrows the
+ * room, or a write fails.
+ * 
+ * The snapshot holds a copy of every column, doubling the memory
+ * used by entities.
+ */
+class LevelAutosaver {
+public:
+    LevelAutosaver() {};
+    LevelAutosaver(JobSystem* jobs): jobs(jobs) {};
+    LevelAutosaver(const LevelAutosaver&) = delete;
+    LevelAutosaver& operator=(const LevelAutosaver&) = delete;
+    LevelAutosaver& operator=(LevelAutosaver&& other) = default;
+    
+    JobSystem* jobs = nullptr;
+    // Level file to autosave to
+    std::string path;
+    bool enabled = true;
+    // Seconds from one autosave to the next, at least
+    double interval = 60.0;
+    
+    // Start an autosave if one is due and the level changed since
+    // the last. Call at a frame boundary, between edits. Time is
+    // in seconds, from any fixed point.
+    void update(const LevelDocument& document, double time);
+    // Start an autosave now. Returns false if one is in progress,
+    // or there is nowhere to save.
+    bool save(const LevelDocument& document);
+    bool is_saving() const {
+        return this->saving;
+    }
+    // Wait for the autosave in progress, if any, and forget its
+    // results, so that the next autosave writes the whole file.
+    void cancel();
+    
+private:
+    // Level as of the last autosave, which the job writes
+    std::unique_ptr<LevelDocument> snapshot;
+    // LevelDocument::revision the snapshot was last frozen at
+    uint64_t snapshot_revision = 0;
+    // Where sections of the autosave file are, while it can be
+    // updated in place
+    LevelFileLayout layout;
+    bool layout_valid = false;
+    std::string layout_path;
+    double last_time = -INFINITY;
+    bool saving = false;
+    JobHandle save_job = JobHandle_None;
+    uint32_t generation = 0;
+    
+    // Copy what changed since the last autosave into the snapshot.
+    // Adds the changed rows to ranges, and returns true if the
+    // whole file must be written.
+    bool freeze(const LevelDocument& document, std::vector<LevelFileRowRange>* ranges);
+};
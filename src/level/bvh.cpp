@@ -0,0 +1,1260 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+#include "util/simd.hpp"
+
+// Centroid bins per axis when searching for a split
+const int LevelBvh_BinCount = 16;
+// Subtrees with at least this many primitives, at the depth where
+// parallel building starts, are built by their own jobs
+const uint32_t LevelBvh_ParallelMinCount = 4096;
+const int LevelBvh_ParallelDepth = 2;
+// Below this depth, ranges are split at their median center rather
+// than by surface area, so that each level at least halves them and
+// no tree is deeper than LevelBvh_MaxDepth however primitives lie
+const int LevelBvh_SahMaxDepth = 48;
+const int LevelBvh_MaxDepth = LevelBvh_SahMaxDepth + 32;
+// Traversal keeps at most three pending siblings per level, plus the
+// four children of the node being visited
+const int LevelBvh_StackSize = 3 * LevelBvh_MaxDepth + 1;
+
+void LevelBvhNode::set_bounds(int lane, const Bounds3& bounds) {
+    this->min_x[lane] = bounds.min.x;
+    this->min_y[lane] = bounds.min.y;
+    this->min_z[lane] = bounds.min.z;
+    this->max_x[lane] = bounds.max.x;
+    this->max_y[lane] = bounds.max.y;
+    this->max_z[lane] = bounds.max.z;
+}
+
+Bounds3 LevelBvhNode::get_bounds() const {
+    Bounds3 bounds = Bounds3_Empty;
+    for(int lane = 0; lane < 4; ++lane) {
+        bounds = Bounds3_Union(bounds, Bounds3{
+            Vec3{this->min_x[lane], this->min_y[lane], this->min_z[lane]},
+            Vec3{this->max_x[lane], this->max_y[lane], this->max_z[lane]}
+        });
+    }
+    return bounds;
+}
+
+static LevelBvhNode LevelBvh_MakeEmptyNode() {
+    LevelBvhNode node;
+    for(int lane = 0; lane < 4; ++lane) {
+        node.set_bounds(lane, Bounds3_Empty);
+        node.children[lane] = LevelBvh_EmptyChild;
+        node.counts[lane] = 0;
+    }
+    return node;
+}
+
+static float LevelBvh_GetAxis(const Vec3& v, int axis) {
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+// Primitive being sorted into a BVH. Builders move these around
+// directly rather than indexes to them, so that each pass over a
+// range reads memory in order.
+struct LevelBvhPrimitive {
+    Bounds3 bounds;
+    uint32_t index;
+};
+
+/**
+ * Builds the nodes of one BVH, or of one subtree of it, over a
+ * range of primitives.
+ */
+struct LevelBvhBuilder {
+    // Reordered so that each leaf's primitives are contiguous
+    LevelBvhPrimitive* primitives = nullptr;
+    LevelColumn<LevelBvhNode>* nodes = nullptr;
+    // Set when building a mesh BVH. Leaves then refer to blocks
+    // of triangles rather than ranges of primitives.
+    const LevelMesh* mesh = nullptr;
+    LevelColumn<LevelBvhTriangles>* triangles = nullptr;
+    // Set to defer large subtrees, for building in parallel
+    struct Subtree {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t node;
+        int lane;
+        int depth;
+    };
+    std::vector<Subtree>* deferred = nullptr;
+    
+    Bounds3 get_range_bounds(uint32_t begin, uint32_t end) const {
+        Bounds3 range_bounds = Bounds3_Empty;
+        for(uint32_t i = begin; i < end; ++i) {
+            range_bounds = Bounds3_Union(range_bounds, this->primitives[i].bounds);
+        }
+        return range_bounds;
+    }
+    
+    // Partition a range with a binned surface area heuristic, and
+    // return the index of the first primitive on the right.
+    uint32_t split(uint32_t begin, uint32_t end) {
+        // Centers are doubled, which doesn't change their order
+        Bounds3 center_bounds = Bounds3_Empty;
+        for(uint32_t i = begin; i < end; ++i) {
+            const Bounds3& bounds = this->primitives[i].bounds;
+            center_bounds = Bounds3_Grow(center_bounds, bounds.min + bounds.max);
+        }
+        const Vec3 extent = center_bounds.max - center_bounds.min;
+        const Vec3 scale = Vec3{
+            extent.x > 0.0f ? (float) LevelBvh_BinCount / extent.x : 0.0f,
+            extent.y > 0.0f ? (float) LevelBvh_BinCount / extent.y : 0.0f,
+            extent.z > 0.0f ? (float) LevelBvh_BinCount / extent.z : 0.0f
+        };
+        auto get_bin = [&](const Bounds3& bounds, int axis) {
+            const float offset = LevelBvh_GetAxis(
+                bounds.min + bounds.max - center_bounds.min, axis
+            );
+            return std::min(LevelBvh_BinCount - 1, (int) (offset * LevelBvh_GetAxis(scale, axis)));
+        };
+        // Only the axis along which centers spread the most is
+        // binned, which costs little in quality for a third of the
+        // time of binning all three
+        int axis = 0;
+        if(extent.y > LevelBvh_GetAxis(extent, axis)) {
+            axis = 1;
+        }
+        if(extent.z > LevelBvh_GetAxis(extent, axis)) {
+            axis = 2;
+        }
+        float best_cost = INFINITY;
+        int best_axis = -1;
+        int best_bin = 0;
+        if(LevelBvh_GetAxis(scale, axis) > 0.0f) {
+            Bounds3 bin_bounds[LevelBvh_BinCount];
+            uint32_t bin_counts[LevelBvh_BinCount] = {};
+            std::fill(bin_bounds, bin_bounds + LevelBvh_BinCount, Bounds3_Empty);
+            for(uint32_t i = begin; i < end; ++i) {
+                const Bounds3& bounds = this->primitives[i].bounds;
+                const int bin = get_bin(bounds, axis);
+                bin_bounds[bin] = Bounds3_Union(bin_bounds[bin], bounds);
+                bin_counts[bin]++;
+            }
+            // Sweep from the right, then from the left, to cost each
+            // split between bins
+            float right_areas[LevelBvh_BinCount];
+            uint32_t right_counts[LevelBvh_BinCount];
+            Bounds3 right_bounds = Bounds3_Empty;
+            uint32_t right_count = 0;
+            for(int bin = LevelBvh_BinCount - 1; bin > 0; --bin) {
+                right_bounds = Bounds3_Union(right_bounds, bin_bounds[bin]);
+                right_count += bin_counts[bin];
+                right_areas[bin] = Bounds3_GetSurfaceArea(right_bounds);
+                right_counts[bin] = right_count;
+            }
+            Bounds3 left_bounds = Bounds3_Empty;
+            uint32_t left_count = 0;
+            for(int bin = 0; bin < LevelBvh_BinCount - 1; ++bin) {
+                left_bounds = Bounds3_Union(left_bounds, bin_bounds[bin]);
+                left_count += bin_counts[bin];
+                if(left_count == 0 || right_counts[bin + 1] == 0) {
+                    continue;
+                }
+                const float cost = (
+                    Bounds3_GetSurfaceArea(left_bounds) * (float) left_count +
+                    right_areas[bin + 1] * (float) right_counts[bin + 1]
+                );
+                if(cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = bin;
+                }
+            }
+        }
+        const uint32_t middle = begin + (end - begin) / 2;
+        if(best_axis < 0) {
+            // Every center is the same, so any split is as good
+            return middle;
+        }
+        LevelBvhPrimitive* split = std::partition(
+            this->primitives + begin,
+            this->primitives + end,
+            [&](const LevelBvhPrimitive& primitive) {
+                return get_bin(primitive.bounds, best_axis) <= best_bin;
+            }
+        );
+        const uint32_t split_index = (uint32_t) (split - this->primitives);
+        return split_index > begin && split_index < end ? split_index : middle;
+    }
+    
+    // Partition a range at the median center along the axis the
+    // centers spread the most, and return the index of the first
+    // primitive on the right.
+    uint32_t split_median(uint32_t begin, uint32_t end) {
+        Bounds3 center_bounds = Bounds3_Empty;
+        for(uint32_t i = begin; i < end; ++i) {
+            const Bounds3& bounds = this->primitives[i].bounds;
+            center_bounds = Bounds3_Grow(center_bounds, bounds.min + bounds.max);
+        }
+        const Vec3 extent = center_bounds.max - center_bounds.min;
+        int axis = 0;
+        if(extent.y > LevelBvh_GetAxis(extent, axis)) {
+            axis = 1;
+        }
+        if(extent.z > LevelBvh_GetAxis(extent, axis)) {
+            axis = 2;
+        }
+        const uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(
+            this->primitives + begin,
+            this->primitives + middle,
+            this->primitives + end,
+            [&](const LevelBvhPrimitive& a, const LevelBvhPrimitive& b) {
+                return (
+                    LevelBvh_GetAxis(a.bounds.min + a.bounds.max, axis) <
+                    LevelBvh_GetAxis(b.bounds.min + b.bounds.max, axis)
+                );
+            }
+        );
+        return middle;
+    }
+    
+    uint32_t make_leaf(uint32_t begin, uint32_t end) {
+        if(!this->mesh) {
+            return LevelBvh_LeafBit | begin;
+        }
+        LevelBvhTriangles block;
+        std::memset(&block, 0, sizeof(block));
+        for(uint32_t i = begin; i < end; ++i) {
+            const uint32_t triangle = this->primitives[i].index;
+            const int lane = (int) (i - begin);
+            const Vec3 v0 = this->mesh->positions[this->mesh->indices[triangle * 3 + 0]];
+            const Vec3 v1 = this->mesh->positions[this->mesh->indices[triangle * 3 + 1]];
+            const Vec3 v2 = this->mesh->positions[this->mesh->indices[triangle * 3 + 2]];
+            const Vec3 edge1 = v1 - v0;
+            const Vec3 edge2 = v2 - v0;
+            block.v0_x[lane] = v0.x;
+            block.v0_y[lane] = v0.y;
+            block.v0_z[lane] = v0.z;
+            block.edge1_x[lane] = edge1.x;
+            block.edge1_y[lane] = edge1.y;
+            block.edge1_z[lane] = edge1.z;
+            block.edge2_x[lane] = edge2.x;
+            block.edge2_y[lane] = edge2.y;
+            block.edge2_z[lane] = edge2.z;
+            block.triangles[lane] = triangle;
+        }
+        this->triangles->push_back(block);
+        return LevelBvh_LeafBit | (this->triangles->size() - 1);
+    }
+
+    // Build a node over a range, splitting it into up to four
+    // children, and return the node's index.
+    uint32_t build_node(uint32_t begin, uint32_t end, int depth) {
+        // Median splits halve the largest range, so ranges of up to
+        // 2^32 primitives are leaves by LevelBvh_MaxDepth
+        assert(depth < LevelBvh_MaxDepth);
+        const uint32_t index = this->nodes->size();
+        this->nodes->push_back(LevelBvh_MakeEmptyNode());
+        uint32_t range_begins[4] = {begin};
+        uint32_t range_ends[4] = {end};
+        int range_count = 1;
+        while(range_count < 4) {
+            // Split the largest range which is too big for a leaf
+            int largest = -1;
+            uint32_t largest_count = LevelBvh_LeafSize;
+            for(int i = 0; i < range_count; ++i) {
+                if(range_ends[i] - range_begins[i] > largest_count) {
+                    largest = i;
+                    largest_count = range_ends[i] - range_begins[i];
+                }
+            }
+            if(largest < 0) {
+                break;
+            }
+            const uint32_t middle = depth < LevelBvh_SahMaxDepth ?
+                this->split(range_begins[largest], range_ends[largest]) :
+                this->split_median(range_begins[largest], range_ends[largest]);
+            range_begins[range_count] = middle;
+            range_ends[range_count] = range_ends[largest];
+            range_ends[largest] = middle;
+            range_count++;
+        }
+        for(int lane = 0; lane < range_count; ++lane) {
+            const uint32_t lane_begin = range_begins[lane];
+            const uint32_t lane_end = range_ends[lane];
+            const uint32_t count = lane_end - lane_begin;
+            uint32_t child;
+            uint32_t leaf_count = 0;
+            if(count <= LevelBvh_LeafSize) {
+                child = this->make_leaf(lane_begin, lane_end);
+                leaf_count = count;
+            }
+            else if(
+                this->deferred &&
+                depth + 1 >= LevelBvh_ParallelDepth &&
+                count >= LevelBvh_ParallelMinCount
+            ) {
+                this->deferred->push_back(Subtree{lane_begin, lane_end, index, lane, depth + 1});
+                child = LevelBvh_EmptyChild;
+            }
+            else {
+                child = this->build_node(lane_begin, lane_end, depth + 1);
+            }
+            // Nodes may have been reallocated while building children
+            LevelBvhNode& node = (*this->nodes)[index];
+            node.set_bounds(lane, this->get_range_bounds(lane_begin, lane_end));
+            node.children[lane] = child;
+            node.counts[lane] = leaf_count;
+        }
+        return index;
+    }
+};
+
+/**
+ * Ray with values precomputed for slab tests against node bounds.
+ */
+struct LevelBvhRay {
+    Ray3 ray;
+    Vec3 inverse_direction;
+    // For each axis, whether the near plane is at the max bound
+    bool negative[3];
+
+    LevelBvhRay(const Ray3& ray): ray(ray) {
+        this->inverse_direction = Vec3{
+            1.0f / ray.direction.x,
+            1.0f / ray.direction.y,
+            1.0f / ray.direction.z
+        };
+        this->negative[0] = this->inverse_direction.x < 0.0f;
+        this->negative[1] = this->inverse_direction.y < 0.0f;
+        this->negative[2] = this->inverse_direction.z < 0.0f;
+    }
+};
+
+// Test a ray against all four children of a node. Returns a bit
+// mask of the lanes hit nearer than max_distance, and writes the
+// entry distance of each lane.
+static int LevelBvh_IntersectNode(
+    const LevelBvhNode& node,
+    const LevelBvhRay& ray,
+    float max_distance,
+    float* entries
+) {
+    // Picking the near and far plane per axis from the direction's
+    // sign makes empty lanes, whose min is above their max, miss.
+    const float* near_x = ray.negative[0] ? node.max_x : node.min_x;
+    const float* near_y = ray.negative[1] ? node.max_y : node.min_y;
+    const float* near_z = ray.negative[2] ? node.max_z : node.min_z;
+    const float* far_x = ray.negative[0] ? node.min_x : node.max_x;
+    const float* far_y = ray.negative[1] ? node.min_y : node.max_y;
+    const float* far_z = ray.negative[2] ? node.min_z : node.max_z;
+#if UNI_SIMD_SSE
+    const __m128 origin_x = _mm_set1_ps(ray.ray.origin.x);
+    const __m128 origin_y = _mm_set1_ps(ray.ray.origin.y);
+    const __m128 origin_z = _mm_set1_ps(ray.ray.origin.z);
+    const __m128 inverse_x = _mm_set1_ps(ray.inverse_direction.x);
+    const __m128 inverse_y = _mm_set1_ps(ray.inverse_direction.y);
+    const __m128 inverse_z = _mm_set1_ps(ray.inverse_direction.z);
+    // _mm_max_ps and _mm_min_ps return their second operand when
+    // either is NaN, as happens for a zero direction component on
+    // a plane through the origin, so that axis is ignored
+    __m128 entry = _mm_setzero_ps();
+    __m128 exit = _mm_set1_ps(max_distance);
+    entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_x), origin_x), inverse_x), entry);
+    entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_y), origin_y), inverse_y), entry);
+    entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_z), origin_z), inverse_z), entry);
+    exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_x), origin_x), inverse_x), exit);
+    exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_y), origin_y), inverse_y), exit);
+    exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_z), origin_z), inverse_z), exit);
+    _mm_storeu_ps(entries, entry);
+    return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+#else
+    int mask = 0;
+    for(int lane = 0; lane < 4; ++lane) {
+        float entry = 0.0f;
+        float exit = max_distance;
+        const float near_t[3] = {
+            (near_x[lane] - ray.ray.origin.x) * ray.inverse_direction.x,
+            (near_y[lane] - ray.ray.origin.y) * ray.inverse_direction.y,
+            (near_z[lane] - ray.ray.origin.z) * ray.inverse_direction.z
+        };
+        const float far_t[3] = {
+            (far_x[lane] - ray.ray.origin.x) * ray.inverse_direction.x,
+            (far_y[lane] - ray.ray.origin.y) * ray.inverse_direction.y,
+            (far_z[lane] - ray.ray.origin.z) * ray.inverse_direction.z
+        };
+        for(int axis = 0; axis < 3; ++axis) {
+            entry = near_t[axis] > entry ? near_t[axis] : entry;
+            exit = far_t[axis] < exit ? far_t[axis] : exit;
+        }
+        entries[lane] = entry;
+        mask |= entry <= exit ? 1 << lane : 0;
+    }
+    return mask;
+#endif
+}
+
+// Test a ray against a block of four triangles, with the
+// Moller-Trumbore algorithm. Returns the lane of the nearest hit
+// nearer than *distance, updating *distance, or -1.
+static int LevelBvh_IntersectTriangles(
+    const LevelBvhTriangles& block,
+    const Ray3& ray,
+    float* distance
+) {
+    const float epsilon = 1e-12f;
+#if UNI_SIMD_SSE
+    const __m128 dir_x = _mm_set1_ps(ray.direction.x);
+    const __m128 dir_y = _mm_set1_ps(ray.direction.y);
+    const __m128 dir_z = _mm_set1_ps(ray.direction.z);
+    const __m128 e1_x = _mm_load_ps(block.edge1_x);
+    const __m128 e1_y = _mm_load_ps(block.edge1_y);
+    const __m128 e1_z = _mm_load_ps(block.edge1_z);
+    const __m128 e2_x = _mm_load_ps(block.edge2_x);
+    const __m128 e2_y = _mm_load_ps(block.edge2_y);
+    const __m128 e2_z = _mm_load_ps(block.edge2_z);
+    // p = direction x edge2
+    const __m128 p_x = _mm_sub_ps(_mm_mul_ps(dir_y, e2_z), _mm_mul_ps(dir_z, e2_y));
+    const __m128 p_y = _mm_sub_ps(_mm_mul_ps(dir_z, e2_x), _mm_mul_ps(dir_x, e2_z));
+    const __m128 p_z = _mm_sub_ps(_mm_mul_ps(dir_x, e2_y), _mm_mul_ps(dir_y, e2_x));
+    const __m128 det = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(e1_x, p_x), _mm_mul_ps(e1_y, p_y)), _mm_mul_ps(e1_z, p_z)
+    );
+    const __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    const __m128 inverse_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    // s = origin - v0
+    const __m128 s_x = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(block.v0_x));
+    const __m128 s_y = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(block.v0_y));
+    const __m128 s_z = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(block.v0_z));
+    const __m128 u = _mm_mul_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(s_x, p_x), _mm_mul_ps(s_y, p_y)), _mm_mul_ps(s_z, p_z)
+    ), inverse_det);
+    // q = s x edge1
+    const __m128 q_x = _mm_sub_ps(_mm_mul_ps(s_y, e1_z), _mm_mul_ps(s_z, e1_y));
+    const __m128 q_y = _mm_sub_ps(_mm_mul_ps(s_z, e1_x), _mm_mul_ps(s_x, e1_z));
+    const __m128 q_z = _mm_sub_ps(_mm_mul_ps(s_x, e1_y), _mm_mul_ps(s_y, e1_x));
+    const __m128 v = _mm_mul_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(dir_x, q_x), _mm_mul_ps(dir_y, q_y)), _mm_mul_ps(dir_z, q_z)
+    ), inverse_det);
+    const __m128 t = _mm_mul_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(e2_x, q_x), _mm_mul_ps(e2_y, q_y)), _mm_mul_ps(e2_z, q_z)
+    ), inverse_det);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 hit = _mm_cmpgt_ps(abs_det, _mm_set1_ps(epsilon));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, zero));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(*distance)));
+    int mask = _mm_movemask_ps(hit);
+    if(!mask) {
+        return -1;
+    }
+    float distances[4];
+    _mm_storeu_ps(distances, t);
+#else
+    int mask = 0;
+    float distances[4];
+    for(int lane = 0; lane < 4; ++lane) {
+        const Vec3 direction = ray.direction;
+        const Vec3 edge1 = Vec3{block.edge1_x[lane], block.edge1_y[lane], block.edge1_z[lane]};
+        const Vec3 edge2 = Vec3{block.edge2_x[lane], block.edge2_y[lane], block.edge2_z[lane]};
+        const Vec3 p = Vec3_Cross(direction, edge2);
+        const float det = Vec3_Dot(edge1, p);
+        if(!(std::fabs(det) > epsilon)) {
+            continue;
+        }
+        const float inverse_det = 1.0f / det;
+        const Vec3 s = ray.origin - Vec3{block.v0_x[lane], block.v0_y[lane], block.v0_z[lane]};
+        const float u = Vec3_Dot(s, p) * inverse_det;
+        const Vec3 q = Vec3_Cross(s, edge1);
+        const float v = Vec3_Dot(direction, q) * inverse_det;
+        const float t = Vec3_Dot(edge2, q) * inverse_det;
+        distances[lane] = t;
+        if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < *distance) {
+            mask |= 1 << lane;
+        }
+    }
+    if(!mask) {
+        return -1;
+    }
+#endif
+    int nearest = -1;
+    for(int lane = 0; lane < 4; ++lane) {
+        if((mask & (1 << lane)) && distances[lane] < *distance) {
+            *distance = distances[lane];
+            nearest = lane;
+        }
+    }
+    return nearest;
+}
+
+/**
+ * Walk a BVH front to back, calling leaf(child, count, distance)
+ * for each leaf lane the ray reaches nearer than *distance. The
+ * callback lowers *distance when it finds a hit, which prunes the
+ * rest of the walk.
+ */
+template<typename LeafFn>
+static void LevelBvh_Traverse(
+    const LevelColumn<LevelBvhNode>& nodes,
+    const Ray3& ray,
+    float* distance,
+    LeafFn&& leaf
+) {
+    if(nodes.size() == 0) {
+        return;
+    }
+    const LevelBvhRay bvh_ray(ray);
+    uint32_t stack[LevelBvh_StackSize];
+    float stack_entries[LevelBvh_StackSize];
+    int stack_size = 0;
+    stack[stack_size] = 0;
+    stack_entries[stack_size++] = 0.0f;
+    while(stack_size > 0) {
+        stack_size--;
+        if(stack_entries[stack_size] >= *distance) {
+            continue;
+        }
+        const LevelBvhNode& node = nodes[stack[stack_size]];
+        float entries[4];
+        const int mask = LevelBvh_IntersectNode(node, bvh_ray, *distance, entries);
+        if(!mask) {
+            continue;
+        }
+        // Order hit lanes nearest first
+        int lanes[4];
+        int lane_count = 0;
+        for(int lane = 0; lane < 4; ++lane) {
+            if(mask & (1 << lane)) {
+                int i = lane_count++;
+                while(i > 0 && entries[lanes[i - 1]] > entries[lane]) {
+                    lanes[i] = lanes[i - 1];
+                    i--;
+                }
+                lanes[i] = lane;
+            }
+        }
+        // Visit leaves now, and push inner nodes farthest first
+        for(int i = 0; i < lane_count; ++i) {
+            const int lane = lanes[i];
+            const uint32_t child = node.children[lane];
+            if((child & LevelBvh_LeafBit) && child != LevelBvh_EmptyChild) {
+                if(entries[lane] < *distance) {
+                    leaf(child & ~LevelBvh_LeafBit, node.counts[lane]);
+                }
+            }
+        }
+        for(int i = lane_count - 1; i >= 0; --i) {
+            const int lane = lanes[i];
+            const uint32_t child = node.children[lane];
+            if(!(child & LevelBvh_LeafBit)) {
+                assert(stack_size < LevelBvh_StackSize);
+                stack[stack_size] = child;
+                stack_entries[stack_size++] = entries[lane];
+            }
+        }
+    }
+}
+
+void LevelMeshBvh::build(const LevelMesh& mesh) {
+    UNI_PROFILE_ZONE("LevelMeshBvh::build");
+    this->nodes.clear();
+    this->triangles.clear();
+    const uint32_t triangle_count = (uint32_t) (mesh.indices.size() / 3);
+    if(triangle_count == 0) {
+        return;
+    }
+    std::vector<LevelBvhPrimitive> primitives(triangle_count);
+    for(uint32_t i = 0; i < triangle_count; ++i) {
+        const Vec3 v0 = mesh.positions[mesh.indices[i * 3 + 0]];
+        const Vec3 v1 = mesh.positions[mesh.indices[i * 3 + 1]];
+        const Vec3 v2 = mesh.positions[mesh.indices[i * 3 + 2]];
+        primitives[i].bounds = Bounds3_Grow(Bounds3_Grow(Bounds3{v0, v0}, v1), v2);
+        primitives[i].index = i;
+    }
+    LevelBvhBuilder builder;
+    builder.primitives = primitives.data();
+    builder.nodes = &this->nodes;
+    builder.mesh = &mesh;
+    builder.triangles = &this->triangles;
+    builder.build_node(0, triangle_count, 0);
+}
+
+bool LevelMeshBvh::intersect(const Ray3& ray, float* distance, uint32_t* triangle) const {
+    bool hit = false;
+    LevelBvh_Traverse(this->nodes, ray, distance, [&](uint32_t block, uint32_t /*count*/) {
+        const LevelBvhTriangles& triangles = this->triangles[block];
+        const int lane = LevelBvh_IntersectTriangles(triangles, ray, distance);
+        if(lane >= 0) {
+            *triangle = triangles.triangles[lane];
+            hit = true;
+        }
+    });
+    return hit;
+}
+
+void LevelRayPacket::set_ray(int lane, const Ray3& ray, float distance) {
+    this->origin_x[lane] = ray.origin.x;
+    this->origin_y[lane] = ray.origin.y;
+    this->origin_z[lane] = ray.origin.z;
+    this->direction_x[lane] = ray.direction.x;
+    this->direction_y[lane] = ray.direction.y;
+    this->direction_z[lane] = ray.direction.z;
+    this->distance[lane] = distance;
+    this->triangle[lane] = UINT32_MAX;
+}
+
+Ray3 LevelRayPacket::get_ray(int lane) const {
+    return Ray3{
+        Vec3{this->origin_x[lane], this->origin_y[lane], this->origin_z[lane]},
+        Vec3{this->direction_x[lane], this->direction_y[lane], this->direction_z[lane]}
+    };
+}
+
+// Test one child of a node against every ray of a packet. Returns
+// a bit mask of the rays which hit it nearer than their distance,
+// and writes the nearest entry distance among them.
+static int LevelBvh_IntersectPacketChild(
+    const LevelBvhNode& node,
+    int lane,
+    const LevelRayPacket& packet,
+    const float* inverse_x,
+    const float* inverse_y,
+    const float* inverse_z,
+    float* nearest_entry
+) {
+#if UNI_SIMD_SSE
+    const __m128 origin_x = _mm_load_ps(packet.origin_x);
+    const __m128 origin_y = _mm_load_ps(packet.origin_y);
+    const __m128 origin_z = _mm_load_ps(packet.origin_z);
+    const __m128 inv_x = _mm_load_ps(inverse_x);
+    const __m128 inv_y = _mm_load_ps(inverse_y);
+    const __m128 inv_z = _mm_load_ps(inverse_z);
+    const __m128 low_x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min_x[lane]), origin_x), inv_x);
+    const __m128 low_y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min_y[lane]), origin_y), inv_y);
+    const __m128 low_z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min_z[lane]), origin_z), inv_z);
+    const __m128 high_x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max_x[lane]), origin_x), inv_x);
+    const __m128 high_y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max_y[lane]), origin_y), inv_y);
+    const __m128 high_z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max_z[lane]), origin_z), inv_z);
+    // Rays differ in direction, so the near plane of each axis is
+    // picked per ray. As in LevelBvh_IntersectNode, a NaN from a
+    // zero direction component leaves the running value unchanged.
+    __m128 entry = _mm_setzero_ps();
+    __m128 exit = _mm_load_ps(packet.distance);
+    entry = _mm_max_ps(_mm_min_ps(low_x, high_x), entry);
+    entry = _mm_max_ps(_mm_min_ps(low_y, high_y), entry);
+    entry = _mm_max_ps(_mm_min_ps(low_z, high_z), entry);
+    exit = _mm_min_ps(_mm_max_ps(low_x, high_x), exit);
+    exit = _mm_min_ps(_mm_max_ps(low_y, high_y), exit);
+    exit = _mm_min_ps(_mm_max_ps(low_z, high_z), exit);
+    const int mask = _mm_movemask_ps(_mm_and_ps(
+        _mm_cmple_ps(entry, exit), _mm_cmpgt_ps(exit, _mm_setzero_ps())
+    ));
+    float entries[4];
+    _mm_storeu_ps(entries, entry);
+#else
+    int mask = 0;
+    float entries[4];
+    for(int ray = 0; ray < 4; ++ray) {
+        const float origin[3] = {packet.origin_x[ray], packet.origin_y[ray], packet.origin_z[ray]};
+        const float inverse[3] = {inverse_x[ray], inverse_y[ray], inverse_z[ray]};
+        const float low[3] = {node.min_x[lane], node.min_y[lane], node.min_z[lane]};
+        const float high[3] = {node.max_x[lane], node.max_y[lane], node.max_z[lane]};
+        float entry = 0.0f;
+        float exit = packet.distance[ray];
+        for(int axis = 0; axis < 3; ++axis) {
+            const float t0 = (low[axis] - origin[axis]) * inverse[axis];
+            const float t1 = (high[axis] - origin[axis]) * inverse[axis];
+            const float near_t = t0 < t1 ? t0 : t1;
+            const float far_t = t0 < t1 ? t1 : t0;
+            entry = near_t > entry ? near_t : entry;
+            exit = far_t < exit ? far_t : exit;
+        }
+        entries[ray] = entry;
+        mask |= entry <= exit && exit > 0.0f ? 1 << ray : 0;
+    }
+#endif
+    *nearest_entry = INFINITY;
+    for(int ray = 0; ray < 4; ++ray) {
+        if(mask & (1 << ray)) {
+            *nearest_entry = std::min(*nearest_entry, entries[ray]);
+        }
+    }
+    return mask;
+}
+
+int LevelMeshBvh::intersect_packet(LevelRayPacket* packet) const {
+    if(this->nodes.size() == 0) {
+        return 0;
+    }
+    alignas(16) float inverse_x[4];
+    alignas(16) float inverse_y[4];
+    alignas(16) float inverse_z[4];
+    float farthest = 0.0f;
+    for(int ray = 0; ray < 4; ++ray) {
+        inverse_x[ray] = 1.0f / packet->direction_x[ray];
+        inverse_y[ray] = 1.0f / packet->direction_y[ray];
+        inverse_z[ray] = 1.0f / packet->direction_z[ray];
+        farthest = std::max(farthest, packet->distance[ray]);
+    }
+    int hit_mask = 0;
+    uint32_t stack[LevelBvh_StackSize];
+    float stack_entries[LevelBvh_StackSize];
+    int stack_size = 0;
+    stack[stack_size] = 0;
+    stack_entries[stack_size++] = 0.0f;
+    while(stack_size > 0) {
+        stack_size--;
+        if(stack_entries[stack_size] >= farthest) {
+            continue;
+        }
+        const LevelBvhNode& node = this->nodes[stack[stack_size]];
+        int lanes[4];
+        float lane_entries[4];
+        int lane_count = 0;
+        for(int lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.children[lane];
+            if(child == LevelBvh_EmptyChild) {
+                continue;
+            }
+            float entry;
+            const int ray_mask = LevelBvh_IntersectPacketChild(
+                node, lane, *packet, inverse_x, inverse_y, inverse_z, &entry
+            );
+            if(!ray_mask) {
+                continue;
+            }
+            if(!(child & LevelBvh_LeafBit)) {
+                // Order inner children nearest first
+                int i = lane_count++;
+                while(i > 0 && lane_entries[i - 1] > entry) {
+                    lanes[i] = lanes[i - 1];
+                    lane_entries[i] = lane_entries[i - 1];
+                    i--;
+                }
+                lanes[i] = lane;
+                lane_entries[i] = entry;
+                continue;
+            }
+            // Test the leaf's triangles against each ray which
+            // reached it, four triangles at a time
+            const LevelBvhTriangles& triangles = this->triangles[child & ~LevelBvh_LeafBit];
+            for(int ray = 0; ray < 4; ++ray) {
+                if(!(ray_mask & (1 << ray))) {
+                    continue;
+                }
+                const int hit = LevelBvh_IntersectTriangles(
+                    triangles, packet->get_ray(ray), &packet->distance[ray]
+                );
+                if(hit >= 0) {
+                    packet->triangle[ray] = triangles.triangles[hit];
+                    hit_mask |= 1 << ray;
+                }
+            }
+        }
+        if(hit_mask) {
+            farthest = 0.0f;
+            for(int ray = 0; ray < 4; ++ray) {
+                farthest = std::max(farthest, packet->distance[ray]);
+            }
+        }
+        for(int i = lane_count - 1; i >= 0; --i) {
+            assert(stack_size < LevelBvh_StackSize);
+            stack[stack_size] = node.children[lanes[i]];
+            stack_entries[stack_size++] = lane_entries[i];
+        }
+    }
+    return hit_mask;
+}
+
+/**
+ * Entity BVH built from a snapshot of bounds, so that it can be
+ * built in the background while the document keeps changing.
+ */
+struct LevelBvhBuildResult {
+    LevelColumn<LevelBvhNode> nodes;
+    std::vector<LevelHandle> handles;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> slot_leaves;
+    uint64_t structure_revision = 0;
+};
+
+static void LevelBvh_BuildEntities(
+    JobSystem* jobs,
+    const std::vector<Bounds3>& bounds,
+    const std::vector<LevelHandle>& handles,
+    LevelBvhBuildResult* result
+) {
+    UNI_PROFILE_ZONE("LevelBvh_BuildEntities");
+    const uint32_t count = (uint32_t) bounds.size();
+    if(count == 0) {
+        return;
+    }
+    std::vector<LevelBvhPrimitive> primitives(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        primitives[i].bounds = bounds[i];
+        primitives[i].index = i;
+    }
+    std::vector<LevelBvhBuilder::Subtree> deferred;
+    LevelBvhBuilder builder;
+    builder.primitives = primitives.data();
+    builder.nodes = &result->nodes;
+    builder.deferred = jobs ? &deferred : nullptr;
+    builder.build_node(0, count, 0);
+    // Build deferred subtrees in parallel. Their ranges of
+    // primitives don't overlap, so each job can reorder its own in place.
+    std::vector<LevelColumn<LevelBvhNode>> subtree_nodes(deferred.size());
+    if(!deferred.empty()) {
+        jobs->parallel_for((int) deferred.size(), 1, [&](int begin, int end) {
+            for(int i = begin; i < end; ++i) {
+                LevelBvhBuilder subtree_builder = builder;
+                subtree_builder.nodes = &subtree_nodes[i];
+                subtree_builder.deferred = nullptr;
+                subtree_builder.build_node(deferred[i].begin, deferred[i].end, deferred[i].depth);
+            }
+        });
+    }
+    for(size_t i = 0; i < deferred.size(); ++i) {
+        const uint32_t offset = result->nodes.size();
+        const LevelColumn<LevelBvhNode>& subtree = subtree_nodes[i];
+        for(uint32_t j = 0; j < subtree.size(); ++j) {
+            LevelBvhNode node = subtree[j];
+            for(int lane = 0; lane < 4; ++lane) {
+                if(!(node.children[lane] & LevelBvh_LeafBit)) {
+                    node.children[lane] += offset;
+                }
+            }
+            result->nodes.push_back(node);
+        }
+        result->nodes[deferred[i].node].children[deferred[i].lane] = offset;
+    }
+    result->handles.resize(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        result->handles[i] = handles[primitives[i].index];
+    }
+    uint32_t slot_count = 0;
+    for(const LevelHandle handle : handles) {
+        slot_count = std::max(slot_count, handle.index + 1);
+    }
+    result->parents.assign(result->nodes.size(), UINT32_MAX);
+    result->slot_leaves.assign(slot_count, UINT32_MAX);
+    for(uint32_t i = 0; i < result->nodes.size(); ++i) {
+        const LevelBvhNode& node = result->nodes[i];
+        for(int lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.children[lane];
+            if(child == LevelBvh_EmptyChild) {
+                continue;
+            }
+            if(!(child & LevelBvh_LeafBit)) {
+                result->parents[child] = i * 4 + lane;
+                continue;
+            }
+            const uint32_t first = child & ~LevelBvh_LeafBit;
+            for(uint32_t k = 0; k < node.counts[lane]; ++k) {
+                result->slot_leaves[result->handles[first + k].index] = i * 4 + lane;
+            }
+        }
+    }
+}
+
+void LevelBvh::build(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelBvh::build");
+    this->cancel();
+    this->update_meshes(document);
+    const uint32_t count = document.get_count();
+    std::vector<Bounds3> bounds(count);
+    std::vector<LevelHandle> handles(count);
+    for(uint32_t row = 0; row < count; ++row) {
+        bounds[row] = document.get_bounds(row);
+        handles[row] = document.get_handle(row);
+    }
+    LevelBvhBuildResult result;
+    LevelBvh_BuildEntities(this->jobs, bounds, handles, &result);
+    this->nodes = std::move(result.nodes);
+    this->handles = std::move(result.handles);
+    this->parents = std::move(result.parents);
+    this->slot_leaves = std::move(result.slot_leaves);
+    this->built_structure_revision = document.structure_revision;
+    this->all_changed = false;
+    this->changed_entities.clear();
+    this->refit_clear_revision = document.clear_revision;
+}
+
+void LevelBvh::mark_changed(const LevelHandle* handles, uint32_t count) {
+    if(!handles) {
+        this->all_changed = true;
+        this->changed_entities.clear();
+        this->build_all_changed = true;
+        this->build_changed_entities.clear();
+        return;
+    }
+    if(!this->all_changed) {
+        this->changed_entities.insert(this->changed_entities.end(), handles, handles + count);
+    }
+    if(this->building && !this->build_all_changed) {
+        this->build_changed_entities.insert(this->build_changed_entities.end(), handles, handles + count);
+    }
+}
+
+void LevelBvh::update(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelBvh::update");
+    this->update_meshes(document);
+    if(!this->jobs) {
+        if(document.structure_revision != this->built_structure_revision) {
+            this->build(document);
+        }
+    }
+    else if(document.structure_revision != this->built_structure_revision && !this->building) {
+        // The snapshot is a copy of the bounds, so the document can
+        // keep changing while the job runs
+        auto bounds = std::make_shared<std::vector<Bounds3>>(document.get_count());
+        auto handles = std::make_shared<std::vector<LevelHandle>>(document.get_count());
+        for(uint32_t row = 0; row < document.get_count(); ++row) {
+            (*bounds)[row] = document.get_bounds(row);
+            (*handles)[row] = document.get_handle(row);
+        }
+        auto result = std::make_shared<LevelBvhBuildResult>();
+        result->structure_revision = document.structure_revision;
+        JobSystem* jobs = this->jobs;
+        const uint32_t generation = this->generation;
+        this->building = true;
+        this->build_all_changed = false;
+        this->build_changed_entities.clear();
+        this->build_job = this->jobs->submit(
+            [jobs, bounds, handles, result]() {
+                LevelBvh_BuildEntities(jobs, *bounds, *handles, result.get());
+            },
+            {},
+            [this, result, generation]() {
+                if(generation != this->generation) {
+                    return;
+                }
+                this->building = false;
+                this->nodes = std::move(result->nodes);
+                this->handles = std::move(result->handles);
+                this->parents = std::move(result->parents);
+                this->slot_leaves = std::move(result->slot_leaves);
+                // Changes made meanwhile are caught by the next refit
+                this->all_changed = this->all_changed || this->build_all_changed;
+                if(!this->all_changed) {
+                    this->changed_entities = std::move(this->build_changed_entities);
+                }
+                this->build_changed_entities.clear();
+                this->built_structure_revision = result->structure_revision;
+                UNI_LOG_TRACE(
+                    LogSubsystem_Level, "Rebuilt level BVH with {} nodes over {} entities.",
+                    this->nodes.size(), this->handles.size()
+                );
+            }
+        );
+    }
+    if(this->all_changed || document.clear_revision != this->refit_clear_revision) {
+        // Handles from before a clear may refer to other entities
+        this->refit_all(document);
+    }
+    else if(!this->changed_entities.empty()) {
+        this->refit(document, this->changed_entities.data(), (uint32_t) this->changed_entities.size());
+    }
+    this->all_changed = false;
+    this->changed_entities.clear();
+    this->refit_clear_revision = document.clear_revision;
+}
+
+// Test the four children of a node against a frustum. Sets bit i
+// of *outside if child i is entirely behind any plane, and of
+// *inside if it is entirely in front of every plane. Empty lanes
+// must be skipped by the caller.
+static void LevelBvh_TestNodeFrustum(
+    const LevelBvhNode& node,
+    const Frustum3& frustum,
+    int* outside,
+    int* inside
+) {
+    // For each plane, the corner farthest along its normal decides
+    // whether a box is behind it, and the nearest corner whether
+    // the box is entirely in front
+#if UNI_SIMD_SSE
+    const __m128 zero = _mm_setzero_ps();
+    __m128 behind = zero;
+    __m128 crossing = zero;
+    for(int i = 0; i < 6; ++i) {
+        const Plane3& plane = frustum.planes[i];
+        const bool positive_x = plane.normal.x >= 0.0f;
+        const bool positive_y = plane.normal.y >= 0.0f;
+        const bool positive_z = plane.normal.z >= 0.0f;
+        const __m128 normal_x = _mm_set1_ps(plane.normal.x);
+        const __m128 normal_y = _mm_set1_ps(plane.normal.y);
+        const __m128 normal_z = _mm_set1_ps(plane.normal.z);
+        const __m128 distance = _mm_set1_ps(plane.distance);
+        const __m128 farthest = _mm_add_ps(
+            _mm_add_ps(
+                _mm_mul_ps(_mm_load_ps(positive_x ? node.max_x : node.min_x), normal_x),
+                _mm_mul_ps(_mm_load_ps(positive_y ? node.max_y : node.min_y), normal_y)
+            ),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(positive_z ? node.max_z : node.min_z), normal_z), distance)
+        );
+        const __m128 nearest = _mm_add_ps(
+            _mm_add_ps(
+                _mm_mul_ps(_mm_load_ps(positive_x ? node.min_x : node.max_x), normal_x),
+                _mm_mul_ps(_mm_load_ps(positive_y ? node.min_y : node.max_y), normal_y)
+            ),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(positive_z ? node.min_z : node.max_z), normal_z), distance)
+        );
+        behind = _mm_or_ps(behind, _mm_cmplt_ps(farthest, zero));
+        crossing = _mm_or_ps(crossing, _mm_cmplt_ps(nearest, zero));
+    }
+    *outside = _mm_movemask_ps(behind);
+    *inside = ~_mm_movemask_ps(crossing) & 0xf;
+#else
+    *outside = 0;
+    *inside = 0;
+    for(int lane = 0; lane < 4; ++lane) {
+        bool behind = false;
+        bool crossing = false;
+        for(int i = 0; i < 6; ++i) {
+            const Plane3& plane = frustum.planes[i];
+            const float farthest = (
+                (plane.normal.x >= 0.0f ? node.max_x[lane] : node.min_x[lane]) * plane.normal.x +
+                (plane.normal.y >= 0.0f ? node.max_y[lane] : node.min_y[lane]) * plane.normal.y +
+                (plane.normal.z >= 0.0f ? node.max_z[lane] : node.min_z[lane]) * plane.normal.z +
+                plane.distance
+            );
+            const float nearest = (
+                (plane.normal.x >= 0.0f ? node.min_x[lane] : node.max_x[lane]) * plane.normal.x +
+                (plane.normal.y >= 0.0f ? node.min_y[lane] : node.max_y[lane]) * plane.normal.y +
+                (plane.normal.z >= 0.0f ? node.min_z[lane] : node.max_z[lane]) * plane.normal.z +
+                plane.distance
+            );
+            behind = behind || farthest < 0.0f;
+            crossing = crossing || nearest < 0.0f;
+        }
+        *outside |= behind ? 1 << lane : 0;
+        *inside |= crossing ? 0 : 1 << lane;
+    }
+#endif
+}
+
+bool LevelBvh::query_frustum(
+    const Frustum3& frustum,
+    std::vector<LevelHandle>* inside,
+    std::vector<LevelHandle>* crossing,
+    uint32_t max_count
+) const {
+    UNI_PROFILE_ZONE("LevelBvh::query_frustum");
+    if(this->nodes.size() == 0) {
+        return true;
+    }
+    size_t found_count = 0;
+    // Nodes to visit, with the low bit set for nodes known to be
+    // entirely inside, whose leaves are taken without tests
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    while(!stack.empty()) {
+        const uint32_t entry = stack.back();
+        stack.pop_back();
+        const bool all_inside = entry & 1;
+        const LevelBvhNode& node = this->nodes[entry >> 1];
+        int outside_mask = 0;
+        int inside_mask = 0xf;
+        if(!all_inside) {
+            LevelBvh_TestNodeFrustum(node, frustum, &outside_mask, &inside_mask);
+        }
+        for(int lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.children[lane];
+            if(child == LevelBvh_EmptyChild || (outside_mask & (1 << lane))) {
+                continue;
+            }
+            const bool lane_inside = inside_mask & (1 << lane);
+            if(!(child & LevelBvh_LeafBit)) {
+                stack.push_back((child << 1) | (lane_inside ? 1 : 0));
+                continue;
+            }
+            found_count += node.counts[lane];
+            if(found_count > max_count) {
+                return false;
+            }
+            const uint32_t first = child & ~LevelBvh_LeafBit;
+            std::vector<LevelHandle>* handles = lane_inside ? inside : crossing;
+            handles->insert(
+                handles->end(),
+                this->handles.begin() + first,
+                this->handles.begin() + first + node.counts[lane]
+            );
+        }
+    }
+    return true;
+}
+
+void LevelBvh::cancel() {
+    if(this->building && this->jobs) {
+        this->jobs->wait(this->build_job);
+        this->building = false;
+    }
+    this->generation++;
+}
+
+void LevelBvh::update_meshes(const LevelDocument& document) {
+    if(document.clear_revision != this->meshes_clear_revision) {
+        // Meshes were replaced, as when another level was opened
+        this->mesh_bvhs.clear();
+        this->meshes_clear_revision = document.clear_revision;
+    }
+    const size_t first = this->mesh_bvhs.size();
+    const size_t count = document.mesh_assets.size();
+    if(count < first) {
+        // Meshes were removed without clearing the document
+        this->mesh_bvhs.clear();
+        this->update_meshes(document);
+        return;
+    }
+    if(count == first) {
+        return;
+    }
+    UNI_PROFILE_ZONE("LevelBvh::update_meshes");
+    this->mesh_bvhs.resize(count);
+    auto build = [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            this->mesh_bvhs[first + i].build(document.mesh_assets[first + i]);
+        }
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) (count - first), 1, build);
+    }
+    else {
+        build(0, (int) (count - first));
+    }
+}
+
+Bounds3 LevelBvh::get_leaf_bounds(const LevelDocument& document, const LevelBvhNode& node, int lane) const {
+    Bounds3 bounds = Bounds3_Empty;
+    const uint32_t first = node.children[lane] & ~LevelBvh_LeafBit;
+    for(uint32_t k = 0; k < node.counts[lane]; ++k) {
+        const uint32_t row = document.get_row(this->handles[first + k]);
+        if(row != LevelRow_None) {
+            bounds = Bounds3_Union(bounds, document.get_bounds(row));
+        }
+    }
+    return bounds;
+}
+
+void LevelBvh::refit(const LevelDocument& document, const LevelHandle* handles, uint32_t count) {
+    UNI_PROFILE_ZONE("LevelBvh::refit");
+    for(uint32_t i = 0; i < count; ++i) {
+        if(handles[i].index >= this->slot_leaves.size()) {
+            continue;
+        }
+        uint32_t link = this->slot_leaves[handles[i].index];
+        if(link == UINT32_MAX) {
+            continue;
+        }
+        LevelBvhNode* node = &this->nodes[link / 4];
+        node->set_bounds(link % 4, this->get_leaf_bounds(document, *node, link % 4));
+        // Propagate up until a node's bounds stop changing
+        link = this->parents[link / 4];
+        while(link != UINT32_MAX) {
+            const Bounds3 bounds = node->get_bounds();
+            LevelBvhNode& parent = this->nodes[link / 4];
+            const int lane = link % 4;
+            if(
+                parent.min_x[lane] == bounds.min.x && parent.min_y[lane] == bounds.min.y &&
+                parent.min_z[lane] == bounds.min.z && parent.max_x[lane] == bounds.max.x &&
+                parent.max_y[lane] == bounds.max.y && parent.max_z[lane] == bounds.max.z
+            ) {
+                break;
+            }
+            parent.set_bounds(lane, bounds);
+            node = &parent;
+            link = this->parents[link / 4];
+        }
+    }
+}
+
+void LevelBvh::refit_all(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelBvh::refit_all");
+    // Leaves are grown by sweeping rows in order, which reads the
+    // bounds columns linearly, rather than looking up each leaf's
+    // entities by handle
+    for(uint32_t i = 0; i < this->nodes.size(); ++i) {
+        LevelBvhNode& node = this->nodes[i];
+        for(int lane = 0; lane < 4; ++lane) {
+            if(node.children[lane] & LevelBvh_LeafBit) {
+                node.set_bounds(lane, Bounds3_Empty);
+            }
+        }
+    }
+    const uint32_t count = document.get_count();
+    for(uint32_t row = 0; row < count; ++row) {
+        const uint32_t slot = document.row_slots[row];
+        if(slot >= this->slot_leaves.size() || this->slot_leaves[slot] == UINT32_MAX) {
+            continue;
+        }
+        const uint32_t link = this->slot_leaves[slot];
+        LevelBvhNode& node = this->nodes[link / 4];
+        const int lane = link % 4;
+        const Bounds3 bounds = document.get_bounds(row);
+        node.min_x[lane] = std::min(node.min_x[lane], bounds.min.x);
+        node.min_y[lane] = std::min(node.min_y[lane], bounds.min.y);
+        node.min_z[lane] = std::min(node.min_z[lane], bounds.min.z);
+        node.max_x[lane] = std::max(node.max_x[lane], bounds.max.x);
+        node.max_y[lane] = std::max(node.max_y[lane], bounds.max.y);
+        node.max_z[lane] = std::max(node.max_z[lane], bounds.max.z);
+    }
+    // Children always come after their parents, so going in
+    // reverse updates every child before its parent
+    for(uint32_t i = this->nodes.size(); i-- > 0;) {
+        LevelBvhNode& node = this->nodes[i];
+        for(int lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.children[lane];
+            if(!(child & LevelBvh_LeafBit)) {
+                node.set_bounds(lane, this->nodes[child].get_bounds());
+            }
+        }
+    }
+}
+
+bool LevelBvh::raycast(const LevelDocument& document, const Ray3& ray, LevelRayHit* hit) const {
+    UNI_PROFILE_ZONE("LevelBvh::raycast");
+    *hit = LevelRayHit{};
+    float distance = INFINITY;
+    LevelBvh_Traverse(this->nodes, ray, &distance, [&](uint32_t first, uint32_t count) {
+        for(uint32_t k = 0; k < count; ++k) {
+            const LevelHandle handle = this->handles[first + k];
+            const uint32_t row = document.get_row(handle);
+            if(row == LevelRow_None || (document.flags[row] & LevelEntityFlags_Hidden)) {
+                continue;
+            }
+            const LevelMeshId mesh = document.meshes[row];
+            if(mesh >= this->mesh_bvhs.size() || this->mesh_bvhs[mesh].nodes.size() == 0) {
+                // Without triangles, the entity's bounds are hit
+                LevelBvhNode box = LevelBvh_MakeEmptyNode();
+                box.set_bounds(0, document.get_bounds(row));
+                float entries[4];
+                if(LevelBvh_IntersectNode(box, LevelBvhRay(ray), distance, entries) & 1) {
+                    distance = entries[0];
+                    *hit = LevelRayHit{handle, distance, UINT32_MAX};
+                }
+                continue;
+            }
+            // Move the ray into the mesh's space. The direction
+            // isn't normalized, so distances stay the same.
+            const Vec3 scale = document.scales[row];
+            if(scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f) {
+                continue;
+            }
+            const Quat inverse_rotation = Quat_Conjugate(document.rotations[row]);
+            const Vec3 inverse_scale = Vec3{1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z};
+            const Ray3 local_ray = Ray3{
+                Quat_Rotate(inverse_rotation, ray.origin - document.positions[row]) * inverse_scale,
+                Quat_Rotate(inverse_rotation, ray.direction) * inverse_scale
+            };
+            uint32_t triangle;
+            if(this->mesh_bvhs[mesh].intersect(local_ray, &distance, &triangle)) {
+                *hit = LevelRayHit{handle, distance, triangle};
+            }
+        }
+    });
+    return hit->handle != LevelHandle_None;
+}
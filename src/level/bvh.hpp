@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "column.hpp"
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+#include "util/math.hpp"
+
+// Set in a child reference to mark it as a leaf.
+const uint32_t LevelBvh_LeafBit = 0x80000000u;
+// Child reference for unused lanes of a node.
+const uint32_t LevelBvh_EmptyChild = UINT32_MAX;
+// Most primitives referenced by one leaf lane.
+const uint32_t LevelBvh_LeafSize = 4;
+
+/**
+ * Four-wide BVH node. The bounds of all four children are stored
+ * as separate arrays per component, so that one ray is tested
+ * against every child at once with SIMD. Unused lanes have empty
+ * bounds, which no ray hits.
+ */
+struct alignas(64) LevelBvhNode {
+    float min_x[4];
+    float min_y[4];
+    float min_z[4];
+    float max_x[4];
+    float max_y[4];
+    float max_z[4];
+    // Index of a child node, or for leaves, LevelBvh_LeafBit with
+    // the index of the leaf's first primitive
+    uint32_t children[4];
+    // Primitives in each leaf lane, or zero for inner lanes
+    uint32_t counts[4];
+    
+    void set_bounds(int lane, const Bounds3& bounds);
+    Bounds3 get_bounds() const;
+};
+
+// Up to four triangles of a mesh, stored for testing at once.
+// Unused lanes are degenerate, which no ray hits.
+struct alignas(64) LevelBvhTriangles {
+    float v0_x[4];
+    float v0_y[4];
+    float v0_z[4];
+    float edge1_x[4];
+    float edge1_y[4];
+    float edge1_z[4];
+    float edge2_x[4];
+    float edge2_y[4];
+    float edge2_z[4];
+    // Index of each triangle in the mesh
+    uint32_t triangles[4];
+};
+
+// Closest intersection found by a raycast.
+struct LevelRayHit {
+    LevelHandle handle = LevelHandle_None;
+    // Along the ray, in multiples of its direction's length
+    float distance = INFINITY;
+    // Triangle of the entity's mesh, or UINT32_MAX when the ray
+    // hit the bounds of an entity without a mesh
+    uint32_t triangle = UINT32_MAX;
+};
+
+/**
+ * Four rays traced through a BVH together. Components are stored
+ * as separate arrays per lane, so that one node's bounds are
+ * tested against every ray at once with SIMD. Rays which start
+ * near each other and point the same way, such as those from
+ * neighbouring texels, visit mostly the same nodes, so walking
+ * the tree once for all four saves most of the node visits.
+ */
+struct alignas(16) LevelRayPacket {
+    float origin_x[4];
+    float origin_y[4];
+    float origin_z[4];
+    float direction_x[4];
+    float direction_y[4];
+    float direction_z[4];
+    // Farthest hit wanted on each ray, lowered when a hit is found.
+    // Lanes with a distance of zero are unused.
+    float distance[4];
+    // Triangle hit by each ray, or UINT32_MAX
+    uint32_t triangle[4];
+    
+    void set_ray(int lane, const Ray3& ray, float distance);
+    Ray3 get_ray(int lane) const;
+};
+
+/**
+ * BVH over the triangles of one mesh, in the mesh's local space.
+ * Each leaf lane holds one LevelBvhTriangles.
+ */
+class LevelMeshBvh {
+public:
+    LevelColumn<LevelBvhNode> nodes;
+    LevelColumn<LevelBvhTriangles> triangles;
+    
+    void build(const LevelMesh& mesh);
+    // Find the closest triangle hit nearer than *distance. On a
+    // hit, updates *distance and *triangle and returns true.
+    bool intersect(const Ray3& ray, float* distance, uint32_t* triangle) const;
+    // Find the closest triangle hit by each ray of a packet, nearer
+    // than its distance. Returns a bit mask of the lanes hit.
+    int intersect_packet(LevelRayPacket* packet) const;
+};
+
+/**
+ * Answers raycasts against a LevelDocument's entities, such as
+ * for picking what is under the mouse cursor.
+ * 
+ * There are two levels. One BVH is built over the world-space
+ * bounds of every entity, with each leaf referring to entities by
+ * handle. Each mesh gets its own BVH over its triangles, which is
+ * shared by every entity using the mesh; rays which reach an
+ * entity are moved into its mesh's local space and continue there.
+ * 
+ * The entity BVH is built with a binned surface area heuristic.
+ * The top levels are split on the calling thread, and the subtrees
+ * below them are built in parallel by the job system. When
+ * entities move, the BVH is refit rather than rebuilt: the leaves
+ * of the entities marked changed are recomputed, and changes
+ * propagate to the root. Creating or destroying entities needs a
+ * rebuild, which update does in the background.
+ */
+class LevelBvh {
+public:
+    LevelBvh() {};
+    LevelBvh(JobSystem* jobs): jobs(jobs) {};
+    LevelBvh(const LevelBvh&) = delete;
+    LevelBvh& operator=(const LevelBvh&) = delete;
+    LevelBvh& operator=(LevelBvh&& other) = default;
+    
+    JobSystem* jobs = nullptr;
+    
+    // Build synchronously from a document's current entities.
+    void build(const LevelDocument& document);
+    // Note entities which were changed, created or destroyed since
+    // the last update. Null handles mark everything, as when the
+    // journal is cleared. Fits LevelJournalListener.
+    void mark_changed(const LevelHandle* handles, uint32_t count);
+    // Keep up with changes to a document. Call once per frame.
+    // Starts a background rebuild when entities were created or
+    // destroyed, and refits the entities marked changed. Everything
+    // is refit after the document was cleared, as when a level was
+    // opened.
+    void update(const LevelDocument& document);
+    // Recompute the bounds of some entities' leaves, after they
+    // moved or changed mesh.
+    void refit(const LevelDocument& document, const LevelHandle* handles, uint32_t count);
+    // Recompute the bounds of every node.
+    void refit_all(const LevelDocument& document);
+    // Find the closest visible entity hit by a ray. Returns false
+    // if there is none. Entities created since the last build
+    // aren't found until the next one finishes.
+    bool raycast(const LevelDocument& document, const Ray3& ray, LevelRayHit* hit) const;
+    // Find the entities whose bounds reach inside a frustum. Those
+    // entirely inside are added to inside, and the rest to
+    // crossing, for closer tests. Like raycast, this misses
+    // entities created since the last build, and may list ones
+    // destroyed since, or hidden. Stops and returns false once more
+    // than max_count are found, for callers which would rather
+    // test every entity than so many candidates.
+    bool query_frustum(
+        const Frustum3& frustum,
+        std::vector<LevelHandle>* inside,
+        std::vector<LevelHandle>* crossing,
+        uint32_t max_count = UINT32_MAX
+    ) const;
+    
+    // Wait for any background rebuild, and discard its result.
+    void cancel();
+    uint32_t get_node_count() const {
+        return this->nodes.size();
+    }
+    
+private:
+    LevelColumn<LevelBvhNode> nodes;
+    // Entities referred to by leaves, in leaf order
+    std::vector<LevelHandle> handles;
+    // Parent of each node, as node index * 4 + lane. The root's
+    // is UINT32_MAX.
+    std::vector<uint32_t> parents;
+    // Leaf of each entity, as node index * 4 + lane, indexed by
+    // LevelHandle::index
+    std::vector<uint32_t> slot_leaves;
+    // Indexed by LevelMeshId
+    std::vector<LevelMeshBvh> mesh_bvhs;
+    // LevelDocument::clear_revision when mesh BVHs were last built,
+    // since meshes are only replaced by clearing the document
+    uint64_t meshes_clear_revision = 0;
+    uint64_t built_structure_revision = 0;
+    // Entities to refit at the next update
+    bool all_changed = true;
+    std::vector<LevelHandle> changed_entities;
+    // LevelDocument::clear_revision at the last refit
+    uint64_t refit_clear_revision = 0;
+    // Background rebuild in flight, and the entities marked changed
+    // since its snapshot, which its result must be refit for
+    JobHandle build_job = JobHandle_None;
+    bool build_all_changed = false;
+    std::vector<LevelHandle> build_changed_entities;
+    bool building = false;
+    uint32_t generation = 0;
+    
+    // Build mesh BVHs for meshes added since the last call.
+    void update_meshes(const LevelDocument& document);
+    Bounds3 get_leaf_bounds(const LevelDocument& document, const LevelBvhNode& node, int lane) const;
+};
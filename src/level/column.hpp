@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Alignment of column storage, in bytes. Matches a cache line,
+// and suits any SIMD width the level code uses.
+const size_t LevelColumn_Alignment = 64;
+
+/**
+ * Growable array holding one field of every entity in a level.
+ * 
+ * Columns only hold trivially copyable values, so that growing,
+ * removing, and saving them is plain memory copying, and their
+ * storage is cache line aligned for linear and SIMD sweeps.
+ * 
+ * A column can also view memory it doesn't own, such as part of a
+ * mapped level file, so that loading involves no copying. It makes
+ * its own copy of the values only once it needs to grow.
+ */
+template<typename T>
+class LevelColumn {
+    static_assert(std::is_trivially_copyable_v<T>, "Column values must be trivially copyable.");
+    
+public:
+    LevelColumn() {};
+    LevelColumn(const LevelColumn&) = delete;
+    LevelColumn& operator=(const LevelColumn&) = delete;
+    LevelColumn(LevelColumn&& other) noexcept {
+        *this = std::move(other);
+    }
+    LevelColumn& operator=(LevelColumn&& other) noexcept {
+        if(this != &other) {
+            this->release();
+            this->items = other.items;
+            this->count = other.count;
+            this->capacity = other.capacity;
+            this->viewing = other.viewing;
+            other.items = nullptr;
+            other.count = 0;
+            other.capacity = 0;
+            other.viewing = false;
+        }
+        return *this;
+    }
+    ~LevelColumn() {
+        this->release();
+    }
+    
+    T& operator[](uint32_t index) {
+        assert(index < this->count);
+        return this->items[index];
+    }
+    const T& operator[](uint32_t index) const {
+        assert(index < this->count);
+        return this->items[index];
+    }
+    T* data() {
+        return this->items;
+    }
+    const T* data() const {
+        return this->items;
+    }
+    uint32_t size() const {
+        return this->count;
+    }
+    uint32_t get_capacity() const {
+        return this->capacity;
+    }
+    // Get the bytes of memory owned by the column.
+    size_t get_memory_bytes() const {
+        return this->viewing ? 0 : sizeof(T) * (size_t) this->capacity;
+    }
+    // Returns true while the values are in memory not owned by
+    // the column.
+    bool is_view() const {
+        return this->viewing;
+    }
+    // Use values in memory owned elsewhere, which must stay valid
+    // until the column grows, is cleared, or views something else.
+    void view(T* items, uint32_t count) {
+        this->release();
+        this->items = items;
+        this->count = count;
+        this->capacity = count;
+        this->viewing = true;
+    }
+    // Copy viewed values into memory owned by the column, so that
+    // the memory viewed can go away.
+    void own_values() {
+        if(!this->viewing) {
+            return;
+        }
+        if(this->count == 0) {
+            this->release();
+            return;
+        }
+        // Growing from no capacity copies, and stops viewing
+        this->capacity = 0;
+        this->reserve(this->count);
+    }
+    // Make room for at least this many values without moving.
+    void reserve(uint32_t new_capacity) {
+        if(new_capacity <= this->capacity) {
+            return;
+        }
+        T* new_items = (T*) ::operator new(
+            sizeof(T) * new_capacity, std::align_val_t(LevelColumn_Alignment)
+        );
+        if(this->count > 0) {
+            std::memcpy(new_items, this->items, sizeof(T) * this->count);
+        }
+        this->release();
+        this->items = new_items;
+        this->capacity = new_capacity;
+    }
+    // Change the number of values. New values are uninitialized.
+    void resize(uint32_t new_count) {
+        if(new_count > this->capacity) {
+            this->reserve(new_count);
+        }
+        this->count = new_count;
+    }
+    void push_back(const T& value) {
+        if(this->count == this->capacity) {
+            this->reserve(this->capacity < 64 ? 64 : this->capacity + this->capacity / 2);
+        }
+        this->items[this->count++] = value;
+    }
+    // Remove a value by moving the last value into its place.
+    void swap_remove(uint32_t index) {
+        assert(index < this->count);
+        this->items[index] = this->items[this->count - 1];
+        this->count--;
+    }
+    // Remove every value. Also stops viewing external memory.
+    void clear() {
+        if(this->viewing) {
+            this->release();
+        }
+        this->count = 0;
+    }
+    
+private:
+    T* items = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    bool viewing = false;
+    
+    void release() {
+        if(this->items && !this->viewing) {
+            ::operator delete(this->items, std::align_val_t(LevelColumn_Alignment));
+        }
+        this->items = nullptr;
+        this->capacity = 0;
+        this->viewing = false;
+    }
+};
@@ -0,0 +1,418 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+#include "util/simd.hpp"
+
+// Most cells along each axis of the grid
+const uint32_t LevelCuller_MaxGridSize = 1024;
+// The grid is rebuilt rather than refit once more than one in
+// this many entities have strayed from their cells
+const uint32_t LevelCuller_StrayRatio = 8;
+
+// Planes of a frustum, split into components.
+struct LevelCullPlanes {
+    float normal_x[6];
+    float normal_y[6];
+    float normal_z[6];
+    float abs_normal_x[6];
+    float abs_normal_y[6];
+    float abs_normal_z[6];
+    float distance[6];
+};
+
+// Four boxes to test at once. Unused lanes are copies of used ones.
+struct alignas(16) LevelCullBoxes {
+    float center_x[4];
+    float center_y[4];
+    float center_z[4];
+    float extent_x[4];
+    float extent_y[4];
+    float extent_z[4];
+};
+
+static LevelCullPlanes LevelCuller_GetPlanes(const Frustum3& frustum) {
+    LevelCullPlanes planes;
+    for(int i = 0; i < 6; ++i) {
+        const Plane3& plane = frustum.planes[i];
+        planes.normal_x[i] = plane.normal.x;
+        planes.normal_y[i] = plane.normal.y;
+        planes.normal_z[i] = plane.normal.z;
+        planes.abs_normal_x[i] = std::fabs(plane.normal.x);
+        planes.abs_normal_y[i] = std::fabs(plane.normal.y);
+        planes.abs_normal_z[i] = std::fabs(plane.normal.z);
+        planes.distance[i] = plane.distance;
+    }
+    return planes;
+}
+
+// Test four boxes against a frustum. Sets bit i of *outside if box
+// i is entirely behind any plane, and of *inside if it is entirely
+// in front of every plane.
+static void LevelCuller_TestBoxes(
+    const LevelCullPlanes& planes,
+    const LevelCullBoxes& boxes,
+    int* outside,
+    int* inside
+) {
+    // A box is behind a plane when its center is farther behind it
+    // than the box's projected radius along the plane's normal
+#if UNI_SIMD_SSE
+    const __m128 center_x = _mm_load_ps(boxes.center_x);
+    const __m128 center_y = _mm_load_ps(boxes.center_y);
+    const __m128 center_z = _mm_load_ps(boxes.center_z);
+    const __m128 extent_x = _mm_load_ps(boxes.extent_x);
+    const __m128 extent_y = _mm_load_ps(boxes.extent_y);
+    const __m128 extent_z = _mm_load_ps(boxes.extent_z);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 behind = zero;
+    __m128 crossing = zero;
+    for(int i = 0; i < 6; ++i) {
+        const __m128 distance = _mm_add_ps(
+            _mm_add_ps(
+                _mm_mul_ps(center_x, _mm_set1_ps(planes.normal_x[i])),
+                _mm_mul_ps(center_y, _mm_set1_ps(planes.normal_y[i]))
+            ),
+            _mm_add_ps(
+                _mm_mul_ps(center_z, _mm_set1_ps(planes.normal_z[i])),
+                _mm_set1_ps(planes.distance[i])
+            )
+        );
+        const __m128 radius = _mm_add_ps(
+            _mm_add_ps(
+                _mm_mul_ps(extent_x, _mm_set1_ps(planes.abs_normal_x[i])),
+                _mm_mul_ps(extent_y, _mm_set1_ps(planes.abs_normal_y[i]))
+            ),
+            _mm_mul_ps(extent_z, _mm_set1_ps(planes.abs_normal_z[i]))
+        );
+        behind = _mm_or_ps(behind, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        crossing = _mm_or_ps(crossing, _mm_cmplt_ps(distance, radius));
+    }
+    *outside = _mm_movemask_ps(behind);
+    *inside = ~_mm_movemask_ps(crossing) & 0xf;
+#else
+    *outside = 0;
+    *inside = 0;
+    for(int lane = 0; lane < 4; ++lane) {
+        bool behind = false;
+        bool crossing = false;
+        for(int i = 0; i < 6; ++i) {
+            const float distance = (
+                boxes.center_x[lane] * planes.normal_x[i] +
+                boxes.center_y[lane] * planes.normal_y[i] +
+                boxes.center_z[lane] * planes.normal_z[i] +
+                planes.distance[i]
+            );
+            const float radius = (
+                boxes.extent_x[lane] * planes.abs_normal_x[i] +
+                boxes.extent_y[lane] * planes.abs_normal_y[i] +
+                boxes.extent_z[lane] * planes.abs_normal_z[i]
+            );
+            behind = behind || distance + radius < 0.0f;
+            crossing = crossing || distance < radius;
+        }
+        *outside |= behind ? 1 << lane : 0;
+        *inside |= crossing ? 0 : 1 << lane;
+    }
+#endif
+}
+
+template<typename Fn>
+void LevelCuller::for_each_chunk(Fn&& fn) {
+    const uint32_t cell_count = this->get_cell_count();
+    const uint32_t chunk_size = std::max<uint32_t>(1, this->chunk_cell_count);
+    const uint32_t chunk_count = (cell_count + chunk_size - 1) / chunk_size;
+    this->chunk_rows.resize(chunk_count);
+    this->chunk_stats.resize(chunk_count);
+    this->chunk_stray_counts.resize(chunk_count);
+    // Chunks start at multiples of the chunk size
+    auto run = [&](int begin, int end) {
+        fn((uint32_t) begin, (uint32_t) end, (uint32_t) begin / chunk_size);
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) cell_count, (int) chunk_size, run);
+    }
+    else {
+        for(uint32_t begin = 0; begin < cell_count; begin += chunk_size) {
+            run((int) begin, (int) std::min(cell_count, begin + chunk_size));
+        }
+    }
+}
+
+void LevelCuller::cull(const LevelDocument& document, const Frustum3& frustum) {
+    UNI_PROFILE_ZONE("LevelCuller::cull");
+    if(!this->built || document.structure_revision != this->built_structure_revision) {
+        this->build(document);
+    }
+    else if(document.revision != this->built_revision) {
+        const uint32_t stray_count = this->refit(document);
+        if(stray_count > document.get_count() / LevelCuller_StrayRatio) {
+            this->build(document);
+        }
+    }
+    const LevelCullPlanes planes = LevelCuller_GetPlanes(frustum);
+    const uint32_t* flags = document.flags.data();
+    const float* center_x = document.bounds_center_x.data();
+    const float* center_y = document.bounds_center_y.data();
+    const float* center_z = document.bounds_center_z.data();
+    const float* extent_x = document.bounds_extent_x.data();
+    const float* extent_y = document.bounds_extent_y.data();
+    const float* extent_z = document.bounds_extent_z.data();
+    this->for_each_chunk([&](uint32_t begin, uint32_t end, uint32_t chunk) {
+        std::vector<uint32_t>& rows = this->chunk_rows[chunk];
+        LevelCullStats& stats = this->chunk_stats[chunk];
+        rows.clear();
+        stats = LevelCullStats();
+        auto add_row = [&](uint32_t row) {
+            if(!(flags[row] & LevelEntityFlags_Hidden)) {
+                rows.push_back(row);
+            }
+        };
+        for(uint32_t cell_group = begin; cell_group < end; cell_group += 4) {
+            const uint32_t group_count = std::min<uint32_t>(4, end - cell_group);
+            LevelCullBoxes boxes;
+            for(uint32_t lane = 0; lane < 4; ++lane) {
+                const uint32_t cell = cell_group + std::min(lane, group_count - 1);
+                boxes.center_x[lane] = this->cell_center_x[cell];
+                boxes.center_y[lane] = this->cell_center_y[cell];
+                boxes.center_z[lane] = this->cell_center_z[cell];
+                boxes.extent_x[lane] = this->cell_extent_x[cell];
+                boxes.extent_y[lane] = this->cell_extent_y[cell];
+                boxes.extent_z[lane] = this->cell_extent_z[cell];
+            }
+            int cells_outside = 0;
+            int cells_inside = 0;
+            LevelCuller_TestBoxes(planes, boxes, &cells_outside, &cells_inside);
+            for(uint32_t lane = 0; lane < group_count; ++lane) {
+                const uint32_t cell = cell_group + lane;
+                const uint32_t first = this->cell_starts[cell];
+                const uint32_t count = this->cell_starts[cell + 1] - first;
+                if(count == 0) {
+                    continue;
+                }
+                stats.entity_count += count;
+                stats.cell_count++;
+                if(cells_outside & (1 << lane)) {
+                    continue;
+                }
+                stats.visible_cell_count++;
+                if(cells_inside & (1 << lane)) {
+                    stats.inside_cell_count++;
+                    for(uint32_t i = first; i < first + count; ++i) {
+                        add_row(this->cell_rows[i]);
+                    }
+                    continue;
+                }
+                // The cell crosses the frustum, so test its entities
+                stats.tested_count += count;
+                for(uint32_t k = 0; k < count; k += 4) {
+                    const uint32_t entity_count = std::min<uint32_t>(4, count - k);
+                    for(uint32_t entity_lane = 0; entity_lane < 4; ++entity_lane) {
+                        const uint32_t row = this->cell_rows[
+                            first + k + std::min(entity_lane, entity_count - 1)
+                        ];
+                        boxes.center_x[entity_lane] = center_x[row];
+                        boxes.center_y[entity_lane] = center_y[row];
+                        boxes.center_z[entity_lane] = center_z[row];
+                        boxes.extent_x[entity_lane] = extent_x[row];
+                        boxes.extent_y[entity_lane] = extent_y[row];
+                        boxes.extent_z[entity_lane] = extent_z[row];
+                    }
+                    int entities_outside = 0;
+                    int entities_inside = 0;
+                    LevelCuller_TestBoxes(planes, boxes, &entities_outside, &entities_inside);
+                    for(uint32_t entity_lane = 0; entity_lane < entity_count; ++entity_lane) {
+                        if(!(entities_outside & (1 << entity_lane))) {
+                            add_row(this->cell_rows[first + k + entity_lane]);
+                        }
+                    }
+                }
+            }
+        }
+        stats.visible_count = (uint32_t) rows.size();
+    });
+    // Gather each chunk's rows into one list
+    this->stats = LevelCullStats();
+    for(const auto& chunk_stats : this->chunk_stats) {
+        this->stats.add(chunk_stats);
+    }
+    this->visible_rows.resize(this->stats.visible_count);
+    uint32_t offset = 0;
+    for(const auto& rows : this->chunk_rows) {
+        if(!rows.empty()) {
+            std::memcpy(&this->visible_rows[offset], rows.data(), rows.size() * sizeof(uint32_t));
+            offset += (uint32_t) rows.size();
+        }
+    }
+    UNI_PROFILE_COUNTER("Culling entities", this->stats.entity_count);
+    UNI_PROFILE_COUNTER("Culling entities tested", this->stats.tested_count);
+    UNI_PROFILE_COUNTER("Culling entities visible", this->stats.visible_count);
+    UNI_PROFILE_COUNTER("Culling cells visible", this->stats.visible_cell_count);
+    UNI_PROFILE_COUNTER("Culling cells inside", this->stats.inside_cell_count);
+}
+
+void LevelCuller::clear() {
+    this->built = false;
+    this->cell_starts.clear();
+    this->cell_rows.clear();
+    this->cell_center_x.clear();
+    this->cell_center_y.clear();
+    this->cell_center_z.clear();
+    this->cell_extent_x.clear();
+    this->cell_extent_y.clear();
+    this->cell_extent_z.clear();
+    this->visible_rows.clear();
+    this->stats = LevelCullStats();
+}
+
+void LevelCuller::build(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelCuller::build");
+    const uint32_t count = document.get_count();
+    const float* center_x = document.bounds_center_x.data();
+    const float* center_z = document.bounds_center_z.data();
+    const float* extent_x = document.bounds_extent_x.data();
+    const float* extent_z = document.bounds_extent_z.data();
+    // Fit the grid to the entities' centers, with cells about as
+    // wide as they are deep
+    float min_x = INFINITY;
+    float min_z = INFINITY;
+    float max_x = -INFINITY;
+    float max_z = -INFINITY;
+    for(uint32_t row = 0; row < count; ++row) {
+        min_x = std::min(min_x, center_x[row]);
+        min_z = std::min(min_z, center_z[row]);
+        max_x = std::max(max_x, center_x[row]);
+        max_z = std::max(max_z, center_z[row]);
+    }
+    if(count == 0) {
+        min_x = min_z = max_x = max_z = 0.0f;
+    }
+    const float span_x = std::max(max_x - min_x, 1e-3f);
+    const float span_z = std::max(max_z - min_z, 1e-3f);
+    const float wanted_cells = (float) std::max<uint32_t>(
+        1, count / std::max<uint32_t>(1, this->cell_entity_count)
+    );
+    this->grid_size_x = (uint32_t) std::clamp(
+        std::round(std::sqrt(wanted_cells * span_x / span_z)),
+        1.0f, (float) LevelCuller_MaxGridSize
+    );
+    this->grid_size_z = (uint32_t) std::clamp(
+        std::round(wanted_cells / (float) this->grid_size_x),
+        1.0f, (float) LevelCuller_MaxGridSize
+    );
+    this->origin_x = min_x;
+    this->origin_z = min_z;
+    this->cell_size_x = span_x / (float) this->grid_size_x;
+    this->cell_size_z = span_z / (float) this->grid_size_z;
+    // Sort rows by cell. The last cell holds entities more than
+    // half a cell wide.
+    const uint32_t large_cell = this->grid_size_x * this->grid_size_z;
+    const uint32_t cell_count = large_cell + 1;
+    std::vector<uint32_t> row_cells(count);
+    for(uint32_t row = 0; row < count; ++row) {
+        if(
+            extent_x[row] > 0.5f * this->cell_size_x ||
+            extent_z[row] > 0.5f * this->cell_size_z
+        ) {
+            row_cells[row] = large_cell;
+            continue;
+        }
+        const uint32_t x = (uint32_t) std::clamp(
+            (int) ((center_x[row] - this->origin_x) / this->cell_size_x),
+            0, (int) this->grid_size_x - 1
+        );
+        const uint32_t z = (uint32_t) std::clamp(
+            (int) ((center_z[row] - this->origin_z) / this->cell_size_z),
+            0, (int) this->grid_size_z - 1
+        );
+        row_cells[row] = z * this->grid_size_x + x;
+    }
+    this->cell_starts.assign(cell_count + 1, 0);
+    for(uint32_t row = 0; row < count; ++row) {
+        this->cell_starts[row_cells[row] + 1]++;
+    }
+    for(uint32_t cell = 0; cell < cell_count; ++cell) {
+        this->cell_starts[cell + 1] += this->cell_starts[cell];
+    }
+    std::vector<uint32_t> cell_ends(this->cell_starts.begin(), this->cell_starts.end() - 1);
+    this->cell_rows.resize(count);
+    for(uint32_t row = 0; row < count; ++row) {
+        this->cell_rows[cell_ends[row_cells[row]]++] = row;
+    }
+    this->cell_center_x.resize(cell_count);
+    this->cell_center_y.resize(cell_count);
+    this->cell_center_z.resize(cell_count);
+    this->cell_extent_x.resize(cell_count);
+    this->cell_extent_y.resize(cell_count);
+    this->cell_extent_z.resize(cell_count);
+    this->built = true;
+    this->built_structure_revision = document.structure_revision;
+    this->refit(document);
+    UNI_LOG_TRACE(
+        LogSubsystem_Level, "Built {} by {} culling grid over {} entities, {} of them large.",
+        this->grid_size_x, this->grid_size_z, count,
+        this->cell_starts[cell_count] - this->cell_starts[large_cell]
+    );
+}
+
+uint32_t LevelCuller::refit(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelCuller::refit");
+    const float* center_x = document.bounds_center_x.data();
+    const float* center_y = document.bounds_center_y.data();
+    const float* center_z = document.bounds_center_z.data();
+    const float* extent_x = document.bounds_extent_x.data();
+    const float* extent_y = document.bounds_extent_y.data();
+    const float* extent_z = document.bounds_extent_z.data();
+    const uint32_t large_cell = this->grid_size_x * this->grid_size_z;
+    this->for_each_chunk([&](uint32_t begin, uint32_t end, uint32_t chunk) {
+        uint32_t stray_count = 0;
+        for(uint32_t cell = begin; cell < end; ++cell) {
+            // Entities belong to a cell while their centers are
+            // within half a cell of it, and they are small enough
+            const float x = (float) (cell % this->grid_size_x);
+            const float z = (float) (cell / this->grid_size_x);
+            const float loose_min_x = this->origin_x + (x - 0.5f) * this->cell_size_x;
+            const float loose_min_z = this->origin_z + (z - 0.5f) * this->cell_size_z;
+            const float loose_max_x = loose_min_x + 2.0f * this->cell_size_x;
+            const float loose_max_z = loose_min_z + 2.0f * this->cell_size_z;
+            Bounds3 bounds = Bounds3_Empty;
+            for(uint32_t i = this->cell_starts[cell]; i < this->cell_starts[cell + 1]; ++i) {
+                const uint32_t row = this->cell_rows[i];
+                const Vec3 center = Vec3{center_x[row], center_y[row], center_z[row]};
+                const Vec3 extent = Vec3{extent_x[row], extent_y[row], extent_z[row]};
+                bounds = Bounds3_Union(bounds, Bounds3{center - extent, center + extent});
+                if(cell != large_cell && (
+                    center.x < loose_min_x || center.x > loose_max_x ||
+                    center.z < loose_min_z || center.z > loose_max_z ||
+                    extent.x > 0.5f * this->cell_size_x ||
+                    extent.z > 0.5f * this->cell_size_z
+                )) {
+                    stray_count++;
+                }
+            }
+            if(this->cell_starts[cell] == this->cell_starts[cell + 1]) {
+                // Empty cells are skipped when culling
+                bounds = Bounds3{};
+            }
+            const Vec3 center = bounds.get_center();
+            const Vec3 extent = bounds.get_extent();
+            this->cell_center_x[cell] = center.x;
+            this->cell_center_y[cell] = center.y;
+            this->cell_center_z[cell] = center.z;
+            this->cell_extent_x[cell] = extent.x;
+            this->cell_extent_y[cell] = extent.y;
+            this->cell_extent_z[cell] = extent.z;
+        }
+        this->chunk_stray_counts[chunk] = stray_count;
+    });
+    uint32_t stray_count = 0;
+    for(const uint32_t count : this->chunk_stray_counts) {
+        stray_count += count;
+    }
+    this->built_revision = document.revision;
+    return stray_count;
+}
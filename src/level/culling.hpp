@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+#include "util/math.hpp"
+
+// Counts from the last call to LevelCuller::cull.
+struct LevelCullStats {
+    uint32_t entity_count = 0;
+    // Cells holding any entities
+    uint32_t cell_count = 0;
+    // Cells at least partly inside the frustum
+    uint32_t visible_cell_count = 0;
+    // Cells entirely inside the frustum, whose entities were
+    // accepted without being tested one by one
+    uint32_t inside_cell_count = 0;
+    // Entities tested one by one against the frustum
+    uint32_t tested_count = 0;
+    uint32_t visible_count = 0;
+    
+    void add(const LevelCullStats& other) {
+        this->entity_count += other.entity_count;
+        this->cell_count += other.cell_count;
+        this->visible_cell_count += other.visible_cell_count;
+        this->inside_cell_count += other.inside_cell_count;
+        this->tested_count += other.tested_count;
+        this->visible_count += other.visible_count;
+    }
+};
+
+/**
+ * Finds the entities of a LevelDocument which a camera can see,
+ * so that only those are drawn.
+ * 
+ * Entities are sorted into a loose grid on the XZ plane, by the
+ * centers of their bounds. An entity belongs to the cell holding
+ * its center as long as it is no more than half a cell wide, and
+ * larger entities share one extra cell. Each cell keeps the union
+ * of its entities' bounds, which may reach past the cell itself.
+ * 
+ * Cells are tested against the frustum first, four at a time with
+ * SIMD. Entities in cells entirely inside it are visible without
+ * further tests, and entities in cells crossing its planes are
+ * tested four at a time, reading the document's bounds columns.
+ * Cells are culled in parallel chunks by the job system.
+ * 
+ * The grid is rebuilt when entities are created or destroyed.
+ * When they only move, each cell's bounds are recomputed instead,
+ * until too many entities have strayed from their cells.
+ */
+class LevelCuller {
+public:
+    LevelCuller() {};
+    LevelCuller(JobSystem* jobs): jobs(jobs) {};
+    LevelCuller(const LevelCuller&) = delete;
+    LevelCuller& operator=(const LevelCuller&) = delete;
+    LevelCuller& operator=(LevelCuller&& other) = default;
+    
+    // Culls in parallel if set
+    JobSystem* jobs = nullptr;
+    // Average number of entities wanted in each cell
+    uint32_t cell_entity_count = 256;
+    // Cells culled by each job
+    uint32_t chunk_cell_count = 64;
+    
+    // Find the entities at least partly inside a frustum, first
+    // bringing the grid up to date if the document changed.
+    // Hidden entities are never visible.
+    void cull(const LevelDocument& document, const Frustum3& frustum);
+    // Forget the grid, so that the next call to cull rebuilds it.
+    void clear();
+    // Get the rows of the entities found visible by the last call
+    // to cull, grouped by cell.
+    const std::vector<uint32_t>& get_visible_rows() const {
+        return this->visible_rows;
+    }
+    const LevelCullStats& get_stats() const {
+        return this->stats;
+    }
+    // Get the number of cells in the grid, including the one
+    // holding large entities.
+    uint32_t get_cell_count() const {
+        return (uint32_t) this->cell_center_x.size();
+    }
+    
+private:
+    float origin_x = 0.0f;
+    float origin_z = 0.0f;
+    float cell_size_x = 1.0f;
+    float cell_size_z = 1.0f;
+    uint32_t grid_size_x = 0;
+    uint32_t grid_size_z = 0;
+    // Index in cell_rows of each cell's first row, followed by the
+    // total number of rows
+    std::vector<uint32_t> cell_starts;
+    // Rows of the document, sorted by cell
+    std::vector<uint32_t> cell_rows;
+    // Union of the bounds of each cell's entities, one vector per
+    // component like the document's bounds columns
+    std::vector<float> cell_center_x;
+    std::vector<float> cell_center_y;
+    std::vector<float> cell_center_z;
+    std::vector<float> cell_extent_x;
+    std::vector<float> cell_extent_y;
+    std::vector<float> cell_extent_z;
+    bool built = false;
+    uint64_t built_revision = 0;
+    uint64_t built_structure_revision = 0;
+    // Results of each chunk, reused between calls
+    std::vector<std::vector<uint32_t>> chunk_rows;
+    std::vector<LevelCullStats> chunk_stats;
+    std::vector<uint32_t> chunk_stray_counts;
+    std::vector<uint32_t> visible_rows;
+    LevelCullStats stats;
+    
+    void build(const LevelDocument& document);
+    // Recompute the bounds of every cell. Returns the number of
+    // entities which no longer belong to their cell.
+    uint32_t refit(const LevelDocument& document);
+    // Call fn(begin, end, chunk) for chunks of cells, in parallel
+    // if possible.
+    template<typename Fn>
+    void for_each_chunk(Fn&& fn);
+};
@@ -0,0 +1,440 @@
+#include "document.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "util/profiler.hpp"
+
+const char* const LevelColumnId_Names[] = {
+    "positions",
+    "rotations",
+    "scales",
+    "bounds_center_x",
+    "bounds_center_y",
+    "bounds_center_z",
+    "bounds_extent_x",
+    "bounds_extent_y",
+    "bounds_extent_z",
+    "meshes",
+    "materials",
+    "flags",
+    "row_slots",
+};
+
+const char* LevelColumnId_GetName(LevelColumnId column) {
+    if(column >= LevelColumnId_COUNT) {
+        return "unknown";
+    }
+    return LevelColumnId_Names[column];
+}
+
+bool LevelColumnId_IsDerived(LevelColumnId column) {
+    switch(column) {
+        case LevelColumnId_Positions:
+        case LevelColumnId_Rotations:
+        case LevelColumnId_Scales:
+        case LevelColumnId_Meshes:
+        case LevelColumnId_Materials:
+        case LevelColumnId_Flags:
+            return false;
+        default:
+            return true;
+    }
+}
+
+void LevelDocument::clear() {
+    this->positions.clear();
+    this->rotations.clear();
+    this->scales.clear();
+    this->bounds_center_x.clear();
+    this->bounds_center_y.clear();
+    this->bounds_center_z.clear();
+    this->bounds_extent_x.clear();
+    this->bounds_extent_y.clear();
+    this->bounds_extent_z.clear();
+    this->meshes.clear();
+    this->materials.clear();
+    this->flags.clear();
+    this->row_slots.clear();
+    this->mesh_assets.clear();
+    this->material_assets.clear();
+    this->slots.clear();
+    this->free_slots.clear();
+    // Only once no column is viewing it
+    this->mapped_file.close();
+    this->page_revisions.clear();
+    this->mesh_revisions.clear();
+    this->revision++;
+    this->structure_revision++;
+    this->clear_revision = this->revision;
+}
+
+void LevelDocument::reserve(uint32_t entity_count) {
+    this->positions.reserve(entity_count);
+    this->rotations.reserve(entity_count);
+    this->scales.reserve(entity_count);
+    this->bounds_center_x.reserve(entity_count);
+    this->bounds_center_y.reserve(entity_count);
+    this->bounds_center_z.reserve(entity_count);
+    this->bounds_extent_x.reserve(entity_count);
+    this->bounds_extent_y.reserve(entity_count);
+    this->bounds_extent_z.reserve(entity_count);
+    this->meshes.reserve(entity_count);
+    this->materials.reserve(entity_count);
+    this->flags.reserve(entity_count);
+    this->row_slots.reserve(entity_count);
+    this->slots.reserve(entity_count);
+}
+
+LevelMeshId LevelDocument::add_mesh(LevelMesh mesh) {
+    this->mesh_assets.push_back(std::move(mesh));
+    this->revision++;
+    this->mesh_revisions.resize(this->mesh_assets.size(), 0);
+    this->mesh_revisions.back() = this->revision;
+    return (LevelMeshId) (this->mesh_assets.size() - 1);
+}
+
+LevelMaterialId LevelDocument::add_material(LevelMaterial material) {
+    this->material_assets.push_back(std::move(material));
+    this->revision++;
+    return (LevelMaterialId) (this->material_assets.size() - 1);
+}
+
+const LevelMesh* LevelDocument::get_mesh(LevelMeshId mesh) const {
+    if(mesh >= this->mesh_assets.size()) {
+        return nullptr;
+    }
+    return &this->mesh_assets[mesh];
+}
+
+LevelHandle LevelDocument::create(const LevelEntityDesc& desc) {
+    uint32_t slot_index;
+    if(!this->free_slots.empty()) {
+        slot_index = this->free_slots.back();
+        this->free_slots.pop_back();
+    }
+    else {
+        slot_index = (uint32_t) this->slots.size();
+        this->slots.push_back(LevelHandleSlot{});
+    }
+    this->create_row(slot_index, desc);
+    return LevelHandle{slot_index, this->slots[slot_index].generation};
+}
+
+bool LevelDocument::restore(LevelHandle handle, const LevelEntityDesc& desc) {
+    // Slots past the end may be missing if the document was
+    // cleared since, so add them as free slots
+    while(this->slots.size() <= handle.index) {
+        this->free_slots.push_back((uint32_t) this->slots.size());
+        this->slots.push_back(LevelHandleSlot{});
+    }
+    if(this->slots[handle.index].row != LevelRow_None) {
+        return false;
+    }
+    const auto free_slot = std::find(
+        this->free_slots.begin(), this->free_slots.end(), handle.index
+    );
+    if(free_slot != this->free_slots.end()) {
+        *free_slot = this->free_slots.back();
+        this->free_slots.pop_back();
+    }
+    this->slots[handle.index].generation = handle.generation;
+    this->create_row(handle.index, desc);
+    return true;
+}
+
+void LevelDocument::create_row(uint32_t slot_index, const LevelEntityDesc& desc) {
+    const uint32_t row = this->get_count();
+    this->slots[slot_index].row = row;
+    this->positions.push_back(desc.position);
+    this->rotations.push_back(desc.rotation);
+    this->scales.push_back(desc.scale);
+    this->bounds_center_x.push_back(0.0f);
+    this->bounds_center_y.push_back(0.0f);
+    this->bounds_center_z.push_back(0.0f);
+    this->bounds_extent_x.push_back(0.0f);
+    this->bounds_extent_y.push_back(0.0f);
+    this->bounds_extent_z.push_back(0.0f);
+    this->meshes.push_back(desc.mesh);
+    this->materials.push_back(desc.material);
+    this->flags.push_back(desc.flags);
+    this->row_slots.push_back(slot_index);
+    this->update_bounds(row);
+    this->mark_row_changed(row);
+    this->structure_revision++;
+}
+
+bool LevelDocument::destroy(LevelHandle handle) {
+    const uint32_t row = this->get_row(handle);
+    if(row == LevelRow_None) {
+        return false;
+    }
+    // The last row moves into the destroyed one's place
+    const uint32_t last_row = this->get_count() - 1;
+    this->slots[this->row_slots[last_row]].row = row;
+    this->positions.swap_remove(row);
+    this->rotations.swap_remove(row);
+    this->scales.swap_remove(row);
+    this->bounds_center_x.swap_remove(row);
+    this->bounds_center_y.swap_remove(row);
+    this->bounds_center_z.swap_remove(row);
+    this->bounds_extent_x.swap_remove(row);
+    this->bounds_extent_y.swap_remove(row);
+    this->bounds_extent_z.swap_remove(row);
+    this->meshes.swap_remove(row);
+    this->materials.swap_remove(row);
+    this->flags.swap_remove(row);
+    this->row_slots.swap_remove(row);
+    LevelHandleSlot& slot = this->slots[handle.index];
+    slot.row = LevelRow_None;
+    slot.generation++;
+    this->free_slots.push_back(handle.index);
+    this->mark_row_changed(row);
+    this->mark_row_changed(last_row);
+    this->structure_revision++;
+    return true;
+}
+
+void LevelDocument::mark_row_changed(uint32_t row) {
+    this->revision++;
+    const uint32_t page = row / LevelDocument_PageRows;
+    if(page >= this->page_revisions.size()) {
+        this->page_revisions.resize(page + 1, 0);
+    }
+    this->page_revisions[page] = this->revision;
+}
+
+void LevelDocument::view_slots(LevelHandleSlot* slots, uint32_t count) {
+    this->slots.view(slots, count);
+    this->free_slots.clear();
+}
+
+void LevelDocument::release_mapped_file() {
+    if(!this->mapped_file.is_open()) {
+        return;
+    }
+    UNI_PROFILE_ZONE("LevelDocument::release_mapped_file");
+    for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+        this->visit_column((LevelColumnId) i, [](auto& values) { values.own_values(); });
+    }
+    this->slots.own_values();
+    this->mapped_file.close();
+}
+
+bool LevelDocument::is_valid(LevelHandle handle) const {
+    return this->get_row(handle) != LevelRow_None;
+}
+
+uint32_t LevelDocument::get_row(LevelHandle handle) const {
+    if(handle.index >= this->slots.size()) {
+        return LevelRow_None;
+    }
+    const LevelHandleSlot& slot = this->slots[handle.index];
+    if(slot.generation != handle.generation) {
+        return LevelRow_None;
+    }
+    return slot.row;
+}
+
+LevelHandle LevelDocument::get_handle(uint32_t row) const {
+    if(row >= this->get_count()) {
+        return LevelHandle_None;
+    }
+    const uint32_t slot_index = this->row_slots[row];
+    return LevelHandle{slot_index, this->slots[slot_index].generation};
+}
+
+LevelEntityDesc LevelDocument::get_desc(uint32_t row) const {
+    LevelEntityDesc desc;
+    desc.position = this->positions[row];
+    desc.rotation = this->rotations[row];
+    desc.scale = this->scales[row];
+    desc.mesh = this->meshes[row];
+    desc.material = this->materials[row];
+    desc.flags = this->flags[row];
+    return desc;
+}
+
+void LevelDocument::set_transform(
+    uint32_t row,
+    const Vec3& position,
+    const Quat& rotation,
+    const Vec3& scale
+) {
+    this->positions[row] = position;
+    this->rotations[row] = rotation;
+    this->scales[row] = scale;
+    this->update_bounds(row);
+    this->mark_row_changed(row);
+}
+
+void LevelDocument::set_position(uint32_t row, const Vec3& position) {
+    // Moving doesn't change the shape of the bounds
+    const Vec3 offset = position - this->positions[row];
+    this->positions[row] = position;
+    this->bounds_center_x[row] += offset.x;
+    this->bounds_center_y[row] += offset.y;
+    this->bounds_center_z[row] += offset.z;
+    this->mark_row_changed(row);
+}
+
+void LevelDocument::set_rotation(uint32_t row, const Quat& rotation) {
+    this->rotations[row] = rotation;
+    this->update_bounds(row);
+    this->mark_row_changed(row);
+}
+
+void LevelDocument::set_scale(uint32_t row, const Vec3& scale) {
+    this->scales[row] = scale;
+    this->update_bounds(row);
+    this->mark_row_changed(row);
+}
+
+void LevelDocument::set_mesh(uint32_t row, LevelMeshId mesh) {
+    this->meshes[row] = mesh;
+    this->update_bounds(row);
+    this->mark_row_changed(row);
+}
+
+void LevelDocument::set_material(uint32_t row, LevelMaterialId material) {
+    this->materials[row] = material;
+    this->mark_row_changed(row);
+}
+
+void LevelDocument::set_flags(uint32_t row, uint32_t flags) {
+    this->flags[row] = flags;
+    this->mark_row_changed(row);
+}
+
+uint32_t LevelDocument::get_value_size(LevelColumnId column) const {
+    return this->visit_column(column, [](const auto& values) {
+        return (uint32_t) sizeof(*values.data());
+    });
+}
+
+void LevelDocument::get_value(LevelColumnId column, uint32_t row, void* value) const {
+    this->visit_column(column, [row, value](const auto& values) {
+        std::memcpy(value, &values[row], sizeof(values[row]));
+    });
+}
+
+void LevelDocument::set_value(LevelColumnId column, uint32_t row, const void* value) {
+    assert(!LevelColumnId_IsDerived(column));
+    switch(column) {
+        case LevelColumnId_Positions: {
+            Vec3 position;
+            std::memcpy(&position, value, sizeof(position));
+            this->set_position(row, position);
+            break;
+        }
+        case LevelColumnId_Rotations: {
+            Quat rotation;
+            std::memcpy(&rotation, value, sizeof(rotation));
+            this->set_rotation(row, rotation);
+            break;
+        }
+        case LevelColumnId_Scales: {
+            Vec3 scale;
+            std::memcpy(&scale, value, sizeof(scale));
+            this->set_scale(row, scale);
+            break;
+        }
+        case LevelColumnId_Meshes: {
+            LevelMeshId mesh;
+            std::memcpy(&mesh, value, sizeof(mesh));
+            this->set_mesh(row, mesh);
+            break;
+        }
+        case LevelColumnId_Materials: {
+            LevelMaterialId material;
+            std::memcpy(&material, value, sizeof(material));
+            this->set_material(row, material);
+            break;
+        }
+        case LevelColumnId_Flags: {
+            uint32_t flags;
+            std::memcpy(&flags, value, sizeof(flags));
+            this->set_flags(row, flags);
+            break;
+        }
+        default: break;
+    }
+}
+
+Bounds3 LevelDocument::get_bounds(uint32_t row) const {
+    const Vec3 center = Vec3{
+        this->bounds_center_x[row],
+        this->bounds_center_y[row],
+        this->bounds_center_z[row]
+    };
+    const Vec3 extent = Vec3{
+        this->bounds_extent_x[row],
+        this->bounds_extent_y[row],
+        this->bounds_extent_z[row]
+    };
+    return Bounds3{center - extent, center + extent};
+}
+
+void LevelDocument::update_bounds(uint32_t row) {
+    const LevelMesh* mesh = this->get_mesh(this->meshes[row]);
+    // Entities without a mesh are treated as points
+    const Bounds3 local_bounds = (
+        mesh && !mesh->positions.empty() ? mesh->bounds : Bounds3{}
+    );
+    const Bounds3 bounds = Bounds3_Transform(
+        local_bounds, this->positions[row], this->rotations[row], this->scales[row]
+    );
+    const Vec3 center = bounds.get_center();
+    const Vec3 extent = bounds.get_extent();
+    this->bounds_center_x[row] = center.x;
+    this->bounds_center_y[row] = center.y;
+    this->bounds_center_z[row] = center.z;
+    this->bounds_extent_x[row] = extent.x;
+    this->bounds_extent_y[row] = extent.y;
+    this->bounds_extent_z[row] = extent.z;
+}
+
+size_t LevelDocument::get_memory_bytes() const {
+    size_t bytes = sizeof(LevelDocument) + this->mapped_file.size();
+    for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+        bytes += this->visit_column((LevelColumnId) i, [](const auto& values) -> size_t {
+            return values.get_memory_bytes();
+        });
+    }
+    bytes += this->slots.get_memory_bytes();
+    bytes += sizeof(uint32_t) * this->free_slots.capacity();
+    for(const auto& mesh : this->mesh_assets) {
+        bytes += (
+            sizeof(Vec3) * (mesh.positions.capacity() + mesh.normals.capacity()) +
+            sizeof(Vec2) * mesh.uvs.capacity() +
+            sizeof(uint32_t) * mesh.indices.capacity()
+        );
+    }
+    return bytes;
+}
+
+Bounds3 LevelDocument::get_total_bounds() const {
+    UNI_PROFILE_ZONE("LevelDocument::get_total_bounds");
+    const uint32_t count = this->get_count();
+    if(count == 0) {
+        return Bounds3{};
+    }
+    const float* center_x = this->bounds_center_x.data();
+    const float* center_y = this->bounds_center_y.data();
+    const float* center_z = this->bounds_center_z.data();
+    const float* extent_x = this->bounds_extent_x.data();
+    const float* extent_y = this->bounds_extent_y.data();
+    const float* extent_z = this->bounds_extent_z.data();
+    Bounds3 bounds = Bounds3_Empty;
+    for(uint32_t i = 0; i < count; ++i) {
+        bounds.min.x = std::min(bounds.min.x, center_x[i] - extent_x[i]);
+        bounds.min.y = std::min(bounds.min.y, center_y[i] - extent_y[i]);
+        bounds.min.z = std::min(bounds.min.z, center_z[i] - extent_z[i]);
+        bounds.max.x = std::max(bounds.max.x, center_x[i] + extent_x[i]);
+        bounds.max.y = std::max(bounds.max.y, center_y[i] + extent_y[i]);
+        bounds.max.z = std::max(bounds.max.z, center_z[i] + extent_z[i]);
+    }
+    return bounds;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "column.hpp"
+#include "mesh.hpp"
+#include "util/mapped_file.hpp"
+#include "util/math.hpp"
+
+/**
+ * Identifies an entity in a LevelDocument.
+ * Handles stay safe to use after their entity is destroyed and
+ * its slot reused; they are then simply reported as invalid.
+ */
+struct LevelHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+    
+    bool operator==(const LevelHandle& other) const {
+        return this->index == other.index && this->generation == other.generation;
+    }
+    bool operator!=(const LevelHandle& other) const {
+        return !(*this == other);
+    }
+};
+
+const LevelHandle LevelHandle_None = LevelHandle{};
+
+// Row value for handles which don't refer to a live entity.
+const uint32_t LevelRow_None = UINT32_MAX;
+
+/**
+ * Bit flags stored per entity.
+ */
+enum LevelEntityFlags : uint32_t {
+    LevelEntityFlags_None = 0,
+    // Not drawn in the viewport
+    LevelEntityFlags_Hidden = 1 << 0,
+    // Can't be selected or edited
+    LevelEntityFlags_Locked = 1 << 1,
+};
+
+// Initial values for a new entity.
+struct LevelEntityDesc {
+    Vec3 position;
+    Quat rotation;
+    Vec3 scale = Vec3{1.0f, 1.0f, 1.0f};
+    LevelMeshId mesh = LevelMeshId_None;
+    LevelMaterialId material = LevelMaterialId_None;
+    uint32_t flags = LevelEntityFlags_None;
+};
+
+/**
+ * Identifies each column of a LevelDocument. Values are stored in
+ * level files, so existing ones must not change.
+ */
+enum LevelColumnId : uint32_t {
+    LevelColumnId_Positions = 0,
+    LevelColumnId_Rotations,
+    LevelColumnId_Scales,
+    LevelColumnId_BoundsCenterX,
+    LevelColumnId_BoundsCenterY,
+    LevelColumnId_BoundsCenterZ,
+    LevelColumnId_BoundsExtentX,
+    LevelColumnId_BoundsExtentY,
+    LevelColumnId_BoundsExtentZ,
+    LevelColumnId_Meshes,
+    LevelColumnId_Materials,
+    LevelColumnId_Flags,
+    LevelColumnId_RowSlots,
+    LevelColumnId_COUNT
+};
+
+// Rows in each page whose changes are tracked together.
+const uint32_t LevelDocument_PageRows = 4096;
+
+// Get a readable name for a column, e.g. "positions".
+const char* LevelColumnId_GetName(LevelColumnId column);
+// Returns true for columns which are derived from others, and so
+// can't be set directly.
+bool LevelColumnId_IsDerived(LevelColumnId column);
+
+// Maps a handle's index to the entity's current row.
+struct LevelHandleSlot {
+    uint32_t row = LevelRow_None;
+    uint32_t generation = 0;
+};
+
+/**
+ * The level being edited.
+ * 
+ * Entities are stored as a struct of arrays: each field lives in
+ * its own LevelColumn, and an entity is a row across them. Rows
+ * are kept densely packed by moving the last row into the place
+ * of a destroyed one, so sweeping a column for culling, picking,
+ * or export touches only live entities, in order.
+ * 
+ * Rows move, so code which holds on to an entity keeps a
+ * LevelHandle instead, and looks up the current row with get_row.
+ * World-space bounds are kept up to date by every method which
+ * changes a transform or mesh. All changes to columns go through
+ * LevelDocument methods, so that they can be tracked.
+ */
+class LevelDocument {
+public:
+    LevelDocument() {};
+    LevelDocument(const LevelDocument&) = delete;
+    LevelDocument& operator=(const LevelDocument&) = delete;
+    
+    // Per-entity columns, indexed by row
+    LevelColumn<Vec3> positions;
+    LevelColumn<Quat> rotations;
+    LevelColumn<Vec3> scales;
+    // World-space bounds, one column per component, so that
+    // culling can test several entities at once with SIMD
+    LevelColumn<float> bounds_center_x;
+    LevelColumn<float> bounds_center_y;
+    LevelColumn<float> bounds_center_z;
+    LevelColumn<float> bounds_extent_x;
+    LevelColumn<float> bounds_extent_y;
+    LevelColumn<float> bounds_extent_z;
+    LevelColumn<LevelMeshId> meshes;
+    LevelColumn<LevelMaterialId> materials;
+    LevelColumn<uint32_t> flags;
+    // Index of the handle slot which refers to each row
+    LevelColumn<uint32_t> row_slots;
+    
+    // Shared resources, indexed by id
+    std::vector<LevelMesh> mesh_assets;
+    std::vector<LevelMaterial> material_assets;
+    
+    // Incremented by every change to the document
+    uint64_t revision = 0;
+    // Incremented when entities are created or destroyed, which
+    // also moves rows
+    uint64_t structure_revision = 0;
+    // Revision at which the document was last cleared, as when a
+    // level file is opened. Every page counts as changed then.
+    uint64_t clear_revision = 0;
+    // Level file which columns may be viewing. Kept open until the
+    // document is cleared or another file is opened.
+    MappedFile mapped_file;
+    
+    // Remove every entity and resource.
+    void clear();
+    // Make room for this many entities without reallocating.
+    void reserve(uint32_t entity_count);
+    // Get the number of live entities, which is also the number
+    // of rows in each column.
+    uint32_t get_count() const {
+        return this->positions.size();
+    }
+    
+    LevelMeshId add_mesh(LevelMesh mesh);
+    LevelMaterialId add_material(LevelMaterial material);
+    // Get a mesh by id, or nullptr for LevelMeshId_None.
+    const LevelMesh* get_mesh(LevelMeshId mesh) const;
+    // Get the revision at which a mesh was added, so that copies
+    // made of it, such as on the GPU, can tell when the id came to
+    // refer to another mesh.
+    uint64_t get_mesh_revision(LevelMeshId mesh) const {
+        const uint64_t revision = mesh < this->mesh_revisions.size() ? this->mesh_revisions[mesh] : 0;
+        return std::max(revision, this->clear_revision);
+    }
+    
+    LevelHandle create(const LevelEntityDesc& desc);
+    // Create an entity with a given handle, as when undoing its
+    // destruction. Returns false if the handle's slot is in use.
+    bool restore(LevelHandle handle, const LevelEntityDesc& desc);
+    // Returns false if the handle was already invalid.
+    bool destroy(LevelHandle handle);
+    bool is_valid(LevelHandle handle) const;
+    // Get an entity's current row, or LevelRow_None.
+    uint32_t get_row(LevelHandle handle) const;
+    // Get a handle to the entity in a row.
+    LevelHandle get_handle(uint32_t row) const;
+    // Get the values needed to create a copy of an entity.
+    LevelEntityDesc get_desc(uint32_t row) const;
+    
+    void set_transform(
+        uint32_t row,
+        const Vec3& position,
+        const Quat& rotation,
+        const Vec3& scale
+    );
+    void set_position(uint32_t row, const Vec3& position);
+    void set_rotation(uint32_t row, const Quat& rotation);
+    void set_scale(uint32_t row, const Vec3& scale);
+    void set_mesh(uint32_t row, LevelMeshId mesh);
+    void set_material(uint32_t row, LevelMaterialId material);
+    void set_flags(uint32_t row, uint32_t flags);
+    // Get the size of one value in a column.
+    uint32_t get_value_size(LevelColumnId column) const;
+    // Copy one value out of a column, as bytes.
+    void get_value(LevelColumnId column, uint32_t row, void* value) const;
+    // Set one value in a column from bytes, going through the
+    // typed setter so that bounds are kept up to date. The column
+    // must not be derived.
+    void set_value(LevelColumnId column, uint32_t row, const void* value);
+    Bounds3 get_bounds(uint32_t row) const;
+    // Get the number of pages of LevelDocument_PageRows rows.
+    uint32_t get_page_count() const {
+        return (this->get_count() + LevelDocument_PageRows - 1) / LevelDocument_PageRows;
+    }
+    // Get the revision at which any row of a page last changed, so
+    // that pages changed since an earlier revision can be found.
+    // Rows changed by destroying or creating entities count too.
+    uint64_t get_page_revision(uint32_t page) const {
+        const uint64_t revision = page < this->page_revisions.size() ? this->page_revisions[page] : 0;
+        return std::max(revision, this->clear_revision);
+    }
+    // Recompute world-space bounds from the transform and mesh.
+    void update_bounds(uint32_t row);
+    // Get the memory used by the document, counting the whole of
+    // any mapped file.
+    size_t get_memory_bytes() const;
+    // Get the union of the bounds of every entity.
+    Bounds3 get_total_bounds() const;
+    // Call fn with the column identified by an id, and return
+    // what it returns.
+    template<typename Fn>
+    auto visit_column(LevelColumnId column, Fn&& fn) {
+        switch(column) {
+            case LevelColumnId_Rotations: return fn(this->rotations);
+            case LevelColumnId_Scales: return fn(this->scales);
+            case LevelColumnId_BoundsCenterX: return fn(this->bounds_center_x);
+            case LevelColumnId_BoundsCenterY: return fn(this->bounds_center_y);
+            case LevelColumnId_BoundsCenterZ: return fn(this->bounds_center_z);
+            case LevelColumnId_BoundsExtentX: return fn(this->bounds_extent_x);
+            case LevelColumnId_BoundsExtentY: return fn(this->bounds_extent_y);
+            case LevelColumnId_BoundsExtentZ: return fn(this->bounds_extent_z);
+            case LevelColumnId_Meshes: return fn(this->meshes);
+            case LevelColumnId_Materials: return fn(this->materials);
+            case LevelColumnId_Flags: return fn(this->flags);
+            case LevelColumnId_RowSlots: return fn(this->row_slots);
+            default: return fn(this->positions);
+        }
+    }
+    template<typename Fn>
+    auto visit_column(LevelColumnId column, Fn&& fn) const {
+        return const_cast<LevelDocument*>(this)->visit_column(
+            column, [&fn](const auto& values) { return fn(values); }
+        );
+    }
+    // Use handle slots stored in an opened level file, in which
+    // slot i refers to row i.
+    void view_slots(LevelHandleSlot* slots, uint32_t count);
+    // Copy every column viewing the mapped level file into memory
+    // of its own, and close the file, so that it can be replaced.
+    void release_mapped_file();
+    
+private:
+    // Indexed by LevelHandle::index
+    LevelColumn<LevelHandleSlot> slots;
+    std::vector<uint32_t> free_slots;
+    // Revision of the last change to each page of rows
+    std::vector<uint64_t> page_revisions;
+    // Revision at which each mesh was added, indexed by LevelMeshId
+    std::vector<uint64_t> mesh_revisions;
+    
+    // Count a change to a row, as a new revision.
+    void mark_row_changed(uint32_t row);
+    // Add a row for a new entity, referred to by a free slot.
+    void create_row(uint32_t slot_index, const LevelEntityDesc& desc);
+};
@@ -0,0 +1,228 @@
+#include "exporter.hpp"
+
+#include <cstdio>
+#include <filesystem>
+
+#include "level_file.hpp"
+#include "streaming.hpp"
+#include "util/hash.hpp"
+#include "util/log.hpp"
+#include "util/mapped_file.hpp"
+#include "util/profiler.hpp"
+
+enum LevelExportResult : int {
+    LevelExportResult_Unchanged = 0,
+    LevelExportResult_Written,
+    LevelExportResult_Removed,
+    LevelExportResult_Failed,
+};
+
+// One sector rebuilt by an export.
+struct LevelExportSector {
+    LevelSectorCoord coord;
+    std::string path;
+    // Rows of the document in the sector. Empty if the sector no
+    // longer has any entities, and its file should be removed.
+    std::vector<uint32_t> rows;
+    // Hash of the file's contents as last written, if known
+    bool has_hash = false;
+    uint64_t hash = 0;
+    LevelExportResult result = LevelExportResult_Unchanged;
+};
+
+// Write a file under a temporary name and rename it over the
+// destination, as LevelFile_Save does.
+static bool LevelExporter_WriteFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    const std::string temp_path = path + ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if(!file) {
+        return false;
+    }
+    const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    const bool ok = std::fclose(file) == 0 && written;
+    std::error_code error;
+    if(ok) {
+        std::filesystem::rename(temp_path, path, error);
+    }
+    if(!ok || error) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+// Rebuild one sector, and write or remove its file if its
+// contents changed.
+static void LevelExporter_ExportSector(const LevelDocument& document, LevelExportSector* sector) {
+    UNI_PROFILE_ZONE("LevelExporter_ExportSector");
+    std::error_code error;
+    if(sector->rows.empty()) {
+        const bool removed = std::filesystem::remove(sector->path, error);
+        sector->result = (
+            error ? LevelExportResult_Failed :
+            removed ? LevelExportResult_Removed : LevelExportResult_Unchanged
+        );
+        return;
+    }
+    LevelDocument sector_document;
+    LevelStreamer_BuildSector(
+        document, sector->rows.data(), (uint32_t) sector->rows.size(), &sector_document
+    );
+    std::vector<uint8_t> bytes;
+    LevelFile_Serialize(sector_document, &bytes);
+    const uint64_t hash = hash_bytes(bytes.data(), bytes.size());
+    if(!sector->has_hash) {
+        // Not written this session, so compare with whatever file
+        // is already there
+        MappedFile existing;
+        if(existing.open(sector->path.c_str()) && existing.size() == bytes.size()) {
+            sector->has_hash = true;
+            sector->hash = hash_bytes(existing.data(), existing.size());
+        }
+    }
+    if(sector->has_hash && sector->hash == hash) {
+        sector->result = LevelExportResult_Unchanged;
+        return;
+    }
+    sector->hash = hash;
+    sector->has_hash = true;
+    sector->result = (
+        LevelExporter_WriteFile(sector->path, bytes) ?
+        LevelExportResult_Written : LevelExportResult_Failed
+    );
+}
+
+void LevelExporter::mark_changed(const LevelHandle* handles, uint32_t count) {
+    if(!handles) {
+        this->all_changed = true;
+        this->changed_entities.clear();
+        return;
+    }
+    if(!this->all_changed) {
+        this->changed_entities.insert(this->changed_entities.end(), handles, handles + count);
+    }
+}
+
+bool LevelExporter::has_changes() const {
+    return (
+        this->all_changed ||
+        !this->changed_entities.empty() ||
+        !this->failed_sectors.empty()
+    );
+}
+
+bool LevelExporter::export_changes(const LevelDocument& document) {
+    UNI_PROFILE_ZONE("LevelExporter::export_changes");
+    if(this->directory != this->exported_directory || this->sector_size != this->exported_sector_size) {
+        this->all_changed = true;
+        this->sector_hashes.clear();
+    }
+    if(!this->has_changes()) {
+        return true;
+    }
+    LevelStreamer streamer;
+    streamer.directory = this->directory;
+    streamer.sector_size = this->sector_size;
+    auto get_key = [&](uint32_t row) {
+        return streamer.get_coord(Vec3{
+            document.bounds_center_x[row], 0.0f, document.bounds_center_z[row]
+        }).get_key();
+    };
+    // Find the sectors to rebuild: where changed entities were at
+    // the last export, and where they are now
+    std::unordered_map<uint64_t, LevelExportSector> sectors;
+    for(const uint64_t key : this->failed_sectors) {
+        sectors[key];
+    }
+    for(const LevelHandle handle : this->changed_entities) {
+        if(handle.index < this->entity_exported.size() && this->entity_exported[handle.index]) {
+            sectors[this->entity_sectors[handle.index]];
+            this->entity_exported[handle.index] = 0;
+        }
+        const uint32_t row = document.get_row(handle);
+        if(row != LevelRow_None) {
+            sectors[get_key(row)];
+        }
+    }
+    if(this->all_changed) {
+        std::fill(this->entity_exported.begin(), this->entity_exported.end(), 0);
+    }
+    // Gather the rows of those sectors, and note every entity's
+    // sector for the next export
+    const uint32_t count = document.get_count();
+    for(uint32_t row = 0; row < count; ++row) {
+        const uint64_t key = get_key(row);
+        const uint32_t index = document.get_handle(row).index;
+        if(index >= this->entity_sectors.size()) {
+            this->entity_sectors.resize(index + 1, 0);
+            this->entity_exported.resize(index + 1, 0);
+        }
+        this->entity_sectors[index] = key;
+        this->entity_exported[index] = 1;
+        auto sector = this->all_changed ? sectors.try_emplace(key).first : sectors.find(key);
+        if(sector != sectors.end()) {
+            sector->second.rows.push_back(row);
+        }
+    }
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if(this->all_changed) {
+        // Remove the files of sectors which no longer have entities
+        for(const auto& entry : std::filesystem::directory_iterator(this->directory, error)) {
+            LevelSectorCoord coord;
+            if(LevelStreamer_ParseSectorName(entry.path().filename().string(), &coord)) {
+                sectors[coord.get_key()];
+            }
+        }
+    }
+    std::vector<LevelExportSector*> work;
+    work.reserve(sectors.size());
+    for(auto& [key, sector] : sectors) {
+        sector.coord = LevelSectorCoord{(int32_t) (uint32_t) (key >> 32), (int32_t) (uint32_t) key};
+        sector.path = streamer.get_sector_path(sector.coord);
+        const auto hash = this->sector_hashes.find(key);
+        if(hash != this->sector_hashes.end()) {
+            sector.has_hash = true;
+            sector.hash = hash->second;
+        }
+        work.push_back(&sector);
+    }
+    auto export_sectors = [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            LevelExporter_ExportSector(document, work[i]);
+        }
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) work.size(), 1, export_sectors);
+    }
+    else {
+        export_sectors(0, (int) work.size());
+    }
+    // Remember what is on disk now
+    uint32_t counts[LevelExportResult_Failed + 1] = {};
+    this->failed_sectors.clear();
+    for(auto& [key, sector] : sectors) {
+        counts[sector.result]++;
+        if(sector.result == LevelExportResult_Failed) {
+            this->failed_sectors.insert(key);
+            UNI_LOG_WARN(LogSubsystem_Level, "Failed to export sector file '{}'.", sector.path);
+        }
+        if(sector.result == LevelExportResult_Failed || sector.rows.empty() || !sector.has_hash) {
+            this->sector_hashes.erase(key);
+        }
+        else {
+            this->sector_hashes[key] = sector.hash;
+        }
+    }
+    this->all_changed = false;
+    this->changed_entities.clear();
+    this->exported_directory = this->directory;
+    this->exported_sector_size = this->sector_size;
+    UNI_LOG_INFO(
+        LogSubsystem_Level,
+        "Exported level to '{}': rebuilt {} sectors, wrote {}, removed {}, left {} unchanged.",
+        this->directory, sectors.size(), counts[LevelExportResult_Written],
+        counts[LevelExportResult_Removed], counts[LevelExportResult_Unchanged]
+    );
+    return this->failed_sectors.empty();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+
+/**
+ * Exports a level as a directory of sector files, laid out as
+ * LevelStreamer_SplitDocument does, rewriting only what changed.
+ * 
+ * Entities are marked as changed when the journal reports edits
+ * to them. An export then rebuilds only the sectors those entities
+ * were in at the last export, or are in now, one job per sector.
+ * Each rebuilt sector is serialized in memory and hashed, and its
+ * file is only written when the hash differs from the file's, so
+ * files whose contents come out the same are never touched, and
+ * engines watching the directory reload only what really changed.
+ * 
+ * The first export, and the first after the document is replaced
+ * or the settings change, rebuilds every sector and removes sector
+ * files which no longer have entities. Even then, files which
+ * already hold the right contents are left alone.
+ */
+class LevelExporter {
+public:
+    LevelExporter() {};
+    LevelExporter(JobSystem* jobs): jobs(jobs) {};
+    LevelExporter(const LevelExporter&) = delete;
+    LevelExporter& operator=(const LevelExporter&) = delete;
+    LevelExporter& operator=(LevelExporter&& other) = default;
+    
+    JobSystem* jobs = nullptr;
+    // Directory to write one level file per sector to
+    std::string directory;
+    // Width of each sector, in world units
+    float sector_size = 256.0f;
+    
+    // Note entities which were changed, created or destroyed since
+    // the last export. Null handles mark everything, as when the
+    // journal is cleared. Fits LevelJournalListener.
+    void mark_changed(const LevelHandle* handles, uint32_t count);
+    // Returns true if the next export has anything to rebuild.
+    bool has_changes() const;
+    // Write the sectors which changed since the last export.
+    // Returns false if any file could not be written or removed;
+    // those sectors are tried again by the next export.
+    bool export_changes(const LevelDocument& document);
+    
+private:
+    bool all_changed = true;
+    std::vector<LevelHandle> changed_entities;
+    // Sectors which failed to export, by key
+    std::unordered_set<uint64_t> failed_sectors;
+    // Key of the sector each entity was in at the last export, by
+    // handle index, and whether the entity was exported at all
+    std::vector<uint64_t> entity_sectors;
+    std::vector<uint8_t> entity_exported;
+    // Hash of each sector file's contents, by sector key, as last
+    // written or found on disk
+    std::unordered_map<uint64_t, uint64_t> sector_hashes;
+    // Settings of the last export
+    std::string exported_directory;
+    float exported_sector_size = 0.0f;
+};
@@ -0,0 +1,557 @@
+#include "journal.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+/**
+ * Compressed journal data is split into byte planes, so that byte
+ * b of every value is stored together, and then written as runs of
+ * zero bytes and literal bytes. XOR deltas of small edits are
+ * mostly zero, as are the high bytes of handles and ids, so whole
+ * planes often shrink to a few bytes.
+ * 
+ * Each run starts with a token byte. Tokens below 128 stand for
+ * token + 1 zero bytes. Other tokens are followed by token - 127
+ * literal bytes.
+ */
+static void LevelJournal_Compress(
+    const uint8_t* data,
+    size_t size,
+    uint32_t stride,
+    std::vector<uint8_t>* output
+) {
+    const size_t count = size / stride;
+    std::vector<uint8_t> plane(count);
+    for(uint32_t b = 0; b < stride; ++b) {
+        for(size_t i = 0; i < count; ++i) {
+            plane[i] = data[i * stride + b];
+        }
+        size_t i = 0;
+        while(i < count) {
+            size_t zero_count = 0;
+            while(i + zero_count < count && plane[i + zero_count] == 0 && zero_count < 128) {
+                zero_count++;
+            }
+            if(zero_count > 0) {
+                output->push_back((uint8_t) (zero_count - 1));
+                i += zero_count;
+                continue;
+            }
+            // Single zeros are cheaper to keep within a literal run
+            const size_t literal_start = i;
+            while(i < count && i - literal_start < 128) {
+                if(plane[i] == 0 && i + 1 < count && plane[i + 1] == 0) {
+                    break;
+                }
+                i++;
+            }
+            output->push_back((uint8_t) (127 + (i - literal_start)));
+            output->insert(output->end(), plane.begin() + literal_start, plane.begin() + i);
+        }
+    }
+}
+
+// Reverse LevelJournal_Compress. Returns false if the data is
+// malformed.
+static bool LevelJournal_Decompress(
+    const uint8_t* data,
+    size_t size,
+    uint32_t stride,
+    uint8_t* output,
+    size_t output_size
+) {
+    const size_t count = output_size / stride;
+    size_t read = 0;
+    for(uint32_t b = 0; b < stride; ++b) {
+        size_t i = 0;
+        while(i < count) {
+            if(read >= size) {
+                return false;
+            }
+            const uint8_t token = data[read++];
+            const size_t run = token < 128 ? token + 1 : token - 127;
+            if(i + run > count || (token >= 128 && read + run > size)) {
+                return false;
+            }
+            for(size_t j = 0; j < run; ++j) {
+                output[(i + j) * stride + b] = token < 128 ? 0 : data[read + j];
+            }
+            if(token >= 128) {
+                read += run;
+            }
+            i += run;
+        }
+    }
+    return read == size;
+}
+
+static size_t LevelJournal_GetOpsMemoryBytes(const std::vector<LevelJournalOp>& ops) {
+    size_t bytes = sizeof(ops) + sizeof(LevelJournalOp) * ops.capacity();
+    for(const LevelJournalOp& op : ops) {
+        bytes += sizeof(LevelHandle) * op.handles.capacity();
+        bytes += op.values.capacity();
+        bytes += op.packed.capacity();
+    }
+    return bytes;
+}
+
+void LevelJournal::begin(Symbol name, uint64_t merge_key) {
+    assert(!this->recording);
+    this->recording = true;
+    this->pending_name = name;
+    this->pending_merge_key = merge_key;
+    this->pending_ops.clear();
+    this->pending_open_index = 0;
+    this->pending_recorded.clear();
+}
+
+void LevelJournal::record_values(LevelColumnId column, const LevelHandle* handles, uint32_t count) {
+    assert(this->recording);
+    assert(!LevelColumnId_IsDerived(column));
+    LevelJournalOp op;
+    op.type = LevelJournalOpType_SetValues;
+    op.column = column;
+    op.value_size = this->document->get_value_size(column);
+    op.handles.reserve(count);
+    op.values.reserve((size_t) count * op.value_size);
+    for(uint32_t i = 0; i < count; ++i) {
+        const uint32_t row = this->document->get_row(handles[i]);
+        if(row == LevelRow_None) {
+            continue;
+        }
+        const uint64_t key = ((uint64_t) column << 32) | handles[i].index;
+        if(!this->pending_recorded.insert(key).second) {
+            continue;
+        }
+        const size_t offset = op.values.size();
+        op.values.resize(offset + op.value_size);
+        this->document->get_value(column, row, op.values.data() + offset);
+        op.handles.push_back(handles[i]);
+    }
+    if(op.handles.empty()) {
+        return;
+    }
+    op.count = (uint32_t) op.handles.size();
+    this->pending_ops.push_back(std::move(op));
+}
+
+void LevelJournal::record_create(const LevelHandle* handles, uint32_t count) {
+    assert(this->recording);
+    // Values changed before now were changed before the creation
+    this->flush_pending();
+    LevelJournalOp op;
+    op.type = LevelJournalOpType_Create;
+    op.value_size = sizeof(LevelEntityDesc);
+    for(uint32_t i = 0; i < count; ++i) {
+        const uint32_t row = this->document->get_row(handles[i]);
+        if(row == LevelRow_None) {
+            continue;
+        }
+        const LevelEntityDesc desc = this->document->get_desc(row);
+        const uint8_t* bytes = (const uint8_t*) &desc;
+        op.values.insert(op.values.end(), bytes, bytes + sizeof(desc));
+        op.handles.push_back(handles[i]);
+    }
+    if(op.handles.empty()) {
+        return;
+    }
+    op.count = (uint32_t) op.handles.size();
+    this->pending_ops.push_back(std::move(op));
+    this->pending_open_index = this->pending_ops.size();
+}
+
+void LevelJournal::record_destroy(const LevelHandle* handles, uint32_t count) {
+    assert(this->recording);
+    this->flush_pending();
+    LevelJournalOp op;
+    op.type = LevelJournalOpType_Destroy;
+    op.value_size = sizeof(LevelEntityDesc);
+    for(uint32_t i = 0; i < count; ++i) {
+        const uint32_t row = this->document->get_row(handles[i]);
+        if(row == LevelRow_None) {
+            continue;
+        }
+        const LevelEntityDesc desc = this->document->get_desc(row);
+        const uint8_t* bytes = (const uint8_t*) &desc;
+        op.values.insert(op.values.end(), bytes, bytes + sizeof(desc));
+        op.handles.push_back(handles[i]);
+    }
+    if(op.handles.empty()) {
+        return;
+    }
+    op.count = (uint32_t) op.handles.size();
+    this->pending_ops.push_back(std::move(op));
+    this->pending_open_index = this->pending_ops.size();
+}
+
+void LevelJournal::flush_pending() {
+    for(size_t i = this->pending_open_index; i < this->pending_ops.size(); ++i) {
+        LevelJournalOp& op = this->pending_ops[i];
+        assert(op.type == LevelJournalOpType_SetValues);
+        uint8_t value[sizeof(LevelEntityDesc)];
+        for(uint32_t j = 0; j < op.count; ++j) {
+            uint8_t* delta = op.values.data() + (size_t) j * op.value_size;
+            const uint32_t row = this->document->get_row(op.handles[j]);
+            if(row == LevelRow_None) {
+                // Destroyed without being recorded, so there is
+                // nothing to restore
+                std::memset(delta, 0, op.value_size);
+                continue;
+            }
+            this->document->get_value(op.column, row, value);
+            for(uint32_t k = 0; k < op.value_size; ++k) {
+                delta[k] ^= value[k];
+            }
+        }
+        // Leave out values which didn't change
+        uint32_t kept = 0;
+        for(uint32_t j = 0; j < op.count; ++j) {
+            const uint8_t* delta = op.values.data() + (size_t) j * op.value_size;
+            bool changed = false;
+            for(uint32_t k = 0; k < op.value_size; ++k) {
+                changed |= delta[k] != 0;
+            }
+            if(!changed) {
+                continue;
+            }
+            if(kept != j) {
+                op.handles[kept] = op.handles[j];
+                std::memmove(
+                    op.values.data() + (size_t) kept * op.value_size,
+                    delta,
+                    op.value_size
+                );
+            }
+            kept++;
+        }
+        op.count = kept;
+        op.handles.resize(kept);
+        op.values.resize((size_t) kept * op.value_size);
+    }
+    this->pending_ops.erase(
+        std::remove_if(
+            this->pending_ops.begin() + this->pending_open_index,
+            this->pending_ops.end(),
+            [](const LevelJournalOp& op) { return op.count == 0; }
+        ),
+        this->pending_ops.end()
+    );
+    this->pending_open_index = this->pending_ops.size();
+    this->pending_recorded.clear();
+}
+
+bool LevelJournal::commit() {
+    assert(this->recording);
+    UNI_PROFILE_ZONE("LevelJournal::commit");
+    this->flush_pending();
+    this->recording = false;
+    if(this->pending_ops.empty()) {
+        return false;
+    }
+    for(const auto& op : this->pending_ops) {
+        this->notify(op.handles.data(), op.count);
+    }
+    // New changes replace whatever could have been redone
+    while(this->entries.size() > this->position) {
+        this->memory_bytes -= this->entries.back().memory_bytes;
+        this->entries.pop_back();
+    }
+    if(this->try_merge(this->pending_ops)) {
+        this->pending_ops.clear();
+        return true;
+    }
+    // The previous entry can't be merged into any more
+    if(!this->entries.empty()) {
+        this->start_compress(this->entries.back());
+    }
+    LevelJournalEntry entry;
+    entry.name = this->pending_name;
+    entry.merge_key = this->pending_merge_key;
+    entry.id = this->next_entry_id++;
+    entry.ops = std::make_shared<std::vector<LevelJournalOp>>(std::move(this->pending_ops));
+    entry.memory_bytes = sizeof(LevelJournalEntry) + LevelJournal_GetOpsMemoryBytes(*entry.ops);
+    this->memory_bytes += entry.memory_bytes;
+    this->entries.push_back(std::move(entry));
+    this->position = this->entries.size();
+    this->last_merge_key = this->pending_merge_key;
+    this->pending_ops = std::vector<LevelJournalOp>();
+    this->trim();
+    return true;
+}
+
+void LevelJournal::cancel() {
+    assert(this->recording);
+    this->flush_pending();
+    this->recording = false;
+    LevelJournalEntry entry;
+    entry.name = this->pending_name;
+    entry.ops = std::make_shared<std::vector<LevelJournalOp>>(std::move(this->pending_ops));
+    this->apply(entry, false);
+    this->pending_ops = std::vector<LevelJournalOp>();
+}
+
+bool LevelJournal::try_merge(std::vector<LevelJournalOp>& ops) {
+    if(
+        this->pending_merge_key == 0 ||
+        this->pending_merge_key != this->last_merge_key ||
+        this->entries.empty()
+    ) {
+        return false;
+    }
+    LevelJournalEntry& entry = this->entries.back();
+    if(entry.compressed || entry.compressing || entry.ops->size() != ops.size()) {
+        return false;
+    }
+    // Only merge changes to exactly the same values
+    for(size_t i = 0; i < ops.size(); ++i) {
+        const LevelJournalOp& a = (*entry.ops)[i];
+        const LevelJournalOp& b = ops[i];
+        if(
+            a.type != LevelJournalOpType_SetValues ||
+            b.type != LevelJournalOpType_SetValues ||
+            a.column != b.column ||
+            a.count != b.count ||
+            a.handles != b.handles
+        ) {
+            return false;
+        }
+    }
+    // (old ^ middle) ^ (middle ^ new) gives old ^ new
+    for(size_t i = 0; i < ops.size(); ++i) {
+        LevelJournalOp& op = (*entry.ops)[i];
+        for(size_t j = 0; j < op.values.size(); ++j) {
+            op.values[j] ^= ops[i].values[j];
+        }
+    }
+    return true;
+}
+
+bool LevelJournal::undo() {
+    if(!this->can_undo()) {
+        return false;
+    }
+    UNI_PROFILE_ZONE("LevelJournal::undo");
+    const LevelJournalEntry& entry = this->entries[this->position - 1];
+    this->apply(entry, false);
+    this->position--;
+    this->last_merge_key = 0;
+    UNI_LOG_DEBUG(LogSubsystem_Level, "Undid '{}'.", entry.name.view());
+    return true;
+}
+
+bool LevelJournal::redo() {
+    if(!this->can_redo()) {
+        return false;
+    }
+    UNI_PROFILE_ZONE("LevelJournal::redo");
+    const LevelJournalEntry& entry = this->entries[this->position];
+    this->apply(entry, true);
+    this->position++;
+    this->last_merge_key = 0;
+    UNI_LOG_DEBUG(LogSubsystem_Level, "Redid '{}'.", entry.name.view());
+    return true;
+}
+
+void LevelJournal::apply(const LevelJournalEntry& entry, bool redo) {
+    const std::vector<LevelJournalOp>& ops = *entry.ops;
+    uint32_t failed_count = 0;
+    for(size_t n = 0; n < ops.size(); ++n) {
+        // Undo goes through the ops in reverse
+        const LevelJournalOp* op = &ops[redo ? n : ops.size() - 1 - n];
+        if(entry.compressed) {
+            LevelJournalOp& scratch = this->scratch_op;
+            scratch.handles.resize(op->count);
+            scratch.values.resize((size_t) op->count * op->value_size);
+            const bool ok = LevelJournal_Decompress(
+                op->packed.data(),
+                op->packed_handles_size,
+                sizeof(LevelHandle),
+                (uint8_t*) scratch.handles.data(),
+                sizeof(LevelHandle) * op->count
+            ) && LevelJournal_Decompress(
+                op->packed.data() + op->packed_handles_size,
+                op->packed.size() - op->packed_handles_size,
+                op->value_size,
+                scratch.values.data(),
+                scratch.values.size()
+            );
+            if(!ok) {
+                failed_count += op->count;
+                continue;
+            }
+            scratch.type = op->type;
+            scratch.column = op->column;
+            scratch.value_size = op->value_size;
+            scratch.count = op->count;
+            op = &scratch;
+        }
+        const bool create = (
+            (op->type == LevelJournalOpType_Create && redo) ||
+            (op->type == LevelJournalOpType_Destroy && !redo)
+        );
+        for(uint32_t i = 0; i < op->count; ++i) {
+            // Undo removes the last created entity first
+            const uint32_t j = redo ? i : op->count - 1 - i;
+            const LevelHandle handle = op->handles[j];
+            const uint8_t* value = op->values.data() + (size_t) j * op->value_size;
+            if(op->type != LevelJournalOpType_SetValues) {
+                LevelEntityDesc desc;
+                std::memcpy(&desc, value, sizeof(desc));
+                const bool ok = create ?
+                    this->document->restore(handle, desc) :
+                    this->document->destroy(handle);
+                failed_count += ok ? 0 : 1;
+                continue;
+            }
+            const uint32_t row = this->document->get_row(handle);
+            if(row == LevelRow_None) {
+                failed_count++;
+                continue;
+            }
+            uint8_t current[sizeof(LevelEntityDesc)];
+            this->document->get_value(op->column, row, current);
+            for(uint32_t k = 0; k < op->value_size; ++k) {
+                current[k] ^= value[k];
+            }
+            this->document->set_value(op->column, row, current);
+        }
+        this->notify(op->handles.data(), op->count);
+    }
+    if(failed_count > 0) {
+        UNI_LOG_WARN(
+            LogSubsystem_Level,
+            "Journal entry '{}' no longer matches the level. {} changes were skipped.",
+            entry.name.view(), failed_count
+        );
+    }
+}
+
+void LevelJournal::clear() {
+    for(const JobHandle handle : this->job_handles) {
+        this->jobs->wait(handle);
+    }
+    this->job_handles.clear();
+    this->entries.clear();
+    this->position = 0;
+    this->memory_bytes = 0;
+    this->last_merge_key = 0;
+    this->recording = false;
+    this->pending_ops.clear();
+    this->pending_recorded.clear();
+    this->generation++;
+    this->notify(nullptr, 0);
+}
+
+void LevelJournal::notify(const LevelHandle* handles, uint32_t count) {
+    for(const auto& listener : this->listeners) {
+        listener(handles, count);
+    }
+}
+
+void LevelJournal::trim() {
+    uint32_t dropped_count = 0;
+    while(
+        this->entries.size() > 1 &&
+        (
+            this->entries.size() > this->max_entry_count ||
+            this->memory_bytes > this->memory_limit_bytes
+        )
+    ) {
+        this->memory_bytes -= this->entries.front().memory_bytes;
+        this->entries.pop_front();
+        this->position--;
+        dropped_count++;
+    }
+    if(dropped_count > 0) {
+        UNI_LOG_TRACE(
+            LogSubsystem_Level, "Dropped {} oldest journal entries, keeping {} using {} bytes.",
+            dropped_count, this->entries.size(), this->memory_bytes
+        );
+    }
+}
+
+void LevelJournal::start_compress(LevelJournalEntry& entry) {
+    if(!this->jobs || entry.compressed || entry.compressing) {
+        return;
+    }
+    entry.compressing = true;
+    this->job_handles.erase(
+        std::remove_if(
+            this->job_handles.begin(),
+            this->job_handles.end(),
+            [this](JobHandle handle) { return this->jobs->is_done(handle); }
+        ),
+        this->job_handles.end()
+    );
+    // The job only reads the entry's ops, which don't change once
+    // it can't be merged into, and writes its own result
+    auto source = entry.ops;
+    auto result = std::make_shared<std::vector<LevelJournalOp>>();
+    const uint64_t id = entry.id;
+    const uint32_t generation = this->generation;
+    this->job_handles.push_back(this->jobs->submit(
+        [source, result]() {
+            UNI_PROFILE_ZONE("LevelJournal compress");
+            result->resize(source->size());
+            for(size_t i = 0; i < source->size(); ++i) {
+                const LevelJournalOp& op = (*source)[i];
+                LevelJournalOp& packed = (*result)[i];
+                packed.type = op.type;
+                packed.column = op.column;
+                packed.value_size = op.value_size;
+                packed.count = op.count;
+                LevelJournal_Compress(
+                    (const uint8_t*) op.handles.data(),
+                    sizeof(LevelHandle) * op.handles.size(),
+                    sizeof(LevelHandle),
+                    &packed.packed
+                );
+                packed.packed_handles_size = packed.packed.size();
+                LevelJournal_Compress(
+                    op.values.data(), op.values.size(), op.value_size, &packed.packed
+                );
+                packed.packed.shrink_to_fit();
+            }
+        },
+        {},
+        [this, source, result, id, generation]() {
+            if(generation != this->generation) {
+                return;
+            }
+            // May have been dropped or replaced meanwhile
+            LevelJournalEntry* entry = this->find_entry(id);
+            if(!entry || entry->ops != source) {
+                return;
+            }
+            const size_t raw_bytes = entry->memory_bytes;
+            entry->ops = result;
+            entry->compressed = true;
+            entry->compressing = false;
+            entry->memory_bytes = sizeof(LevelJournalEntry) + LevelJournal_GetOpsMemoryBytes(*result);
+            this->memory_bytes = this->memory_bytes - raw_bytes + entry->memory_bytes;
+            UNI_LOG_TRACE(
+                LogSubsystem_Level, "Compressed journal entry '{}' from {} to {} bytes.",
+                entry->name.view(), raw_bytes, entry->memory_bytes
+            );
+        }
+    ));
+}
+
+LevelJournalEntry* LevelJournal::find_entry(uint64_t id) {
+    // Ids increase from oldest to newest
+    auto entry = std::lower_bound(
+        this->entries.begin(),
+        this->entries.end(),
+        id,
+        [](const LevelJournalEntry& entry, uint64_t id) { return entry.id < id; }
+    );
+    if(entry == this->entries.end() || entry->id != id) {
+        return nullptr;
+    }
+    return &*entry;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+#include "util/symbol.hpp"
+
+enum LevelJournalOpType : uint32_t {
+    // Column values were changed. Holds before ^ after for each
+    // value, so the same bytes both undo and redo the change.
+    LevelJournalOpType_SetValues = 0,
+    // Entities were created. Holds their LevelEntityDesc.
+    LevelJournalOpType_Create,
+    // Entities were destroyed. Holds their LevelEntityDesc.
+    LevelJournalOpType_Destroy,
+};
+
+// One change within a journal entry, to any number of entities.
+struct LevelJournalOp {
+    LevelJournalOpType type = LevelJournalOpType_SetValues;
+    // Only used by LevelJournalOpType_SetValues
+    LevelColumnId column = LevelColumnId_Positions;
+    uint32_t value_size = 0;
+    uint32_t count = 0;
+    // One handle and one value for each entity. Both are empty
+    // once compressed.
+    std::vector<LevelHandle> handles;
+    std::vector<uint8_t> values;
+    // Compressed handles, followed by compressed values
+    std::vector<uint8_t> packed;
+    size_t packed_handles_size = 0;
+};
+
+// One undoable step, made of every change in a transaction.
+struct LevelJournalEntry {
+    Symbol name;
+    uint64_t merge_key = 0;
+    // Identifies the entry to its compression job
+    uint64_t id = 0;
+    // Shared with the job compressing them, which only reads them
+    std::shared_ptr<std::vector<LevelJournalOp>> ops;
+    bool compressed = false;
+    bool compressing = false;
+    size_t memory_bytes = 0;
+};
+
+// Told which entities a transaction changed, created or destroyed,
+// as it is committed, undone or redone, so that other systems can
+// follow edits without scanning the document. Called with no
+// entities when the journal is cleared, since the whole document
+// may then have been replaced.
+typedef std::function<void(const LevelHandle* handles, uint32_t count)> LevelJournalListener;
+
+/**
+ * Undo and redo history for a LevelDocument.
+ * 
+ * Edits are grouped into transactions. Between begin and commit,
+ * callers tell the journal which column values they are about to
+ * change, and which entities they created or are about to destroy.
+ * Only those values are stored, per column, rather than whole
+ * entities or documents. A changed value is stored as the XOR of
+ * its old and new bytes: applying it to the document's current
+ * value gives the other one, so undo and redo share one copy, and
+ * bytes which didn't change are zero.
+ * 
+ * Transactions committed with the same nonzero merge key, one
+ * after another, that change the same values of the same entities
+ * are merged into one entry, so dragging a gizmo for a hundred
+ * frames is a single step. Entries which can no longer be merged
+ * are compressed by a background job, and the oldest entries are
+ * dropped once memory_limit_bytes or max_entry_count is exceeded.
+ */
+class LevelJournal {
+public:
+    LevelJournal() {};
+    LevelJournal(LevelDocument* document, JobSystem* jobs):
+        document(document),
+        jobs(jobs)
+    {};
+    LevelJournal(const LevelJournal&) = delete;
+    LevelJournal& operator=(const LevelJournal&) = delete;
+    LevelJournal& operator=(LevelJournal&& other) = default;
+    
+    LevelDocument* document = nullptr;
+    // Compresses old entries. Entries stay uncompressed if null.
+    JobSystem* jobs = nullptr;
+    // Oldest entries are dropped past either limit. The newest
+    // entry is always kept, however large.
+    size_t memory_limit_bytes = (size_t) 256 << 20;
+    uint32_t max_entry_count = 10000;
+    // Called on the main thread, in the order they were added
+    std::vector<LevelJournalListener> listeners;
+    
+    // Start recording a transaction. Pass the same nonzero merge
+    // key for each transaction of a continuous edit, such as one
+    // gizmo drag, to merge them.
+    void begin(Symbol name, uint64_t merge_key = 0);
+    // Call before changing a column's values for some entities.
+    // Values already recorded in this transaction are skipped.
+    void record_values(LevelColumnId column, const LevelHandle* handles, uint32_t count);
+    void record_values(LevelColumnId column, LevelHandle handle) {
+        this->record_values(column, &handle, 1);
+    }
+    // Call right after creating entities, before changing them.
+    void record_create(const LevelHandle* handles, uint32_t count);
+    void record_create(LevelHandle handle) {
+        this->record_create(&handle, 1);
+    }
+    // Call right before destroying entities.
+    void record_destroy(const LevelHandle* handles, uint32_t count);
+    void record_destroy(LevelHandle handle) {
+        this->record_destroy(&handle, 1);
+    }
+    // Finish the transaction, adding it to the history. Returns
+    // false if nothing changed, in which case nothing is added.
+    bool commit();
+    // Finish the transaction, reverting every change it recorded.
+    void cancel();
+    bool is_recording() const {
+        return this->recording;
+    }
+    
+    // Both return false when there is nothing to undo or redo,
+    // or while a transaction is being recorded.
+    bool undo();
+    bool redo();
+    bool can_undo() const {
+        return !this->recording && this->position > 0;
+    }
+    bool can_redo() const {
+        return !this->recording && this->position < this->entries.size();
+    }
+    // Forget all history, as when the document is replaced.
+    void clear();
+    
+    uint32_t get_entry_count() const {
+        return (uint32_t) this->entries.size();
+    }
+    size_t get_memory_bytes() const {
+        return this->memory_bytes;
+    }
+    
+private:
+    // Oldest first. Entries before position can be undone, and
+    // the rest redone.
+    std::deque<LevelJournalEntry> entries;
+    size_t position = 0;
+    size_t memory_bytes = 0;
+    uint64_t next_entry_id = 1;
+    // Merge key of the newest entry, while it may still be merged
+    // into. Reset by undo and redo.
+    uint64_t last_merge_key = 0;
+    // Incremented by clear, so that callbacks from compression
+    // jobs started before it are ignored.
+    uint32_t generation = 0;
+    std::vector<JobHandle> job_handles;
+    // Transaction being recorded
+    bool recording = false;
+    Symbol pending_name;
+    uint64_t pending_merge_key = 0;
+    std::vector<LevelJournalOp> pending_ops;
+    // Ops from this index on still hold old values rather than
+    // XOR deltas, until flush_pending
+    size_t pending_open_index = 0;
+    // Column and handle index of each value in the open ops
+    std::unordered_set<uint64_t> pending_recorded;
+    // Reused for decompressing ops
+    LevelJournalOp scratch_op;
+    
+    // Turn old values in open ops into XOR deltas, using the
+    // document's current values.
+    void flush_pending();
+    bool try_merge(std::vector<LevelJournalOp>& ops);
+    void apply(const LevelJournalEntry& entry, bool redo);
+    void notify(const LevelHandle* handles, uint32_t count);
+    void trim();
+    void start_compress(LevelJournalEntry& entry);
+    LevelJournalEntry* find_entry(uint64_t id);
+};
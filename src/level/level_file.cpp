@@ -0,0 +1,466 @@
+#include "level_file.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+static_assert(std::is_trivially_copyable<LevelHandleSlot>::value);
+
+static uint64_t LevelFile_Align(uint64_t offset) {
+    return (offset + LevelFile_Alignment - 1) & ~(uint64_t) (LevelFile_Alignment - 1);
+}
+
+// Returns true if [offset, offset + size) lies within the file
+// and offset is suitably aligned.
+static bool LevelFile_IsInFile(uint64_t offset, uint64_t size, uint64_t file_size) {
+    return (
+        offset % LevelFile_Alignment == 0 &&
+        offset <= file_size && size <= file_size - offset
+    );
+}
+
+// Returns true if every value is less than limit.
+static bool LevelFile_AreAllBelow(const uint32_t* values, uint64_t count, uint64_t limit) {
+    uint32_t max = 0;
+    for(uint64_t i = 0; i < count; ++i) {
+        max = std::max(max, values[i]);
+    }
+    return count == 0 || max < limit;
+}
+
+// Sequential writer which keeps track of the file offset, so that
+// sections can be padded to their planned offsets. Writes to a
+// file if one is set, and otherwise appends to bytes.
+struct LevelFileWriter {
+    std::FILE* file = nullptr;
+    std::vector<uint8_t>* bytes = nullptr;
+    uint64_t offset = 0;
+
+    void write(const void* data, uint64_t size) {
+        if(size == 0) {
+            return;
+        }
+        if(this->file) {
+            std::fwrite(data, 1, (size_t) size, this->file);
+        }
+        else {
+            this->bytes->insert(this->bytes->end(), (const uint8_t*) data, (const uint8_t*) data + size);
+        }
+        this->offset += size;
+    }
+    void pad_to(uint64_t target) {
+        static const uint8_t zeros[LevelFile_Alignment] = {};
+        while(this->offset < target) {
+            this->write(zeros, std::min<uint64_t>(target - this->offset, sizeof(zeros)));
+        }
+    }
+};
+
+// Lay out a document as a level file, with room for capacity
+// entities, and write it. Fills in layout if given.
+static void LevelFile_Write(
+    const LevelDocument& document,
+    uint32_t capacity,
+    LevelFileWriter* writer,
+    LevelFileLayout* layout
+) {
+    const uint32_t entity_count = document.get_count();
+    assert(capacity >= entity_count);
+    LevelFileHeader header = {};
+    std::memcpy(header.magic, LevelFile_Magic, sizeof(header.magic));
+    header.version = LevelFile_Version;
+    header.byte_order = LevelFile_ByteOrderMark;
+    header.header_size = sizeof(LevelFileHeader);
+    header.column_count = LevelColumnId_COUNT;
+    header.entity_count = entity_count;
+    header.mesh_count = (uint32_t) document.mesh_assets.size();
+    header.material_count = (uint32_t) document.material_assets.size();
+    // Plan where every section goes before writing anything
+    uint64_t offset = LevelFile_Align(sizeof(LevelFileHeader));
+    header.columns_offset = offset;
+    offset = LevelFile_Align(offset + sizeof(LevelFileColumn) * header.column_count);
+    header.meshes_offset = offset;
+    offset = LevelFile_Align(offset + sizeof(LevelFileMesh) * header.mesh_count);
+    header.materials_offset = offset;
+    offset = LevelFile_Align(offset + sizeof(LevelFileMaterial) * header.material_count);
+    std::string strings;
+    std::vector<LevelFileMesh> meshes;
+    std::vector<LevelFileMaterial> materials;
+    for(const auto& mesh : document.mesh_assets) {
+        LevelFileMesh entry = {};
+        entry.name_offset = (uint32_t) strings.size();
+        entry.name_length = (uint32_t) mesh.name.size();
+        strings.append(mesh.name.view());
+        entry.vertex_count = (uint32_t) mesh.positions.size();
+        entry.normal_count = (
+            mesh.normals.size() == mesh.positions.size() ? entry.vertex_count : 0
+        );
+        entry.uv_count = mesh.uvs.size() == mesh.positions.size() ? entry.vertex_count : 0;
+        entry.index_count = (uint32_t) mesh.indices.size();
+        entry.bounds = mesh.bounds;
+        meshes.push_back(entry);
+    }
+    for(const auto& material : document.material_assets) {
+        LevelFileMaterial entry = {};
+        entry.name_offset = (uint32_t) strings.size();
+        entry.name_length = (uint32_t) material.name.size();
+        strings.append(material.name.view());
+        std::memcpy(entry.color, material.color, sizeof(entry.color));
+        materials.push_back(entry);
+    }
+    header.strings_offset = offset;
+    header.strings_size = strings.size();
+    offset = LevelFile_Align(offset + strings.size());
+    for(auto& entry : meshes) {
+        entry.positions_offset = offset;
+        offset = LevelFile_Align(offset + sizeof(Vec3) * entry.vertex_count);
+        entry.normals_offset = offset;
+        offset = LevelFile_Align(offset + sizeof(Vec3) * entry.normal_count);
+        entry.uvs_offset = offset;
+        offset = LevelFile_Align(offset + sizeof(Vec2) * entry.uv_count);
+        entry.indices_offset = offset;
+        offset = LevelFile_Align(offset + sizeof(uint32_t) * entry.index_count);
+    }
+    header.slots_offset = offset;
+    offset = LevelFile_Align(offset + sizeof(LevelHandleSlot) * (uint64_t) capacity);
+    LevelFileColumn columns[LevelColumnId_COUNT];
+    for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+        const uint32_t value_size = document.visit_column(
+            (LevelColumnId) i,
+            [](const auto& values) -> uint32_t { return sizeof(values[0]); }
+        );
+        columns[i] = LevelFileColumn{i, value_size, offset};
+        offset = LevelFile_Align(offset + (uint64_t) value_size * capacity);
+    }
+    header.file_size = offset;
+    if(layout) {
+        layout->header = header;
+        std::memcpy(layout->columns, columns, sizeof(columns));
+        layout->capacity = capacity;
+    }
+    if(writer->bytes) {
+        writer->bytes->reserve(writer->bytes->size() + header.file_size);
+    }
+    // Write sections in the planned order
+    writer->write(&header, sizeof(header));
+    writer->pad_to(header.columns_offset);
+    writer->write(columns, sizeof(columns));
+    writer->pad_to(header.meshes_offset);
+    writer->write(meshes.data(), sizeof(LevelFileMesh) * meshes.size());
+    writer->pad_to(header.materials_offset);
+    writer->write(materials.data(), sizeof(LevelFileMaterial) * materials.size());
+    writer->pad_to(header.strings_offset);
+    writer->write(strings.data(), strings.size());
+    for(size_t i = 0; i < meshes.size(); ++i) {
+        const auto& mesh = document.mesh_assets[i];
+        const auto& entry = meshes[i];
+        writer->pad_to(entry.positions_offset);
+        writer->write(mesh.positions.data(), sizeof(Vec3) * entry.vertex_count);
+        writer->pad_to(entry.normals_offset);
+        writer->write(mesh.normals.data(), sizeof(Vec3) * entry.normal_count);
+        writer->pad_to(entry.uvs_offset);
+        writer->write(mesh.uvs.data(), sizeof(Vec2) * entry.uv_count);
+        writer->pad_to(entry.indices_offset);
+        writer->write(mesh.indices.data(), sizeof(uint32_t) * entry.index_count);
+    }
+    // Handles aren't kept between sessions, so rows are written
+    // with fresh slots which simply refer to themselves. Rows of
+    // room get them too, so that they need no writing when filled.
+    const uint32_t batch_size = 4096;
+    std::vector<LevelHandleSlot> slot_batch(batch_size);
+    std::vector<uint32_t> row_batch(batch_size);
+    writer->pad_to(header.slots_offset);
+    for(uint32_t begin = 0; begin < capacity; begin += batch_size) {
+        const uint32_t end = std::min(capacity, begin + batch_size);
+        for(uint32_t i = begin; i < end; ++i) {
+            slot_batch[i - begin] = LevelHandleSlot{i, 0};
+        }
+        writer->write(slot_batch.data(), sizeof(LevelHandleSlot) * (end - begin));
+    }
+    for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+        writer->pad_to(columns[i].offset);
+        if(i == LevelColumnId_RowSlots) {
+            for(uint32_t begin = 0; begin < capacity; begin += batch_size) {
+                const uint32_t end = std::min(capacity, begin + batch_size);
+                for(uint32_t j = begin; j < end; ++j) {
+                    row_batch[j - begin] = j;
+                }
+                writer->write(row_batch.data(), sizeof(uint32_t) * (end - begin));
+            }
+            continue;
+        }
+        document.visit_column((LevelColumnId) i, [&](const auto& values) {
+            writer->write(values.data(), sizeof(values[0]) * (uint64_t) entity_count);
+        });
+    }
+    writer->pad_to(header.file_size);
+}
+
+// Write a level file under a temporary name, then rename it over
+// the destination.
+static bool LevelFile_WriteFile(
+    const LevelDocument& document,
+    const char* path,
+    uint32_t capacity,
+    LevelFileLayout* layout
+) {
+    std::error_code error;
+    const auto parent = std::filesystem::path(path).parent_path();
+    if(!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+    }
+    const std::string temp_path = std::string(path) + ".tmp";
+    LevelFileWriter writer;
+    writer.file = std::fopen(temp_path.c_str(), "wb");
+    if(!writer.file) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Failed to open level file '{}' for writing.", temp_path);
+        return false;
+    }
+    LevelFile_Write(document, capacity, &writer, layout);
+    const bool ok = std::ferror(writer.file) == 0;
+    std::fclose(writer.file);
+    if(ok) {
+        std::filesystem::rename(temp_path, path, error);
+    }
+    if(!ok || error) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Failed to write level file '{}'.", path);
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+bool LevelFile_Save(const LevelDocument& document, const char* path) {
+    UNI_PROFILE_ZONE("LevelFile_Save");
+    if(!LevelFile_WriteFile(document, path, document.get_count(), nullptr)) {
+        return false;
+    }
+    UNI_LOG_INFO(
+        LogSubsystem_Level, "Saved {} entities to level file '{}'.", document.get_count(), path
+    );
+    return true;
+}
+
+bool LevelFile_SaveOver(LevelDocument* document, const char* path) {
+#if defined(PLATFORM_WINDOWS)
+    document->release_mapped_file();
+#endif
+    return LevelFile_Save(*document, path);
+}
+
+bool LevelFile_SaveWithRoom(
+    const LevelDocument& document,
+    const char* path,
+    uint32_t capacity,
+    LevelFileLayout* layout
+) {
+    UNI_PROFILE_ZONE("LevelFile_SaveWithRoom");
+    return LevelFile_WriteFile(document, path, capacity, layout);
+}
+
+bool LevelFile_WriteRows(
+    const LevelDocument& document,
+    const char* path,
+    LevelFileLayout* layout,
+    const LevelFileRowRange* ranges,
+    uint32_t range_count
+) {
+    UNI_PROFILE_ZONE("LevelFile_WriteRows");
+    const uint32_t entity_count = document.get_count();
+    assert(entity_count <= layout->capacity);
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    if(!file) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Failed to open level file '{}' for writing.", path);
+        return false;
+    }
+    for(uint32_t i = 0; i < LevelColumnId_COUNT; ++i) {
+        // Row slots were written for every row of room already
+        if(i == LevelColumnId_RowSlots) {
+            continue;
+        }
+        document.visit_column((LevelColumnId) i, [&](const auto& values) {
+            const uint64_t value_size = sizeof(values[0]);
+            for(uint32_t j = 0; j < range_count; ++j) {
+                const uint32_t first = ranges[j].first;
+                const uint32_t end = std::min(entity_count, first + ranges[j].count);
+                if(first >= end) {
+                    continue;
+                }
+                file.seekp((std::streamoff) (layout->columns[i].offset + value_size * first));
+                file.write((const char*) (values.data() + first), (std::streamsize) (value_size * (end - first)));
+            }
+        });
+    }
+    // The count goes last, so rows past the old count are in place
+    // before the file claims them
+    layout->header.entity_count = entity_count;
+    file.seekp(0);
+    file.write((const char*) &layout->header, sizeof(layout->header));
+    file.flush();
+    if(!file) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Failed to write level file '{}'.", path);
+        return false;
+    }
+    return true;
+}
+
+void LevelFile_Serialize(const LevelDocument& document, std::vector<uint8_t>* bytes) {
+    UNI_PROFILE_ZONE("LevelFile_Serialize");
+    bytes->clear();
+    LevelFileWriter writer;
+    writer.bytes = bytes;
+    LevelFile_Write(document, document.get_count(), &writer, nullptr);
+}
+
+bool LevelFile_Open(LevelDocument* document, const char* path) {
+    UNI_PROFILE_ZONE("LevelFile_Open");
+    document->clear();
+    MappedFile file;
+    if(!file.open(path, MappedFileMode_CopyOnWrite)) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Failed to open level file '{}'.", path);
+        return false;
+    }
+    uint8_t* data = file.data_mutable();
+    const uint64_t size = file.size();
+    if(size < sizeof(LevelFileHeader)) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Level file '{}' is truncated.", path);
+        return false;
+    }
+    LevelFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, LevelFile_Magic, sizeof(header.magic)) != 0) {
+        UNI_LOG_WARN(LogSubsystem_Level, "'{}' is not a level file.", path);
+        return false;
+    }
+    if(header.version != LevelFile_Version ||
+        header.byte_order != LevelFile_ByteOrderMark ||
+        header.header_size != sizeof(LevelFileHeader)
+    ) {
+        UNI_LOG_WARN(
+            LogSubsystem_Level, "Level file '{}' has an unsupported format, version {}.",
+            path, header.version
+        );
+        return false;
+    }
+    // Validate every section before using any of them
+    const uint64_t entity_count = header.entity_count;
+    bool valid = (
+        header.file_size == size &&
+        header.column_count == LevelColumnId_COUNT &&
+        LevelFile_IsInFile(header.columns_offset, sizeof(LevelFileColumn) * (uint64_t) header.column_count, size) &&
+        LevelFile_IsInFile(header.meshes_offset, sizeof(LevelFileMesh) * (uint64_t) header.mesh_count, size) &&
+        LevelFile_IsInFile(header.materials_offset, sizeof(LevelFileMaterial) * (uint64_t) header.material_count, size) &&
+        LevelFile_IsInFile(header.strings_offset, header.strings_size, size) &&
+        LevelFile_IsInFile(header.slots_offset, sizeof(LevelHandleSlot) * entity_count, size)
+    );
+    const LevelFileColumn* columns = (const LevelFileColumn*) (data + header.columns_offset);
+    const LevelFileMesh* meshes = (const LevelFileMesh*) (data + header.meshes_offset);
+    const LevelFileMaterial* materials = (const LevelFileMaterial*) (data + header.materials_offset);
+    for(uint32_t i = 0; valid && i < header.column_count; ++i) {
+        const LevelFileColumn& column = columns[i];
+        if(column.id != i) {
+            valid = false;
+            break;
+        }
+        const uint32_t value_size = document->visit_column(
+            (LevelColumnId) i,
+            [](auto& values) -> uint32_t { return sizeof(values[0]); }
+        );
+        valid = (
+            column.value_size == value_size &&
+            LevelFile_IsInFile(column.offset, (uint64_t) value_size * entity_count, size)
+        );
+    }
+    for(uint32_t i = 0; valid && i < header.mesh_count; ++i) {
+        const LevelFileMesh& mesh = meshes[i];
+        valid = (
+            (uint64_t) mesh.name_offset + mesh.name_length <= header.strings_size &&
+            (mesh.normal_count == 0 || mesh.normal_count == mesh.vertex_count) &&
+            (mesh.uv_count == 0 || mesh.uv_count == mesh.vertex_count) &&
+            LevelFile_IsInFile(mesh.positions_offset, sizeof(Vec3) * (uint64_t) mesh.vertex_count, size) &&
+            LevelFile_IsInFile(mesh.normals_offset, sizeof(Vec3) * (uint64_t) mesh.normal_count, size) &&
+            LevelFile_IsInFile(mesh.uvs_offset, sizeof(Vec2) * (uint64_t) mesh.uv_count, size) &&
+            LevelFile_IsInFile(mesh.indices_offset, sizeof(uint32_t) * (uint64_t) mesh.index_count, size)
+        );
+    }
+    for(uint32_t i = 0; valid && i < header.material_count; ++i) {
+        const LevelFileMaterial& material = materials[i];
+        valid = (uint64_t) material.name_offset + material.name_length <= header.strings_size;
+    }
+    // Rows, slots, and vertexes referred to must exist, since they
+    // are used as indexes without checking
+    for(uint32_t i = 0; valid && i < header.mesh_count; ++i) {
+        const LevelFileMesh& mesh = meshes[i];
+        valid = LevelFile_AreAllBelow(
+            (const uint32_t*) (data + mesh.indices_offset), mesh.index_count, mesh.vertex_count
+        );
+    }
+    if(valid) {
+        const uint32_t* row_slots = (const uint32_t*) (data + columns[LevelColumnId_RowSlots].offset);
+        const LevelHandleSlot* slots = (const LevelHandleSlot*) (data + header.slots_offset);
+        uint32_t max_row = 0;
+        for(uint64_t i = 0; i < entity_count; ++i) {
+            max_row = std::max(max_row, slots[i].row);
+        }
+        valid = (
+            LevelFile_AreAllBelow(row_slots, entity_count, entity_count) &&
+            (entity_count == 0 || max_row < entity_count)
+        );
+    }
+    if(!valid) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Level file '{}' is invalid.", path);
+        return false;
+    }
+    // Meshes and materials are few next to entities, and are
+    // copied out so that they can be edited freely.
+    const char* strings = (const char*) (data + header.strings_offset);
+    for(uint32_t i = 0; i < header.mesh_count; ++i) {
+        const LevelFileMesh& entry = meshes[i];
+        LevelMesh mesh;
+        mesh.name = Symbol(std::string_view(strings + entry.name_offset, entry.name_length));
+        const Vec3* positions = (const Vec3*) (data + entry.positions_offset);
+        const Vec3* normals = (const Vec3*) (data + entry.normals_offset);
+        const Vec2* uvs = (const Vec2*) (data + entry.uvs_offset);
+        const uint32_t* indices = (const uint32_t*) (data + entry.indices_offset);
+        mesh.positions.assign(positions, positions + entry.vertex_count);
+        mesh.normals.assign(normals, normals + entry.normal_count);
+        mesh.uvs.assign(uvs, uvs + entry.uv_count);
+        mesh.indices.assign(indices, indices + entry.index_count);
+        mesh.bounds = entry.bounds;
+        document->add_mesh(std::move(mesh));
+    }
+    for(uint32_t i = 0; i < header.material_count; ++i) {
+        const LevelFileMaterial& entry = materials[i];
+        LevelMaterial material;
+        material.name = Symbol(std::string_view(strings + entry.name_offset, entry.name_length));
+        std::memcpy(material.color, entry.color, sizeof(material.color));
+        document->material_assets.push_back(material);
+    }
+    // Entity data is used in place
+    for(uint32_t i = 0; i < header.column_count; ++i) {
+        document->visit_column((LevelColumnId) i, [&](auto& values) {
+            typedef std::remove_reference_t<decltype(values[0])> Value;
+            values.view((Value*) (data + columns[i].offset), header.entity_count);
+        });
+    }
+    document->view_slots(
+        (LevelHandleSlot*) (data + header.slots_offset), header.entity_count
+    );
+    document->mapped_file = std::move(file);
+    document->revision++;
+    document->structure_revision++;
+    UNI_LOG_INFO(
+        LogSubsystem_Level, "Opened level file '{}' with {} entities.",
+        path, header.entity_count
+    );
+    return true;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "document.hpp"
+
+/**
+ * Native binary level format.
+ * 
+ * The file is laid out so that each column's bytes on disk are
+ * exactly its bytes in memory. Opening a level maps the file with
+ * copy-on-write pages, checks the header and section table, and
+ * points the document's columns at the mapped data. No entity is
+ * read or converted; the OS faults pages in as they are touched,
+ * and copies a page privately the first time it is edited.
+ * 
+ * Layout, with every offset relative to the start of the file and
+ * every section aligned to LevelFile_Alignment:
+ * - LevelFileHeader
+ * - LevelFileColumn table, one entry per stored column
+ * - LevelFileMesh table, then LevelFileMaterial table
+ * - Name strings
+ * - Mesh vertex and index data
+ * - Handle slots, then column data
+ */
+
+// Increment when the file layout changes.
+const uint32_t LevelFile_Version = 1;
+const char LevelFile_Magic[8] = {'U', 'N', 'I', 'L', 'E', 'V', 'E', 'L'};
+// Written as a number, to detect files from a machine with
+// different byte order.
+const uint32_t LevelFile_ByteOrderMark = 0x01020304;
+// Alignment of every section, in bytes. At least the alignment
+// of LevelColumn storage, so mapped columns can be used directly.
+const uint32_t LevelFile_Alignment = LevelColumn_Alignment;
+// Conventional extension for level files.
+const char* const LevelFile_Extension = ".unilevel";
+
+struct LevelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t column_count;
+    uint32_t entity_count;
+    uint32_t mesh_count;
+    uint32_t material_count;
+    uint32_t reserved;
+    // Expected size of the whole file, to detect truncation
+    uint64_t file_size;
+    uint64_t columns_offset;
+    uint64_t meshes_offset;
+    uint64_t materials_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    // LevelHandleSlot for each entity, where slot i refers to row i
+    uint64_t slots_offset;
+};
+
+struct LevelFileColumn {
+    // LevelColumnId
+    uint32_t id;
+    // Size of one value, checked against the column's type
+    uint32_t value_size;
+    // Holds LevelFileHeader::entity_count values
+    uint64_t offset;
+};
+
+struct LevelFileMesh {
+    // Name, as an offset into the strings section
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t vertex_count;
+    // Either zero or vertex_count
+    uint32_t normal_count;
+    uint32_t uv_count;
+    uint32_t index_count;
+    Bounds3 bounds;
+    uint64_t positions_offset;
+    uint64_t normals_offset;
+    uint64_t uvs_offset;
+    uint64_t indices_offset;
+};
+
+struct LevelFileMaterial {
+    uint32_t name_offset;
+    uint32_t name_length;
+    float color[4];
+};
+
+// Where the sections of a level file were written, for updating
+// its rows in place.
+struct LevelFileLayout {
+    LevelFileHeader header = {};
+    LevelFileColumn columns[LevelColumnId_COUNT] = {};
+    // Rows of room in each column
+    uint32_t capacity = 0;
+};
+
+// Rows of a document to write with LevelFile_WriteRows.
+struct LevelFileRowRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+/**
+ * Write a document to a level file. The file is written under a
+ * temporary name and then renamed over the destination, so a
+ * failed save never leaves a partial file behind.
+ * Returns false if the file could not be written.
+ */
+bool LevelFile_Save(const LevelDocument& document, const char* path);
+
+/**
+ * Write a document to a level file like LevelFile_Save, where the
+ * document may be viewing that very file. Windows refuses to
+ * replace a file while it is mapped, so there the document's
+ * columns are copied out of its mapped file first. Elsewhere the
+ * document keeps viewing the replaced file, which stays readable
+ * until unmapped.
+ */
+bool LevelFile_SaveOver(LevelDocument* document, const char* path);
+
+/**
+ * Write a document as a level file into memory, with the same
+ * bytes LevelFile_Save would write. The same document always gives
+ * the same bytes, so they can be hashed to tell whether a file on
+ * disk needs writing again.
+ */
+void LevelFile_Serialize(const LevelDocument& document, std::vector<uint8_t>* bytes);
+
+/**
+ * Write a document to a level file like LevelFile_Save, but with
+ * room in the slots and every column for capacity entities, which
+ * must be at least the document's count. Such a file opens like
+ * any other. Its rows can then be rewritten in place with
+ * LevelFile_WriteRows, without moving anything else.
+ * Returns false if the file could not be written.
+ */
+bool LevelFile_SaveWithRoom(
+    const LevelDocument& document,
+    const char* path,
+    uint32_t capacity,
+    LevelFileLayout* layout
+);
+
+/**
+ * Rewrite ranges of rows of a file written by
+ * LevelFile_SaveWithRoom in place, along with its entity count.
+ * The document must have the same meshes and materials as when the
+ * file was written, and no more entities than the layout's
+ * capacity. Rows outside the ranges keep what the file held.
+ * 
+ * Failing part way leaves a file which still opens, but with some
+ * rows from before and some from after, so callers should write
+ * the whole file again with LevelFile_SaveWithRoom.
+ * Returns false if the file could not be written.
+ */
+bool LevelFile_WriteRows(
+    const LevelDocument& document,
+    const char* path,
+    LevelFileLayout* layout,
+    const LevelFileRowRange* ranges,
+    uint32_t range_count
+);
+
+/**
+ * Replace a document's contents with a level file's. Columns view
+ * the mapped file until they grow. Returns false, leaving the
+ * document empty, if the file is missing or invalid.
+ */
+bool LevelFile_Open(LevelDocument* document, const char* path);
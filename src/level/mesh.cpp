@@ -0,0 +1,42 @@
+#include "mesh.hpp"
+
+void LevelMesh::update_bounds() {
+    this->bounds = Bounds3_Empty;
+    for(const auto& position : this->positions) {
+        this->bounds = Bounds3_Grow(this->bounds, position);
+    }
+}
+
+LevelMesh LevelMesh_CreateCube(Symbol name) {
+    LevelMesh mesh;
+    mesh.name = name;
+    // Four vertices per face so that each face has its own normal
+    const Vec3 normals[6] = {
+        Vec3{1.0f, 0.0f, 0.0f}, Vec3{-1.0f, 0.0f, 0.0f},
+        Vec3{0.0f, 1.0f, 0.0f}, Vec3{0.0f, -1.0f, 0.0f},
+        Vec3{0.0f, 0.0f, 1.0f}, Vec3{0.0f, 0.0f, -1.0f},
+    };
+    for(const auto& normal : normals) {
+        // Two axes spanning the face, wound counter-clockwise
+        // when seen from outside
+        const Vec3 u = Vec3{normal.y, normal.z, normal.x};
+        const Vec3 v = Vec3_Cross(normal, u);
+        const uint32_t base = (uint32_t) mesh.positions.size();
+        const float corners[4][2] = {
+            {-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}
+        };
+        for(const auto& corner : corners) {
+            mesh.positions.push_back(
+                normal * 0.5f + u * corner[0] + v * corner[1]
+            );
+            mesh.normals.push_back(normal);
+            mesh.uvs.push_back(Vec2{corner[0] + 0.5f, corner[1] + 0.5f});
+        }
+        const uint32_t face_indices[6] = {0, 1, 2, 0, 2, 3};
+        for(const uint32_t index : face_indices) {
+            mesh.indices.push_back(base + index);
+        }
+    }
+    mesh.update_bounds();
+    return mesh;
+}
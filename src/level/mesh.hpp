@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "util/math.hpp"
+#include "util/symbol.hpp"
+
+// Index of a mesh in a LevelDocument.
+typedef uint32_t LevelMeshId;
+// Index of a material in a LevelDocument.
+typedef uint32_t LevelMaterialId;
+
+const LevelMeshId LevelMeshId_None = UINT32_MAX;
+const LevelMaterialId LevelMaterialId_None = UINT32_MAX;
+
+// Triangle mesh shared by any number of level entities.
+struct LevelMesh {
+    Symbol name;
+    std::vector<Vec3> positions;
+    std::vector<Vec3> normals;
+    std::vector<Vec2> uvs;
+    // Three vertex indexes per triangle
+    std::vector<uint32_t> indices;
+    // Bounds of the positions, in the mesh's local space
+    Bounds3 bounds = Bounds3_Empty;
+    
+    // Recompute bounds from positions.
+    void update_bounds();
+};
+
+// Surface appearance shared by any number of level entities.
+struct LevelMaterial {
+    Symbol name;
+    // Linear RGBA
+    float color[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+};
+
+// Make an axis-aligned box mesh centered on the origin, with one
+// unit sides.
+LevelMesh LevelMesh_CreateCube(Symbol name);
@@ -0,0 +1,444 @@
+#include "selection.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+
+#include "util/profiler.hpp"
+#include "util/simd.hpp"
+
+// Candidates or rows handled by one job.
+const int LevelSelection_ChunkSize = 4096;
+// Box and lasso selections test every row instead of the BVH's
+// candidates when more than this fraction of rows are candidates.
+const uint32_t LevelSelection_SweepFraction = 4;
+// Flags of entities which can't be selected.
+const uint32_t LevelSelection_SkipFlags = LevelEntityFlags_Hidden | LevelEntityFlags_Locked;
+
+enum LevelSelectionOp {
+    // words | other
+    LevelSelectionOp_Or,
+    // words & other
+    LevelSelectionOp_And,
+    // words & ~other
+    LevelSelectionOp_AndNot,
+};
+
+// Combine count words of other into words, which must be an even
+// number.
+static void LevelSelection_Combine(
+    uint64_t* words,
+    const uint64_t* other,
+    uint32_t count,
+    LevelSelectionOp op
+) {
+#if UNI_SIMD_SSE
+    for(uint32_t i = 0; i < count; i += 2) {
+        const __m128i a = _mm_loadu_si128((const __m128i*) (words + i));
+        const __m128i b = _mm_loadu_si128((const __m128i*) (other + i));
+        __m128i result;
+        switch(op) {
+            case LevelSelectionOp_Or: result = _mm_or_si128(a, b); break;
+            case LevelSelectionOp_And: result = _mm_and_si128(a, b); break;
+            case LevelSelectionOp_AndNot: result = _mm_andnot_si128(b, a); break;
+        }
+        _mm_storeu_si128((__m128i*) (words + i), result);
+    }
+#else
+    for(uint32_t i = 0; i < count; ++i) {
+        switch(op) {
+            case LevelSelectionOp_Or: words[i] |= other[i]; break;
+            case LevelSelectionOp_And: words[i] &= other[i]; break;
+            case LevelSelectionOp_AndNot: words[i] &= ~other[i]; break;
+        }
+    }
+#endif
+}
+
+// View directions and scales, worked out once for projecting
+// many points.
+struct LevelSelectProjection {
+    Vec3 position;
+    Vec3 forward;
+    Vec3 right;
+    Vec3 up;
+    float near_distance = 0.0f;
+    float far_distance = 0.0f;
+    // Pixels per unit of slope along each axis
+    float scale_x = 0.0f;
+    float scale_y = 0.0f;
+    float center_x = 0.0f;
+    float center_y = 0.0f;
+    
+    LevelSelectProjection(const LevelSelectView& view) {
+        this->position = view.position;
+        this->forward = Vec3_Normalize(view.forward);
+        this->right = Vec3_Normalize(Vec3_Cross(this->forward, view.up));
+        this->up = Vec3_Cross(this->right, this->forward);
+        this->near_distance = view.near_distance;
+        this->far_distance = view.far_distance;
+        const float half_height = std::tan(0.5f * view.fovy);
+        const float half_width = half_height * view.width / view.height;
+        this->center_x = 0.5f * view.width;
+        this->center_y = 0.5f * view.height;
+        this->scale_x = this->center_x / half_width;
+        this->scale_y = this->center_y / half_height;
+    }
+    
+    bool project(const Vec3& point, Vec2* pixel) const {
+        const Vec3 offset = point - this->position;
+        const float depth = Vec3_Dot(offset, this->forward);
+        if(!(depth >= this->near_distance && depth <= this->far_distance)) {
+            return false;
+        }
+        const float inverse_depth = 1.0f / depth;
+        pixel->x = this->center_x + Vec3_Dot(offset, this->right) * inverse_depth * this->scale_x;
+        pixel->y = this->center_y - Vec3_Dot(offset, this->up) * inverse_depth * this->scale_y;
+        return true;
+    }
+};
+
+Frustum3 LevelSelectView::get_frustum(const Vec2& min, const Vec2& max) const {
+    const Vec3 f = Vec3_Normalize(this->forward);
+    const Vec3 r = Vec3_Normalize(Vec3_Cross(f, this->up));
+    const Vec3 u = Vec3_Cross(r, f);
+    const float half_height = std::tan(0.5f * this->fovy);
+    const float half_width = half_height * this->width / this->height;
+    // Slopes of the rectangle's sides, at a distance of one along
+    // the view direction. Pixel rows grow downwards.
+    const float left = (min.x / this->width * 2.0f - 1.0f) * half_width;
+    const float right = (max.x / this->width * 2.0f - 1.0f) * half_width;
+    const float bottom = (1.0f - max.y / this->height * 2.0f) * half_height;
+    const float top = (1.0f - min.y / this->height * 2.0f) * half_height;
+    Frustum3 frustum;
+    frustum.planes[0] = Plane3_FromNormalPoint(f, this->position + f * this->near_distance);
+    frustum.planes[1] = Plane3_FromNormalPoint(f * -1.0f, this->position + f * this->far_distance);
+    frustum.planes[2] = Plane3_FromNormalPoint(r - f * left, this->position);
+    frustum.planes[3] = Plane3_FromNormalPoint(f * right - r, this->position);
+    frustum.planes[4] = Plane3_FromNormalPoint(u - f * bottom, this->position);
+    frustum.planes[5] = Plane3_FromNormalPoint(f * top - u, this->position);
+    return frustum;
+}
+
+bool LevelSelectView::project(const Vec3& point, Vec2* pixel) const {
+    return LevelSelectProjection(*this).project(point, pixel);
+}
+
+void LevelSelection::reserve(uint32_t index) {
+    const size_t size = ((size_t) (index >> 6) + 2) & ~(size_t) 1;
+    if(size > this->words.size()) {
+        this->words.resize(size, 0);
+    }
+}
+
+void LevelSelection::add_concurrent(uint32_t word, uint64_t bits) {
+    if(bits) {
+        std::atomic_ref<uint64_t>(this->words[word]).fetch_or(bits, std::memory_order_relaxed);
+    }
+}
+
+template<typename Fn>
+void LevelSelection::add_rows(const LevelDocument& document, JobSystem* jobs, Fn&& test) {
+    const uint32_t row_count = document.get_count();
+    if(row_count == 0) {
+        return;
+    }
+    const uint32_t* row_slots = document.row_slots.data();
+    const uint32_t* flags = document.flags.data();
+    const float* center_x = document.bounds_center_x.data();
+    const float* center_y = document.bounds_center_y.data();
+    const float* center_z = document.bounds_center_z.data();
+    this->reserve(*std::max_element(row_slots, row_slots + row_count));
+    auto add = [&](int begin, int end) {
+        // Slots mostly follow rows, so bits are gathered while they
+        // fall in the same word, and set together
+        uint32_t word = UINT32_MAX;
+        uint64_t bits = 0;
+        for(int row = begin; row < end; ++row) {
+            if(flags[row] & LevelSelection_SkipFlags) {
+                continue;
+            }
+            if(!test(Vec3{center_x[row], center_y[row], center_z[row]})) {
+                continue;
+            }
+            const uint32_t slot = row_slots[row];
+            if((slot >> 6) != word) {
+                this->add_concurrent(word, bits);
+                word = slot >> 6;
+                bits = 0;
+            }
+            bits |= (uint64_t) 1 << (slot & 63);
+        }
+        this->add_concurrent(word, bits);
+    };
+    if(jobs) {
+        jobs->parallel_for((int) row_count, LevelSelection_ChunkSize, add);
+    } else {
+        add(0, (int) row_count);
+    }
+}
+
+template<typename Fn>
+void LevelSelection::add_in_frustum(
+    const LevelDocument& document,
+    const LevelBvh& bvh,
+    const Frustum3& frustum,
+    bool test_inside,
+    JobSystem* jobs,
+    Fn&& test
+) {
+    // Looking up rows of candidates in BVH order jumps around every
+    // column, so when many rows are candidates, sweeping the columns
+    // in order is faster
+    std::vector<LevelHandle> inside;
+    std::vector<LevelHandle> crossing;
+    if(!bvh.query_frustum(frustum, &inside, &crossing, document.get_count() / LevelSelection_SweepFraction)) {
+        this->add_rows(document, jobs, test);
+        return;
+    }
+    const uint32_t inside_count = (uint32_t) inside.size();
+    const uint32_t count = inside_count + (uint32_t) crossing.size();
+    if(count == 0) {
+        return;
+    }
+    // Size the words first, so that jobs only set bits
+    uint32_t max_index = 0;
+    for(const LevelHandle& handle : inside) {
+        max_index = std::max(max_index, handle.index);
+    }
+    for(const LevelHandle& handle : crossing) {
+        max_index = std::max(max_index, handle.index);
+    }
+    this->reserve(max_index);
+    auto add = [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            const bool is_inside = (uint32_t) i < inside_count;
+            const LevelHandle handle = is_inside ? inside[i] : crossing[i - inside_count];
+            // The BVH may list entities destroyed since it was built
+            const uint32_t row = document.get_row(handle);
+            if(row == LevelRow_None || (document.flags[row] & LevelSelection_SkipFlags)) {
+                continue;
+            }
+            if(!is_inside || test_inside) {
+                const Vec3 center = Vec3{
+                    document.bounds_center_x[row],
+                    document.bounds_center_y[row],
+                    document.bounds_center_z[row]
+                };
+                if(!test(center)) {
+                    continue;
+                }
+            }
+            this->add_concurrent(handle.index >> 6, (uint64_t) 1 << (handle.index & 63));
+        }
+    };
+    if(jobs) {
+        jobs->parallel_for((int) count, LevelSelection_ChunkSize, add);
+    } else {
+        add(0, (int) count);
+    }
+}
+
+void LevelSelection::add(LevelHandle handle) {
+    this->reserve(handle.index);
+    this->words[handle.index >> 6] |= (uint64_t) 1 << (handle.index & 63);
+}
+
+void LevelSelection::remove(LevelHandle handle) {
+    const uint32_t word = handle.index >> 6;
+    if(word < this->words.size()) {
+        this->words[word] &= ~((uint64_t) 1 << (handle.index & 63));
+    }
+}
+
+void LevelSelection::clear() {
+    std::fill(this->words.begin(), this->words.end(), 0);
+}
+
+bool LevelSelection::empty() const {
+    for(uint64_t word : this->words) {
+        if(word) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t LevelSelection::count() const {
+    uint32_t count = 0;
+    for(uint64_t word : this->words) {
+        count += std::popcount(word);
+    }
+    return count;
+}
+
+void LevelSelection::unite(const LevelSelection& other) {
+    if(other.words.size() > this->words.size()) {
+        this->words.resize(other.words.size(), 0);
+    }
+    LevelSelection_Combine(
+        this->words.data(),
+        other.words.data(),
+        (uint32_t) other.words.size(),
+        LevelSelectionOp_Or
+    );
+}
+
+void LevelSelection::intersect(const LevelSelection& other) {
+    if(this->words.size() > other.words.size()) {
+        this->words.resize(other.words.size());
+    }
+    LevelSelection_Combine(
+        this->words.data(),
+        other.words.data(),
+        (uint32_t) this->words.size(),
+        LevelSelectionOp_And
+    );
+}
+
+void LevelSelection::subtract(const LevelSelection& other) {
+    LevelSelection_Combine(
+        this->words.data(),
+        other.words.data(),
+        (uint32_t) std::min(this->words.size(), other.words.size()),
+        LevelSelectionOp_AndNot
+    );
+}
+
+void LevelSelection::select_all(const LevelDocument& document, JobSystem* jobs) {
+    UNI_PROFILE_ZONE("LevelSelection::select_all");
+    this->add_rows(document, jobs, [](const Vec3&) {
+        return true;
+    });
+}
+
+void LevelSelection::invert(const LevelDocument& document, JobSystem* jobs) {
+    UNI_PROFILE_ZONE("LevelSelection::invert");
+    // Inverting every bit would also select empty slots, so the
+    // result is the selectable entities minus the current ones
+    LevelSelection selectable;
+    selectable.select_all(document, jobs);
+    LevelSelection_Combine(
+        selectable.words.data(),
+        this->words.data(),
+        (uint32_t) std::min(this->words.size(), selectable.words.size()),
+        LevelSelectionOp_AndNot
+    );
+    this->words = std::move(selectable.words);
+}
+
+void LevelSelection::remove_invalid(const LevelDocument& document, const LevelHandle* handles, uint32_t count) {
+    if(!handles) {
+        this->words.clear();
+        return;
+    }
+    for(uint32_t i = 0; i < count; ++i) {
+        if(!document.is_valid(handles[i])) {
+            this->remove(handles[i]);
+        }
+    }
+}
+
+void LevelSelection::get_handles(const LevelDocument& document, std::vector<LevelHandle>* handles) const {
+    const uint32_t row_count = document.get_count();
+    for(uint32_t row = 0; row < row_count; ++row) {
+        const uint32_t slot = document.row_slots[row];
+        if((slot >> 6) < this->words.size() && (this->words[slot >> 6] >> (slot & 63)) & 1) {
+            handles->push_back(document.get_handle(row));
+        }
+    }
+}
+
+void LevelSelection::select_box(
+    const LevelDocument& document,
+    const LevelBvh& bvh,
+    const LevelSelectView& view,
+    const Vec2& min,
+    const Vec2& max,
+    JobSystem* jobs
+) {
+    UNI_PROFILE_ZONE("LevelSelection::select_box");
+    const Vec2 box_min = Vec2{std::max(std::min(min.x, max.x), 0.0f), std::max(std::min(min.y, max.y), 0.0f)};
+    const Vec2 box_max = Vec2{std::min(std::max(min.x, max.x), view.width), std::min(std::max(min.y, max.y), view.height)};
+    if(!(box_max.x > box_min.x && box_max.y > box_min.y)) {
+        return;
+    }
+    const LevelSelectProjection projection(view);
+    // Entities entirely inside the box's frustum need no test
+    this->add_in_frustum(document, bvh, view.get_frustum(box_min, box_max), false, jobs, [&](const Vec3& center) {
+        Vec2 pixel;
+        return (
+            projection.project(center, &pixel) &&
+            pixel.x >= box_min.x && pixel.x <= box_max.x &&
+            pixel.y >= box_min.y && pixel.y <= box_max.y
+        );
+    });
+}
+
+void LevelSelection::select_lasso(
+    const LevelDocument& document,
+    const LevelBvh& bvh,
+    const LevelSelectView& view,
+    const Vec2* points,
+    uint32_t point_count,
+    JobSystem* jobs
+) {
+    UNI_PROFILE_ZONE("LevelSelection::select_lasso");
+    if(point_count < 3) {
+        return;
+    }
+    Vec2 box_min = points[0];
+    Vec2 box_max = points[0];
+    for(uint32_t i = 1; i < point_count; ++i) {
+        box_min = Vec2{std::min(box_min.x, points[i].x), std::min(box_min.y, points[i].y)};
+        box_max = Vec2{std::max(box_max.x, points[i].x), std::max(box_max.y, points[i].y)};
+    }
+    box_min = Vec2{std::max(std::floor(box_min.x), 0.0f), std::max(std::floor(box_min.y), 0.0f)};
+    box_max = Vec2{std::min(std::ceil(box_max.x), view.width), std::min(std::ceil(box_max.y), view.height)};
+    if(!(box_max.x > box_min.x && box_max.y > box_min.y)) {
+        return;
+    }
+
+    // Fill a mask of the pixels inside the lasso, one row at a
+    // time, between pairs of edge crossings at the pixel centers
+    const int mask_width = (int) (box_max.x - box_min.x);
+    const int mask_height = (int) (box_max.y - box_min.y);
+    std::vector<uint8_t> mask((size_t) mask_width * mask_height, 0);
+    std::vector<float> crossings;
+    for(int y = 0; y < mask_height; ++y) {
+        const float center_y = box_min.y + (float) y + 0.5f;
+        crossings.clear();
+        for(uint32_t i = 0; i < point_count; ++i) {
+            const Vec2& a = points[i];
+            const Vec2& b = points[(i + 1) % point_count];
+            if((a.y <= center_y) != (b.y <= center_y)) {
+                crossings.push_back(a.x + (center_y - a.y) * (b.x - a.x) / (b.y - a.y) - box_min.x);
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for(size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            const int begin = std::max((int) std::ceil(crossings[i] - 0.5f), 0);
+            const int end = std::min((int) std::ceil(crossings[i + 1] - 0.5f), mask_width);
+            if(begin < end) {
+                std::fill(mask.begin() + (size_t) y * mask_width + begin, mask.begin() + (size_t) y * mask_width + end, 1);
+            }
+        }
+    }
+
+    // Entities inside the bounding box's frustum may still be
+    // outside the lasso, so every candidate is tested
+    const LevelSelectProjection projection(view);
+    this->add_in_frustum(document, bvh, view.get_frustum(box_min, box_max), true, jobs, [&](const Vec3& center) {
+        Vec2 pixel;
+        if(!projection.project(center, &pixel)) {
+            return false;
+        }
+        const float x = std::floor(pixel.x - box_min.x);
+        const float y = std::floor(pixel.y - box_min.y);
+        if(!(x >= 0.0f && x < (float) mask_width && y >= 0.0f && y < (float) mask_height)) {
+            return false;
+        }
+        return mask[(size_t) y * mask_width + (size_t) x] != 0;
+    });
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+#include "util/math.hpp"
+
+/**
+ * Perspective view which box and lasso selections are drawn in,
+ * matching the camera the level is drawn with.
+ */
+struct LevelSelectView {
+    Vec3 position;
+    Vec3 forward = Vec3{0.0f, 0.0f, -1.0f};
+    Vec3 up = Vec3{0.0f, 1.0f, 0.0f};
+    // Vertical field of view, in radians
+    float fovy = 1.0f;
+    float near_distance = 0.01f;
+    float far_distance = 1000.0f;
+    // Size of the view, in pixels
+    float width = 1.0f;
+    float height = 1.0f;
+    
+    // Get the frustum through a rectangle of the view, in pixels
+    // from the top left.
+    Frustum3 get_frustum(const Vec2& min, const Vec2& max) const;
+    // Get the pixel a point is drawn at. Returns false if the point
+    // is nearer than the near plane or beyond the far plane.
+    bool project(const Vec3& point, Vec2* pixel) const;
+};
+
+/**
+ * Set of selected entities, as one bit per handle slot.
+ * 
+ * Bits are indexed by LevelHandle::index, so selecting every one
+ * of a million entities touches 128KB, and set operations between
+ * selections combine two words at a time with SIMD. A bit refers
+ * to whichever entity holds the slot, so destroyed entities must
+ * be removed, as remove_invalid does when given the handles the
+ * journal reports.
+ * 
+ * Box and lasso selection find candidates by querying the level's
+ * BVH with the frustum through the box, or the lasso's bounding
+ * box, and test the projected center of each candidate's bounds in
+ * parallel. Entities entirely inside a box's frustum are selected
+ * without being tested. When a selection covers most of the level,
+ * the bounds columns are swept in order instead, which is faster
+ * than visiting that many candidates in BVH order. Hidden and
+ * locked entities are never selected by these, nor by select_all
+ * and invert.
+ */
+class LevelSelection {
+public:
+    void add(LevelHandle handle);
+    void remove(LevelHandle handle);
+    bool contains(LevelHandle handle) const {
+        const uint32_t word = handle.index >> 6;
+        return word < this->words.size() && (this->words[word] >> (handle.index & 63)) & 1;
+    }
+    void clear();
+    bool empty() const;
+    uint32_t count() const;
+    
+    // Add every entity of another selection.
+    void unite(const LevelSelection& other);
+    // Keep only entities also in another selection.
+    void intersect(const LevelSelection& other);
+    // Remove every entity of another selection.
+    void subtract(const LevelSelection& other);
+    // Select every entity which can be selected.
+    void select_all(const LevelDocument& document, JobSystem* jobs = nullptr);
+    // Select exactly the entities which can be selected and aren't.
+    void invert(const LevelDocument& document, JobSystem* jobs = nullptr);
+    // Remove those of the handles which no longer refer to live
+    // entities. Null handles remove everything, as when the journal
+    // is cleared because the document was replaced.
+    void remove_invalid(const LevelDocument& document, const LevelHandle* handles, uint32_t count);
+    // Get the handles of the selected entities, in row order.
+    void get_handles(const LevelDocument& document, std::vector<LevelHandle>* handles) const;
+    
+    // Add the entities whose bounds centers are drawn inside a
+    // rectangle of the view, in pixels.
+    void select_box(
+        const LevelDocument& document,
+        const LevelBvh& bvh,
+        const LevelSelectView& view,
+        const Vec2& min,
+        const Vec2& max,
+        JobSystem* jobs = nullptr
+    );
+    // Add the entities whose bounds centers are drawn inside a
+    // polygon in the view, in pixels. Crossing edges are allowed;
+    // areas inside are found by the even-odd rule.
+    void select_lasso(
+        const LevelDocument& document,
+        const LevelBvh& bvh,
+        const LevelSelectView& view,
+        const Vec2* points,
+        uint32_t point_count,
+        JobSystem* jobs = nullptr
+    );
+    
+private:
+    // Always an even number, so SIMD code handles pairs
+    std::vector<uint64_t> words;
+    
+    // Make room for bits up to index.
+    void reserve(uint32_t index);
+    // Set bits of a word while other threads may set bits in the
+    // same word.
+    void add_concurrent(uint32_t word, uint64_t bits);
+    // Add the entities which can be selected and pass a test of
+    // their bounds center, sweeping every row in parallel.
+    template<typename Fn>
+    void add_rows(const LevelDocument& document, JobSystem* jobs, Fn&& test);
+    // Add the entities which can be selected, reach inside a
+    // frustum, and pass a test of their bounds center, in parallel.
+    // Entities entirely inside skip the test unless test_inside is
+    // set. When the BVH finds too many candidates, every row is
+    // tested instead.
+    template<typename Fn>
+    void add_in_frustum(
+        const LevelDocument& document,
+        const LevelBvh& bvh,
+        const Frustum3& frustum,
+        bool test_inside,
+        JobSystem* jobs,
+        Fn&& test
+    );
+};
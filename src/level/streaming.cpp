@@ -0,0 +1,426 @@
+#include "streaming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#include "level_file.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+bool LevelStreamer_ParseSectorName(const std::string& name, LevelSectorCoord* coord) {
+    int x = 0;
+    int z = 0;
+    int length = 0;
+    if(std::sscanf(name.c_str(), "sector_%d_%d%n", &x, &z, &length) != 2) {
+        return false;
+    }
+    if(name.compare(length, std::string::npos, LevelFile_Extension) != 0) {
+        return false;
+    }
+    *coord = LevelSectorCoord{x, z};
+    return true;
+}
+
+// Get the distance on the XZ plane from a point to a sector.
+static float LevelStreamer_GetDistance(LevelSectorCoord coord, float sector_size, const Vec3& point) {
+    const float min_x = (float) coord.x * sector_size;
+    const float min_z = (float) coord.z * sector_size;
+    const float dx = std::max({min_x - point.x, 0.0f, point.x - (min_x + sector_size)});
+    const float dz = std::max({min_z - point.z, 0.0f, point.z - (min_z + sector_size)});
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+bool LevelStreamer::open(std::string directory) {
+    this->close();
+    std::error_code error;
+    std::filesystem::directory_iterator iterator(directory, error);
+    if(error) {
+        UNI_LOG_WARN(LogSubsystem_Level, "Failed to read sector directory '{}'.", directory);
+        return false;
+    }
+    for(const auto& entry : iterator) {
+        LevelSectorCoord coord;
+        if(!entry.is_regular_file(error) ||
+            !LevelStreamer_ParseSectorName(entry.path().filename().string(), &coord)
+        ) {
+            continue;
+        }
+        auto sector = std::make_unique<LevelSector>();
+        sector->coord = coord;
+        sector->memory_bytes = (uint64_t) entry.file_size(error);
+        this->sectors[coord.get_key()] = std::move(sector);
+    }
+    this->directory = std::move(directory);
+    UNI_LOG_INFO(
+        LogSubsystem_Level, "Streaming {} sectors from '{}'.",
+        this->sectors.size(), this->directory
+    );
+    return true;
+}
+
+void LevelStreamer::close() {
+    for(const JobHandle handle : this->job_handles) {
+        this->jobs->wait(handle);
+    }
+    this->job_handles.clear();
+    this->sectors.clear();
+    this->directory.clear();
+    this->resident_bytes = 0;
+    this->job_count = 0;
+    this->generation++;
+}
+
+void LevelStreamer::update(const Vec3& camera_position, const Vec3& camera_velocity) {
+    if(!this->is_open()) {
+        return;
+    }
+    UNI_PROFILE_ZONE("LevelStreamer::update");
+    this->job_handles.erase(
+        std::remove_if(
+            this->job_handles.begin(),
+            this->job_handles.end(),
+            [this](JobHandle handle) { return this->jobs->is_done(handle); }
+        ),
+        this->job_handles.end()
+    );
+    const Vec3 prefetch_position = camera_position + camera_velocity * this->prefetch_seconds;
+    auto get_distance = [&](LevelSectorCoord coord) -> float {
+        const float distance = std::min(
+            LevelStreamer_GetDistance(coord, this->sector_size, camera_position),
+            LevelStreamer_GetDistance(coord, this->sector_size, prefetch_position)
+        );
+        return distance <= this->load_distance ? distance : INFINITY;
+    };
+    // Resident and loading sectors are few, since they fit in
+    // the budget, so they are all checked every frame.
+    for(auto& [key, sector] : this->sectors) {
+        if(sector->state != LevelSectorState_Unloaded) {
+            sector->distance = get_distance(sector->coord);
+        }
+    }
+    // Find unloaded sectors in range around both points
+    std::vector<LevelSector*> wanted;
+    const int radius = (int) std::ceil(this->load_distance / this->sector_size);
+    for(const Vec3& point : {camera_position, prefetch_position}) {
+        const LevelSectorCoord center = this->get_coord(point);
+        for(int z = center.z - radius; z <= center.z + radius; ++z) {
+            for(int x = center.x - radius; x <= center.x + radius; ++x) {
+                LevelSector* sector = this->find_sector(LevelSectorCoord{x, z});
+                if(!sector || sector->state != LevelSectorState_Unloaded) {
+                    continue;
+                }
+                const float distance = get_distance(sector->coord);
+                if(distance != INFINITY && std::find(wanted.begin(), wanted.end(), sector) == wanted.end()) {
+                    sector->distance = distance;
+                    wanted.push_back(sector);
+                }
+            }
+        }
+    }
+    std::sort(wanted.begin(), wanted.end(), [](const LevelSector* a, const LevelSector* b) {
+        return a->distance < b->distance;
+    });
+    for(LevelSector* sector : wanted) {
+        if(this->job_count >= this->max_job_count) {
+            break;
+        }
+        const uint64_t budget = this->memory_budget_bytes;
+        if(this->resident_bytes + sector->memory_bytes > budget) {
+            // Only make room by unloading sectors farther away
+            const uint64_t target = budget > sector->memory_bytes ? budget - sector->memory_bytes : 0;
+            if(!this->evict(target, sector->distance)) {
+                break;
+            }
+        }
+        this->start_load(sector);
+    }
+    if(this->resident_bytes > this->memory_budget_bytes) {
+        // Sectors may take more memory once loaded than estimated.
+        // The nearest is kept, so that there is always one to edit.
+        float nearest = INFINITY;
+        for(auto& [key, sector] : this->sectors) {
+            if(sector->state == LevelSectorState_Resident || sector->state == LevelSectorState_Loading) {
+                nearest = std::min(nearest, sector->distance);
+            }
+        }
+        this->evict(this->memory_budget_bytes, std::min(nearest, this->load_distance));
+    }
+}
+
+bool LevelStreamer::save_dirty() {
+    UNI_PROFILE_ZONE("LevelStreamer::save_dirty");
+    bool ok = true;
+    for(auto& [key, sector] : this->sectors) {
+        if(sector->state != LevelSectorState_Resident || !sector->dirty) {
+            continue;
+        }
+        if(LevelFile_SaveOver(sector->document.get(), this->get_sector_path(sector->coord).c_str())) {
+            sector->dirty = false;
+        }
+        else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+LevelSectorCoord LevelStreamer::get_coord(const Vec3& position) const {
+    return LevelSectorCoord{
+        (int32_t) std::floor(position.x / this->sector_size),
+        (int32_t) std::floor(position.z / this->sector_size)
+    };
+}
+
+std::string LevelStreamer::get_sector_path(LevelSectorCoord coord) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "sector_%d_%d%s", coord.x, coord.z, LevelFile_Extension);
+    return (std::filesystem::path(this->directory) / name).string();
+}
+
+LevelDocument* LevelStreamer::get_document(LevelSectorCoord coord) {
+    LevelSector* sector = this->find_sector(coord);
+    if(!sector || sector->state != LevelSectorState_Resident) {
+        return nullptr;
+    }
+    return sector->document.get();
+}
+
+LevelDocument* LevelStreamer::get_or_create_document(LevelSectorCoord coord) {
+    if(!this->is_open()) {
+        return nullptr;
+    }
+    LevelSector* sector = this->find_sector(coord);
+    if(!sector) {
+        auto new_sector = std::make_unique<LevelSector>();
+        new_sector->coord = coord;
+        new_sector->state = LevelSectorState_Resident;
+        new_sector->document = std::make_unique<LevelDocument>();
+        new_sector->memory_bytes = new_sector->document->get_memory_bytes();
+        new_sector->dirty = true;
+        this->resident_bytes += new_sector->memory_bytes;
+        sector = new_sector.get();
+        this->sectors[coord.get_key()] = std::move(new_sector);
+    }
+    if(sector->state != LevelSectorState_Resident) {
+        return nullptr;
+    }
+    return sector->document.get();
+}
+
+void LevelStreamer::mark_dirty(LevelSectorCoord coord) {
+    LevelSector* sector = this->find_sector(coord);
+    if(!sector || sector->state != LevelSectorState_Resident) {
+        return;
+    }
+    sector->dirty = true;
+    // Edits may have grown the document
+    const uint64_t memory_bytes = sector->document->get_memory_bytes();
+    this->resident_bytes = this->resident_bytes - sector->memory_bytes + memory_bytes;
+    sector->memory_bytes = memory_bytes;
+}
+
+int LevelStreamer::get_resident_count() const {
+    int count = 0;
+    for(const auto& [key, sector] : this->sectors) {
+        count += sector->state == LevelSectorState_Resident ? 1 : 0;
+    }
+    return count;
+}
+
+LevelSector* LevelStreamer::find_sector(LevelSectorCoord coord) {
+    const auto iterator = this->sectors.find(coord.get_key());
+    return iterator != this->sectors.end() ? iterator->second.get() : nullptr;
+}
+
+void LevelStreamer::start_load(LevelSector* sector) {
+    sector->state = LevelSectorState_Loading;
+    this->resident_bytes += sector->memory_bytes;
+    this->job_count++;
+    // The job only touches its own result; the sector itself is
+    // only changed on the main thread.
+    auto result = std::make_shared<std::unique_ptr<LevelDocument>>();
+    std::string path = this->get_sector_path(sector->coord);
+    const LevelSectorCoord coord = sector->coord;
+    const uint32_t generation = this->generation;
+    this->job_handles.push_back(this->jobs->submit(
+        [result, path]() {
+            auto document = std::make_unique<LevelDocument>();
+            if(LevelFile_Open(document.get(), path.c_str())) {
+                *result = std::move(document);
+            }
+        },
+        {},
+        [this, result, coord, generation]() {
+            if(generation != this->generation) {
+                return;
+            }
+            this->job_count--;
+            LevelSector* sector = this->find_sector(coord);
+            this->resident_bytes -= sector->memory_bytes;
+            if(!*result) {
+                // Stays unloaded. It will be retried once wanted
+                // again, so failures are logged by LevelFile_Open.
+                sector->state = LevelSectorState_Unloaded;
+                return;
+            }
+            sector->document = std::move(*result);
+            sector->state = LevelSectorState_Resident;
+            sector->dirty = false;
+            sector->memory_bytes = sector->document->get_memory_bytes();
+            this->resident_bytes += sector->memory_bytes;
+            UNI_LOG_TRACE(
+                LogSubsystem_Level, "Loaded sector {}, {}.", coord.x, coord.z
+            );
+        }
+    ));
+}
+
+void LevelStreamer::start_unload(LevelSector* sector) {
+    sector->state = LevelSectorState_Unloading;
+    // Counted as free from now on, since the job will release it
+    // shortly and nothing else can use it meanwhile.
+    this->resident_bytes -= sector->memory_bytes;
+    this->job_count++;
+    // Handed back by the job only if its changes couldn't be saved
+    auto result = std::make_shared<std::unique_ptr<LevelDocument>>(std::move(sector->document));
+    const bool dirty = sector->dirty;
+    std::string path = this->get_sector_path(sector->coord);
+    const LevelSectorCoord coord = sector->coord;
+    const uint32_t generation = this->generation;
+    this->job_handles.push_back(this->jobs->submit(
+        [result, dirty, path]() {
+            if(dirty && !LevelFile_SaveOver(result->get(), path.c_str())) {
+                return;
+            }
+            // Unmapping and freeing also happen off the main thread
+            result->reset();
+        },
+        {},
+        [this, result, coord, generation]() {
+            if(generation != this->generation) {
+                return;
+            }
+            this->job_count--;
+            LevelSector* sector = this->find_sector(coord);
+            if(*result) {
+                // Stays resident and dirty, so that the save is
+                // retried by a later unload or save_dirty
+                UNI_LOG_ERROR(
+                    LogSubsystem_Level, "Failed to save sector {}, {}; keeping it loaded.",
+                    coord.x, coord.z
+                );
+                sector->document = std::move(*result);
+                sector->state = LevelSectorState_Resident;
+                this->resident_bytes += sector->memory_bytes;
+                return;
+            }
+            // memory_bytes is kept as measured while resident, which
+            // estimates a reload better than the file size
+            sector->state = LevelSectorState_Unloaded;
+            sector->dirty = false;
+        }
+    ));
+}
+
+bool LevelStreamer::evict(uint64_t target_bytes, float max_distance) {
+    if(this->resident_bytes <= target_bytes) {
+        return true;
+    }
+    std::vector<LevelSector*> candidates;
+    for(auto& [key, sector] : this->sectors) {
+        if(sector->state == LevelSectorState_Resident && sector->distance > max_distance) {
+            candidates.push_back(sector.get());
+        }
+    }
+    // Clean sectors are cheap to unload, so they go first
+    std::sort(candidates.begin(), candidates.end(), [](const LevelSector* a, const LevelSector* b) {
+        if(a->dirty != b->dirty) {
+            return !a->dirty;
+        }
+        return a->distance > b->distance;
+    });
+    for(LevelSector* sector : candidates) {
+        if(this->resident_bytes <= target_bytes) {
+            break;
+        }
+        if(this->job_count >= this->max_job_count) {
+            return false;
+        }
+        this->start_unload(sector);
+    }
+    return this->resident_bytes <= target_bytes;
+}
+
+void LevelStreamer_BuildSector(
+    const LevelDocument& document,
+    const uint32_t* rows,
+    uint32_t row_count,
+    LevelDocument* sector
+) {
+    sector->clear();
+    sector->reserve(row_count);
+    // Copy only the meshes and materials this sector uses
+    std::unordered_map<uint32_t, uint32_t> mesh_ids;
+    std::unordered_map<uint32_t, uint32_t> material_ids;
+    for(uint32_t i = 0; i < row_count; ++i) {
+        const uint32_t row = rows[i];
+        LevelEntityDesc desc;
+        desc.position = document.positions[row];
+        desc.rotation = document.rotations[row];
+        desc.scale = document.scales[row];
+        desc.flags = document.flags[row];
+        const LevelMeshId mesh = document.meshes[row];
+        if(mesh < document.mesh_assets.size()) {
+            const auto found = mesh_ids.find(mesh);
+            desc.mesh = found != mesh_ids.end() ? found->second : (
+                mesh_ids[mesh] = sector->add_mesh(document.mesh_assets[mesh])
+            );
+        }
+        const LevelMaterialId material = document.materials[row];
+        if(material < document.material_assets.size()) {
+            const auto found = material_ids.find(material);
+            desc.material = found != material_ids.end() ? found->second : (
+                material_ids[material] = sector->add_material(document.material_assets[material])
+            );
+        }
+        sector->create(desc);
+    }
+}
+
+bool LevelStreamer_SplitDocument(
+    const LevelDocument& document,
+    const char* directory,
+    float sector_size
+) {
+    UNI_PROFILE_ZONE("LevelStreamer_SplitDocument");
+    LevelStreamer streamer;
+    streamer.directory = directory;
+    streamer.sector_size = sector_size;
+    // Group rows by sector
+    std::unordered_map<uint64_t, std::vector<uint32_t>> sector_rows;
+    std::unordered_map<uint64_t, LevelSectorCoord> sector_coords;
+    const uint32_t count = document.get_count();
+    for(uint32_t row = 0; row < count; ++row) {
+        const LevelSectorCoord coord = streamer.get_coord(Vec3{
+            document.bounds_center_x[row], 0.0f, document.bounds_center_z[row]
+        });
+        sector_rows[coord.get_key()].push_back(row);
+        sector_coords[coord.get_key()] = coord;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    bool ok = true;
+    for(const auto& [key, rows] : sector_rows) {
+        LevelDocument sector;
+        LevelStreamer_BuildSector(document, rows.data(), (uint32_t) rows.size(), &sector);
+        ok = LevelFile_Save(sector, streamer.get_sector_path(sector_coords[key]).c_str()) && ok;
+    }
+    UNI_LOG_INFO(
+        LogSubsystem_Level, "Split {} entities into {} sectors in '{}'.",
+        count, sector_rows.size(), directory
+    );
+    return ok;
+}
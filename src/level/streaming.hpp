@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+
+// Position of a sector in the grid of sectors, on the XZ plane.
+struct LevelSectorCoord {
+    int32_t x = 0;
+    int32_t z = 0;
+    
+    bool operator==(const LevelSectorCoord& other) const {
+        return this->x == other.x && this->z == other.z;
+    }
+    // Pack into a single value, for use as a map key.
+    uint64_t get_key() const {
+        return ((uint64_t) (uint32_t) this->x << 32) | (uint64_t) (uint32_t) this->z;
+    }
+};
+
+enum LevelSectorState : int {
+    // Only on disk
+    LevelSectorState_Unloaded = 0,
+    // Being opened by a background job
+    LevelSectorState_Loading,
+    // In memory, and may be edited
+    LevelSectorState_Resident,
+    // Being saved and freed by a background job
+    LevelSectorState_Unloading,
+};
+
+// One square column of the world, stored in its own level file.
+struct LevelSector {
+    LevelSectorCoord coord;
+    LevelSectorState state = LevelSectorState_Unloaded;
+    // Set only while resident
+    std::unique_ptr<LevelDocument> document;
+    // Set when the document has unsaved changes. Dirty sectors
+    // are saved before they are unloaded.
+    bool dirty = false;
+    // Memory used while resident. For other states, an estimate
+    // taken from the file size.
+    uint64_t memory_bytes = 0;
+    // Distance from the camera, or from the point it is heading
+    // to, whichever is nearer. Infinite when out of range.
+    float distance = 0.0f;
+};
+
+/**
+ * Keeps the sectors of a large level near the camera in memory.
+ * 
+ * A streamed level is a directory of level files, one per sector
+ * of a square grid on the XZ plane. Each frame, sectors within
+ * load_distance of the camera, or of where the camera will be
+ * after prefetch_seconds at its current velocity, are opened by
+ * background jobs, nearest first. When the memory budget would be
+ * exceeded, the farthest sectors are unloaded first, preferring
+ * ones without unsaved changes. Dirty sectors are saved by the job
+ * which unloads them, and stay loaded if the save fails.
+ * 
+ * Resident sectors can be edited like any other LevelDocument.
+ * Call mark_dirty afterwards so that the changes are kept.
+ */
+class LevelStreamer {
+public:
+    LevelStreamer() {};
+    LevelStreamer(JobSystem* jobs): jobs(jobs) {};
+    LevelStreamer(const LevelStreamer&) = delete;
+    LevelStreamer& operator=(const LevelStreamer&) = delete;
+    LevelStreamer& operator=(LevelStreamer&& other) = default;
+    
+    JobSystem* jobs = nullptr;
+    // Directory holding one level file per sector
+    std::string directory;
+    // Width of each sector, in world units
+    float sector_size = 256.0f;
+    // Sectors nearer than this to the camera are loaded
+    float load_distance = 768.0f;
+    // How far ahead of the camera's motion to prefetch, in seconds
+    float prefetch_seconds = 2.0f;
+    uint64_t memory_budget_bytes = (uint64_t) 2 << 30;
+    // Background loads and unloads in flight at once, at most
+    int max_job_count = 4;
+    
+    // Start streaming a level from a directory of sector files.
+    // Returns false if the directory can't be read.
+    bool open(std::string directory);
+    // Wait for background jobs and forget every sector. Unsaved
+    // changes are lost; call save_dirty first to keep them.
+    void close();
+    bool is_open() const {
+        return !this->directory.empty();
+    }
+    // Load and unload sectors. Call once per frame, after
+    // JobSystem::update.
+    void update(const Vec3& camera_position, const Vec3& camera_velocity);
+    // Save every resident sector with unsaved changes, now.
+    // Returns false if any failed to save.
+    bool save_dirty();
+    
+    LevelSectorCoord get_coord(const Vec3& position) const;
+    std::string get_sector_path(LevelSectorCoord coord) const;
+    // Get a sector's document, or nullptr if it isn't resident.
+    LevelDocument* get_document(LevelSectorCoord coord);
+    // Get a resident sector's document for adding entities to,
+    // making a new empty sector if there is none at coord yet.
+    // Returns nullptr if the sector exists but isn't resident.
+    LevelDocument* get_or_create_document(LevelSectorCoord coord);
+    void mark_dirty(LevelSectorCoord coord);
+    
+    int get_sector_count() const {
+        return (int) this->sectors.size();
+    }
+    int get_resident_count() const;
+    // Get the number of background loads and unloads in flight.
+    int get_job_count() const {
+        return this->job_count;
+    }
+    // Get memory used by resident sectors, and expected to be used
+    // by loading ones. Unloading sectors aren't counted.
+    uint64_t get_resident_bytes() const {
+        return this->resident_bytes;
+    }
+    
+private:
+    std::unordered_map<uint64_t, std::unique_ptr<LevelSector>> sectors;
+    std::vector<JobHandle> job_handles;
+    uint64_t resident_bytes = 0;
+    int job_count = 0;
+    // Incremented by close, so that callbacks from jobs started
+    // before it are ignored.
+    uint32_t generation = 0;
+    
+    LevelSector* find_sector(LevelSectorCoord coord);
+    void start_load(LevelSector* sector);
+    void start_unload(LevelSector* sector);
+    // Unload sectors farther than max_distance, farthest first,
+    // until resident memory is at most target_bytes. Returns true
+    // if the target was reached.
+    bool evict(uint64_t target_bytes, float max_distance);
+};
+
+// Parse a sector file name such as "sector_-3_12.unilevel", as
+// made by LevelStreamer::get_sector_path. Returns false for other
+// names.
+bool LevelStreamer_ParseSectorName(const std::string& name, LevelSectorCoord* coord);
+
+/**
+ * Fill a sector's document with copies of some rows of another
+ * document, in the order given. The sector gets its own copy of
+ * each mesh and material those rows use.
+ */
+void LevelStreamer_BuildSector(
+    const LevelDocument& document,
+    const uint32_t* rows,
+    uint32_t row_count,
+    LevelDocument* sector
+);
+
+/**
+ * Split a document into sectors, writing each to a level file in
+ * a directory, for streaming with LevelStreamer. Entities go to
+ * the sector containing the center of their bounds. Each sector
+ * file gets its own copy of the meshes and materials it uses.
+ * Returns false if any file could not be written.
+ */
+bool LevelStreamer_SplitDocument(
+    const LevelDocument& document,
+    const char* directory,
+    float sector_size
+);
@@ -0,0 +1,405 @@
+#include "vertex_hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Bits of each cell coordinate in a cell key. Vertexes farther out
+// than this many cells from the origin share the outermost cells.
+const int LevelVertexHash_CoordBits = 21;
+const int64_t LevelVertexHash_CoordMin = -((int64_t) 1 << (LevelVertexHash_CoordBits - 1));
+const int64_t LevelVertexHash_CoordMax = ((int64_t) 1 << (LevelVertexHash_CoordBits - 1)) - 1;
+// Rows transformed by one job during a full rebuild.
+const int LevelVertexHash_RebuildChunkSize = 1024;
+
+static int64_t LevelVertexHash_GetCoord(float value, float cell_size) {
+    const float cell = std::floor(value / cell_size);
+    if(!(cell >= (float) LevelVertexHash_CoordMin)) {
+        return LevelVertexHash_CoordMin;
+    }
+    if(cell > (float) LevelVertexHash_CoordMax) {
+        return LevelVertexHash_CoordMax;
+    }
+    return (int64_t) cell;
+}
+
+static bool LevelVertexHash_IsCoordValid(int64_t coord) {
+    return coord >= LevelVertexHash_CoordMin && coord <= LevelVertexHash_CoordMax;
+}
+
+static uint64_t LevelVertexHash_GetKey(int64_t x, int64_t y, int64_t z) {
+    const uint64_t mask = ((uint64_t) 1 << LevelVertexHash_CoordBits) - 1;
+    return (
+        ((uint64_t) (x - LevelVertexHash_CoordMin) & mask) |
+        (((uint64_t) (y - LevelVertexHash_CoordMin) & mask) << LevelVertexHash_CoordBits) |
+        (((uint64_t) (z - LevelVertexHash_CoordMin) & mask) << (LevelVertexHash_CoordBits * 2))
+    );
+}
+
+// Insert a hit into a list sorted nearest first, holding at most
+// capacity hits.
+static void LevelVertexHash_InsertNearest(
+    const LevelVertexHit& hit,
+    LevelVertexHit* hits,
+    uint32_t* count,
+    uint32_t capacity
+) {
+    if(*count == capacity && hit.distance_squared >= hits[capacity - 1].distance_squared) {
+        return;
+    }
+    uint32_t i = *count < capacity ? (*count)++ : capacity - 1;
+    while(i > 0 && hits[i - 1].distance_squared > hit.distance_squared) {
+        hits[i] = hits[i - 1];
+        i--;
+    }
+    hits[i] = hit;
+}
+
+void LevelVertexHash::mark_changed(const LevelHandle* handles, uint32_t count) {
+    if(!handles) {
+        this->all_changed = true;
+        this->changed_entities.clear();
+        return;
+    }
+    if(!this->all_changed) {
+        this->changed_entities.insert(this->changed_entities.end(), handles, handles + count);
+    }
+}
+
+void LevelVertexHash::update(const LevelDocument& document) {
+    if(this->cell_size != this->built_cell_size) {
+        this->all_changed = true;
+    }
+    if(!this->all_changed && this->changed_entities.empty()) {
+        return;
+    }
+    UNI_PROFILE_ZONE("LevelVertexHash::update");
+    if(!this->all_changed) {
+        // Remove first, then add, since a handle index may be in
+        // the list for both a destroyed entity and the one which
+        // took its place
+        for(const LevelHandle handle : this->changed_entities) {
+            this->remove_entity(handle.index);
+        }
+        std::vector<Vec3> vertexes;
+        for(const LevelHandle handle : this->changed_entities) {
+            const uint32_t row = document.get_row(handle);
+            if(row == LevelRow_None) {
+                continue;
+            }
+            if(handle.index < this->entity_points.size() && !this->entity_points[handle.index].empty()) {
+                // Listed more than once
+                continue;
+            }
+            const std::vector<Vec3>& mesh_vertexes = this->get_mesh_vertexes(document, document.meshes[row]);
+            this->get_entity_vertexes(document, row, &mesh_vertexes, &vertexes);
+            for(const Vec3& vertex : vertexes) {
+                this->add_point(vertex, handle);
+            }
+        }
+        this->changed_entities.clear();
+        return;
+    }
+    // Everything is rebuilt, as when the document was replaced and
+    // mesh ids may refer to other meshes
+    this->all_changed = false;
+    this->changed_entities.clear();
+    this->built_cell_size = this->cell_size;
+    this->points.clear();
+    this->free_points.clear();
+    this->cells.clear();
+    this->entity_points.clear();
+    // Sized up front, so that the references to each mesh's
+    // positions held below stay valid
+    this->mesh_vertexes.clear();
+    this->mesh_vertexes.resize(document.mesh_assets.size());
+    this->mesh_vertexes_ready.assign(document.mesh_assets.size(), 0);
+    const uint32_t row_count = document.get_count();
+    // Distinct positions of every mesh in use, and where each row's
+    // points start
+    std::vector<const std::vector<Vec3>*> row_meshes(row_count);
+    std::vector<uint32_t> row_offsets(row_count + 1, 0);
+    for(uint32_t row = 0; row < row_count; ++row) {
+        row_meshes[row] = &this->get_mesh_vertexes(document, document.meshes[row]);
+        uint32_t count = 0;
+        if(!(document.flags[row] & LevelEntityFlags_Hidden)) {
+            count = document.meshes[row] == LevelMeshId_None ? 1 : (uint32_t) row_meshes[row]->size();
+        }
+        row_offsets[row + 1] = row_offsets[row] + count;
+    }
+    this->points.resize(row_offsets[row_count]);
+    const auto transform = [this, &document, &row_meshes, &row_offsets](int begin, int end) {
+        std::vector<Vec3> vertexes;
+        for(int row = begin; row < end; ++row) {
+            this->get_entity_vertexes(document, (uint32_t) row, row_meshes[row], &vertexes);
+            const LevelHandle handle = document.get_handle((uint32_t) row);
+            LevelVertexHashPoint* point = &this->points[row_offsets[row]];
+            for(const Vec3& vertex : vertexes) {
+                point->position = vertex;
+                point->handle = handle;
+                point->cell = this->get_cell_key(vertex);
+                point++;
+            }
+        }
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) row_count, LevelVertexHash_RebuildChunkSize, transform);
+    } else {
+        transform(0, (int) row_count);
+    }
+    for(uint32_t row = 0; row < row_count; ++row) {
+        const LevelHandle handle = document.get_handle(row);
+        if(handle.index >= this->entity_points.size()) {
+            this->entity_points.resize(handle.index + 1);
+        }
+        std::vector<uint32_t>& indexes = this->entity_points[handle.index];
+        for(uint32_t i = row_offsets[row]; i < row_offsets[row + 1]; ++i) {
+            indexes.push_back(i);
+            this->cells[this->points[i].cell].push_back(i);
+        }
+    }
+    UNI_LOG_DEBUG(
+        LogSubsystem_Level, "Hashed {} vertexes of {} entities into {} cells.",
+        this->points.size(), row_count, this->cells.size()
+    );
+}
+
+uint32_t LevelVertexHash::find_in_radius(
+    const Vec3& center,
+    float radius,
+    std::vector<LevelVertexHit>* hits,
+    LevelHandle ignore
+) const {
+    if(!(radius >= 0.0f) || this->cells.empty()) {
+        return 0;
+    }
+    const float radius_squared = radius * radius;
+    uint32_t found = 0;
+    const auto check = [&](const LevelVertexHashPoint& point) {
+        if(point.handle == ignore) {
+            return;
+        }
+        const Vec3 offset = point.position - center;
+        const float distance_squared = Vec3_Dot(offset, offset);
+        if(distance_squared <= radius_squared) {
+            hits->push_back(LevelVertexHit{point.position, point.handle, distance_squared});
+            found++;
+        }
+    };
+    const int64_t min_x = LevelVertexHash_GetCoord(center.x - radius, this->built_cell_size);
+    const int64_t min_y = LevelVertexHash_GetCoord(center.y - radius, this->built_cell_size);
+    const int64_t min_z = LevelVertexHash_GetCoord(center.z - radius, this->built_cell_size);
+    const int64_t max_x = LevelVertexHash_GetCoord(center.x + radius, this->built_cell_size);
+    const int64_t max_y = LevelVertexHash_GetCoord(center.y + radius, this->built_cell_size);
+    const int64_t max_z = LevelVertexHash_GetCoord(center.z + radius, this->built_cell_size);
+    const double cell_count = (double) (max_x - min_x + 1) * (max_y - min_y + 1) * (max_z - min_z + 1);
+    if(cell_count > (double) this->cells.size()) {
+        // Fewer cells are occupied than overlap the sphere
+        for(const auto& [key, indexes] : this->cells) {
+            for(const uint32_t index : indexes) {
+                check(this->points[index]);
+            }
+        }
+        return found;
+    }
+    for(int64_t z = min_z; z <= max_z; ++z) {
+        for(int64_t y = min_y; y <= max_y; ++y) {
+            for(int64_t x = min_x; x <= max_x; ++x) {
+                this->visit_cell(x, y, z, check);
+            }
+        }
+    }
+    return found;
+}
+
+uint32_t LevelVertexHash::find_nearest(
+    const Vec3& center,
+    uint32_t count,
+    float max_distance,
+    LevelVertexHit* hits,
+    LevelHandle ignore
+) const {
+    if(count == 0 || !(max_distance >= 0.0f) || this->cells.empty()) {
+        return 0;
+    }
+    const float max_distance_squared = max_distance * max_distance;
+    uint32_t found = 0;
+    const auto check = [&](const LevelVertexHashPoint& point) {
+        if(point.handle == ignore) {
+            return;
+        }
+        const Vec3 offset = point.position - center;
+        const float distance_squared = Vec3_Dot(offset, offset);
+        if(distance_squared <= max_distance_squared) {
+            LevelVertexHash_InsertNearest(
+                LevelVertexHit{point.position, point.handle, distance_squared},
+                hits, &found, count
+            );
+        }
+    };
+    const float cell_size = this->built_cell_size;
+    const int64_t center_x = LevelVertexHash_GetCoord(center.x, cell_size);
+    const int64_t center_y = LevelVertexHash_GetCoord(center.y, cell_size);
+    const int64_t center_z = LevelVertexHash_GetCoord(center.z, cell_size);
+    // Visit shells of cells around the center's cell. Once shell n
+    // is done, every vertex left is at least n cells away.
+    for(int64_t n = 0; ; ++n) {
+        const double side = (double) (2 * n + 1);
+        if(side * side * side > (double) this->cells.size()) {
+            // Fewer cells are occupied than the shells would visit
+            found = 0;
+            for(const auto& [key, indexes] : this->cells) {
+                for(const uint32_t index : indexes) {
+                    check(this->points[index]);
+                }
+            }
+            return found;
+        }
+        for(int64_t dz = -n; dz <= n; ++dz) {
+            for(int64_t dy = -n; dy <= n; ++dy) {
+                // Inside the shell, only its two ends along x
+                const bool on_face = dz == -n || dz == n || dy == -n || dy == n;
+                const int64_t step = on_face || n == 0 ? 1 : 2 * n;
+                for(int64_t dx = -n; dx <= n; dx += step) {
+                    this->visit_cell(center_x + dx, center_y + dy, center_z + dz, check);
+                }
+            }
+        }
+        const float reached = (float) n * cell_size;
+        if(reached >= max_distance) {
+            return found;
+        }
+        if(found == count && hits[count - 1].distance_squared <= reached * reached) {
+            return found;
+        }
+    }
+}
+
+uint64_t LevelVertexHash::get_cell_key(const Vec3& position) const {
+    return LevelVertexHash_GetKey(
+        LevelVertexHash_GetCoord(position.x, this->built_cell_size),
+        LevelVertexHash_GetCoord(position.y, this->built_cell_size),
+        LevelVertexHash_GetCoord(position.z, this->built_cell_size)
+    );
+}
+
+const std::vector<Vec3>& LevelVertexHash::get_mesh_vertexes(
+    const LevelDocument& document,
+    LevelMeshId mesh_id
+) {
+    static const std::vector<Vec3> none;
+    const LevelMesh* mesh = document.get_mesh(mesh_id);
+    if(!mesh) {
+        return none;
+    }
+    if(mesh_id >= this->mesh_vertexes.size()) {
+        this->mesh_vertexes.resize(mesh_id + 1);
+        this->mesh_vertexes_ready.resize(mesh_id + 1, 0);
+    }
+    std::vector<Vec3>& vertexes = this->mesh_vertexes[mesh_id];
+    if(!this->mesh_vertexes_ready[mesh_id]) {
+        // Vertexes are often repeated with other normals or uvs,
+        // as at the corners of a cube
+        vertexes = mesh->positions;
+        std::sort(vertexes.begin(), vertexes.end(), [](const Vec3& a, const Vec3& b) {
+            if(a.x != b.x) {
+                return a.x < b.x;
+            }
+            if(a.y != b.y) {
+                return a.y < b.y;
+            }
+            return a.z < b.z;
+        });
+        vertexes.erase(std::unique(vertexes.begin(), vertexes.end()), vertexes.end());
+        this->mesh_vertexes_ready[mesh_id] = 1;
+    }
+    return vertexes;
+}
+
+void LevelVertexHash::get_entity_vertexes(
+    const LevelDocument& document,
+    uint32_t row,
+    const std::vector<Vec3>* mesh_vertexes,
+    std::vector<Vec3>* vertexes
+) const {
+    vertexes->clear();
+    if(document.flags[row] & LevelEntityFlags_Hidden) {
+        return;
+    }
+    const Vec3 position = document.positions[row];
+    // Entities without a mesh are points
+    if(document.meshes[row] == LevelMeshId_None) {
+        vertexes->push_back(position);
+        return;
+    }
+    const Quat rotation = document.rotations[row];
+    const Vec3 scale = document.scales[row];
+    vertexes->reserve(mesh_vertexes->size());
+    for(const Vec3& vertex : *mesh_vertexes) {
+        vertexes->push_back(position + Quat_Rotate(rotation, vertex * scale));
+    }
+}
+
+void LevelVertexHash::add_point(const Vec3& position, LevelHandle handle) {
+    uint32_t index;
+    if(!this->free_points.empty()) {
+        index = this->free_points.back();
+        this->free_points.pop_back();
+    } else {
+        index = (uint32_t) this->points.size();
+        this->points.emplace_back();
+    }
+    LevelVertexHashPoint& point = this->points[index];
+    point.position = position;
+    point.handle = handle;
+    point.cell = this->get_cell_key(position);
+    this->cells[point.cell].push_back(index);
+    if(handle.index >= this->entity_points.size()) {
+        this->entity_points.resize(handle.index + 1);
+    }
+    this->entity_points[handle.index].push_back(index);
+}
+
+void LevelVertexHash::remove_entity(uint32_t index) {
+    if(index >= this->entity_points.size()) {
+        return;
+    }
+    for(const uint32_t point_index : this->entity_points[index]) {
+        LevelVertexHashPoint& point = this->points[point_index];
+        const auto found = this->cells.find(point.cell);
+        if(found != this->cells.end()) {
+            std::vector<uint32_t>& indexes = found->second;
+            const auto position = std::find(indexes.begin(), indexes.end(), point_index);
+            if(position != indexes.end()) {
+                *position = indexes.back();
+                indexes.pop_back();
+            }
+            if(indexes.empty()) {
+                this->cells.erase(found);
+            }
+        }
+        point.handle = LevelHandle_None;
+        this->free_points.push_back(point_index);
+    }
+    this->entity_points[index].clear();
+}
+
+template<typename Fn>
+void LevelVertexHash::visit_cell(int64_t x, int64_t y, int64_t z, Fn&& fn) const {
+    if(
+        !LevelVertexHash_IsCoordValid(x) ||
+        !LevelVertexHash_IsCoordValid(y) ||
+        !LevelVertexHash_IsCoordValid(z)
+    ) {
+        return;
+    }
+    const auto found = this->cells.find(LevelVertexHash_GetKey(x, y, z));
+    if(found == this->cells.end()) {
+        return;
+    }
+    for(const uint32_t index : found->second) {
+        fn(this->points[index]);
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "document.hpp"
+#include "jobs/job_system.hpp"
+#include "util/math.hpp"
+
+// Vertex found by a LevelVertexHash query.
+struct LevelVertexHit {
+    Vec3 position;
+    LevelHandle handle = LevelHandle_None;
+    float distance_squared = INFINITY;
+};
+
+// World-space vertex stored in a LevelVertexHash.
+struct LevelVertexHashPoint {
+    Vec3 position;
+    LevelHandle handle = LevelHandle_None;
+    // Key of the cell the point is in
+    uint64_t cell = 0;
+};
+
+/**
+ * Finds the level vertexes near a point, for snapping to them.
+ * 
+ * Every distinct vertex of each visible entity's mesh is kept in
+ * world space, in a hash of cubic cells keyed by their integer
+ * coordinates. A query only visits the cells which overlap its
+ * sphere, or for nearest queries, cells in shells of growing size
+ * around the point until no closer vertex can be left, so its cost
+ * follows the density of vertexes near the point rather than the
+ * size of the level.
+ * 
+ * Entities are marked as changed when the journal reports edits
+ * to them, and update moves only their vertexes. The first update,
+ * and the first after the document is replaced or the cell size
+ * changes, rebuilds everything, transforming vertexes in parallel.
+ */
+class LevelVertexHash {
+public:
+    LevelVertexHash() {};
+    LevelVertexHash(JobSystem* jobs): jobs(jobs) {};
+    LevelVertexHash(const LevelVertexHash&) = delete;
+    LevelVertexHash& operator=(const LevelVertexHash&) = delete;
+    LevelVertexHash& operator=(LevelVertexHash&& other) = default;
+    
+    JobSystem* jobs = nullptr;
+    // Width of each cell, in world units. Queries are fastest when
+    // their radius is about this size.
+    float cell_size = 1.0f;
+    
+    // Note entities which were changed, created or destroyed since
+    // the last update. Null handles mark everything, as when the
+    // journal is cleared. Fits LevelJournalListener.
+    void mark_changed(const LevelHandle* handles, uint32_t count);
+    // Bring the vertexes of changed entities up to date.
+    void update(const LevelDocument& document);
+    // Find every vertex within a distance of a point, adding them
+    // to hits in no particular order. Vertexes of the ignored
+    // entity, such as one being dragged, are skipped. Returns the
+    // number found.
+    uint32_t find_in_radius(
+        const Vec3& center,
+        float radius,
+        std::vector<LevelVertexHit>* hits,
+        LevelHandle ignore = LevelHandle_None
+    ) const;
+    // Find up to count vertexes nearest to a point and within a
+    // distance of it, nearest first. Returns the number found.
+    uint32_t find_nearest(
+        const Vec3& center,
+        uint32_t count,
+        float max_distance,
+        LevelVertexHit* hits,
+        LevelHandle ignore = LevelHandle_None
+    ) const;
+    uint32_t get_point_count() const {
+        return (uint32_t) (this->points.size() - this->free_points.size());
+    }
+    
+private:
+    bool all_changed = true;
+    std::vector<LevelHandle> changed_entities;
+    float built_cell_size = 0.0f;
+    std::vector<LevelVertexHashPoint> points;
+    std::vector<uint32_t> free_points;
+    // Indexes of the points in each cell, by cell key
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+    // Indexes of each entity's points, by handle index
+    std::vector<std::vector<uint32_t>> entity_points;
+    // Distinct positions of each mesh, by mesh id, filled in when
+    // first needed
+    std::vector<std::vector<Vec3>> mesh_vertexes;
+    std::vector<uint8_t> mesh_vertexes_ready;
+    
+    uint64_t get_cell_key(const Vec3& position) const;
+    // Get the distinct positions of a mesh.
+    const std::vector<Vec3>& get_mesh_vertexes(const LevelDocument& document, LevelMeshId mesh);
+    // Get the world-space vertexes of the entity in a row.
+    void get_entity_vertexes(
+        const LevelDocument& document,
+        uint32_t row,
+        const std::vector<Vec3>* mesh_vertexes,
+        std::vector<Vec3>* vertexes
+    ) const;
+    void add_point(const Vec3& position, LevelHandle handle);
+    void remove_entity(uint32_t index);
+    // Check the points of one cell against a query.
+    template<typename Fn>
+    void visit_cell(int64_t x, int64_t y, int64_t z, Fn&& fn) const;
+};
@@ -0,0 +1,101 @@
+#include "bake_command.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+
+#include "baker.hpp"
+#include "level/level_file.hpp"
+#include "util/log.hpp"
+
+// Write a page's mesh, with lightmap coordinates, as an OBJ file.
+static bool LightmapBakeCommand_WriteObj(const LightmapPage& page, const char* path) {
+    FILE* file = std::fopen(path, "wb");
+    if(!file) {
+        return false;
+    }
+    for(const auto& position : page.mesh.positions) {
+        std::fprintf(file, "v %g %g %g\n", position.x, position.y, position.z);
+    }
+    // OBJ texture coordinates start at the bottom of the image
+    for(const auto& uv : page.mesh.uvs) {
+        std::fprintf(file, "vt %g %g\n", uv.x, 1.0f - uv.y);
+    }
+    for(size_t i = 0; i + 2 < page.mesh.indices.size(); i += 3) {
+        const uint32_t a = page.mesh.indices[i] + 1;
+        const uint32_t b = page.mesh.indices[i + 1] + 1;
+        const uint32_t c = page.mesh.indices[i + 2] + 1;
+        std::fprintf(file, "f %u/%u %u/%u %u/%u\n", a, a, b, b, c, c);
+    }
+    return std::fclose(file) == 0;
+}
+
+int LightmapBakeCommand_Run(int argc, char** argv) {
+    Log_Init();
+    Log_SetLevelAll(LogLevel_Info);
+    if(argc < 2) {
+        UNI_LOG_ERROR(
+            LogSubsystem_General,
+            "Usage: {} <level file> <output directory> [max passes]",
+            LightmapBakeCommand_Argument
+        );
+        Log_Conclude();
+        return 2;
+    }
+    const char* level_path = argv[0];
+    const std::filesystem::path output_directory = argv[1];
+    const uint32_t max_passes = argc >= 3 ? (uint32_t) std::strtoul(argv[2], nullptr, 10) : UINT32_MAX;
+    LevelDocument document;
+    if(!LevelFile_Open(&document, level_path)) {
+        Log_Conclude();
+        return 1;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(output_directory, error);
+    if(error) {
+        UNI_LOG_ERROR(
+            LogSubsystem_General, "Failed to create {}: {}",
+            output_directory.string(), error.message()
+        );
+        Log_Conclude();
+        return 1;
+    }
+    JobSystem jobs;
+    jobs.init();
+    LightmapBaker baker(&jobs);
+    std::vector<LightmapSource> sources;
+    Lightmap_GatherEntitySources(document, baker, &sources);
+    UNI_LOG_INFO(LogSubsystem_General, "Baking lightmaps for {} entities.", sources.size());
+    baker.set_sources(std::move(sources));
+    baker.bake(max_passes);
+    jobs.conclude();
+    int result = 0;
+    std::vector<uint8_t> pixels;
+    for(const auto& page : baker.get_pages()) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) page->key);
+        const std::string image_path = (output_directory / (std::string(name) + ".png")).string();
+        const std::string obj_path = (output_directory / (std::string(name) + ".obj")).string();
+        pixels.resize((size_t) page->width * page->height * 4);
+        page->get_pixels(baker.settings.exposure, pixels.data());
+        RaylibImage image = RaylibImage{
+            pixels.data(), (int) page->width, (int) page->height,
+            1, RAYLIB_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+        };
+        if(!RaylibExportImage(image, image_path.c_str()) || !LightmapBakeCommand_WriteObj(*page, obj_path.c_str())) {
+            UNI_LOG_ERROR(LogSubsystem_General, "Failed to write the lightmap of page {}.", name);
+            result = 1;
+        }
+    }
+    UNI_LOG_INFO(
+        LogSubsystem_General, "Wrote {} lightmaps to {} after {} passes{}.",
+        baker.get_pages().size(), output_directory.string(), baker.get_pass_count(),
+        baker.is_converged() ? "" : ", before converging"
+    );
+    Log_Conclude();
+    return result;
+}
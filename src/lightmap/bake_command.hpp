@@ -0,0 +1,19 @@
+#pragma once
+
+// Argument which runs the lightmap bake command instead of the
+// editor.
+const char* const LightmapBakeCommand_Argument = "--bake-lightmaps";
+
+/**
+ * Bake lightmaps for a level without opening a window, as on a
+ * build machine. Arguments follow LightmapBakeCommand_Argument:
+ * 
+ *     <level file> <output directory> [max passes]
+ * 
+ * Every visible entity with a mesh gets a page, lit by the sky,
+ * since levels don't store lights yet. Each page is written as a
+ * PNG image, with an OBJ of the entity's triangles in world space
+ * whose texture coordinates address the image.
+ * Returns the process exit code.
+ */
+int LightmapBakeCommand_Run(int argc, char** argv);
@@ -0,0 +1,942 @@
+#include "baker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "util/hash.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Texels of padding around each chart, so that filtering at the
+// edge of a chart doesn't blend in its neighbours
+const uint32_t Lightmap_ChartPadding = 1;
+// Times the texel density is halved to fit a page before giving up
+const int Lightmap_MaxFitAttempts = 12;
+// Tiles baked by one job of a pass
+const uint32_t Lightmap_TilesPerJob = 4;
+
+// Flat group of triangles unwrapped together.
+struct LightmapChart {
+    uint32_t first_triangle = 0;
+    uint32_t triangle_count = 0;
+    Vec3 normal;
+    Vec3 axis_u;
+    Vec3 axis_v;
+    float min_u = 0.0f;
+    float min_v = 0.0f;
+    float max_u = 0.0f;
+    float max_v = 0.0f;
+    // Size and position in the page, in texels, with padding
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+};
+
+// Get two unit axes on a plane, such that the cross product of the
+// first and second is the normal.
+static void Lightmap_GetAxes(const Vec3& normal, Vec3* u, Vec3* v) {
+    const Vec3 other = (
+        std::fabs(normal.x) < 0.9f ? Vec3{1.0f, 0.0f, 0.0f} : Vec3{0.0f, 1.0f, 0.0f}
+    );
+    *v = Vec3_Normalize(Vec3_Cross(normal, other));
+    *u = Vec3_Cross(*v, normal);
+}
+
+static float Lightmap_Cross2(const Vec2& a, const Vec2& b, const Vec2& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+static Vec2 Lightmap_ClosestOnSegment(const Vec2& p, const Vec2& a, const Vec2& b) {
+    const float dx = b.x - a.x;
+    const float dy = b.y - a.y;
+    const float length_squared = dx * dx + dy * dy;
+    float t = length_squared > 0.0f ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / length_squared : 0.0f;
+    t = std::clamp(t, 0.0f, 1.0f);
+    return Vec2{a.x + dx * t, a.y + dy * t};
+}
+
+// Get the point of a 2D triangle nearest to p.
+static Vec2 Lightmap_ClosestOnTriangle(const Vec2& p, const Vec2& a, const Vec2& b, const Vec2& c) {
+    const float d0 = Lightmap_Cross2(a, b, p);
+    const float d1 = Lightmap_Cross2(b, c, p);
+    const float d2 = Lightmap_Cross2(c, a, p);
+    const bool has_negative = d0 < 0.0f || d1 < 0.0f || d2 < 0.0f;
+    const bool has_positive = d0 > 0.0f || d1 > 0.0f || d2 > 0.0f;
+    if(!(has_negative && has_positive)) {
+        return p;
+    }
+    Vec2 best = Lightmap_ClosestOnSegment(p, a, b);
+    float best_distance = (best.x - p.x) * (best.x - p.x) + (best.y - p.y) * (best.y - p.y);
+    for(const Vec2 candidate : {Lightmap_ClosestOnSegment(p, b, c), Lightmap_ClosestOnSegment(p, c, a)}) {
+        const float distance = (
+            (candidate.x - p.x) * (candidate.x - p.x) + (candidate.y - p.y) * (candidate.y - p.y)
+        );
+        if(distance < best_distance) {
+            best = candidate;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+// Place charts in rows, tallest first. Returns false if they don't
+// fit in the largest page allowed.
+static bool Lightmap_PackCharts(
+    std::vector<LightmapChart>* charts,
+    uint32_t max_size,
+    uint32_t* width,
+    uint32_t* height
+) {
+    uint64_t area = 0;
+    uint32_t widest = 0;
+    for(const auto& chart : *charts) {
+        area += (uint64_t) chart.width * chart.height;
+        widest = std::max(widest, chart.width);
+    }
+    // Aim for a roughly square page, with some room for the gaps
+    // left at the ends of rows
+    *width = std::max(widest, (uint32_t) std::ceil(std::sqrt((double) area * 1.15)));
+    *width = (*width + 3) & ~3u;
+    if(*width > max_size) {
+        return false;
+    }
+    std::vector<uint32_t> order(charts->size());
+    for(uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [charts](uint32_t a, uint32_t b) {
+        return (*charts)[a].height > (*charts)[b].height;
+    });
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t row_height = 0;
+    for(const uint32_t index : order) {
+        LightmapChart& chart = (*charts)[index];
+        if(x + chart.width > *width) {
+            x = 0;
+            y += row_height;
+            row_height = 0;
+        }
+        chart.x = x;
+        chart.y = y;
+        x += chart.width;
+        row_height = std::max(row_height, chart.height);
+    }
+    *height = ((y + row_height) + 3) & ~3u;
+    return *height <= max_size;
+}
+
+std::unique_ptr<LightmapPage> LightmapPage_Create(
+    uint64_t key,
+    uint64_t signature,
+    const LevelMesh& mesh,
+    const LightmapSettings& settings
+) {
+    UNI_PROFILE_ZONE("LightmapPage_Create");
+    auto page = std::make_unique<LightmapPage>();
+    page->key = key;
+    page->signature = signature;
+    page->mesh.name = mesh.name;
+    const uint32_t triangle_count = (uint32_t) (mesh.indices.size() / 3);
+    // Group the triangles of each flat fan into a chart
+    std::vector<LightmapChart> charts;
+    uint32_t chart_first_vertex = UINT32_MAX;
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        const Vec3& a = mesh.positions[mesh.indices[t * 3 + 0]];
+        const Vec3& b = mesh.positions[mesh.indices[t * 3 + 1]];
+        const Vec3& c = mesh.positions[mesh.indices[t * 3 + 2]];
+        const Vec3 cross = Vec3_Cross(b - a, c - a);
+        const float length = Vec3_Length(cross);
+        const bool degenerate = length < 1e-12f;
+        const Vec3 normal = degenerate ? Vec3{0.0f, 1.0f, 0.0f} : cross * (1.0f / length);
+        if(
+            !charts.empty() &&
+            mesh.indices[t * 3] == chart_first_vertex &&
+            (degenerate || Vec3_Dot(normal, charts.back().normal) > 0.999f)
+        ) {
+            charts.back().triangle_count++;
+            continue;
+        }
+        LightmapChart chart;
+        chart.first_triangle = t;
+        chart.triangle_count = 1;
+        chart.normal = normal;
+        Lightmap_GetAxes(normal, &chart.axis_u, &chart.axis_v);
+        charts.push_back(chart);
+        chart_first_vertex = mesh.indices[t * 3];
+    }
+    for(auto& chart : charts) {
+        chart.min_u = chart.min_v = INFINITY;
+        chart.max_u = chart.max_v = -INFINITY;
+        for(uint32_t i = chart.first_triangle * 3; i < (chart.first_triangle + chart.triangle_count) * 3; ++i) {
+            const Vec3& position = mesh.positions[mesh.indices[i]];
+            const float u = Vec3_Dot(position, chart.axis_u);
+            const float v = Vec3_Dot(position, chart.axis_v);
+            chart.min_u = std::min(chart.min_u, u);
+            chart.min_v = std::min(chart.min_v, v);
+            chart.max_u = std::max(chart.max_u, u);
+            chart.max_v = std::max(chart.max_v, v);
+        }
+    }
+    // Fewer texels per unit for sources too large to fit
+    float density = settings.texels_per_unit;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    for(int attempt = 0; ; ++attempt) {
+        for(auto& chart : charts) {
+            chart.width = (uint32_t) std::ceil((chart.max_u - chart.min_u) * density) + 1 + 2 * Lightmap_ChartPadding;
+            chart.height = (uint32_t) std::ceil((chart.max_v - chart.min_v) * density) + 1 + 2 * Lightmap_ChartPadding;
+        }
+        if(Lightmap_PackCharts(&charts, settings.max_page_size, &width, &height)) {
+            break;
+        }
+        if(attempt + 1 >= Lightmap_MaxFitAttempts) {
+            UNI_LOG_WARN(
+                LogSubsystem_Level,
+                "Lightmap of '{}' is {}x{}, larger than the {} allowed.",
+                mesh.name.c_str(), width, height, settings.max_page_size
+            );
+            break;
+        }
+        density *= 0.5f;
+    }
+    page->width = width;
+    page->height = height;
+    const size_t texel_count = (size_t) width * height;
+    page->texel_positions.assign(texel_count, Vec3());
+    page->texel_normals.assign(texel_count, Vec3());
+    page->light_sums.assign(texel_count, Vec3());
+    page->sample_counts.assign(texel_count, 0);
+    // Copy the vertexes of each chart, with their lightmap uvs
+    std::vector<uint32_t> vertex_charts(mesh.positions.size(), UINT32_MAX);
+    std::vector<uint32_t> vertex_copies(mesh.positions.size());
+    page->mesh.indices.resize(mesh.indices.size());
+    const bool has_normals = mesh.normals.size() == mesh.positions.size();
+    const float texel_size = 1.0f / density;
+    for(uint32_t chart_index = 0; chart_index < charts.size(); ++chart_index) {
+        const LightmapChart& chart = charts[chart_index];
+        const uint32_t begin = chart.first_triangle * 3;
+        const uint32_t end = (chart.first_triangle + chart.triangle_count) * 3;
+        for(uint32_t i = begin; i < end; ++i) {
+            const uint32_t vertex = mesh.indices[i];
+            if(vertex_charts[vertex] != chart_index) {
+                vertex_charts[vertex] = chart_index;
+                vertex_copies[vertex] = (uint32_t) page->mesh.positions.size();
+                const Vec3& position = mesh.positions[vertex];
+                page->mesh.positions.push_back(position);
+                page->mesh.normals.push_back(has_normals ? mesh.normals[vertex] : chart.normal);
+                const float u = (Vec3_Dot(position, chart.axis_u) - chart.min_u) * density;
+                const float v = (Vec3_Dot(position, chart.axis_v) - chart.min_v) * density;
+                page->mesh.uvs.push_back(Vec2{
+                    ((float) (chart.x + Lightmap_ChartPadding) + u + 0.5f) / (float) width,
+                    ((float) (chart.y + Lightmap_ChartPadding) + v + 0.5f) / (float) height
+                });
+            }
+            page->mesh.indices[i] = vertex_copies[vertex];
+        }
+        // Find the surface point of each texel. Texels whose centers
+        // are off the chart take the nearest point on it, so that
+        // filtering at the chart's edge reads lit texels.
+        const float plane_distance = Vec3_Dot(mesh.positions[mesh.indices[begin]], chart.normal);
+        for(uint32_t ty = 0; ty < chart.height; ++ty) {
+            for(uint32_t tx = 0; tx < chart.width; ++tx) {
+                const Vec2 point = Vec2{
+                    chart.min_u + ((float) tx - (float) Lightmap_ChartPadding) * texel_size,
+                    chart.min_v + ((float) ty - (float) Lightmap_ChartPadding) * texel_size
+                };
+                Vec2 nearest;
+                float nearest_distance = INFINITY;
+                for(uint32_t i = begin; i < end && nearest_distance > 0.0f; i += 3) {
+                    Vec2 corners[3];
+                    for(int k = 0; k < 3; ++k) {
+                        const Vec3& position = mesh.positions[mesh.indices[i + k]];
+                        corners[k] = Vec2{
+                            Vec3_Dot(position, chart.axis_u), Vec3_Dot(position, chart.axis_v)
+                        };
+                    }
+                    const Vec2 closest = Lightmap_ClosestOnTriangle(
+                        point, corners[0], corners[1], corners[2]
+                    );
+                    const float distance = (
+                        (closest.x - point.x) * (closest.x - point.x) +
+                        (closest.y - point.y) * (closest.y - point.y)
+                    );
+                    if(distance < nearest_distance) {
+                        nearest = closest;
+                        nearest_distance = distance;
+                    }
+                }
+                const float reach = 1.5f * texel_size * (float) Lightmap_ChartPadding;
+                if(nearest_distance > reach * reach) {
+                    continue;
+                }
+                const size_t texel = (size_t) (chart.y + ty) * width + chart.x + tx;
+                page->texel_positions[texel] = (
+                    chart.axis_u * nearest.x + chart.axis_v * nearest.y + chart.normal * plane_distance
+                );
+                page->texel_normals[texel] = chart.normal;
+            }
+        }
+    }
+    page->mesh.update_bounds();
+    return page;
+}
+
+void LightmapPage::get_pixels(float exposure, uint8_t* rgba) const {
+    const size_t texel_count = (size_t) this->width * this->height;
+    for(size_t i = 0; i < texel_count; ++i) {
+        const uint32_t count = this->sample_counts[i];
+        const Vec3 light = count ? this->light_sums[i] * (exposure / (float) count) : Vec3();
+        rgba[i * 4 + 0] = (uint8_t) (std::clamp(light.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+        rgba[i * 4 + 1] = (uint8_t) (std::clamp(light.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+        rgba[i * 4 + 2] = (uint8_t) (std::clamp(light.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+std::shared_ptr<LightmapScene> LightmapScene_Build(
+    const std::vector<LightmapSource>& sources,
+    const std::unordered_map<uint64_t, uint64_t>& previous_signatures,
+    const LightmapSettings& settings
+) {
+    UNI_PROFILE_ZONE("LightmapScene_Build");
+    auto scene = std::make_shared<LightmapScene>();
+    for(const auto& source : sources) {
+        if(!source.mesh) {
+            continue;
+        }
+        scene->meshes.push_back(source.mesh);
+        scene->keys.push_back(source.key);
+        scene->signatures.push_back(source.signature);
+        const auto previous = previous_signatures.find(source.key);
+        if(previous != previous_signatures.end() && previous->second == source.signature) {
+            scene->pages.push_back(nullptr);
+        }
+        else {
+            scene->pages.push_back(LightmapPage_Create(
+                source.key, source.signature, *source.mesh, settings
+            ));
+        }
+        // Add the source's triangles to the ones rays are traced
+        // against
+        const LevelMesh& mesh = *source.mesh;
+        const uint32_t base = (uint32_t) scene->combined.positions.size();
+        scene->combined.positions.insert(
+            scene->combined.positions.end(), mesh.positions.begin(), mesh.positions.end()
+        );
+        for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const Vec3& a = mesh.positions[mesh.indices[i]];
+            const Vec3& b = mesh.positions[mesh.indices[i + 1]];
+            const Vec3& c = mesh.positions[mesh.indices[i + 2]];
+            scene->triangle_normals.push_back(Vec3_Normalize(Vec3_Cross(b - a, c - a)));
+            for(int k = 0; k < 3; ++k) {
+                scene->combined.indices.push_back(base + mesh.indices[i + k]);
+            }
+        }
+    }
+    scene->combined.update_bounds();
+    scene->bvh.build(scene->combined);
+    return scene;
+}
+
+void LightmapBaker::set_sources(std::vector<LightmapSource> sources) {
+    std::unordered_map<uint64_t, LightmapSource> by_key;
+    for(auto& source : sources) {
+        if(!source.mesh) {
+            // Unchanged, so the mesh given last time still applies
+            const auto previous = this->sources.find(source.key);
+            if(previous == this->sources.end() || previous->second.signature != source.signature) {
+                UNI_LOG_WARN(
+                    LogSubsystem_Level,
+                    "Lightmap source {:x} has no mesh and was not given before.", source.key
+                );
+                continue;
+            }
+            source.mesh = previous->second.mesh;
+        }
+        by_key[source.key] = source;
+    }
+    this->sources = std::move(by_key);
+    this->pending_sources = std::make_shared<std::vector<LightmapSource>>(std::move(sources));
+    std::erase_if(*this->pending_sources, [](const LightmapSource& source) {
+        return !source.mesh;
+    });
+}
+
+bool LightmapBaker::has_source(uint64_t key, uint64_t signature) const {
+    const auto found = this->sources.find(key);
+    return found != this->sources.end() && found->second.signature == signature;
+}
+
+void LightmapBaker::reset() {
+    this->cancel();
+    if(!this->scene) {
+        return;
+    }
+    for(auto& page : this->scene->pages) {
+        std::fill(page->light_sums.begin(), page->light_sums.end(), Vec3());
+        std::fill(page->sample_counts.begin(), page->sample_counts.end(), 0);
+        page->revision++;
+    }
+    this->count_remaining();
+    this->revision++;
+}
+
+void LightmapBaker::update() {
+    if(!this->jobs) {
+        this->bake(1);
+        return;
+    }
+    if(this->busy) {
+        return;
+    }
+    if(this->pending_sources) {
+        // Rebuild from the latest sources. If more are given before
+        // this finishes, they are built after it.
+        auto sources = this->pending_sources;
+        auto previous_signatures = std::make_shared<std::unordered_map<uint64_t, uint64_t>>();
+        if(this->scene) {
+            for(const auto& page : this->scene->pages) {
+                (*previous_signatures)[page->key] = page->signature;
+            }
+        }
+        auto result = std::make_shared<std::shared_ptr<LightmapScene>>();
+        const LightmapSettings settings = this->settings;
+        const uint32_t generation = this->generation;
+        this->busy = true;
+        this->job = this->jobs->submit(
+            [sources, previous_signatures, result, settings]() {
+                *result = LightmapScene_Build(*sources, *previous_signatures, settings);
+            },
+            {},
+            [this, sources, result, generation]() {
+                if(generation != this->generation) {
+                    return;
+                }
+                this->busy = false;
+                if(this->pending_sources == sources) {
+                    this->pending_sources.reset();
+                }
+                this->install_scene(std::move(*result));
+            }
+        );
+        return;
+    }
+    if(this->scene && !this->is_converged()) {
+        this->start_pass();
+    }
+}
+
+void LightmapBaker::bake(uint32_t pass_count) {
+    UNI_PROFILE_ZONE("LightmapBaker::bake");
+    this->cancel();
+    if(this->pending_sources) {
+        std::unordered_map<uint64_t, uint64_t> previous_signatures;
+        if(this->scene) {
+            for(const auto& page : this->scene->pages) {
+                previous_signatures[page->key] = page->signature;
+            }
+        }
+        auto scene = LightmapScene_Build(*this->pending_sources, previous_signatures, this->settings);
+        this->pending_sources.reset();
+        this->install_scene(std::move(scene));
+    }
+    for(uint32_t pass = 0; pass < pass_count && this->scene && !this->is_converged(); ++pass) {
+        LightmapScene* scene = this->scene.get();
+        const uint32_t tile_count = (uint32_t) scene->tiles.size();
+        this->begin_pass();
+        if(this->jobs) {
+            this->jobs->parallel_for((int) tile_count, (int) Lightmap_TilesPerJob, [&](int begin, int end) {
+                this->run_tiles(scene, (uint32_t) begin, (uint32_t) end);
+            });
+        }
+        else {
+            this->run_tiles(scene, 0, tile_count);
+        }
+        this->finish_pass();
+    }
+}
+
+void LightmapBaker::cancel() {
+    if(this->busy && this->jobs) {
+        this->jobs->wait(this->job);
+    }
+    this->job = JobHandle_None;
+    this->busy = false;
+    this->generation++;
+}
+
+bool LightmapBaker::is_converged() const {
+    return !this->pending_sources && this->unconverged_count == 0;
+}
+
+const LightmapPage* LightmapBaker::find_page(uint64_t key) const {
+    const auto found = this->page_indexes.find(key);
+    return found == this->page_indexes.end() ? nullptr : this->scene->pages[found->second].get();
+}
+
+const std::vector<std::unique_ptr<LightmapPage>>& LightmapBaker::get_pages() const {
+    static const std::vector<std::unique_ptr<LightmapPage>> empty;
+    return this->scene ? this->scene->pages : empty;
+}
+
+// Get the squared distance from a point to a box, which is zero
+// inside it.
+static float Lightmap_GetDistanceSquared(const Bounds3& bounds, const Vec3& point) {
+    const Vec3 nearest = Vec3_Min(Vec3_Max(point, bounds.min), bounds.max);
+    const Vec3 offset = point - nearest;
+    return Vec3_Dot(offset, offset);
+}
+
+void LightmapBaker::install_scene(std::shared_ptr<LightmapScene> scene) {
+    UNI_PROFILE_ZONE("LightmapBaker::install_scene");
+    // Bounds of sources which were added, removed, or changed, as
+    // they are now and as they were
+    std::vector<Bounds3> changed_bounds;
+    std::unordered_map<uint64_t, std::unique_ptr<LightmapPage>> previous_pages;
+    if(this->scene) {
+        for(auto& page : this->scene->pages) {
+            previous_pages[page->key] = std::move(page);
+        }
+    }
+    std::vector<uint8_t> reused(scene->pages.size(), 0);
+    for(size_t i = 0; i < scene->pages.size(); ++i) {
+        auto previous = previous_pages.find(scene->keys[i]);
+        if(!scene->pages[i] && previous == previous_pages.end()) {
+            // The page to reuse is gone, as when the scene was built
+            // against one which was since replaced
+            scene->pages[i] = LightmapPage_Create(
+                scene->keys[i], scene->signatures[i], *scene->meshes[i], this->settings
+            );
+        }
+        else if(!scene->pages[i]) {
+            scene->pages[i] = std::move(previous->second);
+            previous_pages.erase(previous);
+            reused[i] = 1;
+            continue;
+        }
+        changed_bounds.push_back(scene->meshes[i]->bounds);
+        if(previous != previous_pages.end()) {
+            changed_bounds.push_back(previous->second->mesh.bounds);
+            previous_pages.erase(previous);
+        }
+    }
+    for(const auto& [key, page] : previous_pages) {
+        changed_bounds.push_back(page->mesh.bounds);
+    }
+    // Light arriving at texels near a change may have changed too
+    const float reach_squared = this->settings.influence_distance * this->settings.influence_distance;
+    for(size_t i = 0; i < scene->pages.size(); ++i) {
+        LightmapPage* page = scene->pages[i].get();
+        if(!reused[i] || changed_bounds.empty()) {
+            continue;
+        }
+        bool page_reset = false;
+        for(size_t texel = 0; texel < page->texel_positions.size(); ++texel) {
+            if(page->sample_counts[texel] == 0) {
+                continue;
+            }
+            for(const auto& bounds : changed_bounds) {
+                if(Lightmap_GetDistanceSquared(bounds, page->texel_positions[texel]) <= reach_squared) {
+                    page->light_sums[texel] = Vec3();
+                    page->sample_counts[texel] = 0;
+                    page_reset = true;
+                    break;
+                }
+            }
+        }
+        page->revision += page_reset ? 1 : 0;
+    }
+    // Divide pages into tiles, skipping tiles with no texels
+    const uint32_t tile_size = std::max(1u, this->settings.tile_size);
+    this->page_indexes.clear();
+    for(uint32_t page_index = 0; page_index < scene->pages.size(); ++page_index) {
+        const LightmapPage& page = *scene->pages[page_index];
+        this->page_indexes[page.key] = page_index;
+        for(uint32_t y = 0; y < page.height; y += tile_size) {
+            for(uint32_t x = 0; x < page.width; x += tile_size) {
+                const LightmapTile tile = LightmapTile{
+                    page_index, x, y,
+                    std::min(tile_size, page.width - x),
+                    std::min(tile_size, page.height - y)
+                };
+                bool any_texel = false;
+                for(uint32_t ty = tile.y; ty < tile.y + tile.height && !any_texel; ++ty) {
+                    for(uint32_t tx = tile.x; tx < tile.x + tile.width && !any_texel; ++tx) {
+                        const Vec3& normal = page.texel_normals[(size_t) ty * page.width + tx];
+                        any_texel = normal.x != 0.0f || normal.y != 0.0f || normal.z != 0.0f;
+                    }
+                }
+                if(any_texel) {
+                    scene->tiles.push_back(tile);
+                }
+            }
+        }
+    }
+    scene->tile_remaining.assign(scene->tiles.size(), 0);
+    this->scene = std::move(scene);
+    this->count_remaining();
+    this->revision++;
+    UNI_LOG_DEBUG(
+        LogSubsystem_Level, "Lightmap scene has {} pages, {} tiles, and {} texels to bake.",
+        this->scene->pages.size(), this->scene->tiles.size(), this->unconverged_count
+    );
+}
+
+void LightmapBaker::count_remaining() {
+    LightmapScene* scene = this->scene.get();
+    this->unconverged_count = 0;
+    for(size_t i = 0; i < scene->tiles.size(); ++i) {
+        const LightmapTile& tile = scene->tiles[i];
+        const LightmapPage& page = *scene->pages[tile.page];
+        uint32_t remaining = 0;
+        for(uint32_t y = tile.y; y < tile.y + tile.height; ++y) {
+            for(uint32_t x = tile.x; x < tile.x + tile.width; ++x) {
+                const size_t texel = (size_t) y * page.width + x;
+                const Vec3& normal = page.texel_normals[texel];
+                const bool valid = normal.x != 0.0f || normal.y != 0.0f || normal.z != 0.0f;
+                remaining += valid && page.sample_counts[texel] < this->settings.target_samples ? 1 : 0;
+            }
+        }
+        scene->tile_remaining[i] = remaining;
+        this->unconverged_count += remaining;
+    }
+}
+
+void LightmapBaker::start_pass() {
+    this->begin_pass();
+    auto scene = this->scene;
+    const uint32_t tile_count = (uint32_t) scene->tiles.size();
+    std::vector<JobHandle> handles;
+    for(uint32_t begin = 0; begin < tile_count; begin += Lightmap_TilesPerJob) {
+        const uint32_t end = std::min(tile_count, begin + Lightmap_TilesPerJob);
+        handles.push_back(this->jobs->submit([this, scene, begin, end]() {
+            this->run_tiles(scene.get(), begin, end);
+        }));
+    }
+    const uint32_t generation = this->generation;
+    this->busy = true;
+    this->job = this->jobs->submit(
+        []() {},
+        handles.data(),
+        (int) handles.size(),
+        [this, generation]() {
+            if(generation != this->generation) {
+                return;
+            }
+            this->busy = false;
+            this->finish_pass();
+        }
+    );
+}
+
+// Small fast random number generator, seeded per sample so that
+// results don't depend on which thread traced what.
+struct LightmapRandom {
+    uint64_t state;
+
+    float next() {
+        this->state = this->state * 6364136223846793005ull + 1442695040888963407ull;
+        return (float) (uint32_t) (this->state >> 40) * (1.0f / 16777216.0f);
+    }
+};
+
+// Pick a direction around a normal, more often near it, in
+// proportion to the cosine of the angle to it.
+static Vec3 Lightmap_SampleCosine(const Vec3& normal, LightmapRandom* random) {
+    const float angle = 2.0f * std::numbers::pi_v<float> * random->next();
+    const float radius_squared = random->next();
+    const float radius = std::sqrt(radius_squared);
+    Vec3 u;
+    Vec3 v;
+    Lightmap_GetAxes(normal, &u, &v);
+    return Vec3_Normalize(
+        u * (radius * std::cos(angle)) +
+        v * (radius * std::sin(angle)) +
+        normal * std::sqrt(std::max(0.0f, 1.0f - radius_squared))
+    );
+}
+
+/**
+ * Trace one path from each active lane's surface point, and add
+ * the light arriving there to result. Light is counted as
+ * irradiance: direct light is weighted by the cosine at the
+ * surface, and each bounce by the albedo. Bounces pick directions
+ * by cosine, which makes the sky's contribution its radiance
+ * times pi.
+ */
+static void Lightmap_TracePacket(
+    const LightmapScene& scene,
+    const LightmapSettings& settings,
+    const std::vector<LightmapLight>& lights,
+    const Vec3* positions,
+    const Vec3* normals,
+    int active,
+    LightmapRandom* randoms,
+    Vec3* results
+) {
+    Vec3 position[4];
+    Vec3 normal[4];
+    float throughput[4];
+    for(int lane = 0; lane < 4; ++lane) {
+        position[lane] = positions[lane];
+        normal[lane] = normals[lane];
+        throughput[lane] = 1.0f;
+        results[lane] = Vec3();
+    }
+    LevelRayPacket packet;
+    for(uint32_t depth = 0; active; ++depth) {
+        for(const auto& light : lights) {
+            Vec3 contributions[4];
+            int shadow_mask = 0;
+            for(int lane = 0; lane < 4; ++lane) {
+                packet.set_ray(lane, Ray3(), 0.0f);
+                if(!(active & (1 << lane))) {
+                    continue;
+                }
+                const Vec3 offset = light.position - position[lane];
+                const float distance = Vec3_Length(offset);
+                if(distance <= settings.ray_bias) {
+                    continue;
+                }
+                const Vec3 direction = offset * (1.0f / distance);
+                const float cosine = Vec3_Dot(normal[lane], direction);
+                if(cosine <= 0.0f) {
+                    continue;
+                }
+                contributions[lane] = light.color * (throughput[lane] * cosine / (distance * distance));
+                packet.set_ray(
+                    lane,
+                    Ray3{position[lane] + normal[lane] * settings.ray_bias, direction},
+                    distance - settings.ray_bias
+                );
+                shadow_mask |= 1 << lane;
+            }
+            if(!shadow_mask) {
+                continue;
+            }
+            const int lit = shadow_mask & ~scene.bvh.intersect_packet(&packet);
+            for(int lane = 0; lane < 4; ++lane) {
+                if(lit & (1 << lane)) {
+                    results[lane] = results[lane] + contributions[lane];
+                }
+            }
+        }
+        if(depth >= settings.bounce_count) {
+            break;
+        }
+        Vec3 directions[4];
+        for(int lane = 0; lane < 4; ++lane) {
+            packet.set_ray(lane, Ray3(), 0.0f);
+            if(active & (1 << lane)) {
+                directions[lane] = Lightmap_SampleCosine(normal[lane], &randoms[lane]);
+                packet.set_ray(
+                    lane,
+                    Ray3{position[lane] + normal[lane] * settings.ray_bias, directions[lane]},
+                    INFINITY
+                );
+            }
+        }
+        const int hit = scene.bvh.intersect_packet(&packet);
+        for(int lane = 0; lane < 4; ++lane) {
+            if(!(active & (1 << lane))) {
+                continue;
+            }
+            if(!(hit & (1 << lane))) {
+                results[lane] = results[lane] + settings.sky_color * (
+                    throughput[lane] * std::numbers::pi_v<float>
+                );
+                active &= ~(1 << lane);
+                continue;
+            }
+            const Ray3 ray = packet.get_ray(lane);
+            position[lane] = ray.get_point(packet.distance[lane]);
+            // Light leaves the surface on the side the ray came from
+            const Vec3& hit_normal = scene.triangle_normals[packet.triangle[lane]];
+            normal[lane] = Vec3_Dot(hit_normal, directions[lane]) > 0.0f ? hit_normal * -1.0f : hit_normal;
+            throughput[lane] *= settings.albedo;
+        }
+    }
+}
+
+void LightmapBaker::run_tiles(LightmapScene* scene, uint32_t begin, uint32_t end) const {
+    UNI_PROFILE_ZONE("LightmapBaker::run_tiles");
+    const uint32_t target = this->settings.target_samples;
+    for(uint32_t tile_index = begin; tile_index < end; ++tile_index) {
+        if(scene->tile_remaining[tile_index] == 0) {
+            continue;
+        }
+        const LightmapTile& tile = scene->tiles[tile_index];
+        LightmapPage& page = *scene->pages[tile.page];
+        const uint64_t page_seed = hash_combine(Hash_DefaultSeed, page.key);
+        // Neighbouring texels are traced together, so that their
+        // rays to the same light stay close
+        size_t texels[4];
+        int texel_count = 0;
+        uint32_t remaining = 0;
+        auto trace = [&]() {
+            Vec3 positions[4];
+            Vec3 normals[4];
+            uint32_t budgets[4] = {};
+            uint32_t most = 0;
+            for(int lane = 0; lane < texel_count; ++lane) {
+                positions[lane] = page.texel_positions[texels[lane]];
+                normals[lane] = page.texel_normals[texels[lane]];
+                budgets[lane] = std::min(
+                    this->settings.samples_per_pass, target - page.sample_counts[texels[lane]]
+                );
+                most = std::max(most, budgets[lane]);
+            }
+            for(uint32_t sample = 0; sample < most; ++sample) {
+                int active = 0;
+                LightmapRandom randoms[4];
+                for(int lane = 0; lane < texel_count; ++lane) {
+                    if(sample < budgets[lane]) {
+                        active |= 1 << lane;
+                        const size_t texel = texels[lane];
+                        randoms[lane].state = hash_combine(
+                            hash_combine(page_seed, texel), page.sample_counts[texel]
+                        );
+                    }
+                }
+                Vec3 results[4];
+                Lightmap_TracePacket(
+                    *scene, this->settings, this->lights, positions, normals, active, randoms, results
+                );
+                for(int lane = 0; lane < texel_count; ++lane) {
+                    if(active & (1 << lane)) {
+                        page.light_sums[texels[lane]] = page.light_sums[texels[lane]] + results[lane];
+                        page.sample_counts[texels[lane]]++;
+                    }
+                }
+            }
+            for(int lane = 0; lane < texel_count; ++lane) {
+                remaining += page.sample_counts[texels[lane]] < target ? 1 : 0;
+            }
+            texel_count = 0;
+        };
+        for(uint32_t y = tile.y; y < tile.y + tile.height; ++y) {
+            for(uint32_t x = tile.x; x < tile.x + tile.width; ++x) {
+                const size_t texel = (size_t) y * page.width + x;
+                const Vec3& normal = page.texel_normals[texel];
+                if(
+                    (normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f) ||
+                    page.sample_counts[texel] >= target
+                ) {
+                    continue;
+                }
+                texels[texel_count++] = texel;
+                if(texel_count == 4) {
+                    trace();
+                }
+            }
+        }
+        if(texel_count > 0) {
+            trace();
+        }
+        scene->tile_remaining[tile_index] = remaining;
+    }
+}
+
+void LightmapBaker::begin_pass() {
+    const LightmapScene* scene = this->scene.get();
+    this->pass_pages.assign(scene->pages.size(), 0);
+    for(size_t i = 0; i < scene->tiles.size(); ++i) {
+        if(scene->tile_remaining[i] > 0) {
+            this->pass_pages[scene->tiles[i].page] = 1;
+        }
+    }
+}
+
+void LightmapBaker::finish_pass() {
+    LightmapScene* scene = this->scene.get();
+    uint64_t unconverged_count = 0;
+    for(size_t i = 0; i < scene->tiles.size(); ++i) {
+        unconverged_count += scene->tile_remaining[i];
+    }
+    for(size_t i = 0; i < scene->pages.size(); ++i) {
+        scene->pages[i]->revision += this->pass_pages[i];
+    }
+    this->unconverged_count = unconverged_count;
+    this->pass_count++;
+    this->revision++;
+    UNI_PROFILE_COUNTER("Lightmap texels unconverged", (double) unconverged_count);
+    if(unconverged_count == 0) {
+        UNI_LOG_INFO(LogSubsystem_Level, "Lightmaps converged after {} passes.", this->pass_count);
+    }
+}
+
+void Lightmap_GatherCsgSources(
+    const CsgCompiler& csg,
+    const LightmapBaker& baker,
+    std::vector<LightmapSource>* sources
+) {
+    UNI_PROFILE_ZONE("Lightmap_GatherCsgSources");
+    sources->clear();
+    for(const auto& [key, region] : csg.get_regions()) {
+        if(region->mesh.render.indices.empty()) {
+            continue;
+        }
+        LightmapSource source;
+        // Entity keys have the top bit set, and region keys never do
+        source.key = key;
+        source.signature = region->mesh_revision;
+        if(!baker.has_source(source.key, source.signature)) {
+            source.mesh = std::make_shared<LevelMesh>(region->mesh.render);
+        }
+        sources->push_back(std::move(source));
+    }
+}
+
+void Lightmap_GatherEntitySources(
+    const LevelDocument& document,
+    const LightmapBaker& baker,
+    std::vector<LightmapSource>* sources
+) {
+    UNI_PROFILE_ZONE("Lightmap_GatherEntitySources");
+    sources->clear();
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        const LevelMesh* mesh = document.get_mesh(document.meshes[row]);
+        if(!mesh || mesh->indices.empty() || (document.flags[row] & LevelEntityFlags_Hidden)) {
+            continue;
+        }
+        const LevelHandle handle = document.get_handle(row);
+        const Vec3 position = document.positions[row];
+        const Quat rotation = document.rotations[row];
+        const Vec3 scale = document.scales[row];
+        LightmapSource source;
+        source.key = (
+            (1ull << 63) | ((uint64_t) (handle.generation & 0x7fffffffu) << 32) | handle.index
+        );
+        Hasher hasher;
+        hasher.add(document.meshes[row]);
+        hasher.add(mesh->positions.data());
+        hasher.add(mesh->positions.size());
+        hasher.add(position);
+        hasher.add(rotation);
+        hasher.add(scale);
+        source.signature = hasher.hash;
+        if(!baker.has_source(source.key, source.signature)) {
+            auto world = std::make_shared<LevelMesh>();
+            world->name = mesh->name;
+            world->indices = mesh->indices;
+            world->positions.reserve(mesh->positions.size());
+            for(const auto& vertex : mesh->positions) {
+                world->positions.push_back(Quat_Rotate(rotation, vertex * scale) + position);
+            }
+            if(mesh->normals.size() == mesh->positions.size()) {
+                // Normals scale inversely, to stay perpendicular
+                const Vec3 inverse_scale = Vec3{1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z};
+                world->normals.reserve(mesh->normals.size());
+                for(const auto& normal : mesh->normals) {
+                    world->normals.push_back(Vec3_Normalize(Quat_Rotate(rotation, normal * inverse_scale)));
+                }
+            }
+            world->update_bounds();
+            source.mesh = std::move(world);
+        }
+        sources->push_back(std::move(source));
+    }
+}
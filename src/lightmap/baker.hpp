@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "csg/compiler.hpp"
+#include "jobs/job_system.hpp"
+#include "level/bvh.hpp"
+#include "level/document.hpp"
+#include "level/mesh.hpp"
+#include "util/math.hpp"
+
+// Point light, lighting surfaces by its color over the squared
+// distance to them.
+struct LightmapLight {
+    Vec3 position;
+    Vec3 color = Vec3{1.0f, 1.0f, 1.0f};
+};
+
+struct LightmapSettings {
+    // Texels along one world unit of a surface
+    float texels_per_unit = 2.0f;
+    // Pages larger than this along either side are given fewer
+    // texels per unit until they fit
+    uint32_t max_page_size = 1024;
+    // Width and height of the squares of texels which are baked
+    // by one job
+    uint32_t tile_size = 16;
+    // Bounces of indirect light after the direct light
+    uint32_t bounce_count = 2;
+    // Samples taken of each texel by one pass
+    uint32_t samples_per_pass = 4;
+    // Samples after which a texel is converged
+    uint32_t target_samples = 256;
+    // Fraction of incoming light which surfaces reflect
+    float albedo = 0.6f;
+    // Light arriving from rays which hit nothing
+    Vec3 sky_color = Vec3{0.3f, 0.35f, 0.45f};
+    // Texels nearer than this to an edited source are baked again
+    float influence_distance = 16.0f;
+    // Distance rays start off surfaces, so as not to hit them
+    float ray_bias = 1e-2f;
+    // Scale applied to light when converting it to pixels
+    float exposure = 0.5f;
+};
+
+/**
+ * Geometry given to the baker. Sources are told apart by key, and
+ * a source is baked again when its signature changes.
+ */
+struct LightmapSource {
+    uint64_t key = 0;
+    uint64_t signature = 0;
+    // World-space triangles. May be null for a source whose
+    // signature matches the page the baker already has.
+    std::shared_ptr<const LevelMesh> mesh;
+};
+
+/**
+ * Lightmap of one source. Every triangle of the source lies flat
+ * in a chart of texels, with triangles in the same plane and
+ * sharing a first vertex, such as the fans CsgRegion_Compile
+ * emits, sharing one chart.
+ */
+struct LightmapPage {
+    uint64_t key = 0;
+    uint64_t signature = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Source's triangles, in the same order, with vertexes copied
+    // where charts meet and uvs set to lightmap coordinates
+    LevelMesh mesh;
+    // Per texel world-space position and surface normal. The
+    // normal is zero for texels outside every chart.
+    std::vector<Vec3> texel_positions;
+    std::vector<Vec3> texel_normals;
+    // Per texel sum of the light sampled, and number of samples
+    std::vector<Vec3> light_sums;
+    std::vector<uint32_t> sample_counts;
+    // Incremented whenever samples are added or reset
+    uint64_t revision = 0;
+    
+    // Write the average light of each texel as 8-bit RGBA.
+    void get_pixels(float exposure, uint8_t* rgba) const;
+};
+
+// Square of texels baked by one job in a pass.
+struct LightmapTile {
+    uint32_t page = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// Geometry and pages being baked. Replaced, rather than changed,
+// when the sources change.
+struct LightmapScene {
+    std::vector<std::shared_ptr<const LevelMesh>> meshes;
+    // Every source's triangles, for tracing rays against
+    LevelMesh combined;
+    std::vector<Vec3> triangle_normals;
+    LevelMeshBvh bvh;
+    // One per source, in order. Null for sources whose page is
+    // moved over from the previous scene when this one replaces it.
+    std::vector<std::unique_ptr<LightmapPage>> pages;
+    std::vector<LightmapTile> tiles;
+    // Texels left to sample in each tile, written by the job
+    // which baked it
+    std::vector<uint32_t> tile_remaining;
+    // Keys and signatures of the sources
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> signatures;
+};
+
+/**
+ * Bakes the light arriving at level geometry into textures, by
+ * path tracing on the CPU.
+ * 
+ * Each source is unwrapped into a page of texels, and each texel
+ * is sampled by tracing paths from it: direct light from every
+ * light is gathered at the texel and at each bounce, and paths
+ * which escape gather the sky. Texels are traced four at a time,
+ * as packets through a BVH over every source's triangles.
+ * 
+ * Pages are divided into tiles, and each pass runs one job per
+ * group of tiles, adding a few samples to every texel which isn't
+ * converged. Results are visible after every pass, so the image
+ * refines while it is looked at. When sources change, only their
+ * pages are unwrapped again, and texels of other pages near them
+ * start over; the rest keep their samples.
+ */
+class LightmapBaker {
+public:
+    LightmapBaker() {};
+    LightmapBaker(JobSystem* jobs): jobs(jobs) {};
+    LightmapBaker(const LightmapBaker&) = delete;
+    LightmapBaker& operator=(const LightmapBaker&) = delete;
+    LightmapBaker& operator=(LightmapBaker&& other) = default;
+    
+    // Bakes in the background if set
+    JobSystem* jobs = nullptr;
+    LightmapSettings settings;
+    std::vector<LightmapLight> lights;
+    // Incremented whenever any page changes
+    uint64_t revision = 0;
+    
+    // Replace the sources. Unchanged sources keep their pages, and
+    // their meshes may be left null. Takes effect at the next
+    // update or bake.
+    void set_sources(std::vector<LightmapSource> sources);
+    // Returns true if the last sources given include one with
+    // this key and signature.
+    bool has_source(uint64_t key, uint64_t signature) const;
+    // Start over on every texel, as after changing the lights or
+    // settings.
+    void reset();
+    // Start the next step in the background: rebuilding the scene
+    // if the sources changed, and otherwise a pass. Call once per
+    // frame, after JobSystem::update.
+    void update();
+    // Bake on the calling thread, with help from the job system,
+    // until every texel is converged or pass_count passes ran.
+    void bake(uint32_t pass_count);
+    // Wait for the step in the background, and discard its result.
+    void cancel();
+    // Returns true when every texel has its target samples.
+    bool is_converged() const;
+    uint32_t get_pass_count() const {
+        return this->pass_count;
+    }
+    // Get the page of a source, or nullptr if it has none yet.
+    const LightmapPage* find_page(uint64_t key) const;
+    const std::vector<std::unique_ptr<LightmapPage>>& get_pages() const;
+    
+private:
+    std::shared_ptr<LightmapScene> scene;
+    // Last sources given, by key, each with its mesh
+    std::unordered_map<uint64_t, LightmapSource> sources;
+    // Set when the sources changed since the scene was built
+    std::shared_ptr<std::vector<LightmapSource>> pending_sources;
+    // Scene rebuild or pass in the background
+    JobHandle job = JobHandle_None;
+    bool busy = false;
+    uint32_t generation = 0;
+    uint32_t pass_count = 0;
+    // Texels in the scene below their target samples
+    uint64_t unconverged_count = 0;
+    // Index of each page in the scene, by key
+    std::unordered_map<uint64_t, uint32_t> page_indexes;
+    // Set for each page with texels left at the start of a pass
+    std::vector<uint8_t> pass_pages;
+    
+    // Put a newly built scene in place of the current one, moving
+    // over the pages it reuses, and start over on texels near the
+    // sources which changed.
+    void install_scene(std::shared_ptr<LightmapScene> scene);
+    // Count the texels left to sample in each tile.
+    void count_remaining();
+    void begin_pass();
+    void start_pass();
+    // Trace one pass over a range of the scene's tiles.
+    void run_tiles(LightmapScene* scene, uint32_t begin, uint32_t end) const;
+    void finish_pass();
+};
+
+// Build a scene from sources, each with its mesh. Sources whose
+// key and signature match one of the previous scene's pages are
+// left without a page, to reuse that one.
+std::shared_ptr<LightmapScene> LightmapScene_Build(
+    const std::vector<LightmapSource>& sources,
+    const std::unordered_map<uint64_t, uint64_t>& previous_signatures,
+    const LightmapSettings& settings
+);
+// Unwrap a source into a page, with no samples yet.
+std::unique_ptr<LightmapPage> LightmapPage_Create(
+    uint64_t key,
+    uint64_t signature,
+    const LevelMesh& mesh,
+    const LightmapSettings& settings
+);
+// Get a source for each region of a CSG compiler. Meshes are only
+// copied for regions whose page in the baker is out of date.
+void Lightmap_GatherCsgSources(
+    const CsgCompiler& csg,
+    const LightmapBaker& baker,
+    std::vector<LightmapSource>* sources
+);
+// Get a source for each visible entity with a mesh, moved into
+// world space.
+void Lightmap_GatherEntitySources(
+    const LevelDocument& document,
+    const LightmapBaker& baker,
+    std::vector<LightmapSource>* sources
+);
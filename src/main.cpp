@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iostream>
 
 #include "config/freetype.h"
@@ -5,8 +6,16 @@
 #include "config/raylib.h"
 
 #include "app.hpp"
+#include "assets/thumbnail_command.hpp"
+#include "lightmap/bake_command.hpp"
 
 int main(int argc, char **argv) {
+    if(argc >= 2 && std::strcmp(argv[1], LightmapBakeCommand_Argument) == 0) {
+        return LightmapBakeCommand_Run(argc - 2, argv + 2);
+    }
+    if(argc >= 2 && std::strcmp(argv[1], AssetThumbnailCommand_Argument) == 0) {
+        return AssetThumbnailCommand_Run(argc - 2, argv + 2);
+    }
     App app = App();
     return app.main();
 }
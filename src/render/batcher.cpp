@@ -0,0 +1,452 @@
+#include "batcher.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "raylib.h"
+#include "rlgl.h"
+
+#include "level/mesh.hpp"
+#include "util/log.hpp"
+#include "util/profiler.hpp"
+
+// Vertex attribute locations of mesh data. Must match the shader.
+const int RenderMesh_PositionLocation = 0;
+const int RenderMesh_TexcoordLocation = 1;
+const int RenderMesh_NormalLocation = 2;
+// Instances packed by each job
+const int RenderBatcher_PackChunkSize = 4096;
+
+// Instance rows are at locations 6 to 8, matching
+// RenderBatcher_InstanceAttribLocation
+static const char* RenderBatcher_VertexShader = R"(#version 330
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec2 vertexTexCoord;
+layout(location = 2) in vec3 vertexNormal;
+layout(location = 6) in vec4 instanceRow0;
+layout(location = 7) in vec4 instanceRow1;
+layout(location = 8) in vec4 instanceRow2;
+uniform mat4 matView;
+uniform mat4 matProjection;
+out vec3 fragNormal;
+out vec2 fragTexCoord;
+void main() {
+    vec4 position = vec4(vertexPosition, 1.0);
+    vec3 world = vec3(
+        dot(instanceRow0, position),
+        dot(instanceRow1, position),
+        dot(instanceRow2, position)
+    );
+    // Inverse transpose of the instance's rotation and scale
+    fragNormal = inverse(mat3(instanceRow0.xyz, instanceRow1.xyz, instanceRow2.xyz)) * vertexNormal;
+    fragTexCoord = vertexTexCoord;
+    gl_Position = matProjection * matView * vec4(world, 1.0);
+}
+)";
+
+// Lightmaps hold half the light, so that surfaces can be lit up
+// to twice their color
+static const char* RenderBatcher_FragmentShader = R"(#version 330
+in vec3 fragNormal;
+in vec2 fragTexCoord;
+uniform vec4 colDiffuse;
+uniform sampler2D lightmap;
+uniform int useLightmap;
+out vec4 finalColor;
+void main() {
+    if(useLightmap != 0) {
+        finalColor = vec4(colDiffuse.rgb * texture(lightmap, fragTexCoord).rgb * 2.0, colDiffuse.a);
+        return;
+    }
+    vec3 light = normalize(vec3(0.4, 1.0, 0.3));
+    float diffuse = max(dot(normalize(fragNormal), light), 0.0);
+    finalColor = vec4(colDiffuse.rgb * (0.35 + 0.65 * diffuse), colDiffuse.a);
+}
+)";
+
+// Compute smooth vertex normals by adding up the normals of the
+// triangles around each vertex, weighted by their areas.
+static std::vector<Vec3> RenderMesh_ComputeNormals(const LevelMesh& mesh) {
+    std::vector<Vec3> normals(mesh.positions.size());
+    for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const uint32_t a = mesh.indices[i];
+        const uint32_t b = mesh.indices[i + 1];
+        const uint32_t c = mesh.indices[i + 2];
+        const Vec3 normal = Vec3_Cross(
+            mesh.positions[b] - mesh.positions[a],
+            mesh.positions[c] - mesh.positions[a]
+        );
+        normals[a] = normals[a] + normal;
+        normals[b] = normals[b] + normal;
+        normals[c] = normals[c] + normal;
+    }
+    for(auto& normal : normals) {
+        normal = Vec3_Normalize(normal);
+    }
+    return normals;
+}
+
+RenderMesh RenderMesh_Upload(const LevelMesh& mesh) {
+    RenderMesh result;
+    std::vector<Vec3> computed_normals;
+    if(mesh.normals.size() != mesh.positions.size()) {
+        computed_normals = RenderMesh_ComputeNormals(mesh);
+    }
+    const std::vector<Vec3>& normals = (
+        computed_normals.empty() ? mesh.normals : computed_normals
+    );
+    // rlgl draws elements with 16-bit indexes
+    result.indexed = mesh.positions.size() <= (size_t) UINT16_MAX + 1;
+    const bool has_uvs = mesh.uvs.size() == mesh.positions.size();
+    std::vector<Vec3> expanded_positions;
+    std::vector<Vec3> expanded_normals;
+    std::vector<Vec2> expanded_uvs;
+    if(!result.indexed) {
+        expanded_positions.reserve(mesh.indices.size());
+        expanded_normals.reserve(mesh.indices.size());
+        for(const uint32_t index : mesh.indices) {
+            expanded_positions.push_back(mesh.positions[index]);
+            expanded_normals.push_back(normals[index]);
+            if(has_uvs) {
+                expanded_uvs.push_back(mesh.uvs[index]);
+            }
+        }
+    }
+    const std::vector<Vec3>& positions = result.indexed ? mesh.positions : expanded_positions;
+    const std::vector<Vec3>& vertex_normals = result.indexed ? normals : expanded_normals;
+    const std::vector<Vec2>& uvs = result.indexed ? mesh.uvs : expanded_uvs;
+    result.vertex_array = rlLoadVertexArray();
+    rlEnableVertexArray(result.vertex_array);
+    result.position_buffer = rlLoadVertexBuffer(
+        positions.data(), (int) (positions.size() * sizeof(Vec3)), false
+    );
+    rlSetVertexAttribute(RenderMesh_PositionLocation, 3, RL_FLOAT, false, 0, nullptr);
+    rlEnableVertexAttribute(RenderMesh_PositionLocation);
+    result.normal_buffer = rlLoadVertexBuffer(
+        vertex_normals.data(), (int) (vertex_normals.size() * sizeof(Vec3)), false
+    );
+    rlSetVertexAttribute(RenderMesh_NormalLocation, 3, RL_FLOAT, false, 0, nullptr);
+    rlEnableVertexAttribute(RenderMesh_NormalLocation);
+    if(has_uvs) {
+        result.uv_buffer = rlLoadVertexBuffer(
+            uvs.data(), (int) (uvs.size() * sizeof(Vec2)), false
+        );
+        rlSetVertexAttribute(RenderMesh_TexcoordLocation, 2, RL_FLOAT, false, 0, nullptr);
+        rlEnableVertexAttribute(RenderMesh_TexcoordLocation);
+    }
+    if(result.indexed) {
+        std::vector<uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+        result.index_buffer = rlLoadVertexBufferElement(
+            indices.data(), (int) (indices.size() * sizeof(uint16_t)), false
+        );
+        result.element_count = (int) indices.size();
+    }
+    else {
+        result.element_count = (int) positions.size();
+    }
+    rlDisableVertexArray();
+    UNI_LOG_TRACE(
+        LogSubsystem_Render, "Uploaded mesh '{}' with {} vertexes and {} triangles.",
+        mesh.name.c_str(), mesh.positions.size(), mesh.indices.size() / 3
+    );
+    return result;
+}
+
+void RenderMesh_Unload(RenderMesh* mesh) {
+    if(mesh->vertex_array) {
+        rlUnloadVertexArray(mesh->vertex_array);
+    }
+    if(mesh->position_buffer) {
+        rlUnloadVertexBuffer(mesh->position_buffer);
+    }
+    if(mesh->normal_buffer) {
+        rlUnloadVertexBuffer(mesh->normal_buffer);
+    }
+    if(mesh->uv_buffer) {
+        rlUnloadVertexBuffer(mesh->uv_buffer);
+    }
+    if(mesh->index_buffer) {
+        rlUnloadVertexBuffer(mesh->index_buffer);
+    }
+    *mesh = RenderMesh();
+}
+
+// Get the first three rows of the matrix which scales, rotates,
+// and then translates.
+static RenderInstance RenderBatcher_GetInstance(
+    const Vec3& position,
+    const Quat& rotation,
+    const Vec3& scale
+) {
+    const float x = rotation.x;
+    const float y = rotation.y;
+    const float z = rotation.z;
+    const float w = rotation.w;
+    RenderInstance instance;
+    instance.rows[0][0] = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+    instance.rows[0][1] = 2.0f * (x * y - w * z) * scale.y;
+    instance.rows[0][2] = 2.0f * (x * z + w * y) * scale.z;
+    instance.rows[0][3] = position.x;
+    instance.rows[1][0] = 2.0f * (x * y + w * z) * scale.x;
+    instance.rows[1][1] = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+    instance.rows[1][2] = 2.0f * (y * z - w * x) * scale.z;
+    instance.rows[1][3] = position.y;
+    instance.rows[2][0] = 2.0f * (x * z - w * y) * scale.x;
+    instance.rows[2][1] = 2.0f * (y * z + w * x) * scale.y;
+    instance.rows[2][2] = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+    instance.rows[2][3] = position.z;
+    return instance;
+}
+
+// Point the instance attributes of the bound vertex array at a
+// buffer of instances, starting from the given one.
+static void RenderBatcher_BindInstances(uint32_t buffer, uint32_t first_instance) {
+    rlEnableVertexBuffer(buffer);
+    for(int row = 0; row < 3; ++row) {
+        const int location = RenderBatcher_InstanceAttribLocation + row;
+        const uintptr_t offset = (
+            first_instance * sizeof(RenderInstance) +
+            row * sizeof(RenderInstance::rows[0])
+        );
+        rlSetVertexAttribute(
+            location, 4, RL_FLOAT, false,
+            (int) sizeof(RenderInstance), (const void*) offset
+        );
+        rlEnableVertexAttribute(location);
+        rlSetVertexAttributeDivisor(location, 1);
+    }
+}
+
+bool RenderBatcher::init() {
+    UNI_LOG_DEBUG(LogSubsystem_Render, "Initializing RenderBatcher.");
+    const int version = rlGetVersion();
+    if(version != RL_OPENGL_33 && version != RL_OPENGL_43) {
+        UNI_LOG_WARN(
+            LogSubsystem_Render,
+            "Instanced drawing needs OpenGL 3.3. Level entities will be drawn as boxes."
+        );
+        this->supported = false;
+        return false;
+    }
+    this->shader = rlLoadShaderCode(RenderBatcher_VertexShader, RenderBatcher_FragmentShader);
+    if(!this->shader) {
+        UNI_LOG_ERROR(LogSubsystem_Render, "Failed to compile the instanced drawing shader.");
+        this->supported = false;
+        return false;
+    }
+    this->view_location = rlGetLocationUniform(this->shader, "matView");
+    this->projection_location = rlGetLocationUniform(this->shader, "matProjection");
+    this->color_location = rlGetLocationUniform(this->shader, "colDiffuse");
+    this->lightmap_location = rlGetLocationUniform(this->shader, "lightmap");
+    this->use_lightmap_location = rlGetLocationUniform(this->shader, "useLightmap");
+    this->fallback_mesh = RenderMesh_Upload(LevelMesh_CreateCube("Cube"));
+    const RenderInstance identity = RenderBatcher_GetInstance(
+        Vec3(), Quat(), Vec3{1.0f, 1.0f, 1.0f}
+    );
+    this->identity_buffer = rlLoadVertexBuffer(&identity, (int) sizeof(identity), false);
+    this->supported = true;
+    return true;
+}
+
+void RenderBatcher::conclude() {
+    UNI_LOG_DEBUG(LogSubsystem_Render, "Concluding RenderBatcher.");
+    for(auto& mesh : this->meshes) {
+        RenderMesh_Unload(&mesh);
+    }
+    this->meshes.clear();
+    RenderMesh_Unload(&this->fallback_mesh);
+    if(this->identity_buffer) {
+        rlUnloadVertexBuffer(this->identity_buffer);
+        this->identity_buffer = 0;
+    }
+    for(int i = 0; i < RenderBatcher_BufferCount; ++i) {
+        if(this->instance_buffers[i]) {
+            rlUnloadVertexBuffer(this->instance_buffers[i]);
+        }
+        this->instance_buffers[i] = 0;
+        this->instance_buffer_sizes[i] = 0;
+    }
+    if(this->shader) {
+        rlUnloadShaderProgram(this->shader);
+        this->shader = 0;
+    }
+    this->supported = false;
+}
+
+void RenderBatcher::prepare(const LevelDocument& document, const uint32_t* rows, uint32_t count) {
+    UNI_PROFILE_ZONE("RenderBatcher::prepare");
+    this->sort_items.resize(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        const uint32_t row = rows[i];
+        this->sort_items[i] = std::make_pair(
+            ((uint64_t) document.meshes[row] << 32) | document.materials[row], row
+        );
+    }
+    std::sort(this->sort_items.begin(), this->sort_items.end());
+    this->batches.clear();
+    for(uint32_t i = 0; i < count; ++i) {
+        const LevelMeshId mesh = (LevelMeshId) (this->sort_items[i].first >> 32);
+        const LevelMaterialId material = (LevelMaterialId) this->sort_items[i].first;
+        if(
+            this->batches.empty() ||
+            this->batches.back().mesh != mesh ||
+            this->batches.back().material != material
+        ) {
+            this->batches.push_back(RenderBatch{mesh, material, i, 0});
+        }
+        this->batches.back().instance_count++;
+    }
+    this->instances.resize(count);
+    auto pack = [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            const uint32_t row = this->sort_items[i].second;
+            this->instances[i] = RenderBatcher_GetInstance(
+                document.positions[row], document.rotations[row], document.scales[row]
+            );
+        }
+    };
+    if(this->jobs) {
+        this->jobs->parallel_for((int) count, RenderBatcher_PackChunkSize, pack);
+    }
+    else {
+        pack(0, (int) count);
+    }
+}
+
+bool RenderBatcher::draw(const LevelDocument& document) {
+    if(!this->supported) {
+        return false;
+    }
+    UNI_PROFILE_ZONE("RenderBatcher::draw");
+    this->stats = RenderBatchStats();
+    if(!this->instances.empty()) {
+        // Draw whatever raylib has batched so far first, since
+        // its state is changed below
+        rlDrawRenderBatchActive();
+        const int slot = (int) (this->frame_index % RenderBatcher_BufferCount);
+        this->frame_index++;
+        const size_t size = this->instances.size() * sizeof(RenderInstance);
+        if(size > this->instance_buffer_sizes[slot]) {
+            if(this->instance_buffers[slot]) {
+                rlUnloadVertexBuffer(this->instance_buffers[slot]);
+            }
+            // Grow geometrically, so a growing level reallocates rarely
+            const size_t capacity = std::max(size, 2 * this->instance_buffer_sizes[slot]);
+            this->instance_buffers[slot] = rlLoadVertexBuffer(nullptr, (int) capacity, true);
+            this->instance_buffer_sizes[slot] = capacity;
+        }
+        const uint32_t instance_buffer = this->instance_buffers[slot];
+        rlUpdateVertexBuffer(instance_buffer, this->instances.data(), (int) size, 0);
+        this->stats.uploaded_bytes = size;
+        rlEnableShader(this->shader);
+        rlSetUniformMatrix(this->view_location, rlGetMatrixModelview());
+        rlSetUniformMatrix(this->projection_location, rlGetMatrixProjection());
+        const int use_lightmap = 0;
+        rlSetUniform(this->use_lightmap_location, &use_lightmap, RL_SHADER_UNIFORM_INT, 1);
+        for(const auto& batch : this->batches) {
+            const RenderMesh* mesh = this->get_mesh(document, batch.mesh);
+            if(!mesh || mesh->element_count == 0) {
+                continue;
+            }
+            const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+            const float* color = (
+                batch.material < document.material_assets.size() ?
+                document.material_assets[batch.material].color : white
+            );
+            rlSetUniform(this->color_location, color, RL_SHADER_UNIFORM_VEC4, 1);
+            rlEnableVertexArray(mesh->vertex_array);
+            // Point the instance attributes at this batch's instances,
+            // since OpenGL 3.3 has no base instance
+            RenderBatcher_BindInstances(instance_buffer, batch.first_instance);
+            if(mesh->indexed) {
+                rlDrawVertexArrayElementsInstanced(
+                    0, mesh->element_count, nullptr, (int) batch.instance_count
+                );
+            }
+            else {
+                rlDrawVertexArrayInstanced(
+                    0, mesh->element_count, (int) batch.instance_count
+                );
+            }
+            this->stats.instance_count += batch.instance_count;
+            this->stats.draw_call_count++;
+        }
+        rlDisableVertexArray();
+        rlDisableVertexBuffer();
+        rlDisableShader();
+    }
+    UNI_PROFILE_COUNTER("Draw calls", this->stats.draw_call_count);
+    UNI_PROFILE_COUNTER("Instances drawn", this->stats.instance_count);
+    UNI_PROFILE_COUNTER("Instance bytes uploaded", this->stats.uploaded_bytes);
+    return true;
+}
+
+bool RenderBatcher::draw_mesh(
+    const RenderMesh& mesh,
+    int first_element,
+    int element_count,
+    const float* color,
+    uint32_t lightmap_texture
+) {
+    if(!this->supported || element_count <= 0) {
+        return this->supported;
+    }
+    rlDrawRenderBatchActive();
+    rlEnableShader(this->shader);
+    rlSetUniformMatrix(this->view_location, rlGetMatrixModelview());
+    rlSetUniformMatrix(this->projection_location, rlGetMatrixProjection());
+    rlSetUniform(this->color_location, color, RL_SHADER_UNIFORM_VEC4, 1);
+    const int use_lightmap = lightmap_texture && mesh.uv_buffer ? 1 : 0;
+    rlSetUniform(this->use_lightmap_location, &use_lightmap, RL_SHADER_UNIFORM_INT, 1);
+    if(use_lightmap) {
+        const int slot = 0;
+        rlActiveTextureSlot(slot);
+        rlEnableTexture(lightmap_texture);
+        rlSetUniform(this->lightmap_location, &slot, RL_SHADER_UNIFORM_INT, 1);
+    }
+    rlEnableVertexArray(mesh.vertex_array);
+    RenderBatcher_BindInstances(this->identity_buffer, 0);
+    // Meshes uploaded without indexes have their vertexes in the
+    // order of the indexes, so ranges of either are the same
+    if(mesh.indexed) {
+        rlDrawVertexArrayElementsInstanced(first_element, element_count, nullptr, 1);
+    }
+    else {
+        rlDrawVertexArrayInstanced(first_element, element_count, 1);
+    }
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+    if(use_lightmap) {
+        rlDisableTexture();
+    }
+    rlDisableShader();
+    this->stats.draw_call_count++;
+    return true;
+}
+
+const RenderMesh* RenderBatcher::get_mesh(const LevelDocument& document, LevelMeshId mesh_id) {
+    if(mesh_id == LevelMeshId_None) {
+        return &this->fallback_mesh;
+    }
+    const LevelMesh* source = document.get_mesh(mesh_id);
+    if(!source) {
+        return nullptr;
+    }
+    if(mesh_id >= this->meshes.size()) {
+        this->meshes.resize(document.mesh_assets.size());
+    }
+    RenderMesh& mesh = this->meshes[mesh_id];
+    const uint64_t revision = document.get_mesh_revision(mesh_id);
+    if(
+        mesh.source_clear_revision != document.clear_revision ||
+        mesh.source_revision != revision
+    ) {
+        // The document's mesh was replaced, as when another level
+        // was opened
+        RenderMesh_Unload(&mesh);
+        mesh = RenderMesh_Upload(*source);
+        mesh.source_clear_revision = document.clear_revision;
+        mesh.source_revision = revision;
+    }
+    return &mesh;
+}
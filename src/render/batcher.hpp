@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/document.hpp"
+
+// Instance buffers used in turn, one per frame, so that a buffer
+// is only written once the GPU has finished drawing from it.
+const int RenderBatcher_BufferCount = 3;
+// First vertex attribute location used by instance data. Taken
+// by three consecutive locations.
+const int RenderBatcher_InstanceAttribLocation = 6;
+
+// Mesh uploaded to the GPU.
+struct RenderMesh {
+    uint32_t vertex_array = 0;
+    uint32_t position_buffer = 0;
+    uint32_t normal_buffer = 0;
+    // Only for meshes with uvs
+    uint32_t uv_buffer = 0;
+    uint32_t index_buffer = 0;
+    // Indexes to draw, or vertexes when not indexed
+    int element_count = 0;
+    // Meshes with more vertexes than 16-bit indexes can refer to
+    // are uploaded without indexes
+    bool indexed = false;
+    // LevelDocument::clear_revision and mesh revision of the
+    // LevelMesh which was uploaded, so that a mesh replaced in the
+    // document is noticed
+    uint64_t source_clear_revision = 0;
+    uint64_t source_revision = 0;
+};
+
+// Per-instance data: the first three rows of an entity's
+// transform matrix.
+struct RenderInstance {
+    float rows[3][4];
+};
+
+// Instances drawn with one mesh and material, in one draw call.
+struct RenderBatch {
+    LevelMeshId mesh = LevelMeshId_None;
+    LevelMaterialId material = LevelMaterialId_None;
+    uint32_t first_instance = 0;
+    uint32_t instance_count = 0;
+};
+
+// Counts from the last frame drawn.
+struct RenderBatchStats {
+    uint32_t instance_count = 0;
+    uint32_t draw_call_count = 0;
+    uint64_t uploaded_bytes = 0;
+};
+
+/**
+ * Draws level entities with one instanced draw call per distinct
+ * mesh and material, rather than one per entity.
+ * 
+ * Each frame, prepare sorts the visible entities by mesh and then
+ * material, and packs their transforms into one array of instance
+ * data, in parallel chunks when there are many. draw uploads that
+ * array to the GPU and issues a draw call for each batch, pointing
+ * the instance attributes at the batch's part of the buffer.
+ * 
+ * Instance buffers are used in turn, so the buffer written in a
+ * frame was last drawn from several frames ago, and uploading
+ * doesn't wait on the GPU. Meshes are uploaded the first time an
+ * entity using them is drawn. Entities without a mesh are drawn
+ * as unit cubes.
+ * 
+ * Requires OpenGL 3.3. Call init after the window is created.
+ */
+class RenderBatcher {
+public:
+    RenderBatcher() {};
+    RenderBatcher(JobSystem* jobs): jobs(jobs) {};
+    RenderBatcher(const RenderBatcher&) = delete;
+    RenderBatcher& operator=(const RenderBatcher&) = delete;
+    RenderBatcher& operator=(RenderBatcher&& other) = default;
+    
+    // Packs instances in parallel if set
+    JobSystem* jobs = nullptr;
+    
+    // Load the shader. Returns false if the GPU can't draw
+    // instances, in which case draw does nothing.
+    bool init();
+    // Free every GPU resource. Call before the window is closed.
+    void conclude();
+    // Group entities by mesh and material, and pack their
+    // instance data. Call once per frame, before draw.
+    void prepare(const LevelDocument& document, const uint32_t* rows, uint32_t count);
+    // Draw what was prepared. Call between RaylibBeginMode3D and
+    // RaylibEndMode3D. Returns false if instancing isn't supported.
+    bool draw(const LevelDocument& document);
+    // Draw part of a mesh which is already in world space, such as
+    // compiled level geometry, with one color. Elements are indexes,
+    // or vertexes when the mesh isn't indexed. If a lightmap texture
+    // is given, it lights the mesh through the mesh's uvs. Call
+    // between RaylibBeginMode3D and RaylibEndMode3D.
+    bool draw_mesh(
+        const RenderMesh& mesh,
+        int first_element,
+        int element_count,
+        const float* color,
+        uint32_t lightmap_texture = 0
+    );
+    
+    const std::vector<RenderBatch>& get_batches() const {
+        return this->batches;
+    }
+    const RenderBatchStats& get_stats() const {
+        return this->stats;
+    }
+    
+private:
+    bool supported = false;
+    uint32_t shader = 0;
+    int view_location = -1;
+    int projection_location = -1;
+    int color_location = -1;
+    int lightmap_location = -1;
+    int use_lightmap_location = -1;
+    uint32_t instance_buffers[RenderBatcher_BufferCount] = {};
+    size_t instance_buffer_sizes[RenderBatcher_BufferCount] = {};
+    uint32_t frame_index = 0;
+    // A single instance with no transform, for draw_mesh
+    uint32_t identity_buffer = 0;
+    // Indexed by LevelMeshId
+    std::vector<RenderMesh> meshes;
+    // Drawn for entities without a mesh
+    RenderMesh fallback_mesh;
+    // Mesh and material in the high and low bits, then row
+    std::vector<std::pair<uint64_t, uint32_t>> sort_items;
+    std::vector<RenderInstance> instances;
+    std::vector<RenderBatch> batches;
+    RenderBatchStats stats;
+    
+    // Get the uploaded copy of a mesh, uploading it if needed.
+    const RenderMesh* get_mesh(const LevelDocument& document, LevelMeshId mesh_id);
+};
+
+// Upload a mesh to the GPU. Normals are computed when the mesh
+// has none. UVs are uploaded when the mesh has them.
+RenderMesh RenderMesh_Upload(const LevelMesh& mesh);
+void RenderMesh_Unload(RenderMesh* mesh);
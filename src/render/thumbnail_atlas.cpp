@@ -0,0 +1,113 @@
+#include "thumbnail_atlas.hpp"
+
+#include "raylib.h"
+#include "rlgl.h"
+
+#include "util/profiler.hpp"
+
+void RenderThumbnailAtlas::init(uint32_t slot_size) {
+    this->slot_size = slot_size;
+    this->slots_per_row = RenderThumbnailAtlas_TextureSize / slot_size;
+    this->slots.assign((size_t) this->slots_per_row * this->slots_per_row, RenderThumbnailSlot{});
+    this->slot_indexes.clear();
+    // Left undefined until slots are filled
+    this->texture = rlLoadTexture(
+        nullptr, (int) RenderThumbnailAtlas_TextureSize, (int) RenderThumbnailAtlas_TextureSize,
+        RL_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1
+    );
+    rlTextureParameters(this->texture, RL_TEXTURE_MIN_FILTER, RL_TEXTURE_FILTER_LINEAR);
+    rlTextureParameters(this->texture, RL_TEXTURE_MAG_FILTER, RL_TEXTURE_FILTER_LINEAR);
+    rlTextureParameters(this->texture, RL_TEXTURE_WRAP_S, RL_TEXTURE_WRAP_CLAMP);
+    rlTextureParameters(this->texture, RL_TEXTURE_WRAP_T, RL_TEXTURE_WRAP_CLAMP);
+}
+
+void RenderThumbnailAtlas::conclude() {
+    if(this->texture) {
+        rlUnloadTexture(this->texture);
+        this->texture = 0;
+    }
+    this->slots.clear();
+    this->slot_indexes.clear();
+}
+
+void RenderThumbnailAtlas::begin_frame() {
+    this->frame++;
+    this->frame_uploads = 0;
+}
+
+int RenderThumbnailAtlas::find(uint64_t id) {
+    const auto found = this->slot_indexes.find(id);
+    if(found == this->slot_indexes.end()) {
+        return -1;
+    }
+    this->slots[found->second].last_frame = this->frame;
+    return found->second;
+}
+
+bool RenderThumbnailAtlas::can_upload() const {
+    return this->texture && this->frame_uploads < this->max_uploads;
+}
+
+bool RenderThumbnailAtlas::upload(uint64_t id, const uint8_t* rgba) {
+    if(!this->can_upload()) {
+        return false;
+    }
+    UNI_PROFILE_ZONE("RenderThumbnailAtlas::upload");
+    int slot = this->find(id);
+    if(slot < 0) {
+        slot = this->take_slot();
+        if(slot < 0) {
+            return false;
+        }
+        RenderThumbnailSlot& taken = this->slots[slot];
+        if(taken.used) {
+            this->slot_indexes.erase(taken.id);
+        }
+        taken.id = id;
+        taken.used = true;
+        taken.last_frame = this->frame;
+        this->slot_indexes[id] = slot;
+    }
+    rlUpdateTexture(
+        this->texture,
+        (int) ((uint32_t) slot % this->slots_per_row * this->slot_size),
+        (int) ((uint32_t) slot / this->slots_per_row * this->slot_size),
+        (int) this->slot_size, (int) this->slot_size,
+        RL_PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, rgba
+    );
+    this->frame_uploads++;
+    return true;
+}
+
+void RenderThumbnailAtlas::clear() {
+    for(auto& slot : this->slots) {
+        slot = RenderThumbnailSlot{};
+    }
+    this->slot_indexes.clear();
+}
+
+void RenderThumbnailAtlas::get_slot_uvs(int slot, float* u0, float* v0, float* u1, float* v1) const {
+    const float scale = 1.0f / (float) this->slots_per_row;
+    *u0 = (float) ((uint32_t) slot % this->slots_per_row) * scale;
+    *v0 = (float) ((uint32_t) slot / this->slots_per_row) * scale;
+    *u1 = *u0 + scale;
+    *v1 = *v0 + scale;
+}
+
+int RenderThumbnailAtlas::take_slot() {
+    // Free slots first, then the least recently looked up
+    int oldest = -1;
+    for(size_t i = 0; i < this->slots.size(); ++i) {
+        const RenderThumbnailSlot& slot = this->slots[i];
+        if(!slot.used) {
+            return (int) i;
+        }
+        if(
+            slot.last_frame < this->frame &&
+            (oldest < 0 || slot.last_frame < this->slots[oldest].last_frame)
+        ) {
+            oldest = (int) i;
+        }
+    }
+    return oldest;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Width and height of the atlas texture, in pixels.
+const uint32_t RenderThumbnailAtlas_TextureSize = 2048;
+
+// Place in the atlas of one thumbnail.
+struct RenderThumbnailSlot {
+    uint64_t id = 0;
+    bool used = false;
+    // Frame on which the slot was last looked up or filled
+    uint64_t last_frame = 0;
+};
+
+/**
+ * Keeps recently shown thumbnails in one GPU texture, divided
+ * into a grid of equal slots, so that a window full of them draws
+ * from a single texture.
+ * 
+ * Thumbnails are uploaded in batches, at most max_uploads per
+ * frame, each into its own part of the texture. When every slot
+ * is taken, the one looked up least recently is given to the new
+ * thumbnail, but never a slot looked up in the current frame, so
+ * what is on screen stays put.
+ * 
+ * Requires OpenGL. Call init after the window is created.
+ */
+class RenderThumbnailAtlas {
+public:
+    RenderThumbnailAtlas() {};
+    RenderThumbnailAtlas(const RenderThumbnailAtlas&) = delete;
+    RenderThumbnailAtlas& operator=(const RenderThumbnailAtlas&) = delete;
+    RenderThumbnailAtlas& operator=(RenderThumbnailAtlas&& other) = default;
+    
+    // Thumbnails uploaded per frame, at most. The rest wait for
+    // later frames.
+    uint32_t max_uploads = 16;
+    
+    // Create the texture, with slots of the given size.
+    void init(uint32_t slot_size);
+    // Free the texture.
+    void conclude();
+    // Start a new frame. Slots looked up before this may be reused.
+    void begin_frame();
+    // Find the slot of a thumbnail, and keep it from being reused
+    // this frame. Returns -1 if the thumbnail isn't in the atlas.
+    int find(uint64_t id);
+    // Returns true if another upload fits in this frame.
+    bool can_upload() const;
+    // Copy a thumbnail of slot_size squared RGBA pixels into a
+    // slot. Returns false if every slot is in use this frame, or
+    // this frame's uploads are used up.
+    bool upload(uint64_t id, const uint8_t* rgba);
+    // Forget every thumbnail, as when their ids change meaning.
+    void clear();
+    // Get the texture coordinates of a slot's corners.
+    void get_slot_uvs(int slot, float* u0, float* v0, float* u1, float* v1) const;
+    uint32_t get_texture() const {
+        return this->texture;
+    }
+    
+private:
+    uint32_t texture = 0;
+    uint32_t slot_size = 0;
+    uint32_t slots_per_row = 0;
+    std::vector<RenderThumbnailSlot> slots;
+    // Slot index of each thumbnail, by id
+    std::unordered_map<uint64_t, int> slot_indexes;
+    uint64_t frame = 1;
+    uint32_t frame_uploads = 0;
+    
+    // Pick a slot for a new thumbnail. Returns -1 if none is free.
+    int take_slot();
+};
@@ -0,0 +1,74 @@
+#include "alloc_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(UNI_PROFILER)
+
+static thread_local uint64_t alloc_thread_count = 0;
+
+static void* alloc_counted(std::size_t size) {
+    alloc_thread_count++;
+    return std::malloc(size ? size : 1);
+}
+
+// Over-aligned new and delete are left to the standard library,
+// which pairs them with each other and not with these.
+void* operator new(std::size_t size) {
+    void* pointer = alloc_counted(size);
+    if(!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new[](std::size_t size) {
+    void* pointer = alloc_counted(size);
+    if(!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return alloc_counted(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return alloc_counted(size);
+}
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+void operator delete(void* pointer, [[maybe_unused]] std::size_t size) noexcept {
+    std::free(pointer);
+}
+void operator delete[](void* pointer, [[maybe_unused]] std::size_t size) noexcept {
+    std::free(pointer);
+}
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+bool AllocCounter_IsEnabled() {
+    return true;
+}
+
+uint64_t AllocCounter_GetThreadCount() {
+    return alloc_thread_count;
+}
+
+#else
+
+bool AllocCounter_IsEnabled() {
+    return false;
+}
+
+uint64_t AllocCounter_GetThreadCount() {
+    return 0;
+}
+
+#endif
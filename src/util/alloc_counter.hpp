@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Counts heap allocations made through global operator new.
+ * 
+ * Counting replaces the global operator new and delete, so it is
+ * only compiled into profiling builds (UNI_PROFILER). In other
+ * builds the counts are always zero.
+ */
+
+// Returns true if allocations are being counted in this build.
+bool AllocCounter_IsEnabled();
+// Get the number of allocations made by the calling thread.
+uint64_t AllocCounter_GetThreadCount();
@@ -0,0 +1,129 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "util/log.hpp"
+
+// Overflow blocks are at least this large, so that many small
+// allocations past the end of the arena don't each hit the heap.
+const size_t Arena_MinOverflowBlockSize = 64 << 10;
+
+Arena::~Arena() {
+    for(void* overflow_block : this->overflow_blocks) {
+        std::free(overflow_block);
+    }
+    std::free(this->block);
+}
+
+void Arena::init(size_t capacity_bytes) {
+    std::free(this->block);
+    this->block = (uint8_t*) std::malloc(capacity_bytes);
+    if(!this->block) {
+        throw std::bad_alloc();
+    }
+    this->capacity = capacity_bytes;
+    this->offset = 0;
+}
+
+void Arena::reset() {
+    if(!this->overflow_blocks.empty()) {
+        for(void* overflow_block : this->overflow_blocks) {
+            std::free(overflow_block);
+        }
+        this->overflow_blocks.clear();
+        // Grow to fit the busiest frame so far, with some headroom
+        const size_t capacity = this->peak_bytes + this->peak_bytes / 2;
+        UNI_LOG_DEBUG(
+            LogSubsystem_General,
+            "Growing arena from {} to {} bytes.", this->capacity, capacity
+        );
+        this->init(capacity);
+    }
+    this->offset = 0;
+    this->overflow_bytes = 0;
+    this->overflow_offset = 0;
+    this->overflow_capacity = 0;
+}
+
+// Bump-allocate from a block, or return nullptr if it is full.
+static void* arena_bump(
+    uint8_t* block, size_t capacity, size_t* offset,
+    size_t size_bytes, size_t alignment
+) {
+    if(!block) {
+        return nullptr;
+    }
+    const uintptr_t base = (uintptr_t) block;
+    const uintptr_t aligned = (
+        (base + *offset + alignment - 1) & ~(uintptr_t) (alignment - 1)
+    );
+    const size_t end = (size_t) (aligned - base) + size_bytes;
+    if(end > capacity) {
+        return nullptr;
+    }
+    *offset = end;
+    return (void*) aligned;
+}
+
+void* Arena::allocate(size_t size_bytes, size_t alignment) {
+    void* pointer = arena_bump(
+        this->block, this->capacity, &this->offset, size_bytes, alignment
+    );
+    if(!pointer) {
+        // Out of space: fall back to heap blocks until the next reset
+        if(!this->overflow_blocks.empty()) {
+            pointer = arena_bump(
+                (uint8_t*) this->overflow_blocks.back(),
+                this->overflow_capacity,
+                &this->overflow_offset,
+                size_bytes,
+                alignment
+            );
+        }
+        if(!pointer) {
+            this->overflow_capacity = std::max(
+                size_bytes + alignment, Arena_MinOverflowBlockSize
+            );
+            this->overflow_offset = 0;
+            void* overflow_block = std::malloc(this->overflow_capacity);
+            if(!overflow_block) {
+                throw std::bad_alloc();
+            }
+            this->overflow_blocks.push_back(overflow_block);
+            pointer = arena_bump(
+                (uint8_t*) overflow_block,
+                this->overflow_capacity,
+                &this->overflow_offset,
+                size_bytes,
+                alignment
+            );
+        }
+        this->overflow_bytes += size_bytes;
+    }
+    this->peak_bytes = std::max(
+        this->peak_bytes, this->offset + this->overflow_bytes
+    );
+    return pointer;
+}
+
+const char* Arena::copy_string(std::string_view text) {
+    char* copy = this->allocate_array<char>(text.size() + 1);
+    std::memcpy(copy, text.data(), text.size());
+    copy[text.size()] = '\0';
+    return copy;
+}
+
+size_t Arena::get_used_bytes() {
+    return this->offset + this->overflow_bytes;
+}
+
+size_t Arena::get_peak_bytes() {
+    return this->peak_bytes;
+}
+
+size_t Arena::get_capacity_bytes() {
+    return this->capacity;
+}
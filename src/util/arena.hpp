@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Linear "bump" allocator for short-lived data.
+ * 
+ * Allocating only advances an offset, and nothing is freed until
+ * the whole arena is reset. App owns an arena for per-frame data,
+ * which it resets at the top of every frame.
+ * 
+ * When a frame needs more memory than the arena holds, overflow
+ * blocks are taken from the heap and the arena grows to fit on
+ * the next reset, so steady-state frames never touch the heap.
+ * Arenas are not thread-safe.
+ */
+class Arena {
+public:
+    Arena() {};
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+    
+    // Allocate the arena's main block.
+    void init(size_t capacity_bytes);
+    // Release all allocations at once. Invalidates every pointer
+    // previously returned by allocate.
+    void reset();
+    // Allocate uninitialized memory. Never returns nullptr.
+    void* allocate(size_t size_bytes, size_t alignment = alignof(std::max_align_t));
+    // Allocate uninitialized storage for an array of objects.
+    template<typename T>
+    T* allocate_array(size_t count) {
+        return (T*) this->allocate(sizeof(T) * count, alignof(T));
+    }
+    // Copy a string into the arena, adding a null terminator.
+    const char* copy_string(std::string_view text);
+    // Get the number of bytes allocated since the last reset.
+    size_t get_used_bytes();
+    // Get the most bytes ever allocated between two resets.
+    size_t get_peak_bytes();
+    // Get the size of the arena's main block.
+    size_t get_capacity_bytes();
+    
+private:
+    uint8_t* block = nullptr;
+    size_t capacity = 0;
+    size_t offset = 0;
+    // Bytes allocated from overflow blocks since the last reset
+    size_t overflow_bytes = 0;
+    // Usage of the most recent overflow block
+    size_t overflow_offset = 0;
+    size_t overflow_capacity = 0;
+    size_t peak_bytes = 0;
+    std::vector<void*> overflow_blocks;
+};
+
+/**
+ * Standard allocator which takes memory from an Arena, for use
+ * with standard containers. Deallocation does nothing; memory is
+ * reclaimed when the arena is reset.
+ */
+template<typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+    
+    Arena* arena = nullptr;
+    
+    ArenaAllocator(Arena* arena): arena(arena) {};
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other): arena(other.arena) {};
+    
+    T* allocate(size_t count) {
+        return this->arena->template allocate_array<T>(count);
+    }
+    void deallocate(T*, size_t) {}
+    
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return this->arena == other.arena;
+    }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return this->arena != other.arena;
+    }
+};
+
+// String whose storage comes from an Arena.
+// Must not outlive the arena's next reset.
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+// Vector whose storage comes from an Arena.
+// Must not outlive the arena's next reset.
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
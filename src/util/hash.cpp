@@ -0,0 +1,34 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+    uint64_t h = seed ^ (size * m);
+    const unsigned char* bytes = (const unsigned char*) data;
+    const unsigned char* end = bytes + (size & ~(size_t) 7);
+    while(bytes != end) {
+        uint64_t k;
+        std::memcpy(&k, bytes, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+        bytes += 8;
+    }
+    switch(size & 7) {
+        case 7: h ^= (uint64_t) bytes[6] << 48; [[fallthrough]];
+        case 6: h ^= (uint64_t) bytes[5] << 40; [[fallthrough]];
+        case 5: h ^= (uint64_t) bytes[4] << 32; [[fallthrough]];
+        case 4: h ^= (uint64_t) bytes[3] << 24; [[fallthrough]];
+        case 3: h ^= (uint64_t) bytes[2] << 16; [[fallthrough]];
+        case 2: h ^= (uint64_t) bytes[1] << 8; [[fallthrough]];
+        case 1: h ^= (uint64_t) bytes[0]; h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Default seed for hash_bytes.
+const uint64_t Hash_DefaultSeed = 0x9e3779b97f4a7c15ull;
+
+/**
+ * Compute a 64-bit hash of a byte buffer.
+ * 
+ * Uses MurmurHash64A, which consumes eight bytes at a time and is
+ * fast enough for hashing large files and buffers. The result
+ * depends on byte order and must not be shared between little and
+ * big endian machines.
+ */
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = Hash_DefaultSeed);
+
+// Mix a value into an existing hash.
+inline uint64_t hash_combine(uint64_t hash, uint64_t value) {
+    value *= 0xc6a4a7935bd1e995ull;
+    value ^= value >> 47;
+    value *= 0xc6a4a7935bd1e995ull;
+    hash ^= value;
+    hash *= 0xc6a4a7935bd1e995ull;
+    return hash;
+}
+
+// Helper for incrementally hashing several values or buffers.
+struct Hasher {
+    uint64_t hash = Hash_DefaultSeed;
+    
+    void add_bytes(const void* data, size_t size) {
+        this->hash = hash_combine(this->hash, hash_bytes(data, size, this->hash));
+    }
+    template<typename T>
+    void add(const T& value) {
+        this->add_bytes(&value, sizeof(T));
+    }
+};
@@ -0,0 +1,296 @@
+#include "log.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "util/profiler.hpp"
+
+const char* const LogLevel_Names[] = {
+    "trace",
+    "debug",
+    "info",
+    "warning",
+    "error",
+    "critical",
+    "off",
+};
+
+const char* const LogSubsystem_Names[] = {
+    "General",
+    "Input",
+    "GUI",
+    "Jobs",
+    "Level",
+    "Render",
+    "Assets",
+};
+
+// How long the writer thread sleeps when there is nothing to write
+const auto Log_WriterIdleSleep = std::chrono::milliseconds(2);
+
+std::atomic<int> log_levels[LogSubsystem_COUNT] = {};
+
+// Bounded multi-producer queue, after Dmitry Vyukov's design.
+// Producers claim slots with a CAS on enqueue_position; the one
+// consumer reads slots in order once their sequence says they are
+// published.
+struct LogRing {
+    LogRingSlot* slots;
+    alignas(64) std::atomic<uint64_t> enqueue_position = 0;
+    alignas(64) uint64_t dequeue_position = 0;
+    std::atomic<uint64_t> dropped_count = 0;
+    
+    LogRing() {
+        // Never freed, so that logging keeps working during exit
+        this->slots = new LogRingSlot[Log_RingCapacity];
+        for(uint32_t i = 0; i < Log_RingCapacity; ++i) {
+            this->slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Append-only message history. Only the consumer appends; entry
+// blocks are published before the count which covers them, so
+// readers need only an acquire load of the count.
+struct LogHistory {
+    std::atomic<LogHistoryEntry*> blocks[Log_HistoryMaxEntries / Log_HistoryBlockSize] = {};
+    std::atomic<uint32_t> count = 0;
+    // Remainder of the current text block. Never freed.
+    char* text = nullptr;
+    uint32_t text_remaining = 0;
+};
+
+static LogHistory log_history;
+
+static LogRing& log_get_ring() {
+    static LogRing ring;
+    return ring;
+}
+
+static std::thread log_writer;
+static std::atomic<bool> log_writer_running = false;
+// Serializes consumers: the writer thread, or threads writing
+// synchronously while it isn't running.
+static std::mutex log_consumer_mutex;
+static uint64_t log_reported_dropped_count = 0;
+
+const char* LogLevel_GetName(LogLevel level) {
+    if(level < 0 || level >= LogLevel_COUNT) {
+        return "unknown";
+    }
+    return LogLevel_Names[level];
+}
+
+const char* LogSubsystem_GetName(LogSubsystem subsystem) {
+    if(subsystem < 0 || subsystem >= LogSubsystem_COUNT) {
+        return "Unknown";
+    }
+    return LogSubsystem_Names[subsystem];
+}
+
+// Pass one message on to spdlog. Called by the consumer only.
+static void log_output(const LogMessage& message) {
+    const auto time = spdlog::log_clock::time_point(
+        std::chrono::duration_cast<spdlog::log_clock::duration>(
+            std::chrono::nanoseconds(message.time_ns)
+        )
+    );
+    char text[LogMessage_MaxLength + 32];
+    const auto result = fmt::format_to_n(
+        text,
+        sizeof(text),
+        "[{}] {}",
+        LogSubsystem_GetName(message.subsystem),
+        std::string_view(message.text, message.length)
+    );
+    spdlog::default_logger_raw()->log(
+        time,
+        spdlog::source_loc{},
+        (spdlog::level::level_enum) message.level,
+        spdlog::string_view_t(text, std::min(result.size, sizeof(text)))
+    );
+}
+
+// Add one message to the history. Called by the consumer only.
+static void log_append_history(const LogMessage& message) {
+    const uint32_t index = log_history.count.load(std::memory_order_relaxed);
+    if(index >= Log_HistoryMaxEntries) {
+        return;
+    }
+    const uint32_t block_index = index / Log_HistoryBlockSize;
+    LogHistoryEntry* block = log_history.blocks[block_index].load(std::memory_order_relaxed);
+    if(!block) {
+        block = new LogHistoryEntry[Log_HistoryBlockSize];
+        log_history.blocks[block_index].store(block, std::memory_order_release);
+    }
+    if(message.length > log_history.text_remaining) {
+        log_history.text = new char[Log_HistoryTextBlockSize];
+        log_history.text_remaining = Log_HistoryTextBlockSize;
+    }
+    std::memcpy(log_history.text, message.text, message.length);
+    block[index % Log_HistoryBlockSize] = LogHistoryEntry{
+        .time_ns = message.time_ns,
+        .text = log_history.text,
+        .length = message.length,
+        .level = message.level,
+        .subsystem = message.subsystem,
+    };
+    log_history.text += message.length;
+    log_history.text_remaining -= message.length;
+    log_history.count.store(index + 1, std::memory_order_release);
+}
+
+// Write out every published message. Returns the number written.
+// Caller must hold log_consumer_mutex.
+static int log_drain() {
+    LogRing& ring = log_get_ring();
+    int count = 0;
+    while(true) {
+        const uint64_t position = ring.dequeue_position;
+        LogRingSlot& slot = ring.slots[position & (Log_RingCapacity - 1)];
+        if(slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            // Empty, or the next message is still being formatted
+            break;
+        }
+        log_output(slot.message);
+        log_append_history(slot.message);
+        slot.sequence.store(position + Log_RingCapacity, std::memory_order_release);
+        ring.dequeue_position = position + 1;
+        count++;
+    }
+    const uint64_t dropped_count = ring.dropped_count.load(std::memory_order_relaxed);
+    if(dropped_count != log_reported_dropped_count) {
+        LogMessage message;
+        message.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+        message.level = LogLevel_Warn;
+        message.subsystem = LogSubsystem_General;
+        const auto result = fmt::format_to_n(
+            message.text,
+            LogMessage_MaxLength,
+            "Dropped {} log messages because the log buffer was full.",
+            dropped_count - log_reported_dropped_count
+        );
+        message.length = (uint32_t) std::min<size_t>(result.size, LogMessage_MaxLength);
+        log_output(message);
+        log_append_history(message);
+        log_reported_dropped_count = dropped_count;
+    }
+    return count;
+}
+
+static void log_writer_main() {
+    UNI_PROFILE_THREAD("Log Writer");
+    while(log_writer_running.load(std::memory_order_acquire)) {
+        int count = 0;
+        {
+            std::lock_guard<std::mutex> lock(log_consumer_mutex);
+            count = log_drain();
+        }
+        if(count == 0) {
+            std::this_thread::sleep_for(Log_WriterIdleSleep);
+        }
+    }
+}
+
+void Log_Init() {
+    if(log_writer_running.load(std::memory_order_acquire)) {
+        return;
+    }
+    // Levels are filtered before messages reach spdlog
+    spdlog::set_level(spdlog::level::trace);
+    log_get_ring();
+    log_writer_running.store(true, std::memory_order_release);
+    log_writer = std::thread(log_writer_main);
+}
+
+void Log_Conclude() {
+    if(!log_writer_running.load(std::memory_order_acquire)) {
+        return;
+    }
+    log_writer_running.store(false, std::memory_order_release);
+    log_writer.join();
+    std::lock_guard<std::mutex> lock(log_consumer_mutex);
+    log_drain();
+    spdlog::default_logger_raw()->flush();
+}
+
+void Log_SetLevel(LogSubsystem subsystem, LogLevel level) {
+    log_levels[subsystem].store((int) level, std::memory_order_relaxed);
+}
+
+void Log_SetLevelAll(LogLevel level) {
+    for(int i = 0; i < LogSubsystem_COUNT; ++i) {
+        log_levels[i].store((int) level, std::memory_order_relaxed);
+    }
+}
+
+LogLevel Log_GetLevel(LogSubsystem subsystem) {
+    return (LogLevel) log_levels[subsystem].load(std::memory_order_relaxed);
+}
+
+uint64_t Log_GetDroppedCount() {
+    return log_get_ring().dropped_count.load(std::memory_order_relaxed);
+}
+
+uint32_t Log_GetHistoryCount() {
+    return log_history.count.load(std::memory_order_acquire);
+}
+
+const LogHistoryEntry& Log_GetHistoryEntry(uint32_t index) {
+    const LogHistoryEntry* block = log_history.blocks[index / Log_HistoryBlockSize].load(
+        std::memory_order_acquire
+    );
+    return block[index % Log_HistoryBlockSize];
+}
+
+LogRingSlot* Log_BeginWrite(LogLevel level, LogSubsystem subsystem) {
+    LogRing& ring = log_get_ring();
+    uint64_t position = ring.enqueue_position.load(std::memory_order_relaxed);
+    LogRingSlot* slot = nullptr;
+    while(true) {
+        slot = &ring.slots[position & (Log_RingCapacity - 1)];
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const int64_t difference = (int64_t) sequence - (int64_t) position;
+        if(difference == 0) {
+            if(ring.enqueue_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed
+            )) {
+                break;
+            }
+        }
+        else if(difference < 0) {
+            // The writer hasn't caught up; drop instead of waiting
+            ring.dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else {
+            position = ring.enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+    LogMessage& message = slot->message;
+    message.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    message.level = level;
+    message.subsystem = subsystem;
+    message.length = 0;
+    return slot;
+}
+
+void Log_EndWrite(LogRingSlot* slot) {
+    // A claimed slot's sequence equals its position until published
+    slot->sequence.store(
+        slot->sequence.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release
+    );
+    if(!log_writer_running.load(std::memory_order_acquire)) {
+        // Before Log_Init and after Log_Conclude, write immediately
+        std::lock_guard<std::mutex> lock(log_consumer_mutex);
+        log_drain();
+    }
+}
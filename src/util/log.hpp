@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "spdlog/fmt/fmt.h"
+
+/**
+ * Asynchronous logging, split by subsystem.
+ * 
+ * Log calls are written with the UNI_LOG_* macros, e.g.
+ * `UNI_LOG_DEBUG(LogSubsystem_GUI, "Showing '{}'.", name);`.
+ * 
+ * Each subsystem has a minimum level fixed at compile time. Calls
+ * below it are discarded by the compiler, arguments and all, so
+ * they cost nothing. Calls which remain are also checked against a
+ * runtime level, then formatted directly into a slot of a lock-free
+ * ring buffer. A background writer thread passes them on to spdlog,
+ * so the calling thread never waits on console or file output.
+ * When the ring is full, messages are dropped rather than blocking.
+ * 
+ * The writer thread also appends each message to an in-memory
+ * history, which the log console reads from directly.
+ */
+
+/**
+ * Severity of a log message. Values match spdlog's levels, and
+ * are used by the UNI_LOG_MIN_LEVEL defines.
+ */
+enum LogLevel : int {
+    LogLevel_Trace = 0,
+    LogLevel_Debug = 1,
+    LogLevel_Info = 2,
+    LogLevel_Warn = 3,
+    LogLevel_Error = 4,
+    LogLevel_Critical = 5,
+    LogLevel_Off = 6,
+    LogLevel_COUNT
+};
+
+/**
+ * Part of the application which a log message comes from.
+ * Levels can be set separately for each subsystem.
+ */
+enum LogSubsystem : int {
+    LogSubsystem_General = 0,
+    LogSubsystem_Input,
+    LogSubsystem_GUI,
+    LogSubsystem_Jobs,
+    LogSubsystem_Level,
+    LogSubsystem_Render,
+    LogSubsystem_Assets,
+    LogSubsystem_COUNT
+};
+
+// Compile-time minimum levels. Defaults to keeping trace messages
+// in debug builds only. Override with e.g. `scons log_level=2`, or
+// per subsystem with e.g. -DUNI_LOG_MIN_LEVEL_INPUT=0.
+#if !defined(UNI_LOG_MIN_LEVEL)
+    #if defined(DEBUG)
+        #define UNI_LOG_MIN_LEVEL 0
+    #else
+        #define UNI_LOG_MIN_LEVEL 1
+    #endif
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_GENERAL)
+    #define UNI_LOG_MIN_LEVEL_GENERAL UNI_LOG_MIN_LEVEL
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_INPUT)
+    #define UNI_LOG_MIN_LEVEL_INPUT UNI_LOG_MIN_LEVEL
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_GUI)
+    #define UNI_LOG_MIN_LEVEL_GUI UNI_LOG_MIN_LEVEL
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_JOBS)
+    #define UNI_LOG_MIN_LEVEL_JOBS UNI_LOG_MIN_LEVEL
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_LEVEL)
+    #define UNI_LOG_MIN_LEVEL_LEVEL UNI_LOG_MIN_LEVEL
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_RENDER)
+    #define UNI_LOG_MIN_LEVEL_RENDER UNI_LOG_MIN_LEVEL
+#endif
+#if !defined(UNI_LOG_MIN_LEVEL_ASSETS)
+    #define UNI_LOG_MIN_LEVEL_ASSETS UNI_LOG_MIN_LEVEL
+#endif
+
+// Minimum level compiled in for each subsystem.
+constexpr int Log_CompiledLevels[LogSubsystem_COUNT] = {
+    UNI_LOG_MIN_LEVEL_GENERAL,
+    UNI_LOG_MIN_LEVEL_INPUT,
+    UNI_LOG_MIN_LEVEL_GUI,
+    UNI_LOG_MIN_LEVEL_JOBS,
+    UNI_LOG_MIN_LEVEL_LEVEL,
+    UNI_LOG_MIN_LEVEL_RENDER,
+    UNI_LOG_MIN_LEVEL_ASSETS,
+};
+
+// Returns true if messages of a level are compiled in at all.
+constexpr bool Log_IsCompiled(LogLevel level, LogSubsystem subsystem) {
+    return (int) level >= Log_CompiledLevels[subsystem];
+}
+
+#define UNI_LOG(level, subsystem, ...) do { \
+    if constexpr(Log_IsCompiled(level, subsystem)) { \
+        if(Log_IsEnabled(level, subsystem)) { \
+            Log_Write(level, subsystem, __VA_ARGS__); \
+        } \
+    } \
+} while(0)
+#define UNI_LOG_TRACE(subsystem, ...) UNI_LOG(LogLevel_Trace, subsystem, __VA_ARGS__)
+#define UNI_LOG_DEBUG(subsystem, ...) UNI_LOG(LogLevel_Debug, subsystem, __VA_ARGS__)
+#define UNI_LOG_INFO(subsystem, ...) UNI_LOG(LogLevel_Info, subsystem, __VA_ARGS__)
+#define UNI_LOG_WARN(subsystem, ...) UNI_LOG(LogLevel_Warn, subsystem, __VA_ARGS__)
+#define UNI_LOG_ERROR(subsystem, ...) UNI_LOG(LogLevel_Error, subsystem, __VA_ARGS__)
+#define UNI_LOG_CRITICAL(subsystem, ...) UNI_LOG(LogLevel_Critical, subsystem, __VA_ARGS__)
+
+// Longer messages are truncated.
+const uint32_t LogMessage_MaxLength = 472;
+// Number of messages the ring buffer can hold. Power of two.
+const uint32_t Log_RingCapacity = 1 << 13;
+
+// A formatted log message.
+struct LogMessage {
+    // Wall clock time, in nanoseconds since the Unix epoch
+    int64_t time_ns;
+    LogLevel level;
+    LogSubsystem subsystem;
+    uint32_t length;
+    char text[LogMessage_MaxLength];
+};
+
+// Ring buffer slot. The sequence number tells producers and the
+// writer thread whose turn it is to use the slot.
+struct alignas(64) LogRingSlot {
+    std::atomic<uint64_t> sequence;
+    LogMessage message;
+};
+
+// History entries are allocated in blocks of this many.
+const uint32_t Log_HistoryBlockSize = 1 << 14;
+// Maximum number of messages kept in the history. Later messages
+// are still written out, but are not added to the history.
+const uint32_t Log_HistoryMaxEntries = Log_HistoryBlockSize << 8;
+// Message text in the history is stored in blocks of this size.
+const uint32_t Log_HistoryTextBlockSize = 1 << 20;
+
+// A message kept in the log history. Entries and their text are
+// never changed or freed once published, so they can be read
+// from any thread without locks.
+struct LogHistoryEntry {
+    // Wall clock time, in nanoseconds since the Unix epoch
+    int64_t time_ns;
+    const char* text;
+    uint32_t length;
+    LogLevel level;
+    LogSubsystem subsystem;
+};
+
+// Get a readable name for a level, e.g. "debug".
+const char* LogLevel_GetName(LogLevel level);
+// Get a readable name for a subsystem, e.g. "GUI".
+const char* LogSubsystem_GetName(LogSubsystem subsystem);
+
+// Start the background writer thread.
+void Log_Init();
+// Write out all queued messages and stop the writer thread.
+// Messages logged afterwards are written synchronously.
+void Log_Conclude();
+// Set the runtime minimum level for one subsystem.
+void Log_SetLevel(LogSubsystem subsystem, LogLevel level);
+// Set the runtime minimum level for every subsystem.
+void Log_SetLevelAll(LogLevel level);
+LogLevel Log_GetLevel(LogSubsystem subsystem);
+// Get the number of messages dropped because the ring was full.
+uint64_t Log_GetDroppedCount();
+// Get the number of messages in the history so far.
+uint32_t Log_GetHistoryCount();
+// Get a message from the history. The index must be less than
+// a value previously returned by Log_GetHistoryCount.
+const LogHistoryEntry& Log_GetHistoryEntry(uint32_t index);
+
+// Runtime levels, read by Log_IsEnabled
+extern std::atomic<int> log_levels[LogSubsystem_COUNT];
+
+// Returns true if a message would currently be logged.
+inline bool Log_IsEnabled(LogLevel level, LogSubsystem subsystem) {
+    return (int) level >= log_levels[subsystem].load(std::memory_order_relaxed);
+}
+
+// Claim a ring slot and fill in its header. Returns nullptr, and
+// counts a dropped message, if the ring is full.
+LogRingSlot* Log_BeginWrite(LogLevel level, LogSubsystem subsystem);
+// Publish a claimed slot to the writer thread.
+void Log_EndWrite(LogRingSlot* slot);
+
+// Format a message into the ring. Prefer the UNI_LOG_* macros,
+// which skip formatting for disabled levels.
+template<typename... Args>
+void Log_Write(
+    LogLevel level,
+    LogSubsystem subsystem,
+    fmt::format_string<Args...> format,
+    Args&&... args
+) {
+    LogRingSlot* slot = Log_BeginWrite(level, subsystem);
+    if(!slot) {
+        return;
+    }
+    LogMessage& message = slot->message;
+    const auto result = fmt::format_to_n(
+        message.text, LogMessage_MaxLength, format, std::forward<Args>(args)...
+    );
+    if(result.size > LogMessage_MaxLength) {
+        // Mark the message as truncated
+        std::memcpy(message.text + LogMessage_MaxLength - 3, "...", 3);
+    }
+    message.length = (uint32_t) std::min<size_t>(result.size, LogMessage_MaxLength);
+    Log_EndWrite(slot);
+}
@@ -0,0 +1,129 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#if defined(PLATFORM_WINDOWS)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    this->close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other) {
+        this->close();
+        std::swap(this->bytes, other.bytes);
+        std::swap(this->length, other.length);
+        std::swap(this->mode, other.mode);
+#if defined(PLATFORM_WINDOWS)
+        std::swap(this->file_handle, other.file_handle);
+        std::swap(this->mapping_handle, other.mapping_handle);
+#endif
+    }
+    return *this;
+}
+
+#if defined(PLATFORM_WINDOWS)
+
+bool MappedFile::open(const char* path, MappedFileMode mode) {
+    this->close();
+    HANDLE file = CreateFileA(
+        path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if(file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+    const DWORD protect = (
+        mode == MappedFileMode_CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY
+    );
+    HANDLE mapping = CreateFileMappingA(file, nullptr, protect, 0, 0, nullptr);
+    if(!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    const DWORD access = (
+        mode == MappedFileMode_CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ
+    );
+    void* view = MapViewOfFile(mapping, access, 0, 0, 0);
+    if(!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    this->bytes = (uint8_t*) view;
+    this->length = (size_t) file_size.QuadPart;
+    this->mode = mode;
+    this->file_handle = file;
+    this->mapping_handle = mapping;
+    return true;
+}
+
+void MappedFile::close() {
+    if(this->bytes) {
+        UnmapViewOfFile(this->bytes);
+        CloseHandle((HANDLE) this->mapping_handle);
+        CloseHandle((HANDLE) this->file_handle);
+    }
+    this->bytes = nullptr;
+    this->length = 0;
+    this->file_handle = nullptr;
+    this->mapping_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path, MappedFileMode mode) {
+    this->close();
+    const int fd = ::open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    const int protect = (
+        mode == MappedFileMode_CopyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ
+    );
+    void* view = mmap(
+        nullptr, (size_t) file_stat.st_size, protect, MAP_PRIVATE, fd, 0
+    );
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if(view == MAP_FAILED) {
+        return false;
+    }
+    this->bytes = (uint8_t*) view;
+    this->length = (size_t) file_stat.st_size;
+    this->mode = mode;
+    return true;
+}
+
+void MappedFile::close() {
+    if(this->bytes) {
+        munmap(this->bytes, this->length);
+    }
+    this->bytes = nullptr;
+    this->length = 0;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum MappedFileMode : int {
+    // Pages are mapped read-only.
+    MappedFileMode_Read = 0,
+    // Pages are readable and writable, but writes are private to
+    // this process and never reach the file. The OS copies each
+    // page the first time it is written.
+    MappedFileMode_CopyOnWrite = 1,
+};
+
+/**
+ * Memory-mapped view of an entire file.
+ * Pages are faulted in by the OS as they are first touched.
+ */
+class MappedFile {
+public:
+    MappedFile() {};
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    
+    // Map a file. Returns false if the file could not be opened
+    // or mapped. Empty files can't be mapped.
+    bool open(const char* path, MappedFileMode mode = MappedFileMode_Read);
+    // Unmap the file, if one is mapped.
+    void close();
+    bool is_open() const {
+        return this->bytes != nullptr;
+    }
+    const uint8_t* data() const {
+        return this->bytes;
+    }
+    // Writable pointer. Only valid in MappedFileMode_CopyOnWrite.
+    uint8_t* data_mutable() {
+        return this->mode == MappedFileMode_CopyOnWrite ? this->bytes : nullptr;
+    }
+    size_t size() const {
+        return this->length;
+    }
+    
+private:
+    uint8_t* bytes = nullptr;
+    size_t length = 0;
+    MappedFileMode mode = MappedFileMode_Read;
+#if defined(PLATFORM_WINDOWS)
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
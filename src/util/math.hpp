@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Small vector types for data which must not depend on raylib,
+ * such as the level document, so that it can also be used by
+ * headless tools and worker threads.
+ */
+
+struct Vec2 {
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+struct Vec3 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    
+    Vec3 operator+(const Vec3& other) const {
+        return Vec3{this->x + other.x, this->y + other.y, this->z + other.z};
+    }
+    Vec3 operator-(const Vec3& other) const {
+        return Vec3{this->x - other.x, this->y - other.y, this->z - other.z};
+    }
+    Vec3 operator*(const Vec3& other) const {
+        return Vec3{this->x * other.x, this->y * other.y, this->z * other.z};
+    }
+    Vec3 operator*(float scale) const {
+        return Vec3{this->x * scale, this->y * scale, this->z * scale};
+    }
+    bool operator==(const Vec3& other) const {
+        return this->x == other.x && this->y == other.y && this->z == other.z;
+    }
+    bool operator!=(const Vec3& other) const {
+        return !(*this == other);
+    }
+};
+
+// Rotation quaternion. The default value is the identity.
+struct Quat {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 1.0f;
+    
+    bool operator==(const Quat& other) const {
+        return (
+            this->x == other.x && this->y == other.y &&
+            this->z == other.z && this->w == other.w
+        );
+    }
+    bool operator!=(const Quat& other) const {
+        return !(*this == other);
+    }
+};
+
+// Half-line from an origin in a direction. The direction doesn't
+// need to be normalized; distances along the ray are measured in
+// multiples of its length.
+struct Ray3 {
+    Vec3 origin;
+    Vec3 direction;
+    
+    Vec3 get_point(float distance) const {
+        return this->origin + this->direction * distance;
+    }
+};
+
+// Axis-aligned bounding box.
+struct Bounds3 {
+    Vec3 min;
+    Vec3 max;
+    
+    Vec3 get_center() const {
+        return (this->min + this->max) * 0.5f;
+    }
+    Vec3 get_extent() const {
+        return (this->max - this->min) * 0.5f;
+    }
+};
+
+// Plane of the points p where dot(normal, p) + distance is zero.
+// Points on the side the normal faces are in front of it.
+struct Plane3 {
+    Vec3 normal;
+    float distance = 0.0f;
+};
+
+// Volume seen by a camera, bounded by six planes facing inward:
+// near, far, left, right, bottom and top.
+struct Frustum3 {
+    Plane3 planes[6];
+};
+
+// Bounds which contain nothing. Growing them by any point or box
+// gives that point or box.
+const Bounds3 Bounds3_Empty = Bounds3{
+    Vec3{INFINITY, INFINITY, INFINITY},
+    Vec3{-INFINITY, -INFINITY, -INFINITY}
+};
+
+inline float Vec3_Dot(const Vec3& a, const Vec3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 Vec3_Cross(const Vec3& a, const Vec3& b) {
+    return Vec3{
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x
+    };
+}
+
+inline float Vec3_Length(const Vec3& a) {
+    return std::sqrt(Vec3_Dot(a, a));
+}
+
+inline Vec3 Vec3_Normalize(const Vec3& a) {
+    const float length = Vec3_Length(a);
+    return length > 0.0f ? a * (1.0f / length) : a;
+}
+
+inline Vec3 Vec3_Min(const Vec3& a, const Vec3& b) {
+    return Vec3{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+inline Vec3 Vec3_Max(const Vec3& a, const Vec3& b) {
+    return Vec3{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+
+inline Vec3 Vec3_Abs(const Vec3& a) {
+    return Vec3{std::fabs(a.x), std::fabs(a.y), std::fabs(a.z)};
+}
+
+// Rotate a vector by a unit quaternion.
+inline Vec3 Quat_Rotate(const Quat& q, const Vec3& v) {
+    const Vec3 u = Vec3{q.x, q.y, q.z};
+    const Vec3 t = Vec3_Cross(u, v) * 2.0f;
+    return v + t * q.w + Vec3_Cross(u, t);
+}
+
+// Get the inverse of a unit quaternion.
+inline Quat Quat_Conjugate(const Quat& q) {
+    return Quat{-q.x, -q.y, -q.z, q.w};
+}
+
+// Make a unit quaternion from a unit axis and an angle in radians.
+inline Quat Quat_FromAxisAngle(const Vec3& axis, float angle) {
+    const float s = std::sin(0.5f * angle);
+    return Quat{axis.x * s, axis.y * s, axis.z * s, std::cos(0.5f * angle)};
+}
+
+inline Bounds3 Bounds3_Grow(const Bounds3& bounds, const Vec3& point) {
+    return Bounds3{Vec3_Min(bounds.min, point), Vec3_Max(bounds.max, point)};
+}
+
+inline Bounds3 Bounds3_Union(const Bounds3& a, const Bounds3& b) {
+    return Bounds3{Vec3_Min(a.min, b.min), Vec3_Max(a.max, b.max)};
+}
+
+inline float Bounds3_GetSurfaceArea(const Bounds3& bounds) {
+    const Vec3 size = bounds.max - bounds.min;
+    if(size.x < 0.0f || size.y < 0.0f || size.z < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+inline bool Bounds3_Overlaps(const Bounds3& a, const Bounds3& b) {
+    return (
+        a.min.x <= b.max.x && a.max.x >= b.min.x &&
+        a.min.y <= b.max.y && a.max.y >= b.min.y &&
+        a.min.z <= b.max.z && a.max.z >= b.min.z
+    );
+}
+
+// Get the world-space bounds of a box after scaling, rotating,
+// and then translating it.
+inline Bounds3 Bounds3_Transform(
+    const Bounds3& bounds,
+    const Vec3& position,
+    const Quat& rotation,
+    const Vec3& scale
+) {
+    const Vec3 center = position + Quat_Rotate(rotation, bounds.get_center() * scale);
+    const Vec3 extent = bounds.get_extent() * Vec3_Abs(scale);
+    // Each world axis takes the absolute projection of each
+    // rotated local axis, scaled by the extent along it.
+    const Vec3 axis_x = Vec3_Abs(Quat_Rotate(rotation, Vec3{1.0f, 0.0f, 0.0f}));
+    const Vec3 axis_y = Vec3_Abs(Quat_Rotate(rotation, Vec3{0.0f, 1.0f, 0.0f}));
+    const Vec3 axis_z = Vec3_Abs(Quat_Rotate(rotation, Vec3{0.0f, 0.0f, 1.0f}));
+    const Vec3 world_extent = axis_x * extent.x + axis_y * extent.y + axis_z * extent.z;
+    return Bounds3{center - world_extent, center + world_extent};
+}
+
+inline Plane3 Plane3_FromNormalPoint(const Vec3& normal, const Vec3& point) {
+    const Vec3 unit = Vec3_Normalize(normal);
+    return Plane3{unit, -Vec3_Dot(unit, point)};
+}
+
+// Get the frustum of a perspective camera. The vertical field of
+// view is in radians, and aspect is width divided by height.
+inline Frustum3 Frustum3_FromPerspective(
+    const Vec3& position,
+    const Vec3& forward,
+    const Vec3& up,
+    float fovy,
+    float aspect,
+    float near_distance,
+    float far_distance
+) {
+    const Vec3 f = Vec3_Normalize(forward);
+    const Vec3 r = Vec3_Normalize(Vec3_Cross(f, up));
+    const Vec3 u = Vec3_Cross(r, f);
+    const float half_height = std::tan(0.5f * fovy);
+    const float half_width = half_height * aspect;
+    Frustum3 frustum;
+    frustum.planes[0] = Plane3_FromNormalPoint(f, position + f * near_distance);
+    frustum.planes[1] = Plane3_FromNormalPoint(f * -1.0f, position + f * far_distance);
+    frustum.planes[2] = Plane3_FromNormalPoint(r + f * half_width, position);
+    frustum.planes[3] = Plane3_FromNormalPoint(f * half_width - r, position);
+    frustum.planes[4] = Plane3_FromNormalPoint(u + f * half_height, position);
+    frustum.planes[5] = Plane3_FromNormalPoint(f * half_height - u, position);
+    return frustum;
+}
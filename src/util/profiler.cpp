@@ -0,0 +1,297 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "util/alloc_counter.hpp"
+#include "util/log.hpp"
+
+// Single-producer, single-consumer ring of completed zones.
+// The owning thread writes at head, the main thread reads at tail.
+struct ProfilerThreadBuffer {
+    uint32_t thread_index = 0;
+    char name[32] = {};
+    std::atomic<uint32_t> head = 0;
+    std::atomic<uint32_t> tail = 0;
+    std::atomic<uint64_t> dropped = 0;
+    ProfilerEvent events[Profiler_ThreadBufferCapacity];
+};
+
+static std::mutex profiler_registry_mutex;
+static std::atomic<ProfilerThreadBuffer*> profiler_buffers[Profiler_MaxThreads];
+static std::atomic<uint32_t> profiler_buffer_count = 0;
+static thread_local ProfilerThreadBuffer* profiler_local_buffer = nullptr;
+static thread_local bool profiler_local_buffer_failed = false;
+static thread_local uint32_t profiler_local_depth = 0;
+// Counters recorded since the last end_frame. Only a few are
+// recorded per frame, so unlike zones they share one list.
+static std::mutex profiler_counters_mutex;
+static std::vector<ProfilerCounter> profiler_pending_counters;
+
+// Get the calling thread's buffer, registering one on first use.
+// Buffers are never freed so that the main thread can always
+// safely drain them, even after their thread has exited.
+static ProfilerThreadBuffer* Profiler_GetLocalBuffer() {
+    if(profiler_local_buffer || profiler_local_buffer_failed) {
+        return profiler_local_buffer;
+    }
+    std::lock_guard<std::mutex> lock(profiler_registry_mutex);
+    const uint32_t index = profiler_buffer_count.load();
+    if(index >= Profiler_MaxThreads) {
+        profiler_local_buffer_failed = true;
+        return nullptr;
+    }
+    auto buffer = new ProfilerThreadBuffer();
+    buffer->thread_index = index;
+    std::snprintf(buffer->name, sizeof(buffer->name), "Thread %u", index);
+    profiler_buffers[index].store(buffer, std::memory_order_release);
+    profiler_buffer_count.store(index + 1, std::memory_order_release);
+    profiler_local_buffer = buffer;
+    return buffer;
+}
+
+uint64_t Profiler_Now() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void Profiler_SetThreadName(const char* name) {
+    auto buffer = Profiler_GetLocalBuffer();
+    if(buffer) {
+        std::lock_guard<std::mutex> lock(profiler_registry_mutex);
+        std::snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+    }
+}
+
+void Profiler_GetThreadName(uint32_t thread_index, char* name, size_t name_size) {
+    std::lock_guard<std::mutex> lock(profiler_registry_mutex);
+    const char* source = "[Unknown]";
+    if(thread_index < profiler_buffer_count.load(std::memory_order_acquire)) {
+        source = profiler_buffers[thread_index].load(std::memory_order_acquire)->name;
+    }
+    std::snprintf(name, name_size, "%s", source);
+}
+
+void Profiler_RecordZone(
+    const char* name, uint64_t begin_ns, uint64_t end_ns, uint32_t depth
+) {
+    auto buffer = Profiler_GetLocalBuffer();
+    if(!buffer) {
+        return;
+    }
+    const uint32_t head = buffer->head.load(std::memory_order_relaxed);
+    const uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+    if(head - tail >= Profiler_ThreadBufferCapacity) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[head & (Profiler_ThreadBufferCapacity - 1)] = ProfilerEvent{
+        .name = name,
+        .begin_ns = begin_ns,
+        .end_ns = end_ns,
+        .thread_index = buffer->thread_index,
+        .depth = depth
+    };
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+uint32_t Profiler_PushDepth() {
+    return profiler_local_depth++;
+}
+
+void Profiler_PopDepth() {
+    profiler_local_depth--;
+}
+
+void Profiler_RecordCounter(const char* name, double value) {
+    std::lock_guard<std::mutex> lock(profiler_counters_mutex);
+    for(auto& counter : profiler_pending_counters) {
+        if(counter.name == name) {
+            counter.value = value;
+            return;
+        }
+    }
+    profiler_pending_counters.push_back(ProfilerCounter{name, value});
+}
+
+void Profiler::init() {
+    UNI_LOG_DEBUG(LogSubsystem_General, "Initializing Profiler.");
+    this->history.clear();
+    this->history.resize(std::max(1, this->history_length));
+    this->frame_count = 0;
+    Profiler_SetThreadName("Main");
+}
+
+void Profiler::begin_frame() {
+    this->frame_begin_ns = Profiler_Now();
+    this->frame_begin_alloc_count = AllocCounter_GetThreadCount();
+}
+
+void Profiler::end_frame() {
+    if(this->history.empty()) {
+        return;
+    }
+    const uint64_t frame_end_ns = Profiler_Now();
+    const uint64_t alloc_count = (
+        AllocCounter_GetThreadCount() - this->frame_begin_alloc_count
+    );
+    ProfilerFrame* frame = nullptr;
+    if(!this->paused) {
+        const auto slot = this->frame_count % this->history.size();
+        frame = &this->history[slot];
+        frame->begin_ns = this->frame_begin_ns;
+        frame->end_ns = frame_end_ns;
+        frame->alloc_count = alloc_count;
+        frame->events.clear();
+        this->frame_count++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(profiler_counters_mutex);
+        if(frame) {
+            frame->counters.assign(
+                profiler_pending_counters.begin(),
+                profiler_pending_counters.end()
+            );
+        }
+        profiler_pending_counters.clear();
+    }
+    // Drain every thread buffer, even when paused, so that
+    // writers never observe a full buffer for long.
+    const uint32_t buffer_count = (
+        profiler_buffer_count.load(std::memory_order_acquire)
+    );
+    this->dropped_count = 0;
+    for(uint32_t i = 0; i < buffer_count; ++i) {
+        auto buffer = profiler_buffers[i].load(std::memory_order_acquire);
+        const uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+        const uint32_t head = buffer->head.load(std::memory_order_acquire);
+        if(frame) {
+            for(uint32_t j = tail; j != head; ++j) {
+                frame->events.push_back(
+                    buffer->events[j & (Profiler_ThreadBufferCapacity - 1)]
+                );
+            }
+        }
+        buffer->tail.store(head, std::memory_order_release);
+        this->dropped_count += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    if(frame) {
+        // Zones are pushed as they end, so parents come after
+        // their children. Order them for drawing.
+        std::sort(
+            frame->events.begin(),
+            frame->events.end(),
+            [](const ProfilerEvent& a, const ProfilerEvent& b) -> bool {
+                if(a.thread_index != b.thread_index) {
+                    return a.thread_index < b.thread_index;
+                }
+                if(a.begin_ns != b.begin_ns) {
+                    return a.begin_ns < b.begin_ns;
+                }
+                return a.depth < b.depth;
+            }
+        );
+    }
+}
+
+int Profiler::get_frame_count() {
+    return (int) std::min<uint64_t>(this->frame_count, this->history.size());
+}
+
+ProfilerFrame* Profiler::get_frame(int age) {
+    if(age < 0 || age >= this->get_frame_count()) {
+        return nullptr;
+    }
+    const auto slot = (this->frame_count - 1 - age) % this->history.size();
+    return &this->history[slot];
+}
+
+static void Profiler_WriteJsonString(std::FILE* file, const char* text) {
+    std::fputc('"', file);
+    for(const char* ch = text; *ch; ++ch) {
+        if(*ch == '"' || *ch == '\\') {
+            std::fputc('\\', file);
+            std::fputc(*ch, file);
+        }
+        else if((unsigned char) *ch < 0x20) {
+            std::fprintf(file, "\\u%04x", (unsigned) *ch);
+        }
+        else {
+            std::fputc(*ch, file);
+        }
+    }
+    std::fputc('"', file);
+}
+
+bool Profiler::export_chrome_trace(const char* path) {
+    std::FILE* file = std::fopen(path, "wb");
+    if(!file) {
+        UNI_LOG_ERROR(LogSubsystem_General, "Failed to open profiler trace output file '{}'.", path);
+        return false;
+    }
+    const int frame_count = this->get_frame_count();
+    // Timestamps are written relative to the oldest frame
+    const ProfilerFrame* oldest = this->get_frame(frame_count - 1);
+    const uint64_t origin_ns = oldest ? oldest->begin_ns : 0;
+    std::fputs("{\"traceEvents\":[\n", file);
+    bool first = true;
+    const uint32_t buffer_count = profiler_buffer_count.load();
+    for(uint32_t i = 0; i < buffer_count; ++i) {
+        std::fprintf(
+            file,
+            "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+            first ? "" : ",\n", i
+        );
+        char thread_name[sizeof(ProfilerThreadBuffer::name)];
+        Profiler_GetThreadName(i, thread_name, sizeof(thread_name));
+        Profiler_WriteJsonString(file, thread_name);
+        std::fputs("}}", file);
+        first = false;
+    }
+    for(int age = frame_count - 1; age >= 0; --age) {
+        const ProfilerFrame* frame = this->get_frame(age);
+        for(const auto& event : frame->events) {
+            if(event.begin_ns < origin_ns) {
+                continue;
+            }
+            std::fputs(first ? "{\"ph\":\"X\",\"name\":" : ",\n{\"ph\":\"X\",\"name\":", file);
+            Profiler_WriteJsonString(file, event.name);
+            std::fprintf(
+                file,
+                ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.thread_index,
+                (double) (event.begin_ns - origin_ns) * 1e-3,
+                (double) (event.end_ns - event.begin_ns) * 1e-3
+            );
+            first = false;
+        }
+        for(const auto& counter : frame->counters) {
+            if(frame->begin_ns < origin_ns) {
+                continue;
+            }
+            std::fputs(first ? "{\"ph\":\"C\",\"name\":" : ",\n{\"ph\":\"C\",\"name\":", file);
+            Profiler_WriteJsonString(file, counter.name);
+            std::fprintf(
+                file,
+                ",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%.17g}}",
+                (double) (frame->begin_ns - origin_ns) * 1e-3,
+                counter.value
+            );
+            first = false;
+        }
+    }
+    std::fputs("\n]}\n", file);
+    const bool ok = (std::ferror(file) == 0);
+    std::fclose(file);
+    if(ok) {
+        UNI_LOG_INFO(LogSubsystem_General, "Wrote profiler trace for {} frames to '{}'.", frame_count, path);
+    }
+    else {
+        UNI_LOG_ERROR(LogSubsystem_General, "Failed to write profiler trace output file '{}'.", path);
+    }
+    return ok;
+}
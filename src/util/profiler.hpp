@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Lightweight frame profiler.
+ *
+ * Code is instrumented with UNI_PROFILE_ZONE, which records the
+ * time spent in the enclosing scope. Each thread writes completed
+ * zones into its own single-producer ring buffer without taking
+ * any locks, and the main thread drains all buffers once per frame
+ * in Profiler::end_frame.
+ *
+ * The zone macros compile to nothing unless UNI_PROFILER is
+ * defined, e.g. by building with `scons profile=1`.
+ */
+
+#define UNI_PROFILE_CONCAT_INNER(a, b) a##b
+#define UNI_PROFILE_CONCAT(a, b) UNI_PROFILE_CONCAT_INNER(a, b)
+
+#if defined(UNI_PROFILER)
+    // Record the time spent in the enclosing scope.
+    // The name must be a string with static storage duration,
+    // normally a string literal.
+    #define UNI_PROFILE_ZONE(name) ProfilerZone UNI_PROFILE_CONCAT( \
+        uni_profile_zone_, __LINE__ \
+    )(name)
+    // Set a readable name for the calling thread.
+    #define UNI_PROFILE_THREAD(name) Profiler_SetThreadName(name)
+    // Record a value for the current frame, such as how many
+    // objects were processed. The name must have static storage
+    // duration, like zone names.
+    #define UNI_PROFILE_COUNTER(name, value) Profiler_RecordCounter( \
+        name, (double) (value) \
+    )
+#else
+    #define UNI_PROFILE_ZONE(name) ((void) 0)
+    #define UNI_PROFILE_THREAD(name) ((void) 0)
+    #define UNI_PROFILE_COUNTER(name, value) ((void) 0)
+#endif
+
+// Maximum number of distinct threads which can record zones.
+const int Profiler_MaxThreads = 64;
+// Number of zones which each thread can buffer between frames.
+// Must be a power of two.
+const uint32_t Profiler_ThreadBufferCapacity = 1 << 14;
+
+// Get a monotonic timestamp in nanoseconds.
+uint64_t Profiler_Now();
+// Set a readable name for the calling thread. The name is
+// shown in the overlay and in exported traces.
+void Profiler_SetThreadName(const char* name);
+// Copy the name previously given to a thread, by thread index.
+// Names may change at any time, so they are copied under a lock.
+void Profiler_GetThreadName(uint32_t thread_index, char* name, size_t name_size);
+
+// A completed zone, as recorded by a thread.
+struct ProfilerEvent {
+    // Static string identifying the zone
+    const char* name;
+    // Timestamps from Profiler_Now
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    // Index of the thread which recorded the zone
+    uint32_t thread_index;
+    // Nesting depth of the zone within its thread
+    uint32_t depth;
+};
+
+// A value recorded during one frame.
+struct ProfilerCounter {
+    // Static string identifying the counter
+    const char* name;
+    double value;
+};
+
+// Push a completed zone into the calling thread's ring buffer.
+// The zone is dropped if the buffer is full.
+void Profiler_RecordZone(const char* name, uint64_t begin_ns, uint64_t end_ns, uint32_t depth);
+// Increment and return the calling thread's zone depth.
+uint32_t Profiler_PushDepth();
+// Decrement the calling thread's zone depth.
+void Profiler_PopDepth();
+// Set a counter's value for the current frame, from any thread.
+// Recording a counter again in the same frame replaces its value.
+void Profiler_RecordCounter(const char* name, double value);
+
+// RAII helper instantiated by UNI_PROFILE_ZONE.
+struct ProfilerZone {
+    const char* name;
+    uint64_t begin_ns;
+    uint32_t depth;
+    
+    ProfilerZone(const char* name):
+        name(name),
+        begin_ns(Profiler_Now()),
+        depth(Profiler_PushDepth())
+    {};
+    ~ProfilerZone() {
+        Profiler_PopDepth();
+        Profiler_RecordZone(this->name, this->begin_ns, Profiler_Now(), this->depth);
+    }
+    ProfilerZone(const ProfilerZone&) = delete;
+    ProfilerZone& operator=(const ProfilerZone&) = delete;
+};
+
+// All zones which were drained during one frame.
+struct ProfilerFrame {
+    uint64_t begin_ns = 0;
+    uint64_t end_ns = 0;
+    // Zones sorted by thread, then by begin time
+    std::vector<ProfilerEvent> events;
+    // Counters in the order they were first recorded
+    std::vector<ProfilerCounter> counters;
+    // Heap allocations made by the main thread during the frame,
+    // if AllocCounter is enabled
+    uint64_t alloc_count = 0;
+    
+    float get_duration_ms() const {
+        return (float) (this->end_ns - this->begin_ns) * 1e-6f;
+    }
+};
+
+class Profiler {
+public:
+    // Number of frames retained for display and export
+    int history_length = 300;
+    // When true, end_frame discards drained zones instead of
+    // overwriting the history.
+    bool paused = false;
+    // Ring of recent frames. Storage is reused between frames.
+    std::vector<ProfilerFrame> history;
+    // Total number of frames recorded since init
+    uint64_t frame_count = 0;
+    // Total number of zones dropped due to full thread buffers
+    uint64_t dropped_count = 0;
+    
+    // Allocate frame history.
+    void init();
+    // Mark the beginning of a frame. Call from the main thread.
+    void begin_frame();
+    // Mark the end of a frame and drain all thread buffers.
+    // Call from the main thread.
+    void end_frame();
+    // Get the number of frames currently held in history.
+    int get_frame_count();
+    // Get a recorded frame. Index 0 is the most recent frame.
+    ProfilerFrame* get_frame(int age);
+    // Write the recorded history in Chrome trace event format.
+    // The output can be loaded in chrome://tracing or Perfetto.
+    // Returns false if the file could not be written.
+    bool export_chrome_trace(const char* path);
+    
+private:
+    uint64_t frame_begin_ns = 0;
+    uint64_t frame_begin_alloc_count = 0;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+ * Selects SIMD code paths at compile time.
+ * 
+ * UNI_SIMD_SSE is defined when SSE2 can be used, which is always
+ * true on x86-64. Code using it must keep a plain C++ path for
+ * other targets, such as ARM Macs. Wider instruction sets aren't
+ * used, since builds don't target a particular CPU.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define UNI_SIMD_SSE 1
+    #include <emmintrin.h>
+#endif
@@ -3,7 +3,7 @@
 #include <string>
 #include <vector>
 
-bool string_starts_with_insensitive(std::string a_str, std::string b_str) {
+bool string_starts_with_insensitive(std::string_view a_str, std::string_view b_str) {
     const auto a_length = a_str.size();
     const auto b_length = b_str.size();
     if(a_length < b_length) {
@@ -86,22 +86,33 @@ inline int state_get_score(SubFuzzyMatchState* state) {
 
 // TODO: would be good to factor in index of first matched char in score
 StringFuzzyMatchResult string_fuzzy_match(
-    std::string needle_str, std::string haystack_str
+    std::string_view needle_str,
+    std::string_view haystack_str,
+    Arena* arena
 ) {
     const int needle_length = (int) needle_str.size();
     const int haystack_length = (int) haystack_str.size();
     const int row_length = 1 + needle_length;
     const int col_length = 1 + haystack_length;
     const int state_matrix_length = row_length * col_length;
-    // TODO: std::vector is not needed here. optimize this
-    auto state_matrix = std::vector<SubFuzzyMatchState>(state_matrix_length);
-    // Initialization step not needed due to std::vector
-    // for(int i = 0; i < row_length; ++i) {
-    //     state_matrix[i] = SubFuzzyMatchState{};
-    // }
-    // for(int j = 1; j < col_length; ++j) {
-    //     state_matrix[j * row_length] = SubFuzzyMatchState{};
-    // }
+    std::vector<SubFuzzyMatchState> state_matrix_heap;
+    SubFuzzyMatchState* state_matrix = nullptr;
+    if(arena) {
+        state_matrix = arena->allocate_array<SubFuzzyMatchState>(
+            state_matrix_length
+        );
+        // Only the first row and column are read before written
+        for(int i = 0; i < row_length; ++i) {
+            state_matrix[i] = SubFuzzyMatchState{};
+        }
+        for(int j = 1; j < col_length; ++j) {
+            state_matrix[j * row_length] = SubFuzzyMatchState{};
+        }
+    }
+    else {
+        state_matrix_heap.resize(state_matrix_length);
+        state_matrix = state_matrix_heap.data();
+    }
     for(int i = 1; i < row_length; ++i) {
         const char needle_char = std::toupper(needle_str[i - 1]);
         const auto needle_char_is_word_char = ascii_is_word_char(needle_char);
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+
+#include "util/arena.hpp"
 
 // Type returned by string_fuzzy_match.
 struct StringFuzzyMatchResult {
@@ -20,11 +23,16 @@ struct StringFuzzyMatchResult {
  * Only ASCII characters are compared case-insensitively.
  * Does not perform unicode normalization.
  */
-bool string_starts_with_insensitive(std::string a_str, std::string b_str);
+bool string_starts_with_insensitive(std::string_view a_str, std::string_view b_str);
 
 /**
  * TODO: Document this
+ * 
+ * Scratch memory is taken from the arena if one is given, and
+ * from the heap otherwise.
  */
 StringFuzzyMatchResult string_fuzzy_match(
-    std::string needle_str, std::string haystack_str
+    std::string_view needle_str,
+    std::string_view haystack_str,
+    Arena* arena = nullptr
 );
@@ -0,0 +1,178 @@
+#include "symbol.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "util/arena.hpp"
+#include "util/hash.hpp"
+#include "util/log.hpp"
+
+struct SymbolEntry {
+    const char* text;
+    uint32_t length;
+};
+
+// Symbol entries are allocated in blocks of this size.
+const uint32_t Symbol_BlockSize = 1 << 12;
+// Maximum number of entry blocks, limiting the number of symbols.
+const uint32_t Symbol_MaxBlocks = 1 << 10;
+
+struct SymbolTable {
+    // Guards everything except lock-free reads described below
+    std::mutex mutex;
+    // Storage for interned text. Never reset, so text never moves.
+    Arena arena;
+    // Entries by symbol id. Block pointers are published with
+    // release stores, so any thread holding a symbol can read its
+    // entry without locking.
+    std::atomic<SymbolEntry*> blocks[Symbol_MaxBlocks] = {};
+    uint32_t count = 0;
+    // Open addressing table of symbol ids, with 0 marking an empty
+    // slot. Only modified before freezing, and read without locking
+    // afterwards.
+    std::vector<uint32_t> slots;
+    uint32_t slots_used = 0;
+    std::atomic<bool> frozen = false;
+    // Symbols interned after freezing. Keys view arena text.
+    std::unordered_map<std::string_view, uint32_t> late_symbols;
+    
+    SymbolTable() {
+        this->arena.init(64 << 10);
+        this->slots.resize(1024, 0);
+        // Symbol 0 is the empty string
+        this->add_entry(std::string_view(""));
+    }
+    
+    uint32_t add_entry(std::string_view text) {
+        const uint32_t id = this->count;
+        const uint32_t block_index = id / Symbol_BlockSize;
+        assert(block_index < Symbol_MaxBlocks && "Too many symbols.");
+        SymbolEntry* block = this->blocks[block_index].load(std::memory_order_relaxed);
+        if(!block) {
+            // Blocks live as long as the program, like the text
+            block = new SymbolEntry[Symbol_BlockSize];
+            this->blocks[block_index].store(block, std::memory_order_release);
+        }
+        block[id % Symbol_BlockSize] = SymbolEntry{
+            this->arena.copy_string(text), (uint32_t) text.size()
+        };
+        this->count++;
+        return id;
+    }
+    
+    std::string_view get_text(uint32_t id) {
+        const SymbolEntry* block = this->blocks[id / Symbol_BlockSize].load(
+            std::memory_order_acquire
+        );
+        const SymbolEntry& entry = block[id % Symbol_BlockSize];
+        return std::string_view(entry.text, entry.length);
+    }
+    
+    // Find the slot holding a string's symbol, or the empty slot
+    // where it would be inserted.
+    uint32_t find_slot(std::string_view text) {
+        const uint32_t mask = (uint32_t) this->slots.size() - 1;
+        uint32_t slot = (uint32_t) hash_bytes(text.data(), text.size()) & mask;
+        while(this->slots[slot] != 0 && this->get_text(this->slots[slot]) != text) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+    
+    void insert_slot(uint32_t id) {
+        // Keep the load factor at or below one half
+        if((this->slots_used + 1) * 2 > this->slots.size()) {
+            std::vector<uint32_t> old_slots = std::move(this->slots);
+            this->slots.assign(old_slots.size() * 2, 0);
+            for(const uint32_t old_id : old_slots) {
+                if(old_id != 0) {
+                    this->slots[this->find_slot(this->get_text(old_id))] = old_id;
+                }
+            }
+        }
+        this->slots[this->find_slot(this->get_text(id))] = id;
+        this->slots_used++;
+    }
+};
+
+// Constructed on first use, so that symbols may be interned
+// during static initialization.
+static SymbolTable& Symbol_GetTable() {
+    static SymbolTable table;
+    return table;
+}
+
+Symbol::Symbol(const char* text) {
+    *this = Symbol_Intern(text ? std::string_view(text) : std::string_view());
+}
+
+Symbol::Symbol(std::string_view text) {
+    *this = Symbol_Intern(text);
+}
+
+Symbol::Symbol(const std::string& text) {
+    *this = Symbol_Intern(text);
+}
+
+std::string_view Symbol::view() const {
+    return Symbol_GetTable().get_text(this->id);
+}
+
+const char* Symbol::c_str() const {
+    return this->view().data();
+}
+
+size_t Symbol::size() const {
+    return this->view().size();
+}
+
+Symbol Symbol_Intern(std::string_view text) {
+    if(text.empty()) {
+        return Symbol_None;
+    }
+    SymbolTable& table = Symbol_GetTable();
+    Symbol symbol;
+    if(table.frozen.load(std::memory_order_acquire)) {
+        const uint32_t slot = table.find_slot(text);
+        if(table.slots[slot] != 0) {
+            symbol.id = table.slots[slot];
+            return symbol;
+        }
+        std::lock_guard<std::mutex> lock(table.mutex);
+        auto late_symbol = table.late_symbols.find(text);
+        if(late_symbol != table.late_symbols.end()) {
+            symbol.id = late_symbol->second;
+            return symbol;
+        }
+        symbol.id = table.add_entry(text);
+        table.late_symbols.emplace(table.get_text(symbol.id), symbol.id);
+        UNI_LOG_TRACE(LogSubsystem_General, "Interned symbol '{}' after freezing.", table.get_text(symbol.id));
+        return symbol;
+    }
+    std::lock_guard<std::mutex> lock(table.mutex);
+    const uint32_t slot = table.find_slot(text);
+    if(table.slots[slot] != 0) {
+        symbol.id = table.slots[slot];
+        return symbol;
+    }
+    symbol.id = table.add_entry(text);
+    table.insert_slot(symbol.id);
+    return symbol;
+}
+
+void Symbol_Freeze() {
+    SymbolTable& table = Symbol_GetTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    if(!table.frozen.load(std::memory_order_relaxed)) {
+        UNI_LOG_DEBUG(
+            LogSubsystem_General,
+            "Froze symbol table with {} symbols in {} bytes.",
+            table.count, table.arena.get_used_bytes()
+        );
+        table.frozen.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Interned string, identified by a 32-bit index into a global
+ * symbol table.
+ * 
+ * Interning the same text always gives the same symbol, so symbols
+ * are compared and hashed as integers. The interned text is stored
+ * once, never moves, and lives until the program exits.
+ * 
+ * The table is frozen with Symbol_Freeze once startup is done.
+ * After that, looking up existing symbols and reading their text
+ * takes no locks. Symbols may still be interned after freezing,
+ * but each new one is slower, as it goes through a mutex.
+ */
+struct Symbol {
+    // Zero is the empty string
+    uint32_t id = 0;
+    
+    Symbol() {};
+    // Intern a string
+    Symbol(const char* text);
+    Symbol(std::string_view text);
+    Symbol(const std::string& text);
+    
+    // Get the interned text. The view is null-terminated.
+    std::string_view view() const;
+    const char* c_str() const;
+    size_t size() const;
+    bool empty() const {
+        return this->id == 0;
+    }
+    
+    bool operator==(const Symbol& other) const {
+        return this->id == other.id;
+    }
+    bool operator!=(const Symbol& other) const {
+        return this->id != other.id;
+    }
+};
+
+const Symbol Symbol_None = Symbol();
+
+// Hash function for using symbols as unordered_map keys.
+struct SymbolHash {
+    size_t operator()(const Symbol& symbol) const {
+        return (size_t) symbol.id * 0x9e3779b97f4a7c15ull;
+    }
+};
+
+// Get the symbol for a string, adding it to the table if needed.
+Symbol Symbol_Intern(std::string_view text);
+// Stop adding symbols to the lock-free table. Call once startup
+// has interned the names it knows about.
+void Symbol_Freeze();
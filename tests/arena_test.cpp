@@ -0,0 +1,78 @@
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "test.hpp"
+#include "util/alloc_counter.hpp"
+#include "util/arena.hpp"
+
+UNI_TEST(Arena_AlignsAllocations) {
+    Arena arena;
+    arena.init(1024);
+    const size_t alignments[] = {1, 2, 4, 8, 16, 64};
+    for(const size_t alignment : alignments) {
+        arena.allocate(1, 1);
+        void* pointer = arena.allocate(3, alignment);
+        UNI_CHECK((uintptr_t) pointer % alignment == 0);
+    }
+    double* values = arena.allocate_array<double>(4);
+    UNI_CHECK((uintptr_t) values % alignof(double) == 0);
+}
+
+UNI_TEST(Arena_OverflowsThenGrowsOnReset) {
+    Arena arena;
+    arena.init(256);
+    // Fill past the main block; every pointer must stay distinct
+    // and usable until the reset
+    uint8_t* pointers[64];
+    for(int i = 0; i < 64; ++i) {
+        pointers[i] = (uint8_t*) arena.allocate(100, 1);
+        std::memset(pointers[i], i, 100);
+    }
+    bool intact = true;
+    for(int i = 0; i < 64; ++i) {
+        for(int j = 0; j < 100; ++j) {
+            intact = intact && pointers[i][j] == i;
+        }
+    }
+    UNI_CHECK(intact);
+    UNI_CHECK(arena.get_used_bytes() >= 6400);
+    UNI_CHECK(arena.get_peak_bytes() >= 6400);
+    UNI_CHECK(arena.get_capacity_bytes() == 256);
+    arena.reset();
+    UNI_CHECK(arena.get_used_bytes() == 0);
+    // Grown to fit the busiest frame, so the same frame fits
+    UNI_CHECK(arena.get_capacity_bytes() >= arena.get_peak_bytes());
+    for(int i = 0; i < 64; ++i) {
+        arena.allocate(100, 1);
+    }
+    UNI_CHECK(arena.get_used_bytes() <= arena.get_capacity_bytes());
+}
+
+UNI_TEST(Arena_CopiesStrings) {
+    Arena arena;
+    arena.init(64);
+    const char* empty = arena.copy_string("");
+    const char* text = arena.copy_string("Hello, arena");
+    const char* large = arena.copy_string(std::string_view("0123456789", 10));
+    UNI_CHECK(empty[0] == '\0');
+    UNI_CHECK(std::strcmp(text, "Hello, arena") == 0);
+    UNI_CHECK(std::strcmp(large, "0123456789") == 0);
+}
+
+UNI_TEST(Arena_BacksStandardContainers) {
+    Arena arena;
+    arena.init(4096);
+    const uint64_t alloc_count = AllocCounter_GetThreadCount();
+    ArenaVector<int> values = ArenaVector<int>(ArenaAllocator<int>(&arena));
+    for(int i = 0; i < 100; ++i) {
+        values.push_back(i);
+    }
+    ArenaString text = ArenaString("A string too long to be stored inline", ArenaAllocator<char>(&arena));
+    text += ", made longer still";
+    UNI_CHECK(values.size() == 100 && values[99] == 99);
+    UNI_CHECK(text == "A string too long to be stored inline, made longer still");
+    // Every growth step is left behind in the arena until the reset
+    UNI_CHECK(arena.get_used_bytes() >= 100 * sizeof(int) + text.size());
+    UNI_CHECK(AllocCounter_GetThreadCount() == alloc_count);
+}
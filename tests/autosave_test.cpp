@@ -0,0 +1,107 @@
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/autosave.hpp"
+#include "level/level_file.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+// Returns true if the file at a path opens as the same level as
+// the document, byte for byte once saved again.
+static bool AutosaveTest_Matches(const LevelDocument& document, const std::string& path) {
+    LevelDocument opened;
+    if(!LevelFile_Open(&opened, path.c_str())) {
+        return false;
+    }
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> actual;
+    LevelFile_Serialize(document, &expected);
+    LevelFile_Serialize(opened, &actual);
+    return expected == actual;
+}
+
+UNI_TEST(LevelAutosaver_PartialRewritesMatchWholeSaves) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, LevelDocument_PageRows * 3 + 100, 24);
+    LevelAutosaver autosaver;
+    autosaver.path = Test_GetTempPath("partial.autosave.unilevel");
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+    // Changes to one page
+    std::mt19937 random(25);
+    for(uint32_t i = 0; i < 50; ++i) {
+        const uint32_t row = LevelDocument_PageRows + random() % LevelDocument_PageRows;
+        document.set_position(row, LevelFixture_RandomPoint(random, 100.0f));
+    }
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+    // Destroying moves rows from the last page
+    for(uint32_t i = 0; i < 200; ++i) {
+        document.destroy(document.get_handle(random() % document.get_count()));
+    }
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+    // Creating within the room left in the file
+    for(uint32_t i = 0; i < 500; ++i) {
+        LevelEntityDesc desc;
+        desc.position = LevelFixture_RandomPoint(random, 100.0f);
+        desc.mesh = 0;
+        document.create(desc);
+    }
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+    // Changing materials or outgrowing the room writes it all
+    document.material_assets[0].color[1] = 0.5f;
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+    LevelFixture_Fill(&document, LevelDocument_PageRows * 2, 26);
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+    // A replaced level starts over
+    document.clear();
+    LevelFixture_Fill(&document, 100, 27);
+    UNI_CHECK(autosaver.save(document));
+    UNI_CHECK(AutosaveTest_Matches(document, autosaver.path));
+}
+
+UNI_TEST(LevelAutosaver_SavesSnapshotInBackground) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, LevelDocument_PageRows * 2, 28);
+    LevelAutosaver autosaver = LevelAutosaver(&jobs);
+    autosaver.path = Test_GetTempPath("background.autosave.unilevel");
+    autosaver.interval = 10.0;
+    std::mt19937 random(29);
+    for(int i = 0; i < 5; ++i) {
+        for(uint32_t j = 0; j < 20; ++j) {
+            document.set_position(random() % document.get_count(), LevelFixture_RandomPoint(random, 100.0f));
+        }
+        autosaver.update(document, 10.0 * (i + 1));
+        UNI_CHECK(autosaver.is_saving());
+        std::vector<uint8_t> frozen;
+        LevelFile_Serialize(document, &frozen);
+        // Edits made while saving go into the next autosave
+        document.set_position(0, Vec3{1.0f, 2.0f, 3.0f});
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while(autosaver.is_saving() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            jobs.update();
+        }
+        UNI_CHECK(!autosaver.is_saving());
+        LevelDocument opened;
+        std::vector<uint8_t> saved;
+        if(UNI_CHECK(LevelFile_Open(&opened, autosaver.path.c_str()))) {
+            LevelFile_Serialize(opened, &saved);
+        }
+        UNI_CHECK(saved == frozen);
+    }
+    // Not due yet
+    autosaver.update(document, 55.0);
+    UNI_CHECK(!autosaver.is_saving());
+    autosaver.cancel();
+    jobs.conclude();
+}
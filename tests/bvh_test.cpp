@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/bvh.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+// Intersect a ray with a triangle, from both sides. Returns the
+// distance along the ray, or INFINITY.
+static float BvhTest_IntersectTriangle(const Ray3& ray, const Vec3& a, const Vec3& b, const Vec3& c) {
+    const Vec3 edge1 = b - a;
+    const Vec3 edge2 = c - a;
+    const Vec3 p = Vec3_Cross(ray.direction, edge2);
+    const float det = Vec3_Dot(edge1, p);
+    if(std::fabs(det) < 1e-12f) {
+        return INFINITY;
+    }
+    const Vec3 s = ray.origin - a;
+    const float u = Vec3_Dot(s, p) / det;
+    const Vec3 q = Vec3_Cross(s, edge1);
+    const float v = Vec3_Dot(ray.direction, q) / det;
+    const float t = Vec3_Dot(edge2, q) / det;
+    if(u < 0.0f || v < 0.0f || u + v > 1.0f || t <= 0.0f) {
+        return INFINITY;
+    }
+    return t;
+}
+
+// Get the nearest hit of a ray on one entity, testing every
+// triangle of its mesh in world space.
+static float BvhTest_IntersectEntity(const LevelDocument& document, uint32_t row, const Ray3& ray) {
+    if(document.flags[row] & LevelEntityFlags_Hidden) {
+        return INFINITY;
+    }
+    const LevelMesh& mesh = document.mesh_assets[document.meshes[row]];
+    float nearest = INFINITY;
+    for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        Vec3 corners[3];
+        for(int j = 0; j < 3; ++j) {
+            corners[j] = document.positions[row] + Quat_Rotate(
+                document.rotations[row], mesh.positions[mesh.indices[i + j]] * document.scales[row]
+            );
+        }
+        nearest = std::min(nearest, BvhTest_IntersectTriangle(ray, corners[0], corners[1], corners[2]));
+    }
+    return nearest;
+}
+
+static Ray3 BvhTest_RandomRay(std::mt19937& random, const LevelDocument& document) {
+    Ray3 ray;
+    ray.origin = LevelFixture_RandomPoint(random, 150.0f);
+    // Aim most rays at an entity, so that most of them hit
+    if(random() % 4 != 0 && document.get_count() > 0) {
+        const uint32_t row = random() % document.get_count();
+        ray.direction = Vec3_Normalize(document.positions[row] - ray.origin);
+    }
+    else {
+        ray.direction = Vec3_Normalize(LevelFixture_RandomPoint(random, 2.0f));
+    }
+    return ray;
+}
+
+// Cast random rays through the BVH and by brute force, and count
+// the rays for which they disagree.
+static uint32_t BvhTest_CountMismatches(const LevelDocument& document, const LevelBvh& bvh, uint32_t seed) {
+    std::mt19937 random(seed);
+    uint32_t mismatch_count = 0;
+    std::vector<float> distances(document.get_count());
+    for(int i = 0; i < 300; ++i) {
+        const Ray3 ray = BvhTest_RandomRay(random, document);
+        float nearest = INFINITY;
+        for(uint32_t row = 0; row < document.get_count(); ++row) {
+            distances[row] = BvhTest_IntersectEntity(document, row, ray);
+            nearest = std::min(nearest, distances[row]);
+        }
+        LevelRayHit hit;
+        const bool found = bvh.raycast(document, ray, &hit);
+        if(found != (nearest != INFINITY)) {
+            mismatch_count++;
+            continue;
+        }
+        if(!found) {
+            continue;
+        }
+        // Several entities may be hit at the same distance
+        const float tolerance = 1e-3f * std::max(1.0f, nearest);
+        const uint32_t row = document.get_row(hit.handle);
+        if(
+            row == LevelRow_None ||
+            std::fabs(hit.distance - nearest) > tolerance ||
+            std::fabs(distances[row] - nearest) > tolerance ||
+            hit.triangle == UINT32_MAX
+        ) {
+            mismatch_count++;
+        }
+    }
+    return mismatch_count;
+}
+
+UNI_TEST(LevelBvh_RaycastMatchesBruteForce) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 3000, 12);
+    LevelBvh bvh = LevelBvh(&jobs);
+    bvh.build(document);
+    UNI_CHECK(bvh.get_node_count() > 0);
+    UNI_CHECK(BvhTest_CountMismatches(document, bvh, 1) == 0);
+    // Moved entities are refit rather than rebuilt
+    std::mt19937 random(13);
+    std::vector<LevelHandle> moved;
+    for(uint32_t row = 0; row < document.get_count(); row += 3) {
+        document.set_position(row, LevelFixture_RandomPoint(random, 100.0f));
+        document.set_rotation(row, LevelFixture_RandomRotation(random));
+        moved.push_back(document.get_handle(row));
+    }
+    bvh.mark_changed(moved.data(), (uint32_t) moved.size());
+    bvh.update(document);
+    UNI_CHECK(BvhTest_CountMismatches(document, bvh, 2) == 0);
+    jobs.conclude();
+}
+
+UNI_TEST(LevelBvh_RebuildsInBackground) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 14);
+    LevelBvh bvh = LevelBvh(&jobs);
+    bvh.build(document);
+    for(uint32_t i = 0; i < 300; ++i) {
+        document.destroy(document.get_handle((i * 13) % document.get_count()));
+    }
+    // An entity far from the others, which only a rebuild finds
+    LevelEntityDesc desc;
+    desc.position = Vec3{500.0f, 0.0f, 0.0f};
+    desc.mesh = document.meshes[0];
+    const LevelHandle added = document.create(desc);
+    bvh.update(document);
+    // Entities moved while the rebuild runs are refit once it lands
+    std::mt19937 random(15);
+    std::vector<LevelHandle> moved;
+    for(uint32_t row = 0; row < document.get_row(added); row += 5) {
+        document.set_position(row, LevelFixture_RandomPoint(random, 100.0f));
+        moved.push_back(document.get_handle(row));
+    }
+    bvh.mark_changed(moved.data(), (uint32_t) moved.size());
+    const Ray3 ray = Ray3{Vec3{500.0f, 0.0f, 10.0f}, Vec3{0.0f, 0.0f, -1.0f}};
+    LevelRayHit hit;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    do {
+        jobs.update();
+        bvh.update(document);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while(!bvh.raycast(document, ray, &hit) && std::chrono::steady_clock::now() < deadline);
+    UNI_CHECK(hit.handle == added);
+    UNI_CHECK(std::fabs(hit.distance - 9.5f) < 1e-3f);
+    UNI_CHECK(BvhTest_CountMismatches(document, bvh, 3) == 0);
+    bvh.cancel();
+    jobs.conclude();
+}
+
+UNI_TEST(LevelBvh_RebuildsMeshesOfReplacedDocument) {
+    LevelDocument document;
+    document.add_mesh(LevelMesh_CreateCube(Symbol("Cube")));
+    LevelEntityDesc desc;
+    desc.mesh = 0;
+    document.create(desc);
+    LevelBvh bvh;
+    bvh.update(document);
+    const Ray3 ray = Ray3{Vec3{0.0f, 0.0f, 10.0f}, Vec3{0.0f, 0.0f, -1.0f}};
+    LevelRayHit hit;
+    UNI_CHECK(bvh.raycast(document, ray, &hit));
+    UNI_CHECK(std::fabs(hit.distance - 9.5f) < 1e-3f);
+    // The same mesh id, now a smaller cube
+    document.clear();
+    LevelMesh smaller = LevelMesh_CreateCube(Symbol("Smaller Cube"));
+    for(Vec3& position : smaller.positions) {
+        position = position * 0.5f;
+    }
+    smaller.update_bounds();
+    document.add_mesh(smaller);
+    document.create(desc);
+    bvh.update(document);
+    UNI_CHECK(bvh.raycast(document, ray, &hit));
+    UNI_CHECK(std::fabs(hit.distance - 9.75f) < 1e-3f);
+}
+
+UNI_TEST(LevelMeshBvh_PacketsMatchSingleRays) {
+    // A soup of random triangles
+    std::mt19937 random(15);
+    LevelMesh mesh;
+    for(int i = 0; i < 3000; ++i) {
+        const Vec3 center = LevelFixture_RandomPoint(random, 20.0f);
+        for(int j = 0; j < 3; ++j) {
+            mesh.positions.push_back(center + LevelFixture_RandomPoint(random, 2.0f));
+            mesh.indices.push_back((uint32_t) mesh.indices.size());
+        }
+    }
+    mesh.update_bounds();
+    LevelMeshBvh bvh;
+    bvh.build(mesh);
+    uint32_t mismatch_count = 0;
+    uint32_t hit_count = 0;
+    for(int i = 0; i < 200; ++i) {
+        // Four rays from nearby points, as a baker casts them
+        const Vec3 origin = LevelFixture_RandomPoint(random, 30.0f);
+        const Vec3 target = LevelFixture_RandomPoint(random, 10.0f);
+        LevelRayPacket packet;
+        Ray3 rays[4];
+        for(int lane = 0; lane < 4; ++lane) {
+            rays[lane] = Ray3{
+                origin + LevelFixture_RandomPoint(random, 0.5f),
+                Vec3_Normalize(target - origin + LevelFixture_RandomPoint(random, 0.5f))
+            };
+            packet.set_ray(lane, rays[lane], 100.0f);
+        }
+        const int mask = bvh.intersect_packet(&packet);
+        for(int lane = 0; lane < 4; ++lane) {
+            float nearest = INFINITY;
+            for(size_t k = 0; k < mesh.indices.size(); k += 3) {
+                nearest = std::min(nearest, BvhTest_IntersectTriangle(
+                    rays[lane],
+                    mesh.positions[mesh.indices[k]],
+                    mesh.positions[mesh.indices[k + 1]],
+                    mesh.positions[mesh.indices[k + 2]]
+                ));
+            }
+            float distance = 100.0f;
+            uint32_t triangle = UINT32_MAX;
+            const bool single_hit = bvh.intersect(rays[lane], &distance, &triangle);
+            const bool packet_hit = (mask >> lane) & 1;
+            const bool brute_hit = nearest < 100.0f;
+            hit_count += brute_hit ? 1 : 0;
+            if(single_hit != brute_hit || packet_hit != brute_hit) {
+                mismatch_count++;
+            }
+            else if(brute_hit && (
+                std::fabs(distance - nearest) > 1e-3f ||
+                std::fabs(packet.distance[lane] - nearest) > 1e-3f ||
+                packet.triangle[lane] != triangle
+            )) {
+                mismatch_count++;
+            }
+        }
+    }
+    UNI_CHECK(hit_count > 100);
+    UNI_CHECK(mismatch_count == 0);
+}
+
+UNI_TEST(LevelBvh_FrustumQueryFindsEveryVisibleEntity) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 3000, 16);
+    LevelBvh bvh;
+    bvh.build(document);
+    const Frustum3 frustum = Frustum3_FromPerspective(
+        Vec3{0.0f, 0.0f, 60.0f}, Vec3{0.2f, 0.1f, -1.0f}, Vec3{0.0f, 1.0f, 0.0f},
+        0.8f, 1.5f, 1.0f, 200.0f
+    );
+    std::vector<LevelHandle> inside;
+    std::vector<LevelHandle> crossing;
+    UNI_CHECK(bvh.query_frustum(frustum, &inside, &crossing));
+    std::unordered_set<uint32_t> found;
+    std::unordered_set<uint32_t> found_inside;
+    for(const LevelHandle handle : inside) {
+        found.insert(handle.index);
+        found_inside.insert(handle.index);
+    }
+    for(const LevelHandle handle : crossing) {
+        found.insert(handle.index);
+    }
+    uint32_t mismatch_count = 0;
+    uint32_t visible_count = 0;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        const Bounds3 bounds = document.get_bounds(row);
+        const Vec3 center = bounds.get_center();
+        const Vec3 extent = bounds.get_extent();
+        bool outside = false;
+        bool all_inside = true;
+        for(const Plane3& plane : frustum.planes) {
+            const float distance = Vec3_Dot(plane.normal, center) + plane.distance;
+            const float radius = Vec3_Dot(Vec3_Abs(plane.normal), extent);
+            outside = outside || distance + radius < 0.0f;
+            all_inside = all_inside && distance - radius >= 0.0f;
+        }
+        const uint32_t index = document.get_handle(row).index;
+        visible_count += outside ? 0 : 1;
+        if((!outside && !found.count(index)) || (found_inside.count(index) && !all_inside)) {
+            mismatch_count++;
+        }
+    }
+    UNI_CHECK(visible_count > 100);
+    UNI_CHECK(mismatch_count == 0);
+}
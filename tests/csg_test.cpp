@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+
+#include "csg/compiler.hpp"
+#include "jobs/job_system.hpp"
+#include "test.hpp"
+
+// Add up the signed volume enclosed by every region's render
+// triangles, and their area. A closed surface facing outward
+// encloses a positive volume.
+static void CsgTest_Measure(const CsgCompiler& csg, float* volume, float* area) {
+    *volume = 0.0f;
+    *area = 0.0f;
+    for(const auto& [key, region] : csg.get_regions()) {
+        const LevelMesh& render = region->mesh.render;
+        for(size_t i = 0; i + 2 < render.indices.size(); i += 3) {
+            const Vec3 v0 = render.positions[render.indices[i + 0]];
+            const Vec3 v1 = render.positions[render.indices[i + 1]];
+            const Vec3 v2 = render.positions[render.indices[i + 2]];
+            *volume += Vec3_Dot(v0, Vec3_Cross(v1, v2)) / 6.0f;
+            *area += Vec3_Length(Vec3_Cross(v1 - v0, v2 - v0)) * 0.5f;
+        }
+    }
+}
+
+// Get the mesh revision of each region, by region key.
+static std::unordered_map<uint64_t, uint64_t> CsgTest_GetRevisions(const CsgCompiler& csg) {
+    std::unordered_map<uint64_t, uint64_t> revisions;
+    for(const auto& [key, region] : csg.get_regions()) {
+        revisions[key] = region->mesh_revision;
+    }
+    return revisions;
+}
+
+UNI_TEST(CsgCompiler_CarvesClosedSurfaces) {
+    CsgCompiler csg;
+    // Small regions, so that the boxes cross several. Brushes also
+    // reach regions within Csg_Epsilon of their sides, so none
+    // lie on region sides here.
+    csg.region_size = 3.0f;
+    csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{0.5f, 0.5f, 0.5f}, Vec3{4.5f, 4.5f, 4.5f}}, CsgOperation_Add, LevelMaterialId_None
+    ));
+    csg.compile_all();
+    UNI_CHECK(csg.get_regions().size() == 8);
+    float volume = 0.0f;
+    float area = 0.0f;
+    CsgTest_Measure(csg, &volume, &area);
+    UNI_CHECK(std::fabs(volume - 64.0f) < 1e-2f);
+    UNI_CHECK(std::fabs(area - 96.0f) < 1e-2f);
+    // A column carved out of one edge leaves two new inner faces
+    csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{2.5f, 2.5f, -0.5f}, Vec3{6.5f, 6.5f, 5.5f}}, CsgOperation_Subtract, LevelMaterialId_None
+    ));
+    csg.compile_all();
+    CsgTest_Measure(csg, &volume, &area);
+    UNI_CHECK(std::fabs(volume - 48.0f) < 1e-2f);
+    UNI_CHECK(std::fabs(area - 88.0f) < 1e-2f);
+    // Adding a box inside the solid changes nothing
+    csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{1.0f, 1.0f, 1.0f}, Vec3{2.0f, 2.0f, 2.0f}}, CsgOperation_Add, LevelMaterialId_None
+    ));
+    csg.compile_all();
+    CsgTest_Measure(csg, &volume, &area);
+    UNI_CHECK(std::fabs(volume - 48.0f) < 1e-2f);
+    UNI_CHECK(std::fabs(area - 88.0f) < 1e-2f);
+    // Collision meshes share vertexes between triangles
+    uint32_t collision_index_count = 0;
+    bool welded = true;
+    for(const auto& [key, region] : csg.get_regions()) {
+        const CsgRegionMesh& mesh = region->mesh;
+        collision_index_count += (uint32_t) mesh.collision.indices.size();
+        welded = welded && (
+            mesh.collision.indices.size() == mesh.render.indices.size() &&
+            mesh.collision.positions.size() <= mesh.render.positions.size()
+        );
+    }
+    UNI_CHECK(welded && collision_index_count > 0);
+}
+
+UNI_TEST(CsgCompiler_RecompilesOnlyChangedRegions) {
+    JobSystem jobs;
+    jobs.init(2);
+    CsgCompiler csg = CsgCompiler(&jobs);
+    csg.region_size = 8.0f;
+    csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{1.0f, 1.0f, 1.0f}, Vec3{5.0f, 5.0f, 5.0f}}, CsgOperation_Add, LevelMaterialId_None
+    ));
+    const CsgBrushId far_brush = csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{41.0f, 1.0f, 1.0f}, Vec3{45.0f, 5.0f, 5.0f}}, CsgOperation_Add, LevelMaterialId_None
+    ));
+    // Compiles in the background as update is called
+    auto settle = [&]() {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while(std::chrono::steady_clock::now() < deadline) {
+            jobs.update();
+            csg.update();
+            bool compiling = csg.get_dirty_count() > 0;
+            for(const auto& [key, region] : csg.get_regions()) {
+                compiling = compiling || region->compiling;
+            }
+            if(!compiling) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    };
+    UNI_CHECK(settle());
+    UNI_CHECK(csg.get_regions().size() == 2);
+    const uint64_t near_key = CsgRegionCoord{0, 0, 0}.get_key();
+    const uint64_t far_key = CsgRegionCoord{5, 0, 0}.get_key();
+    const auto revisions = CsgTest_GetRevisions(csg);
+    const uint64_t revision = csg.revision;
+    // Moving the far box within its region compiles that region only
+    UNI_CHECK(csg.set_brush(far_brush, CsgBrush_CreateBox(
+        Bounds3{Vec3{42.0f, 1.0f, 1.0f}, Vec3{46.0f, 6.0f, 5.0f}}, CsgOperation_Add, LevelMaterialId_None
+    )));
+    UNI_CHECK(csg.get_dirty_count() == 1);
+    UNI_CHECK(settle());
+    auto changed = CsgTest_GetRevisions(csg);
+    UNI_CHECK(changed[near_key] == revisions.at(near_key));
+    UNI_CHECK(changed[far_key] > revisions.at(far_key));
+    UNI_CHECK(csg.revision > revision);
+    float volume = 0.0f;
+    float area = 0.0f;
+    CsgTest_Measure(csg, &volume, &area);
+    UNI_CHECK(std::fabs(volume - 64.0f - 80.0f) < 1e-2f);
+    // Moving it into the next region dirties both, and removing it
+    // leaves only the first box's region
+    UNI_CHECK(csg.set_brush(far_brush, CsgBrush_CreateBox(
+        Bounds3{Vec3{50.0f, 1.0f, 1.0f}, Vec3{54.0f, 5.0f, 5.0f}}, CsgOperation_Add, LevelMaterialId_None
+    )));
+    UNI_CHECK(settle());
+    UNI_CHECK(csg.get_regions().size() == 2);
+    UNI_CHECK(csg.get_regions().count(CsgRegionCoord{6, 0, 0}.get_key()) == 1);
+    UNI_CHECK(csg.remove_brush(far_brush));
+    UNI_CHECK(settle());
+    UNI_CHECK(csg.get_regions().size() == 1);
+    UNI_CHECK(CsgTest_GetRevisions(csg)[near_key] == revisions.at(near_key));
+    CsgTest_Measure(csg, &volume, &area);
+    UNI_CHECK(std::fabs(volume - 64.0f) < 1e-2f);
+    csg.cancel();
+    jobs.conclude();
+}
@@ -0,0 +1,113 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/culling.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+// Cull by testing every entity, and count the entities on which
+// the culler disagrees. Entities within a small margin of a plane
+// may go either way.
+static uint32_t CullingTest_CountMismatches(
+    const LevelDocument& document,
+    const LevelCuller& culler,
+    const Frustum3& frustum,
+    uint32_t* visible_count
+) {
+    std::vector<uint8_t> found(document.get_count(), 0);
+    uint32_t mismatch_count = 0;
+    for(const uint32_t row : culler.get_visible_rows()) {
+        if(row >= document.get_count() || found[row]) {
+            // Out of range, or listed twice
+            mismatch_count++;
+            continue;
+        }
+        found[row] = 1;
+    }
+    *visible_count = 0;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        const Bounds3 bounds = document.get_bounds(row);
+        const Vec3 center = bounds.get_center();
+        const Vec3 extent = bounds.get_extent();
+        bool outside = false;
+        bool near_plane = false;
+        for(const Plane3& plane : frustum.planes) {
+            const float distance = Vec3_Dot(plane.normal, center) + plane.distance;
+            const float radius = Vec3_Dot(Vec3_Abs(plane.normal), extent);
+            outside = outside || distance + radius < 0.0f;
+            near_plane = near_plane || std::fabs(distance + radius) < 1e-3f;
+        }
+        const bool visible = !outside && !(document.flags[row] & LevelEntityFlags_Hidden);
+        *visible_count += visible ? 1 : 0;
+        if(!near_plane && visible != (found[row] != 0)) {
+            mismatch_count++;
+        }
+    }
+    return mismatch_count;
+}
+
+UNI_TEST(LevelCuller_MatchesBruteForceAsEntitiesChange) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 20000, 30, 400.0f);
+    LevelCuller culler = LevelCuller(&jobs);
+    culler.cell_entity_count = 64;
+    culler.chunk_cell_count = 16;
+    // Looking down from above, so that whole cells fit inside
+    const Frustum3 frustum = Frustum3_FromPerspective(
+        Vec3{50.0f, 500.0f, 0.0f}, Vec3{0.0f, -1.0f, 0.1f}, Vec3{0.0f, 0.0f, -1.0f},
+        0.8f, 1.5f, 1.0f, 1000.0f
+    );
+    uint32_t visible_count = 0;
+    culler.cull(document, frustum);
+    UNI_CHECK(culler.get_cell_count() > 1);
+    UNI_CHECK(CullingTest_CountMismatches(document, culler, frustum, &visible_count) == 0);
+    UNI_CHECK(visible_count > 1000 && visible_count < document.get_count());
+    UNI_CHECK(culler.get_stats().inside_cell_count > 0);
+    UNI_CHECK(culler.get_stats().visible_count == culler.get_visible_rows().size());
+    // Small moves keep entities in their cells, so cells are refit
+    std::mt19937 random(31);
+    for(uint32_t row = 0; row < document.get_count(); row += 10) {
+        document.set_position(row, document.positions[row] + LevelFixture_RandomPoint(random, 4.0f));
+    }
+    culler.cull(document, frustum);
+    UNI_CHECK(CullingTest_CountMismatches(document, culler, frustum, &visible_count) == 0);
+    // Scattering many entities strays too many for a refit
+    for(uint32_t row = 0; row < document.get_count(); row += 3) {
+        document.set_position(row, LevelFixture_RandomPoint(random, 400.0f));
+    }
+    culler.cull(document, frustum);
+    UNI_CHECK(CullingTest_CountMismatches(document, culler, frustum, &visible_count) == 0);
+    // Creating and destroying entities rebuilds the grid
+    for(uint32_t i = 0; i < 2000; ++i) {
+        document.destroy(document.get_handle(random() % document.get_count()));
+    }
+    LevelEntityDesc desc;
+    desc.mesh = 0;
+    desc.scale = Vec3{60.0f, 60.0f, 60.0f};
+    document.create(desc);
+    culler.cull(document, frustum);
+    UNI_CHECK(CullingTest_CountMismatches(document, culler, frustum, &visible_count) == 0);
+    jobs.conclude();
+}
+
+UNI_TEST(LevelCuller_CullsWithoutJobs) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 3000, 32);
+    LevelCuller culler;
+    const Frustum3 frustum = Frustum3_FromPerspective(
+        Vec3{0.0f, 0.0f, 80.0f}, Vec3{0.0f, 0.0f, -1.0f}, Vec3{0.0f, 1.0f, 0.0f},
+        0.6f, 1.0f, 1.0f, 100.0f
+    );
+    uint32_t visible_count = 0;
+    culler.cull(document, frustum);
+    UNI_CHECK(CullingTest_CountMismatches(document, culler, frustum, &visible_count) == 0);
+    UNI_CHECK(visible_count > 0);
+    // An empty document has nothing to draw
+    document.clear();
+    culler.cull(document, frustum);
+    UNI_CHECK(culler.get_visible_rows().empty());
+}
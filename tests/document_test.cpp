@@ -0,0 +1,187 @@
+#include <random>
+#include <vector>
+
+#include "level/column.hpp"
+#include "level/document.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+UNI_TEST(LevelColumn_CopiesViewedValuesWhenGrowing) {
+    uint32_t values[4] = {1, 2, 3, 4};
+    LevelColumn<uint32_t> column;
+    column.view(values, 4);
+    UNI_CHECK(column.is_view());
+    UNI_CHECK(column.get_memory_bytes() == 0);
+    column[0] = 10;
+    UNI_CHECK(values[0] == 10);
+    column.push_back(5);
+    UNI_CHECK(!column.is_view());
+    UNI_CHECK(column.size() == 5);
+    column[1] = 20;
+    UNI_CHECK(values[1] == 2);
+    UNI_CHECK(column[0] == 10 && column[1] == 20 && column[4] == 5);
+    column.swap_remove(0);
+    UNI_CHECK(column.size() == 4 && column[0] == 5);
+    UNI_CHECK((uintptr_t) column.data() % LevelColumn_Alignment == 0);
+}
+
+UNI_TEST(LevelColumn_OwnsValuesOnRequest) {
+    float values[3] = {1.0f, 2.0f, 3.0f};
+    LevelColumn<float> column;
+    column.view(values, 3);
+    column.own_values();
+    UNI_CHECK(!column.is_view());
+    UNI_CHECK(column.data() != values);
+    values[2] = 0.0f;
+    UNI_CHECK(column.size() == 3 && column[2] == 3.0f);
+    LevelColumn<float> empty;
+    empty.view(values, 0);
+    empty.own_values();
+    UNI_CHECK(!empty.is_view() && empty.size() == 0);
+}
+
+UNI_TEST(LevelDocument_ReusesSlotsWithNewGenerations) {
+    LevelDocument document;
+    LevelEntityDesc desc;
+    desc.position = Vec3{1.0f, 0.0f, 0.0f};
+    const LevelHandle a = document.create(desc);
+    desc.position = Vec3{2.0f, 0.0f, 0.0f};
+    const LevelHandle b = document.create(desc);
+    desc.position = Vec3{3.0f, 0.0f, 0.0f};
+    const LevelHandle c = document.create(desc);
+    UNI_CHECK(document.destroy(b));
+    UNI_CHECK(!document.destroy(b));
+    UNI_CHECK(!document.is_valid(b));
+    // The last row moved into the destroyed one's place
+    UNI_CHECK(document.get_row(c) == 1);
+    UNI_CHECK(document.positions[document.get_row(c)].x == 3.0f);
+    const LevelHandle d = document.create(desc);
+    UNI_CHECK(d.index == b.index);
+    UNI_CHECK(d.generation != b.generation);
+    UNI_CHECK(!document.is_valid(b));
+    UNI_CHECK(document.is_valid(a) && document.is_valid(c) && document.is_valid(d));
+    UNI_CHECK(document.get_count() == 3);
+    UNI_CHECK(!document.is_valid(LevelHandle_None));
+}
+
+UNI_TEST(LevelDocument_RestoresDestroyedHandles) {
+    LevelDocument document;
+    LevelEntityDesc desc;
+    desc.scale = Vec3{2.0f, 3.0f, 4.0f};
+    const LevelHandle a = document.create(desc);
+    const LevelHandle b = document.create(desc);
+    const LevelEntityDesc saved = document.get_desc(document.get_row(a));
+    document.destroy(a);
+    UNI_CHECK(!document.restore(b, saved));
+    UNI_CHECK(document.restore(a, saved));
+    UNI_CHECK(document.is_valid(a));
+    UNI_CHECK(document.scales[document.get_row(a)] == desc.scale);
+    // A restored slot is no longer free
+    const LevelHandle c = document.create(desc);
+    UNI_CHECK(c.index != a.index && c.index != b.index);
+    // Restoring into a cleared document adds the missing slots
+    document.clear();
+    UNI_CHECK(document.restore(c, saved));
+    UNI_CHECK(document.is_valid(c) && !document.is_valid(a));
+    const LevelHandle d = document.create(desc);
+    UNI_CHECK(d.index != c.index);
+}
+
+UNI_TEST(LevelDocument_HandlesSurviveChurn) {
+    LevelDocument document;
+    std::mt19937 random(7);
+    struct Live {
+        LevelHandle handle;
+        float id;
+    };
+    std::vector<Live> live;
+    std::vector<LevelHandle> dead;
+    float next_id = 0.0f;
+    for(int step = 0; step < 5000; ++step) {
+        if(live.empty() || random() % 3 != 0) {
+            LevelEntityDesc desc;
+            desc.position = Vec3{next_id, 0.0f, 0.0f};
+            live.push_back(Live{document.create(desc), next_id});
+            next_id += 1.0f;
+        }
+        else {
+            const size_t index = random() % live.size();
+            UNI_CHECK(document.destroy(live[index].handle));
+            dead.push_back(live[index].handle);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    UNI_CHECK(document.get_count() == live.size());
+    bool live_valid = true;
+    for(const Live& entity : live) {
+        const uint32_t row = document.get_row(entity.handle);
+        live_valid = (
+            live_valid && row != LevelRow_None &&
+            document.positions[row].x == entity.id &&
+            document.get_handle(row) == entity.handle
+        );
+    }
+    UNI_CHECK(live_valid);
+    bool dead_invalid = true;
+    for(const LevelHandle handle : dead) {
+        dead_invalid = dead_invalid && !document.is_valid(handle);
+    }
+    UNI_CHECK(dead_invalid);
+}
+
+UNI_TEST(LevelDocument_TracksPageRevisions) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, LevelDocument_PageRows * 3, 1);
+    UNI_CHECK(document.get_page_count() == 3);
+    const uint64_t revision = document.revision;
+    document.set_position(LevelDocument_PageRows + 5, Vec3{1.0f, 2.0f, 3.0f});
+    UNI_CHECK(document.get_page_revision(0) <= revision);
+    UNI_CHECK(document.get_page_revision(1) > revision);
+    UNI_CHECK(document.get_page_revision(2) <= revision);
+    // Destroying moves the last row, changing its page too
+    const uint64_t destroy_revision = document.revision;
+    document.destroy(document.get_handle(0));
+    UNI_CHECK(document.get_page_revision(0) > destroy_revision);
+    UNI_CHECK(document.get_page_revision(1) <= destroy_revision);
+    UNI_CHECK(document.get_page_revision(2) > destroy_revision);
+    document.clear();
+    UNI_CHECK(document.get_page_revision(1) == document.revision);
+}
+
+UNI_TEST(LevelDocument_KeepsBoundsUpToDate) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 100, 2);
+    bool contained = true;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        const Bounds3 bounds = document.get_bounds(row);
+        for(const Vec3& vertex : document.mesh_assets[0].positions) {
+            const Vec3 point = document.positions[row] + Quat_Rotate(
+                document.rotations[row], vertex * document.scales[row]
+            );
+            contained = (
+                contained &&
+                point.x >= bounds.min.x - 1e-4f && point.x <= bounds.max.x + 1e-4f &&
+                point.y >= bounds.min.y - 1e-4f && point.y <= bounds.max.y + 1e-4f &&
+                point.z >= bounds.min.z - 1e-4f && point.z <= bounds.max.z + 1e-4f
+            );
+        }
+    }
+    UNI_CHECK(contained);
+    document.set_position(0, Vec3{1000.0f, 0.0f, 0.0f});
+    UNI_CHECK(document.get_bounds(0).get_center().x > 990.0f);
+}
+
+UNI_TEST(LevelDocument_TracksMeshRevisions) {
+    LevelDocument document;
+    const LevelMeshId cube = document.add_mesh(LevelMesh_CreateCube(Symbol("Cube")));
+    const uint64_t cube_revision = document.get_mesh_revision(cube);
+    const LevelMeshId other = document.add_mesh(LevelMesh_CreateCube(Symbol("Other Cube")));
+    UNI_CHECK(document.get_mesh_revision(other) > cube_revision);
+    UNI_CHECK(document.get_mesh_revision(cube) == cube_revision);
+    // After a clear, the same id refers to another mesh
+    document.clear();
+    UNI_CHECK(document.add_mesh(LevelMesh_CreateCube(Symbol("Cube"))) == cube);
+    UNI_CHECK(document.get_mesh_revision(cube) > cube_revision);
+    UNI_CHECK(document.get_mesh_revision(other) == document.clear_revision);
+}
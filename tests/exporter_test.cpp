@@ -0,0 +1,121 @@
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include "jobs/job_system.hpp"
+#include "level/exporter.hpp"
+#include "level/level_file.hpp"
+#include "level/streaming.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+// Set the write time of every file in a directory far into the
+// past, so that files written afterwards stand out.
+static void ExporterTest_AgeFiles(const std::string& directory) {
+    const auto old_time = std::filesystem::file_time_type::clock::now() - std::chrono::hours(24);
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::filesystem::last_write_time(entry.path(), old_time, error);
+    }
+}
+
+// Get the names of the files in a directory written since
+// ExporterTest_AgeFiles.
+static std::map<std::string, bool> ExporterTest_GetWritten(const std::string& directory) {
+    const auto cutoff = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+    std::map<std::string, bool> written;
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        written[entry.path().filename().string()] = entry.last_write_time(error) > cutoff;
+    }
+    return written;
+}
+
+static uint32_t ExporterTest_CountWritten(const std::map<std::string, bool>& written) {
+    uint32_t count = 0;
+    for(const auto& [name, is_written] : written) {
+        count += is_written ? 1 : 0;
+    }
+    return count;
+}
+
+UNI_TEST(LevelExporter_RewritesOnlyChangedSectors) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 50);
+    LevelExporter exporter = LevelExporter(&jobs);
+    exporter.directory = Test_GetTempPath("exporter_sectors");
+    exporter.sector_size = 25.0f;
+    std::error_code error;
+    std::filesystem::remove_all(exporter.directory, error);
+    UNI_CHECK(exporter.export_changes(document));
+    UNI_CHECK(ExporterTest_GetWritten(exporter.directory).size() == 16);
+    UNI_CHECK(!exporter.has_changes());
+    // An entity moved within its sector rewrites that sector only
+    LevelStreamer streamer;
+    streamer.directory = exporter.directory;
+    streamer.sector_size = exporter.sector_size;
+    const uint32_t row = 0;
+    const LevelHandle handle = document.get_handle(row);
+    const LevelSectorCoord coord = streamer.get_coord(document.get_bounds(row).get_center());
+    ExporterTest_AgeFiles(exporter.directory);
+    document.set_position(row, document.positions[row] + Vec3{0.0f, 1.0f, 0.0f});
+    exporter.mark_changed(&handle, 1);
+    UNI_CHECK(exporter.export_changes(document));
+    auto written = ExporterTest_GetWritten(exporter.directory);
+    const std::string name = std::filesystem::path(streamer.get_sector_path(coord)).filename().string();
+    UNI_CHECK(ExporterTest_CountWritten(written) == 1 && written[name]);
+    LevelDocument sector;
+    UNI_CHECK(LevelFile_Open(&sector, streamer.get_sector_path(coord).c_str()));
+    bool found = false;
+    for(uint32_t i = 0; i < sector.get_count(); ++i) {
+        found = found || sector.positions[i] == document.positions[row];
+    }
+    UNI_CHECK(found);
+    // Moving it to another sector rewrites both
+    ExporterTest_AgeFiles(exporter.directory);
+    document.set_position(row, Vec3{-40.0f, 0.0f, -40.0f});
+    exporter.mark_changed(&handle, 1);
+    UNI_CHECK(exporter.export_changes(document));
+    UNI_CHECK(ExporterTest_CountWritten(ExporterTest_GetWritten(exporter.directory)) == 2);
+    jobs.conclude();
+}
+
+UNI_TEST(LevelExporter_SkipsSectorsWithSameContents) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 1000, 51);
+    LevelExporter exporter;
+    exporter.directory = Test_GetTempPath("exporter_same");
+    exporter.sector_size = 25.0f;
+    std::error_code error;
+    std::filesystem::remove_all(exporter.directory, error);
+    UNI_CHECK(exporter.export_changes(document));
+    // Marked changed, but set to the value it already had
+    ExporterTest_AgeFiles(exporter.directory);
+    const LevelHandle handle = document.get_handle(5);
+    document.set_position(5, document.positions[5]);
+    exporter.mark_changed(&handle, 1);
+    UNI_CHECK(exporter.has_changes());
+    UNI_CHECK(exporter.export_changes(document));
+    UNI_CHECK(ExporterTest_CountWritten(ExporterTest_GetWritten(exporter.directory)) == 0);
+    // A new exporter hashes the files already there, and finds
+    // nothing to write either
+    LevelExporter fresh;
+    fresh.directory = exporter.directory;
+    fresh.sector_size = exporter.sector_size;
+    UNI_CHECK(fresh.export_changes(document));
+    UNI_CHECK(ExporterTest_CountWritten(ExporterTest_GetWritten(exporter.directory)) == 0);
+    // Marking everything rebuilds every sector, and removes files
+    // of sectors left without entities
+    const std::string stray = fresh.directory + "/sector_40_40.unilevel";
+    std::filesystem::copy_file(
+        std::filesystem::path(exporter.directory) / "sector_0_0.unilevel", stray, error
+    );
+    fresh.mark_changed(nullptr, 0);
+    UNI_CHECK(fresh.export_changes(document));
+    UNI_CHECK(!std::filesystem::exists(stray));
+    UNI_CHECK(ExporterTest_GetWritten(exporter.directory).size() == 16);
+    UNI_CHECK(ExporterTest_CountWritten(ExporterTest_GetWritten(exporter.directory)) == 0);
+}
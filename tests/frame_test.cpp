@@ -0,0 +1,103 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "assets/thumbnail.hpp"
+#include "csg/compiler.hpp"
+#include "jobs/job_system.hpp"
+#include "level/autosave.hpp"
+#include "level/bvh.hpp"
+#include "level/vertex_hash.hpp"
+#include "level_fixture.hpp"
+#include "lightmap/baker.hpp"
+#include "test.hpp"
+#include "util/alloc_counter.hpp"
+#include "util/arena.hpp"
+
+// Runs the parts of App::update which don't need a window, in the
+// same order, against a level which is no longer being edited.
+// Once the background work settles, a frame should not touch the
+// heap at all.
+UNI_TEST(App_SettledFrameMakesNoHeapAllocations) {
+    if(!AllocCounter_IsEnabled()) {
+        // Only profiling builds count allocations
+        return;
+    }
+    JobSystem jobs;
+    jobs.init(2);
+    Arena frame_arena;
+    frame_arena.init(1 << 16);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 50);
+    LevelAutosaver autosaver = LevelAutosaver(&jobs);
+    autosaver.path = Test_GetTempPath("frame.autosave.unilevel");
+    autosaver.interval = 0.0;
+    AssetThumbnailer thumbnailer = AssetThumbnailer(&jobs);
+    LevelBvh bvh = LevelBvh(&jobs);
+    LevelVertexHash vertex_hash = LevelVertexHash(&jobs);
+    CsgCompiler csg = CsgCompiler(&jobs);
+    csg.region_size = 8.0f;
+    csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{1.0f, 1.0f, 1.0f}, Vec3{13.0f, 5.0f, 5.0f}}, CsgOperation_Add, LevelMaterialId_None
+    ));
+    csg.add_brush(CsgBrush_CreateBox(
+        Bounds3{Vec3{3.0f, 2.0f, -1.0f}, Vec3{7.0f, 4.0f, 7.0f}}, CsgOperation_Subtract, LevelMaterialId_None
+    ));
+    LightmapBaker baker = LightmapBaker(&jobs);
+    baker.settings.bounce_count = 0;
+    baker.settings.samples_per_pass = 2;
+    baker.settings.target_samples = 4;
+    baker.lights.push_back(LightmapLight{Vec3{7.0f, 10.0f, 3.0f}, Vec3{1.0f, 1.0f, 1.0f}});
+    uint64_t lightmap_sources_revision = 0;
+    double time = 0.0;
+    const auto frame = [&]() {
+        frame_arena.reset();
+        jobs.update();
+        autosaver.update(document, time);
+        thumbnailer.update();
+        bvh.update(document);
+        vertex_hash.update(document);
+        csg.update();
+        if(lightmap_sources_revision != csg.revision) {
+            lightmap_sources_revision = csg.revision;
+            std::vector<LightmapSource> sources;
+            Lightmap_GatherCsgSources(csg, baker, &sources);
+            baker.set_sources(std::move(sources));
+        }
+        baker.update();
+        // Scratch lists come from the frame arena
+        ArenaVector<uint32_t> rows = ArenaVector<uint32_t>(ArenaAllocator<uint32_t>(&frame_arena));
+        for(uint32_t row = 0; row < document.get_count(); row += 7) {
+            rows.push_back(row);
+        }
+        time += 1.0 / 60.0;
+    };
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    bool settled = false;
+    while(!settled && std::chrono::steady_clock::now() < deadline) {
+        frame();
+        settled = !autosaver.is_saving() && csg.get_dirty_count() == 0 && baker.is_converged();
+        for(const auto& [key, region] : csg.get_regions()) {
+            settled = settled && !region->compiling;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    UNI_CHECK(settled);
+    UNI_CHECK(!baker.get_pages().empty());
+    // A few more frames let the last completion callbacks run, and
+    // containers reach the sizes they keep
+    for(int i = 0; i < 10; ++i) {
+        frame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const uint64_t alloc_count = AllocCounter_GetThreadCount();
+    for(int i = 0; i < 100; ++i) {
+        frame();
+    }
+    UNI_CHECK(AllocCounter_GetThreadCount() == alloc_count);
+    bvh.cancel();
+    csg.cancel();
+    baker.cancel();
+    autosaver.cancel();
+    jobs.conclude();
+}
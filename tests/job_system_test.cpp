@@ -0,0 +1,144 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "test.hpp"
+
+UNI_TEST(JobSystem_RunsDependenciesFirst) {
+    JobSystem jobs;
+    jobs.init(3);
+    std::atomic<int> step = 0;
+    std::atomic<bool> ordered = true;
+    const JobHandle first = jobs.submit([&]() {
+        ordered = ordered && step.fetch_add(1) == 0;
+    });
+    const JobHandle second = jobs.submit([&]() {
+        ordered = ordered && step.fetch_add(1) == 1;
+    }, {first});
+    const JobHandle third = jobs.submit([&]() {
+        ordered = ordered && step.fetch_add(1) == 2;
+    }, {first, second});
+    jobs.wait(third);
+    UNI_CHECK(jobs.is_done(first));
+    UNI_CHECK(jobs.is_done(second));
+    UNI_CHECK(step == 3);
+    UNI_CHECK(ordered);
+    jobs.conclude();
+}
+
+UNI_TEST(JobSystem_CompletesOnMainThread) {
+    JobSystem jobs;
+    jobs.init(2);
+    int completed = 0;
+    bool on_main_thread = true;
+    std::vector<JobHandle> handles;
+    for(int i = 0; i < 100; ++i) {
+        handles.push_back(jobs.submit([]() {}, {}, [&]() {
+            on_main_thread = on_main_thread && jobs.is_main_thread();
+            completed++;
+        }));
+    }
+    for(const JobHandle handle : handles) {
+        jobs.wait(handle);
+    }
+    // Completion callbacks only run during update
+    UNI_CHECK(completed == 0);
+    jobs.update();
+    UNI_CHECK(completed == 100);
+    UNI_CHECK(on_main_thread);
+    jobs.conclude();
+}
+
+UNI_TEST(JobSystem_HandlesOutliveReusedSlots) {
+    JobSystem jobs;
+    jobs.init(2);
+    const JobHandle old_handle = jobs.submit([]() {});
+    jobs.wait(old_handle);
+    // Enough jobs to reuse the first job's slot
+    std::vector<JobHandle> handles;
+    for(uint32_t i = 0; i < JobSystem_SlotBlockSize; ++i) {
+        handles.push_back(jobs.submit([]() {}));
+    }
+    UNI_CHECK(jobs.is_done(old_handle));
+    UNI_CHECK(jobs.is_done(JobHandle_None));
+    for(const JobHandle handle : handles) {
+        jobs.wait(handle);
+    }
+    jobs.update();
+    jobs.conclude();
+}
+
+UNI_TEST(JobSystem_ParallelForCoversRangeOnce) {
+    JobSystem jobs;
+    jobs.init(3);
+    const int counts[] = {0, 1, 7, 1000, 12345};
+    const int chunk_sizes[] = {1, 16, 5000};
+    for(const int count : counts) {
+        for(const int chunk_size : chunk_sizes) {
+            std::vector<std::atomic<int>> visits(count);
+            std::atomic<bool> chunks_valid = true;
+            jobs.parallel_for(count, chunk_size, [&](int begin, int end) {
+                if(begin >= end || end - begin > chunk_size) {
+                    chunks_valid = false;
+                }
+                for(int i = begin; i < end; ++i) {
+                    visits[i]++;
+                }
+            });
+            bool each_once = true;
+            for(int i = 0; i < count; ++i) {
+                each_once = each_once && visits[i] == 1;
+            }
+            UNI_CHECK(chunks_valid);
+            UNI_CHECK(each_once);
+        }
+    }
+    jobs.conclude();
+}
+
+UNI_TEST(JobSystem_ParallelForNests) {
+    JobSystem jobs;
+    jobs.init(2);
+    std::atomic<int> total = 0;
+    jobs.parallel_for(8, 1, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            jobs.parallel_for(100, 10, [&](int inner_begin, int inner_end) {
+                total += inner_end - inner_begin;
+            });
+        }
+    });
+    UNI_CHECK(total == 800);
+    jobs.conclude();
+}
+
+UNI_TEST(JobSystem_WorkersSubmitToOtherSystems) {
+    // More workers than the other system has queues, so a worker
+    // mistaking its own queue index for the other system's would
+    // index past the end of its queues
+    JobSystem outer;
+    outer.init(3);
+    JobSystem inner;
+    inner.init(1);
+    std::atomic<int> total = 0;
+    std::vector<JobHandle> handles;
+    for(int i = 0; i < 64; ++i) {
+        handles.push_back(outer.submit([&]() {
+            const JobHandle handle = inner.submit([&]() {
+                total++;
+            });
+            inner.wait(handle);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }));
+    }
+    // Poll rather than wait, so that only workers run outer jobs
+    for(const JobHandle handle : handles) {
+        while(!outer.is_done(handle)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    UNI_CHECK(total == 64);
+    inner.conclude();
+    outer.conclude();
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/journal.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+// Get every entity's handle and values, ordered by handle. Undo
+// and redo bring back entities, but not always in the same rows.
+static std::vector<uint8_t> JournalTest_GetBytes(const LevelDocument& document) {
+    std::vector<LevelHandle> handles;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        handles.push_back(document.get_handle(row));
+    }
+    std::sort(handles.begin(), handles.end(), [](LevelHandle a, LevelHandle b) {
+        return a.index < b.index;
+    });
+    std::vector<uint8_t> bytes;
+    for(const LevelHandle handle : handles) {
+        const LevelEntityDesc desc = document.get_desc(document.get_row(handle));
+        bytes.insert(bytes.end(), (const uint8_t*) &handle, (const uint8_t*) (&handle + 1));
+        bytes.insert(bytes.end(), (const uint8_t*) &desc, (const uint8_t*) (&desc + 1));
+    }
+    return bytes;
+}
+
+// Move some entities, recording the change as one transaction.
+static void JournalTest_Move(
+    LevelJournal* journal,
+    LevelDocument* document,
+    const std::vector<LevelHandle>& handles,
+    const Vec3& offset,
+    uint64_t merge_key = 0
+) {
+    journal->begin(Symbol("Move"), merge_key);
+    journal->record_values(LevelColumnId_Positions, handles.data(), (uint32_t) handles.size());
+    for(const LevelHandle handle : handles) {
+        const uint32_t row = document->get_row(handle);
+        document->set_position(row, document->positions[row] + offset);
+    }
+    journal->commit();
+}
+
+UNI_TEST(LevelJournal_UndoesAndRedoesValues) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 50, 5);
+    LevelJournal journal = LevelJournal(&document, nullptr);
+    const std::vector<uint8_t> before = JournalTest_GetBytes(document);
+    std::vector<LevelHandle> handles = {document.get_handle(3), document.get_handle(7)};
+    JournalTest_Move(&journal, &document, handles, Vec3{1.0f, 0.0f, 0.0f});
+    const std::vector<uint8_t> after = JournalTest_GetBytes(document);
+    UNI_CHECK(before != after);
+    UNI_CHECK(journal.can_undo() && !journal.can_redo());
+    UNI_CHECK(journal.undo());
+    UNI_CHECK(JournalTest_GetBytes(document) == before);
+    UNI_CHECK(!journal.undo());
+    UNI_CHECK(journal.redo());
+    UNI_CHECK(JournalTest_GetBytes(document) == after);
+    UNI_CHECK(!journal.redo());
+    // Nothing recorded, so nothing added
+    journal.begin(Symbol("Nothing"));
+    UNI_CHECK(!journal.commit());
+    UNI_CHECK(journal.get_entry_count() == 1);
+}
+
+UNI_TEST(LevelJournal_UndoesCreateAndDestroy) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 20, 6);
+    LevelJournal journal = LevelJournal(&document, nullptr);
+    std::vector<LevelHandle> notified;
+    journal.listeners.push_back([&](const LevelHandle* handles, uint32_t count) {
+        notified.insert(notified.end(), handles, handles + count);
+    });
+    const std::vector<uint8_t> start = JournalTest_GetBytes(document);
+    journal.begin(Symbol("Create"));
+    LevelEntityDesc desc;
+    desc.position = Vec3{9.0f, 9.0f, 9.0f};
+    const LevelHandle created = document.create(desc);
+    journal.record_create(created);
+    journal.commit();
+    UNI_CHECK(notified.size() == 1 && notified[0] == created);
+    const LevelHandle destroyed = document.get_handle(4);
+    const LevelEntityDesc destroyed_desc = document.get_desc(4);
+    journal.begin(Symbol("Destroy"));
+    journal.record_destroy(destroyed);
+    document.destroy(destroyed);
+    journal.commit();
+    const std::vector<uint8_t> end = JournalTest_GetBytes(document);
+    UNI_CHECK(journal.undo());
+    UNI_CHECK(document.is_valid(destroyed));
+    UNI_CHECK(document.get_desc(document.get_row(destroyed)).position == destroyed_desc.position);
+    UNI_CHECK(journal.undo());
+    UNI_CHECK(!document.is_valid(created));
+    UNI_CHECK(document.get_count() == 20);
+    UNI_CHECK(journal.redo());
+    UNI_CHECK(document.is_valid(created));
+    UNI_CHECK(document.positions[document.get_row(created)] == desc.position);
+    UNI_CHECK(journal.redo());
+    UNI_CHECK(!document.is_valid(destroyed));
+    UNI_CHECK(JournalTest_GetBytes(document) == end);
+    UNI_CHECK(journal.undo() && journal.undo());
+    UNI_CHECK(JournalTest_GetBytes(document) == start);
+}
+
+UNI_TEST(LevelJournal_MergesContinuousEdits) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 10, 7);
+    LevelJournal journal = LevelJournal(&document, nullptr);
+    const std::vector<uint8_t> before = JournalTest_GetBytes(document);
+    const std::vector<LevelHandle> handles = {document.get_handle(1), document.get_handle(2)};
+    for(int i = 0; i < 100; ++i) {
+        JournalTest_Move(&journal, &document, handles, Vec3{0.01f, 0.0f, 0.0f}, 42);
+    }
+    UNI_CHECK(journal.get_entry_count() == 1);
+    const std::vector<uint8_t> dragged = JournalTest_GetBytes(document);
+    // Another key, or other entities, start a new entry
+    JournalTest_Move(&journal, &document, handles, Vec3{0.01f, 0.0f, 0.0f}, 43);
+    JournalTest_Move(&journal, &document, {document.get_handle(3)}, Vec3{0.01f, 0.0f, 0.0f}, 43);
+    UNI_CHECK(journal.get_entry_count() == 3);
+    UNI_CHECK(journal.undo() && journal.undo());
+    UNI_CHECK(JournalTest_GetBytes(document) == dragged);
+    UNI_CHECK(journal.undo());
+    UNI_CHECK(JournalTest_GetBytes(document) == before);
+}
+
+UNI_TEST(LevelJournal_CancelReverts) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 10, 8);
+    LevelJournal journal = LevelJournal(&document, nullptr);
+    const std::vector<uint8_t> before = JournalTest_GetBytes(document);
+    journal.begin(Symbol("Cancelled"));
+    const LevelHandle handle = document.get_handle(0);
+    journal.record_values(LevelColumnId_Scales, handle);
+    document.set_scale(0, Vec3{5.0f, 5.0f, 5.0f});
+    journal.cancel();
+    UNI_CHECK(JournalTest_GetBytes(document) == before);
+    UNI_CHECK(journal.get_entry_count() == 0);
+}
+
+UNI_TEST(LevelJournal_DropsOldestEntries) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 10, 9);
+    LevelJournal journal = LevelJournal(&document, nullptr);
+    journal.max_entry_count = 5;
+    for(int i = 0; i < 12; ++i) {
+        JournalTest_Move(&journal, &document, {document.get_handle(i % 10)}, Vec3{1.0f, 0.0f, 0.0f});
+    }
+    UNI_CHECK(journal.get_entry_count() == 5);
+    int undo_count = 0;
+    while(journal.undo()) {
+        undo_count++;
+    }
+    UNI_CHECK(undo_count == 5);
+}
+
+UNI_TEST(LevelJournal_UndoesCompressedEntries) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 10);
+    LevelJournal journal = LevelJournal(&document, &jobs);
+    std::mt19937 random(11);
+    // Remember the document after every step, then walk back
+    std::vector<std::vector<uint8_t>> states = {JournalTest_GetBytes(document)};
+    for(int step = 0; step < 30; ++step) {
+        std::vector<LevelHandle> handles;
+        for(uint32_t row = 0; row < document.get_count(); ++row) {
+            if(random() % 4 == 0) {
+                handles.push_back(document.get_handle(row));
+            }
+        }
+        if(step % 5 == 4) {
+            journal.begin(Symbol("Destroy"));
+            journal.record_destroy(handles.data(), (uint32_t) handles.size() / 8);
+            for(uint32_t i = 0; i < handles.size() / 8; ++i) {
+                document.destroy(handles[i]);
+            }
+            journal.commit();
+        }
+        else {
+            JournalTest_Move(&journal, &document, handles, Vec3{0.5f, 0.0f, 0.25f});
+        }
+        states.push_back(JournalTest_GetBytes(document));
+    }
+    // Wait for compression jobs to finish and report back
+    const size_t raw_bytes = journal.get_memory_bytes();
+    size_t memory_bytes = raw_bytes;
+    int quiet_count = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(quiet_count < 50 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        jobs.update();
+        const bool changed = journal.get_memory_bytes() != memory_bytes;
+        memory_bytes = journal.get_memory_bytes();
+        quiet_count = changed || memory_bytes == raw_bytes ? 0 : quiet_count + 1;
+    }
+    UNI_CHECK(memory_bytes < raw_bytes / 2);
+    bool undone = true;
+    for(size_t i = states.size() - 1; i > 0; --i) {
+        undone = undone && journal.undo() && JournalTest_GetBytes(document) == states[i - 1];
+    }
+    UNI_CHECK(undone);
+    bool redone = true;
+    for(size_t i = 1; i < states.size(); ++i) {
+        redone = redone && journal.redo() && JournalTest_GetBytes(document) == states[i];
+    }
+    UNI_CHECK(redone);
+    journal.clear();
+    jobs.update();
+    jobs.conclude();
+}
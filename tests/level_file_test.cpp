@@ -0,0 +1,143 @@
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#include "level/document.hpp"
+#include "level/level_file.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+static bool LevelFileTest_ReadBytes(const std::string& path, std::vector<uint8_t>* bytes) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    bytes->resize((size_t) file.tellg());
+    file.seekg(0);
+    file.read((char*) bytes->data(), (std::streamsize) bytes->size());
+    return (bool) file;
+}
+
+static bool LevelFileTest_WriteBytes(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*) bytes.data(), (std::streamsize) bytes.size());
+    return (bool) file;
+}
+
+// Make a document with destroyed entities, so that handle slots
+// and rows no longer line up.
+static void LevelFileTest_Fill(LevelDocument* document) {
+    LevelFixture_Fill(document, 5000, 3);
+    for(uint32_t i = 0; i < 500; ++i) {
+        document->destroy(document->get_handle((i * 37) % document->get_count()));
+    }
+}
+
+UNI_TEST(LevelFile_RoundTrips) {
+    LevelDocument document;
+    LevelFileTest_Fill(&document);
+    const std::string path = Test_GetTempPath("round_trip.unilevel");
+    if(!UNI_CHECK(LevelFile_Save(document, path.c_str()))) {
+        return;
+    }
+    LevelDocument opened;
+    if(!UNI_CHECK(LevelFile_Open(&opened, path.c_str()))) {
+        return;
+    }
+    UNI_CHECK(opened.get_count() == document.get_count());
+    UNI_CHECK(opened.positions.is_view());
+    bool rows_equal = true;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        rows_equal = (
+            rows_equal && opened.positions[row] == document.positions[row] &&
+            opened.rotations[row] == document.rotations[row] &&
+            opened.scales[row] == document.scales[row] &&
+            opened.meshes[row] == document.meshes[row] &&
+            opened.materials[row] == document.materials[row] &&
+            opened.flags[row] == document.flags[row] &&
+            opened.is_valid(opened.get_handle(row))
+        );
+    }
+    UNI_CHECK(rows_equal);
+    UNI_CHECK(opened.mesh_assets.size() == 1);
+    UNI_CHECK(opened.mesh_assets[0].name == document.mesh_assets[0].name);
+    UNI_CHECK(opened.mesh_assets[0].indices == document.mesh_assets[0].indices);
+    UNI_CHECK(opened.material_assets[0].color[0] == 0.25f);
+    std::vector<uint8_t> saved_bytes;
+    std::vector<uint8_t> opened_bytes;
+    LevelFile_Serialize(document, &saved_bytes);
+    LevelFile_Serialize(opened, &opened_bytes);
+    UNI_CHECK(saved_bytes == opened_bytes);
+}
+
+UNI_TEST(LevelFile_SavesOverViewedFile) {
+    LevelDocument document;
+    LevelFileTest_Fill(&document);
+    const std::string path = Test_GetTempPath("save_over.unilevel");
+    LevelFile_Save(document, path.c_str());
+    LevelDocument opened;
+    if(!UNI_CHECK(LevelFile_Open(&opened, path.c_str()))) {
+        return;
+    }
+    // Edits to a mapped file's pages stay private until saved
+    opened.set_position(10, Vec3{5.0f, 6.0f, 7.0f});
+    opened.create(LevelEntityDesc{});
+    UNI_CHECK(LevelFile_SaveOver(&opened, path.c_str()));
+    LevelDocument reopened;
+    if(!UNI_CHECK(LevelFile_Open(&reopened, path.c_str()))) {
+        return;
+    }
+    UNI_CHECK(reopened.get_count() == document.get_count() + 1);
+    UNI_CHECK(reopened.positions[10] == (Vec3{5.0f, 6.0f, 7.0f}));
+    UNI_CHECK(opened.positions[11] == document.positions[11]);
+}
+
+UNI_TEST(LevelFile_RejectsCorruptFiles) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 100, 4);
+    const std::string path = Test_GetTempPath("corrupt.unilevel");
+    std::vector<uint8_t> bytes;
+    if(!UNI_CHECK(LevelFile_Save(document, path.c_str()) && LevelFileTest_ReadBytes(path, &bytes))) {
+        return;
+    }
+    LevelFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    const LevelFileColumn* columns = (const LevelFileColumn*) (bytes.data() + header.columns_offset);
+    const LevelFileMesh* meshes = (const LevelFileMesh*) (bytes.data() + header.meshes_offset);
+    const uint64_t row_slots_offset = columns[LevelColumnId_RowSlots].offset;
+    const uint64_t indices_offset = meshes[0].indices_offset;
+    const uint32_t vertex_count = meshes[0].vertex_count;
+    const std::function<void(std::vector<uint8_t>&)> corruptions[] = {
+        [](std::vector<uint8_t>& file) { file.resize(file.size() / 2); },
+        [](std::vector<uint8_t>& file) { file.resize(sizeof(LevelFileHeader) - 1); },
+        [](std::vector<uint8_t>& file) { file[0] = 'X'; },
+        [](std::vector<uint8_t>& file) { ((LevelFileHeader*) file.data())->version++; },
+        [](std::vector<uint8_t>& file) { ((LevelFileHeader*) file.data())->byte_order = 0x04030201; },
+        [](std::vector<uint8_t>& file) { ((LevelFileHeader*) file.data())->entity_count *= 1000; },
+        [](std::vector<uint8_t>& file) { ((LevelFileHeader*) file.data())->strings_size = UINT64_MAX; },
+        [&](std::vector<uint8_t>& file) {
+            ((LevelFileColumn*) (file.data() + header.columns_offset))[2].offset = file.size();
+        },
+        [&](std::vector<uint8_t>& file) {
+            ((LevelFileColumn*) (file.data() + header.columns_offset))[0].value_size = 4;
+        },
+        [&](std::vector<uint8_t>& file) {
+            ((uint32_t*) (file.data() + indices_offset))[5] = vertex_count;
+        },
+        [&](std::vector<uint8_t>& file) {
+            ((uint32_t*) (file.data() + row_slots_offset))[50] = header.entity_count;
+        },
+        [&](std::vector<uint8_t>& file) {
+            ((LevelHandleSlot*) (file.data() + header.slots_offset))[99].row = header.entity_count;
+        },
+    };
+    LevelDocument opened;
+    UNI_CHECK(LevelFile_Open(&opened, path.c_str()));
+    for(const auto& corrupt : corruptions) {
+        std::vector<uint8_t> corrupted = bytes;
+        corrupt(corrupted);
+        opened.clear();
+        UNI_CHECK(LevelFileTest_WriteBytes(path, corrupted));
+        UNI_CHECK(!LevelFile_Open(&opened, path.c_str()));
+        UNI_CHECK(opened.get_count() == 0 && opened.mesh_assets.empty());
+    }
+    UNI_CHECK(!LevelFile_Open(&opened, Test_GetTempPath("missing.unilevel").c_str()));
+}
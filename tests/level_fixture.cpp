@@ -0,0 +1,46 @@
+#include "level_fixture.hpp"
+
+#include "level/mesh.hpp"
+
+Vec3 LevelFixture_RandomPoint(std::mt19937& random, float size) {
+    std::uniform_real_distribution<float> coordinate(-0.5f * size, 0.5f * size);
+    const float x = coordinate(random);
+    const float y = coordinate(random);
+    const float z = coordinate(random);
+    return Vec3{x, y, z};
+}
+
+Quat LevelFixture_RandomRotation(std::mt19937& random) {
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    const Vec3 axis = LevelFixture_RandomPoint(random, 2.0f) + Vec3{0.0f, 0.01f, 0.0f};
+    return Quat_FromAxisAngle(Vec3_Normalize(axis), angle(random));
+}
+
+void LevelFixture_Fill(LevelDocument* document, uint32_t count, uint32_t seed, float size) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    const LevelMeshId mesh = document->add_mesh(LevelMesh_CreateCube(Symbol("Fixture Cube")));
+    LevelMaterial material;
+    material.name = Symbol("Fixture Material");
+    material.color[0] = 0.25f;
+    const LevelMaterialId material_id = document->add_material(material);
+    document->reserve(document->get_count() + count);
+    for(uint32_t i = 0; i < count; ++i) {
+        LevelEntityDesc desc;
+        desc.position = LevelFixture_RandomPoint(random, size);
+        desc.rotation = LevelFixture_RandomRotation(random);
+        const float x = scale(random);
+        const float y = scale(random);
+        const float z = scale(random);
+        desc.scale = Vec3{x, y, z};
+        desc.mesh = mesh;
+        desc.material = material_id;
+        if(i % 7 == 6) {
+            desc.flags |= LevelEntityFlags_Hidden;
+        }
+        if(i % 11 == 10) {
+            desc.flags |= LevelEntityFlags_Locked;
+        }
+        document->create(desc);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+#include "level/document.hpp"
+#include "util/math.hpp"
+
+/**
+ * Levels for tests of the level code, made the same way each time
+ * from a seed.
+ */
+
+// Get a random point in a cube of a given size around the origin.
+Vec3 LevelFixture_RandomPoint(std::mt19937& random, float size);
+// Get a random rotation.
+Quat LevelFixture_RandomRotation(std::mt19937& random);
+// Add a cube mesh, a material, and count entities using them,
+// with random transforms inside a cube of a given size. Every
+// seventh entity is hidden, and every eleventh locked.
+void LevelFixture_Fill(LevelDocument* document, uint32_t count, uint32_t seed, float size = 100.0f);
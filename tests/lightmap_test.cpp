@@ -0,0 +1,158 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "lightmap/baker.hpp"
+#include "test.hpp"
+
+// Make a square facing up, centered on a point.
+static std::shared_ptr<LevelMesh> LightmapTest_MakeFloor(const Vec3& center, float half_size) {
+    auto mesh = std::make_shared<LevelMesh>();
+    mesh->positions = {
+        center + Vec3{-half_size, 0.0f, -half_size},
+        center + Vec3{-half_size, 0.0f, half_size},
+        center + Vec3{half_size, 0.0f, half_size},
+        center + Vec3{half_size, 0.0f, -half_size},
+    };
+    mesh->normals.assign(4, Vec3{0.0f, 1.0f, 0.0f});
+    mesh->indices = {0, 1, 2, 0, 2, 3};
+    mesh->update_bounds();
+    return mesh;
+}
+
+// Settings which gather only direct light, so that every sample
+// of a texel is the same.
+static LightmapSettings LightmapTest_GetDirectSettings() {
+    LightmapSettings settings;
+    settings.bounce_count = 0;
+    settings.sky_color = Vec3();
+    settings.samples_per_pass = 2;
+    settings.target_samples = 4;
+    return settings;
+}
+
+// Count the texels of a page which have samples.
+static uint32_t LightmapTest_CountSampled(const LightmapPage& page) {
+    uint32_t count = 0;
+    for(const uint32_t samples : page.sample_counts) {
+        count += samples > 0 ? 1 : 0;
+    }
+    return count;
+}
+
+UNI_TEST(LightmapPage_UnwrapsEveryTriangle) {
+    const auto floor = LightmapTest_MakeFloor(Vec3{}, 4.0f);
+    const LightmapSettings settings;
+    const auto page = LightmapPage_Create(1, 1, *floor, settings);
+    UNI_CHECK(page->width > 0 && page->height > 0);
+    UNI_CHECK(page->mesh.indices.size() == floor->indices.size());
+    UNI_CHECK(page->mesh.uvs.size() == page->mesh.positions.size());
+    bool valid = true;
+    for(size_t i = 0; i < page->mesh.indices.size(); ++i) {
+        // The same corners, with uvs inside the page
+        const uint32_t index = page->mesh.indices[i];
+        const Vec2 uv = page->mesh.uvs[index];
+        valid = (
+            valid && page->mesh.positions[index] == floor->positions[floor->indices[i]] &&
+            uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f
+        );
+    }
+    UNI_CHECK(valid);
+    // About texels_per_unit squared texels per unit of area
+    uint32_t chart_texel_count = 0;
+    for(const Vec3& normal : page->texel_normals) {
+        chart_texel_count += normal.y > 0.5f ? 1 : 0;
+    }
+    const float expected = 64.0f * settings.texels_per_unit * settings.texels_per_unit;
+    UNI_CHECK(chart_texel_count >= expected * 0.8f && chart_texel_count <= expected * 1.5f);
+}
+
+UNI_TEST(LightmapBaker_MatchesDirectLightAndShadows) {
+    LightmapBaker baker;
+    baker.settings = LightmapTest_GetDirectSettings();
+    const Vec3 light_position = Vec3{0.0f, 3.0f, 0.0f};
+    baker.lights.push_back(LightmapLight{light_position, Vec3{1.0f, 1.0f, 1.0f}});
+    // A square between the light and the floor, which shadows the
+    // floor out to 1.5 units from the middle
+    std::vector<LightmapSource> sources(2);
+    sources[0].key = 1;
+    sources[0].mesh = LightmapTest_MakeFloor(Vec3{}, 4.0f);
+    sources[1].key = 2;
+    sources[1].mesh = LightmapTest_MakeFloor(Vec3{0.0f, 1.0f, 0.0f}, 1.0f);
+    baker.set_sources(sources);
+    baker.bake(100);
+    UNI_CHECK(baker.is_converged());
+    const LightmapPage* page = baker.find_page(1);
+    if(!UNI_CHECK(page != nullptr)) {
+        return;
+    }
+    uint32_t lit_count = 0;
+    uint32_t shadowed_count = 0;
+    uint32_t mismatch_count = 0;
+    for(size_t texel = 0; texel < page->texel_positions.size(); ++texel) {
+        if(page->texel_normals[texel].y < 0.5f) {
+            continue;
+        }
+        const Vec3 position = page->texel_positions[texel];
+        const float reach = std::max(std::fabs(position.x), std::fabs(position.z));
+        const float light = page->light_sums[texel].x / (float) page->sample_counts[texel];
+        if(reach < 1.4f) {
+            shadowed_count++;
+            mismatch_count += light == 0.0f ? 0 : 1;
+        }
+        else if(reach > 1.6f) {
+            lit_count++;
+            const Vec3 offset = light_position - position;
+            const float distance = Vec3_Length(offset);
+            const float expected = offset.y / distance / (distance * distance);
+            mismatch_count += std::fabs(light - expected) <= expected * 1e-3f ? 0 : 1;
+        }
+    }
+    UNI_CHECK(lit_count > 100 && shadowed_count > 10);
+    UNI_CHECK(mismatch_count == 0);
+}
+
+UNI_TEST(LightmapBaker_KeepsSamplesAwayFromChanges) {
+    LightmapBaker baker;
+    baker.settings = LightmapTest_GetDirectSettings();
+    baker.settings.influence_distance = 8.0f;
+    baker.lights.push_back(LightmapLight{Vec3{0.0f, 3.0f, 0.0f}, Vec3{1.0f, 1.0f, 1.0f}});
+    // Two floors near each other, and one far off
+    std::vector<LightmapSource> sources(3);
+    sources[0].key = 1;
+    sources[0].mesh = LightmapTest_MakeFloor(Vec3{}, 4.0f);
+    sources[1].key = 2;
+    sources[1].mesh = LightmapTest_MakeFloor(Vec3{10.0f, 0.0f, 0.0f}, 4.0f);
+    sources[2].key = 3;
+    sources[2].mesh = LightmapTest_MakeFloor(Vec3{100.0f, 0.0f, 0.0f}, 4.0f);
+    baker.set_sources(sources);
+    baker.bake(100);
+    UNI_CHECK(baker.is_converged());
+    const LightmapPage* near_page = baker.find_page(1);
+    const LightmapPage* far_page = baker.find_page(3);
+    if(!UNI_CHECK(near_page != nullptr && far_page != nullptr)) {
+        return;
+    }
+    const uint32_t near_sampled = LightmapTest_CountSampled(*near_page);
+    const uint32_t far_sampled = LightmapTest_CountSampled(*far_page);
+    const uint64_t far_revision = far_page->revision;
+    // Raise the second floor. Unchanged sources are given without
+    // their meshes.
+    sources[0].mesh.reset();
+    sources[1].signature = 1;
+    sources[1].mesh = LightmapTest_MakeFloor(Vec3{10.0f, 0.5f, 0.0f}, 4.0f);
+    sources[2].mesh.reset();
+    baker.set_sources(sources);
+    UNI_CHECK(!baker.is_converged());
+    baker.bake(0);
+    // Pages are kept, with only texels near the change started over
+    UNI_CHECK(baker.find_page(1) == near_page && baker.find_page(3) == far_page);
+    UNI_CHECK(LightmapTest_CountSampled(*baker.find_page(2)) == 0);
+    const uint32_t near_kept = LightmapTest_CountSampled(*near_page);
+    UNI_CHECK(near_kept > 0 && near_kept < near_sampled);
+    UNI_CHECK(LightmapTest_CountSampled(*far_page) == far_sampled);
+    UNI_CHECK(far_page->revision == far_revision);
+    baker.bake(100);
+    UNI_CHECK(baker.is_converged());
+    UNI_CHECK(LightmapTest_CountSampled(*baker.find_page(2)) > 0);
+}
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "test.hpp"
+#include "util/log.hpp"
+
+// Wait for the writer thread to add messages to the history.
+static bool LogTest_WaitForHistory(uint32_t count) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(Log_GetHistoryCount() < count) {
+        if(std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+UNI_TEST(Log_KeepsMessagesFromEveryThread) {
+    const LogLevel level = Log_GetLevel(LogSubsystem_Assets);
+    Log_SetLevel(LogSubsystem_Assets, LogLevel_Info);
+    const uint32_t first = Log_GetHistoryCount();
+    const uint64_t dropped = Log_GetDroppedCount();
+    const int thread_count = 4;
+    const int message_count = 500;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([t]() {
+            for(int i = 0; i < message_count; ++i) {
+                UNI_LOG_INFO(LogSubsystem_Assets, "Log test {} {}", t, i);
+                // Below the runtime level, so never written
+                UNI_LOG_DEBUG(LogSubsystem_Assets, "Hidden log test {} {}", t, i);
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    const uint32_t expected = (uint32_t) (thread_count * message_count);
+    UNI_CHECK(Log_GetDroppedCount() == dropped);
+    if(!UNI_CHECK(LogTest_WaitForHistory(first + expected))) {
+        Log_SetLevel(LogSubsystem_Assets, level);
+        return;
+    }
+    // Each thread's messages appear once each, in order
+    int next[thread_count] = {};
+    bool valid = true;
+    const uint32_t last = Log_GetHistoryCount();
+    for(uint32_t i = first; i < last; ++i) {
+        const LogHistoryEntry& entry = Log_GetHistoryEntry(i);
+        const std::string_view text = std::string_view(entry.text, entry.length);
+        if(entry.subsystem != LogSubsystem_Assets || !text.starts_with("Log test ")) {
+            valid = valid && !text.starts_with("Hidden log test");
+            continue;
+        }
+        const int t = text[9] - '0';
+        valid = (
+            valid && entry.level == LogLevel_Info && t >= 0 && t < thread_count &&
+            text == "Log test " + std::to_string(t) + " " + std::to_string(next[t])
+        );
+        if(t >= 0 && t < thread_count) {
+            next[t]++;
+        }
+    }
+    UNI_CHECK(valid);
+    for(int t = 0; t < thread_count; ++t) {
+        UNI_CHECK(next[t] == message_count);
+    }
+    Log_SetLevel(LogSubsystem_Assets, level);
+}
+
+UNI_TEST(Log_TruncatesLongMessages) {
+    const uint32_t first = Log_GetHistoryCount();
+    const std::string text(LogMessage_MaxLength * 2, 'x');
+    UNI_LOG_ERROR(LogSubsystem_General, "{}", text);
+    if(!UNI_CHECK(LogTest_WaitForHistory(first + 1))) {
+        return;
+    }
+    const LogHistoryEntry& entry = Log_GetHistoryEntry(first);
+    UNI_CHECK(entry.length == LogMessage_MaxLength);
+    UNI_CHECK(std::string_view(entry.text, entry.length).ends_with("xxx..."));
+}
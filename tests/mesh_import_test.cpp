@@ -0,0 +1,235 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "import/mesh_import.hpp"
+#include "jobs/job_system.hpp"
+#include "test.hpp"
+
+static std::string ImportTest_Write(const char* name, const void* data, size_t size) {
+    const std::string path = Test_GetTempPath(name);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*) data, (std::streamsize) size);
+    return path;
+}
+
+static std::string ImportTest_Write(const char* name, const std::string& text) {
+    return ImportTest_Write(name, text.data(), text.size());
+}
+
+static std::string ImportTest_EncodeBase64(const std::vector<uint8_t>& bytes) {
+    const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text;
+    for(size_t i = 0; i < bytes.size(); i += 3) {
+        const uint32_t a = bytes[i];
+        const uint32_t b = i + 1 < bytes.size() ? bytes[i + 1] : 0;
+        const uint32_t c = i + 2 < bytes.size() ? bytes[i + 2] : 0;
+        const uint32_t bits = (a << 16) | (b << 8) | c;
+        text += digits[(bits >> 18) & 63];
+        text += digits[(bits >> 12) & 63];
+        text += i + 1 < bytes.size() ? digits[(bits >> 6) & 63] : '=';
+        text += i + 2 < bytes.size() ? digits[bits & 63] : '=';
+    }
+    return text;
+}
+
+// One triangle, as float positions then uint16 indices.
+static std::vector<uint8_t> ImportTest_GetTriangleBuffer() {
+    const float positions[9] = {0.0f, 0.0f, 0.0f, 2.0f, 0.0f, 0.0f, 0.0f, 3.0f, 0.0f};
+    const uint16_t indices[4] = {0, 2, 1, 0};
+    std::vector<uint8_t> bytes(sizeof(positions) + sizeof(indices));
+    std::memcpy(bytes.data(), positions, sizeof(positions));
+    std::memcpy(bytes.data() + sizeof(positions), indices, sizeof(indices));
+    return bytes;
+}
+
+// Get glTF JSON for the triangle buffer, with a buffer entry
+// made of the given fields.
+static std::string ImportTest_GetTriangleJson(const std::string& buffer) {
+    return (
+        "{\"asset\": {\"version\": \"2.0\"},"
+        "\"buffers\": [{" + buffer + "\"byteLength\": 44}],"
+        "\"bufferViews\": ["
+        "{\"buffer\": 0, \"byteOffset\": 0, \"byteLength\": 36},"
+        "{\"buffer\": 0, \"byteOffset\": 36, \"byteLength\": 6}],"
+        "\"accessors\": ["
+        "{\"bufferView\": 0, \"componentType\": 5126, \"count\": 3, \"type\": \"VEC3\"},"
+        "{\"bufferView\": 1, \"componentType\": 5123, \"count\": 3, \"type\": \"SCALAR\"}],"
+        "\"meshes\": [{\"name\": \"Triangle\", \"primitives\": ["
+        "{\"attributes\": {\"POSITION\": 0}, \"indices\": 1}]}]}"
+    );
+}
+
+static bool ImportTest_IsTriangle(const LevelMesh& mesh) {
+    return (
+        mesh.name == Symbol("Triangle") &&
+        mesh.positions.size() == 3 &&
+        mesh.positions[1] == (Vec3{2.0f, 0.0f, 0.0f}) &&
+        mesh.indices == std::vector<uint32_t>{0, 2, 1} &&
+        mesh.bounds.max == (Vec3{2.0f, 3.0f, 0.0f})
+    );
+}
+
+UNI_TEST(Import_GuessesFormats) {
+    UNI_CHECK(Import_GetFormat("a/b/model.obj") == ImportFormat_Obj);
+    UNI_CHECK(Import_GetFormat("MODEL.OBJ") == ImportFormat_Obj);
+    UNI_CHECK(Import_GetFormat("model.gltf") == ImportFormat_Gltf);
+    UNI_CHECK(Import_GetFormat("model.glb") == ImportFormat_Gltf);
+    UNI_CHECK(Import_GetFormat("model.fbx") == ImportFormat_Unknown);
+    UNI_CHECK(Import_GetFormat("model") == ImportFormat_Unknown);
+}
+
+UNI_TEST(Import_ReadsObjCorners) {
+    const std::string path = ImportTest_Write("quad.obj",
+        "# Two triangles with a seam along their shared edge\n"
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 1 1 0\n"
+        "v 0 1 0\n"
+        "vt 0 0\n"
+        "vt 1 1\n"
+        "vn 0 0 1\n"
+        "vn 0 0 -1\n"
+        "f 1/1/1 2/1/1 3/2/1\n"
+        "f -4/-2/-1 -2/-1/-1 -1/-2/-1 # relative indexes\n"
+    );
+    std::vector<LevelMesh> meshes;
+    if(!UNI_CHECK(Import_Meshes(path.c_str(), nullptr, &meshes)) || !UNI_CHECK(meshes.size() == 1)) {
+        return;
+    }
+    const LevelMesh& mesh = meshes[0];
+    UNI_CHECK(mesh.name == Symbol("quad"));
+    UNI_CHECK(mesh.indices.size() == 6);
+    // Positions used with two normals are split
+    UNI_CHECK(mesh.positions.size() == 6);
+    if(!UNI_CHECK(mesh.normals.size() == mesh.positions.size() && mesh.uvs.size() == mesh.positions.size())) {
+        return;
+    }
+    const Vec3 positions[6] = {
+        Vec3{0.0f, 0.0f, 0.0f}, Vec3{1.0f, 0.0f, 0.0f}, Vec3{1.0f, 1.0f, 0.0f},
+        Vec3{0.0f, 0.0f, 0.0f}, Vec3{1.0f, 1.0f, 0.0f}, Vec3{0.0f, 1.0f, 0.0f},
+    };
+    const float normal_z[6] = {1.0f, 1.0f, 1.0f, -1.0f, -1.0f, -1.0f};
+    // Texture coordinates are flipped to start at the top
+    const float uv_v[6] = {1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f};
+    bool corners_match = true;
+    for(int i = 0; i < 6; ++i) {
+        const uint32_t vertex = mesh.indices[i];
+        corners_match = (
+            corners_match && vertex < mesh.positions.size() &&
+            mesh.positions[vertex] == positions[i] &&
+            mesh.normals[vertex].z == normal_z[i] &&
+            mesh.uvs[vertex].y == uv_v[i]
+        );
+    }
+    UNI_CHECK(corners_match);
+    UNI_CHECK(mesh.bounds.max == (Vec3{1.0f, 1.0f, 0.0f}));
+}
+
+UNI_TEST(Import_ReadsLargeObjSameWithJobs) {
+    // A grid of quads, large enough to be split into chunks
+    const int size = 300;
+    std::string text;
+    for(int y = 0; y <= size; ++y) {
+        for(int x = 0; x <= size; ++x) {
+            text += "v " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string((x * y) % 7) + "\n";
+        }
+    }
+    text += "vn 0 0 1\nvt 0.5 0.5\n";
+    for(int y = 0; y < size; ++y) {
+        for(int x = 0; x < size; ++x) {
+            const int a = y * (size + 1) + x + 1;
+            const int b = a + size + 1;
+            text += (
+                "f " + std::to_string(a) + "/1/1 " + std::to_string(a + 1) + "/1/1 " +
+                std::to_string(b + 1) + "/1/1 " + std::to_string(b) + "/1/1\n"
+            );
+        }
+    }
+    const std::string path = ImportTest_Write("grid.obj", text);
+    JobSystem jobs;
+    jobs.init(3);
+    std::vector<LevelMesh> serial;
+    std::vector<LevelMesh> parallel;
+    UNI_CHECK(Import_Meshes(path.c_str(), nullptr, &serial));
+    UNI_CHECK(Import_Meshes(path.c_str(), &jobs, &parallel));
+    jobs.conclude();
+    if(!UNI_CHECK(serial.size() == 1 && parallel.size() == 1)) {
+        return;
+    }
+    UNI_CHECK(serial[0].positions.size() == (size_t) (size + 1) * (size + 1));
+    UNI_CHECK(serial[0].indices.size() == (size_t) size * size * 6);
+    UNI_CHECK(serial[0].positions == parallel[0].positions);
+    UNI_CHECK(serial[0].indices == parallel[0].indices);
+    UNI_CHECK(serial[0].normals.size() == parallel[0].normals.size());
+    UNI_CHECK(serial[0].positions[size + 2] == (Vec3{1.0f, 1.0f, 1.0f}));
+}
+
+UNI_TEST(Import_RejectsBadObj) {
+    std::vector<LevelMesh> meshes;
+    const std::string out_of_range = ImportTest_Write("out_of_range.obj", "v 0 0 0\nv 1 0 0\nf 1 2 3\n");
+    UNI_CHECK(!Import_Meshes(out_of_range.c_str(), nullptr, &meshes));
+    const std::string bad_number = ImportTest_Write("bad_number.obj", "v 0 zero 0\n");
+    UNI_CHECK(!Import_Meshes(bad_number.c_str(), nullptr, &meshes));
+    UNI_CHECK(!Import_Meshes(Test_GetTempPath("missing.obj").c_str(), nullptr, &meshes));
+    UNI_CHECK(meshes.empty());
+}
+
+UNI_TEST(Import_ReadsGltfBuffers) {
+    const std::vector<uint8_t> buffer = ImportTest_GetTriangleBuffer();
+    JobSystem jobs;
+    jobs.init(2);
+    // Embedded as a data URI
+    const std::string embedded = ImportTest_Write("embedded.gltf", ImportTest_GetTriangleJson(
+        "\"uri\": \"data:application/octet-stream;base64," + ImportTest_EncodeBase64(buffer) + "\","
+    ));
+    std::vector<LevelMesh> meshes;
+    UNI_CHECK(Import_Meshes(embedded.c_str(), &jobs, &meshes));
+    UNI_CHECK(meshes.size() == 1 && ImportTest_IsTriangle(meshes[0]));
+    // In a file next to the JSON
+    ImportTest_Write("external.bin", buffer.data(), buffer.size());
+    const std::string external = ImportTest_Write("external.gltf", ImportTest_GetTriangleJson(
+        "\"uri\": \"external.bin\","
+    ));
+    meshes.clear();
+    UNI_CHECK(Import_Meshes(external.c_str(), nullptr, &meshes));
+    UNI_CHECK(meshes.size() == 1 && ImportTest_IsTriangle(meshes[0]));
+    // In the binary chunk of a GLB
+    std::string json = ImportTest_GetTriangleJson("");
+    json.resize((json.size() + 3) / 4 * 4, ' ');
+    const uint32_t header[3] = {0x46546C67, 2, (uint32_t) (12 + 8 + json.size() + 8 + buffer.size())};
+    const uint32_t json_chunk[2] = {(uint32_t) json.size(), 0x4E4F534A};
+    const uint32_t binary_chunk[2] = {(uint32_t) buffer.size(), 0x004E4942};
+    std::vector<uint8_t> glb;
+    glb.insert(glb.end(), (const uint8_t*) header, (const uint8_t*) (header + 3));
+    glb.insert(glb.end(), (const uint8_t*) json_chunk, (const uint8_t*) (json_chunk + 2));
+    glb.insert(glb.end(), json.begin(), json.end());
+    glb.insert(glb.end(), (const uint8_t*) binary_chunk, (const uint8_t*) (binary_chunk + 2));
+    glb.insert(glb.end(), buffer.begin(), buffer.end());
+    const std::string binary = ImportTest_Write("binary.glb", glb.data(), glb.size());
+    meshes.clear();
+    UNI_CHECK(Import_Meshes(binary.c_str(), &jobs, &meshes));
+    UNI_CHECK(meshes.size() == 1 && ImportTest_IsTriangle(meshes[0]));
+    jobs.conclude();
+}
+
+UNI_TEST(Import_RejectsBadGltf) {
+    std::vector<uint8_t> buffer = ImportTest_GetTriangleBuffer();
+    // An index past the last vertex
+    buffer[36 + 2] = 3;
+    std::vector<LevelMesh> meshes;
+    const std::string bad_index = ImportTest_Write("bad_index.gltf", ImportTest_GetTriangleJson(
+        "\"uri\": \"data:application/octet-stream;base64," + ImportTest_EncodeBase64(buffer) + "\","
+    ));
+    UNI_CHECK(!Import_Meshes(bad_index.c_str(), nullptr, &meshes));
+    // A buffer shorter than its byteLength
+    buffer.resize(40);
+    const std::string short_buffer = ImportTest_Write("short_buffer.gltf", ImportTest_GetTriangleJson(
+        "\"uri\": \"data:application/octet-stream;base64," + ImportTest_EncodeBase64(buffer) + "\","
+    ));
+    UNI_CHECK(!Import_Meshes(short_buffer.c_str(), nullptr, &meshes));
+    const std::string bad_json = ImportTest_Write("bad_json.gltf", "{\"meshes\": [");
+    UNI_CHECK(!Import_Meshes(bad_json.c_str(), nullptr, &meshes));
+    UNI_CHECK(meshes.empty());
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/bvh.hpp"
+#include "level/selection.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+static std::set<uint32_t> SelectionTest_GetIndexes(const LevelDocument& document, const LevelSelection& selection) {
+    std::vector<LevelHandle> handles;
+    selection.get_handles(document, &handles);
+    std::set<uint32_t> indexes;
+    for(const LevelHandle handle : handles) {
+        indexes.insert(handle.index);
+    }
+    return indexes;
+}
+
+static bool SelectionTest_IsSelectable(const LevelDocument& document, uint32_t row) {
+    return !(document.flags[row] & (LevelEntityFlags_Hidden | LevelEntityFlags_Locked));
+}
+
+// Test a point against a polygon by the even-odd rule.
+static bool SelectionTest_IsInPolygon(const Vec2& point, const Vec2* polygon, uint32_t count) {
+    bool inside = false;
+    for(uint32_t i = 0, j = count - 1; i < count; j = i++) {
+        const Vec2& a = polygon[i];
+        const Vec2& b = polygon[j];
+        if((a.y > point.y) != (b.y > point.y)) {
+            const float x = a.x + (point.y - a.y) / (b.y - a.y) * (b.x - a.x);
+            inside = inside != (point.x < x);
+        }
+    }
+    return inside;
+}
+
+UNI_TEST(LevelSelection_CombinesSets) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 1000, 20);
+    std::mt19937 random(21);
+    LevelSelection a;
+    LevelSelection b;
+    std::set<uint32_t> set_a;
+    std::set<uint32_t> set_b;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        const LevelHandle handle = document.get_handle(row);
+        if(random() % 3 == 0) {
+            a.add(handle);
+            set_a.insert(handle.index);
+        }
+        if(random() % 2 == 0) {
+            b.add(handle);
+            set_b.insert(handle.index);
+        }
+    }
+    UNI_CHECK(a.count() == set_a.size());
+    UNI_CHECK(SelectionTest_GetIndexes(document, a) == set_a);
+    const LevelHandle removed = document.get_handle(*set_a.begin());
+    a.remove(removed);
+    set_a.erase(removed.index);
+    UNI_CHECK(!a.contains(removed));
+    std::set<uint32_t> expected;
+    LevelSelection united = LevelSelection(a);
+    united.unite(b);
+    std::set_union(set_a.begin(), set_a.end(), set_b.begin(), set_b.end(), std::inserter(expected, expected.end()));
+    UNI_CHECK(SelectionTest_GetIndexes(document, united) == expected);
+    expected.clear();
+    LevelSelection intersected = LevelSelection(a);
+    intersected.intersect(b);
+    std::set_intersection(set_a.begin(), set_a.end(), set_b.begin(), set_b.end(), std::inserter(expected, expected.end()));
+    UNI_CHECK(SelectionTest_GetIndexes(document, intersected) == expected);
+    expected.clear();
+    LevelSelection subtracted = LevelSelection(a);
+    subtracted.subtract(b);
+    std::set_difference(set_a.begin(), set_a.end(), set_b.begin(), set_b.end(), std::inserter(expected, expected.end()));
+    UNI_CHECK(SelectionTest_GetIndexes(document, subtracted) == expected);
+    // Selections of different sizes combine too
+    LevelSelection small;
+    small.add(document.get_handle(0));
+    small.unite(a);
+    UNI_CHECK(small.count() == set_a.size() + (set_a.count(document.get_handle(0).index) ? 0 : 1));
+    small.clear();
+    UNI_CHECK(small.empty() && small.count() == 0);
+}
+
+UNI_TEST(LevelSelection_SelectsAllAndInverts) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 3000, 22);
+    uint32_t selectable_count = 0;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        selectable_count += SelectionTest_IsSelectable(document, row) ? 1 : 0;
+    }
+    LevelSelection selection;
+    selection.select_all(document, &jobs);
+    UNI_CHECK(selection.count() == selectable_count);
+    selection.invert(document, &jobs);
+    UNI_CHECK(selection.empty());
+    selection.add(document.get_handle(0));
+    selection.invert(document, nullptr);
+    UNI_CHECK(selection.count() == selectable_count - 1);
+    UNI_CHECK(!selection.contains(document.get_handle(0)));
+    // Destroyed entities are removed once reported
+    std::vector<LevelHandle> destroyed;
+    for(uint32_t i = 0; i < 10; ++i) {
+        destroyed.push_back(document.get_handle(i * 5 + 1));
+    }
+    uint32_t destroyed_selected = 0;
+    for(const LevelHandle handle : destroyed) {
+        destroyed_selected += selection.contains(handle) ? 1 : 0;
+        document.destroy(handle);
+    }
+    selection.remove_invalid(document, destroyed.data(), (uint32_t) destroyed.size());
+    UNI_CHECK(selection.count() == selectable_count - 1 - destroyed_selected);
+    selection.remove_invalid(document, nullptr, 0);
+    UNI_CHECK(selection.empty());
+    jobs.conclude();
+}
+
+UNI_TEST(LevelSelection_BoxAndLassoMatchBruteForce) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 5000, 23);
+    LevelBvh bvh = LevelBvh(&jobs);
+    bvh.build(document);
+    LevelSelectView view;
+    view.position = Vec3{0.0f, 10.0f, 90.0f};
+    view.forward = Vec3{0.0f, -0.1f, -1.0f};
+    view.width = 1280.0f;
+    view.height = 720.0f;
+    const Vec2 boxes[][2] = {
+        {Vec2{600.0f, 300.0f}, Vec2{700.0f, 400.0f}},
+        {Vec2{0.0f, 0.0f}, Vec2{1280.0f, 720.0f}},
+        {Vec2{100.0f, 500.0f}, Vec2{900.0f, 700.0f}},
+    };
+    for(const auto& box : boxes) {
+        LevelSelection selection;
+        selection.select_box(document, bvh, view, box[0], box[1], &jobs);
+        std::set<uint32_t> expected;
+        for(uint32_t row = 0; row < document.get_count(); ++row) {
+            Vec2 pixel;
+            if(
+                SelectionTest_IsSelectable(document, row) &&
+                view.project(document.get_bounds(row).get_center(), &pixel) &&
+                pixel.x >= box[0].x && pixel.x <= box[1].x &&
+                pixel.y >= box[0].y && pixel.y <= box[1].y
+            ) {
+                expected.insert(document.get_handle(row).index);
+            }
+        }
+        UNI_CHECK(!expected.empty());
+        UNI_CHECK(SelectionTest_GetIndexes(document, selection) == expected);
+    }
+    // A star, whose crossing edges leave a hole in the middle
+    Vec2 star[5];
+    for(int i = 0; i < 5; ++i) {
+        const float angle = (float) (i * 2 % 5) * 1.2566371f;
+        star[i] = Vec2{640.0f + 300.0f * std::sin(angle), 360.0f - 300.0f * std::cos(angle)};
+    }
+    // The lasso is filled at the centers of the pixels it covers
+    LevelSelection selection;
+    selection.select_lasso(document, bvh, view, star, 5, &jobs);
+    std::set<uint32_t> expected;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        Vec2 pixel;
+        if(
+            SelectionTest_IsSelectable(document, row) &&
+            view.project(document.get_bounds(row).get_center(), &pixel) &&
+            SelectionTest_IsInPolygon(
+                Vec2{std::floor(pixel.x) + 0.5f, std::floor(pixel.y) + 0.5f}, star, 5
+            )
+        ) {
+            expected.insert(document.get_handle(row).index);
+        }
+    }
+    UNI_CHECK(!expected.empty());
+    UNI_CHECK(SelectionTest_GetIndexes(document, selection) == expected);
+    jobs.conclude();
+}
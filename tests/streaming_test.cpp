@@ -0,0 +1,172 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "jobs/job_system.hpp"
+#include "level/level_file.hpp"
+#include "level/streaming.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+// Width of the sectors the fixture level is split into. The level
+// spans four sectors on each axis, from -2 to 1.
+const float StreamingTest_SectorSize = 25.0f;
+
+// Split a fixture level into sector files in a fresh directory.
+static std::string StreamingTest_Split(const LevelDocument& document, const char* name) {
+    const std::string directory = Test_GetTempPath(name);
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    LevelStreamer_SplitDocument(document, directory.c_str(), StreamingTest_SectorSize);
+    return directory;
+}
+
+// Get the middle of a sector, where the camera is put.
+static Vec3 StreamingTest_GetCenter(LevelSectorCoord coord) {
+    return Vec3{
+        ((float) coord.x + 0.5f) * StreamingTest_SectorSize,
+        0.0f,
+        ((float) coord.z + 0.5f) * StreamingTest_SectorSize
+    };
+}
+
+// Update the streamer with the camera held still until no loads
+// or unloads are left in flight. Returns false on timeout.
+static bool StreamingTest_Settle(JobSystem* jobs, LevelStreamer* streamer, const Vec3& camera) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    do {
+        jobs->update();
+        streamer->update(camera, Vec3{});
+        if(streamer->get_job_count() == 0) {
+            // Nothing was started by this update either
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while(std::chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+// Count the entities of a document in a sector, by the center of
+// their bounds, as LevelStreamer_SplitDocument assigns them.
+static uint32_t StreamingTest_CountInSector(const LevelDocument& document, LevelSectorCoord coord) {
+    LevelStreamer streamer;
+    streamer.sector_size = StreamingTest_SectorSize;
+    uint32_t count = 0;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        const Vec3 center = Vec3{document.bounds_center_x[row], 0.0f, document.bounds_center_z[row]};
+        count += streamer.get_coord(center) == coord ? 1 : 0;
+    }
+    return count;
+}
+
+UNI_TEST(LevelStreamer_LoadsSectorsInRange) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 40);
+    LevelStreamer streamer = LevelStreamer(&jobs);
+    streamer.sector_size = StreamingTest_SectorSize;
+    streamer.load_distance = 10.0f;
+    UNI_CHECK(streamer.open(StreamingTest_Split(document, "streaming_range")));
+    UNI_CHECK(streamer.get_sector_count() == 16);
+    // Neighbors are half a sector from the middle, out of range
+    const LevelSectorCoord coord = LevelSectorCoord{0, 0};
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(coord)));
+    UNI_CHECK(streamer.get_resident_count() == 1);
+    const LevelDocument* sector = streamer.get_document(coord);
+    if(!UNI_CHECK(sector != nullptr)) {
+        jobs.conclude();
+        return;
+    }
+    UNI_CHECK(sector->get_count() == StreamingTest_CountInSector(document, coord));
+    UNI_CHECK(streamer.get_document(LevelSectorCoord{1, 0}) == nullptr);
+    // Every sector in range, and every entity in some sector
+    streamer.load_distance = 100.0f;
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(coord)));
+    UNI_CHECK(streamer.get_resident_count() == 16);
+    uint32_t count = 0;
+    for(int z = -2; z < 2; ++z) {
+        for(int x = -2; x < 2; ++x) {
+            const LevelDocument* resident = streamer.get_document(LevelSectorCoord{x, z});
+            count += resident ? resident->get_count() : 0;
+        }
+    }
+    UNI_CHECK(count == document.get_count());
+    streamer.close();
+    jobs.conclude();
+}
+
+UNI_TEST(LevelStreamer_EvictsFarthestToStayInBudget) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 41);
+    LevelStreamer streamer = LevelStreamer(&jobs);
+    streamer.sector_size = StreamingTest_SectorSize;
+    streamer.load_distance = 100.0f;
+    const std::string directory = StreamingTest_Split(document, "streaming_budget");
+    UNI_CHECK(streamer.open(directory));
+    // Measure the largest sector, and allow room for two
+    const LevelSectorCoord first = LevelSectorCoord{-2, -2};
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(first)));
+    uint64_t largest = 0;
+    for(int z = -2; z < 2; ++z) {
+        for(int x = -2; x < 2; ++x) {
+            const LevelDocument* resident = streamer.get_document(LevelSectorCoord{x, z});
+            largest = std::max<uint64_t>(largest, resident ? resident->get_memory_bytes() : 0);
+        }
+    }
+    streamer.close();
+    UNI_CHECK(largest > 0);
+    streamer.memory_budget_bytes = largest * 5 / 2;
+    UNI_CHECK(streamer.open(directory));
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(first)));
+    UNI_CHECK(streamer.get_resident_bytes() <= streamer.memory_budget_bytes);
+    UNI_CHECK(streamer.get_resident_count() >= 1 && streamer.get_resident_count() < 16);
+    UNI_CHECK(streamer.get_document(first) != nullptr);
+    // Sectors near the camera's new place push out the old ones
+    const LevelSectorCoord last = LevelSectorCoord{1, 1};
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(last)));
+    UNI_CHECK(streamer.get_resident_bytes() <= streamer.memory_budget_bytes);
+    UNI_CHECK(streamer.get_document(last) != nullptr);
+    UNI_CHECK(streamer.get_document(first) == nullptr);
+    streamer.close();
+    jobs.conclude();
+}
+
+UNI_TEST(LevelStreamer_SavesDirtySectorsItEvicts) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 500, 42);
+    LevelStreamer streamer = LevelStreamer(&jobs);
+    streamer.sector_size = StreamingTest_SectorSize;
+    streamer.load_distance = 10.0f;
+    // Only the sector being loaded fits
+    streamer.memory_budget_bytes = 1;
+    UNI_CHECK(streamer.open(StreamingTest_Split(document, "streaming_dirty")));
+    const LevelSectorCoord coord = LevelSectorCoord{0, 0};
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(coord)));
+    LevelDocument* sector = streamer.get_document(coord);
+    if(!UNI_CHECK(sector != nullptr && sector->get_count() > 0)) {
+        jobs.conclude();
+        return;
+    }
+    const Vec3 moved = Vec3{1.0f, 2.0f, 3.0f};
+    sector->set_position(0, moved);
+    streamer.mark_dirty(coord);
+    const LevelSectorCoord other = LevelSectorCoord{-2, -2};
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(other)));
+    UNI_CHECK(streamer.get_document(coord) == nullptr);
+    UNI_CHECK(streamer.get_document(other) != nullptr);
+    LevelDocument saved;
+    UNI_CHECK(LevelFile_Open(&saved, streamer.get_sector_path(coord).c_str()));
+    UNI_CHECK(saved.get_count() > 0 && saved.positions[0] == moved);
+    // Loading it again brings back the change
+    UNI_CHECK(StreamingTest_Settle(&jobs, &streamer, StreamingTest_GetCenter(coord)));
+    sector = streamer.get_document(coord);
+    UNI_CHECK(sector != nullptr && sector->positions[0] == moved);
+    streamer.close();
+    jobs.conclude();
+}
@@ -0,0 +1,52 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test.hpp"
+#include "util/symbol.hpp"
+
+UNI_TEST(Symbol_InternsEqualTextOnce) {
+    const Symbol a = Symbol("Symbol test");
+    const Symbol b = Symbol(std::string("Symbol test"));
+    const Symbol c = Symbol_Intern(std::string_view("Symbol test, but longer").substr(0, 11));
+    const Symbol other = Symbol("Other symbol test");
+    UNI_CHECK(a == b);
+    UNI_CHECK(a == c);
+    UNI_CHECK(a != other);
+    UNI_CHECK(a.view() == "Symbol test");
+    UNI_CHECK(a.size() == 11);
+    // Views are null-terminated, even for a substring interned
+    UNI_CHECK(c.c_str()[c.size()] == '\0');
+    UNI_CHECK(Symbol("").empty());
+    UNI_CHECK(Symbol("") == Symbol_None);
+    UNI_CHECK(Symbol_None.view().empty());
+}
+
+UNI_TEST(Symbol_InternsFromThreadsAfterFreezing) {
+    const Symbol before = Symbol("Interned before freezing");
+    Symbol_Freeze();
+    UNI_CHECK(Symbol("Interned before freezing") == before);
+    // Threads racing to intern the same new names must agree
+    const int name_count = 200;
+    std::vector<Symbol> results[4];
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&results, t]() {
+            for(int i = 0; i < name_count; ++i) {
+                results[t].push_back(Symbol("Interned after freezing " + std::to_string(i)));
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    bool agree = true;
+    for(int i = 0; i < name_count; ++i) {
+        const std::string text = "Interned after freezing " + std::to_string(i);
+        for(int t = 0; t < 4; ++t) {
+            agree = agree && results[t][i] == results[0][i] && results[t][i].view() == text;
+        }
+    }
+    UNI_CHECK(agree);
+    UNI_CHECK(results[0][0] != results[0][1]);
+}
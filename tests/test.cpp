@@ -0,0 +1,78 @@
+#include "test.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "util/log.hpp"
+
+struct TestCase {
+    const char* name;
+    TestFunction function;
+};
+
+// Function-local, since tests register from static initializers
+// in other files
+static std::vector<TestCase>& Test_GetCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+static uint32_t test_check_count = 0;
+static uint32_t test_failure_count = 0;
+
+bool Test_Register(const char* name, TestFunction function) {
+    Test_GetCases().push_back(TestCase{name, function});
+    return true;
+}
+
+bool Test_Check(bool passed, const char* expression, const char* file, int line) {
+    test_check_count++;
+    if(!passed) {
+        test_failure_count++;
+        std::printf("  %s:%d: check failed: %s\n", file, line, expression);
+    }
+    return passed;
+}
+
+std::string Test_GetTempPath(const char* name) {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "unilevel_tests";
+    std::filesystem::create_directories(directory);
+    return (directory / name).string();
+}
+
+// Run every test, or those whose names contain any argument.
+int main(int argc, char** argv) {
+    Log_Init();
+    // Tests provoke errors on purpose, which needn't be shown.
+    // Messages still reach the log history.
+    spdlog::set_level(spdlog::level::off);
+    uint32_t run_count = 0;
+    uint32_t failed_count = 0;
+    for(const TestCase& test : Test_GetCases()) {
+        bool selected = argc < 2;
+        for(int i = 1; i < argc && !selected; ++i) {
+            selected = std::strstr(test.name, argv[i]) != nullptr;
+        }
+        if(!selected) {
+            continue;
+        }
+        std::printf("%s\n", test.name);
+        std::fflush(stdout);
+        const uint32_t failures_before = test_failure_count;
+        test.function();
+        run_count++;
+        if(test_failure_count != failures_before) {
+            failed_count++;
+        }
+    }
+    std::printf(
+        "Ran %u tests with %u checks: %u tests failed.\n",
+        run_count, test_check_count, failed_count
+    );
+    Log_Conclude();
+    return failed_count == 0 ? 0 : 1;
+}
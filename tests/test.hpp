@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Minimal test runner for the unilevel_tests program, built with
+ * `scons tests`.
+ * 
+ * Each test is a function declared with UNI_TEST, which registers
+ * it before main runs. Tests check conditions with UNI_CHECK, which
+ * reports a failure and carries on, so one run lists every failing
+ * check. Tests only use code which doesn't need a window.
+ */
+
+typedef void (*TestFunction)();
+
+// Add a test to the list run by main. Use UNI_TEST instead.
+bool Test_Register(const char* name, TestFunction function);
+// Count a check, and report it if it failed. Returns whether it
+// passed, so that tests can stop before using a bad result.
+bool Test_Check(bool passed, const char* expression, const char* file, int line);
+// Get the path of a scratch file in a directory for test output,
+// which is created if needed.
+std::string Test_GetTempPath(const char* name);
+
+#define UNI_TEST(name) \
+    static void Test_##name(); \
+    static const bool Test_##name##_Registered = Test_Register(#name, Test_##name); \
+    static void Test_##name()
+
+#define UNI_CHECK(condition) Test_Check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,174 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "assets/thumbnail.hpp"
+#include "jobs/job_system.hpp"
+#include "level/mesh.hpp"
+#include "test.hpp"
+
+static const size_t ThumbnailTest_ByteCount = (size_t) AssetThumbnail_Size * AssetThumbnail_Size * 4;
+
+static const uint8_t* ThumbnailTest_GetPixel(const std::vector<uint8_t>& rgba, uint32_t x, uint32_t y) {
+    return &rgba[((size_t) y * AssetThumbnail_Size + x) * 4];
+}
+
+static uint8_t ThumbnailTest_GetAlpha(const std::vector<uint8_t>& rgba, uint32_t x, uint32_t y) {
+    return ThumbnailTest_GetPixel(rgba, x, y)[3];
+}
+
+// Get a fresh directory to cache thumbnails in.
+static std::string ThumbnailTest_GetDirectory(const char* name) {
+    const std::string directory = Test_GetTempPath(name);
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    return directory;
+}
+
+UNI_TEST(AssetThumbnail_RendersMeshInsideFrame) {
+    const LevelMesh cube = LevelMesh_CreateCube(Symbol("Cube"));
+    const AssetThumbnailSource source = AssetThumbnailSource_FromMesh(1, cube);
+    std::vector<uint8_t> rgba(ThumbnailTest_ByteCount, 0xcd);
+    AssetThumbnail_Render(source, rgba.data());
+    const uint32_t last = AssetThumbnail_Size - 1;
+    const uint32_t middle = AssetThumbnail_Size / 2;
+    UNI_CHECK(ThumbnailTest_GetAlpha(rgba, middle, middle) == 255);
+    UNI_CHECK(ThumbnailTest_GetAlpha(rgba, 0, 0) == 0);
+    UNI_CHECK(ThumbnailTest_GetAlpha(rgba, last, 0) == 0);
+    UNI_CHECK(ThumbnailTest_GetAlpha(rgba, 0, last) == 0);
+    UNI_CHECK(ThumbnailTest_GetAlpha(rgba, last, last) == 0);
+    // The cube is fitted to the frame, without touching its edges
+    uint32_t covered_count = 0;
+    bool edges_clear = true;
+    for(uint32_t y = 0; y < AssetThumbnail_Size; ++y) {
+        for(uint32_t x = 0; x < AssetThumbnail_Size; ++x) {
+            const uint8_t alpha = ThumbnailTest_GetAlpha(rgba, x, y);
+            covered_count += alpha > 0 ? 1 : 0;
+            if(x == 0 || y == 0 || x == last || y == last) {
+                edges_clear = edges_clear && alpha == 0;
+            }
+        }
+    }
+    UNI_CHECK(edges_clear);
+    UNI_CHECK(covered_count > AssetThumbnail_Size * AssetThumbnail_Size / 4);
+    // Three faces are seen, each lit differently
+    const uint32_t lower = AssetThumbnail_Size * 3 / 5;
+    const uint8_t* top = ThumbnailTest_GetPixel(rgba, middle, AssetThumbnail_Size / 5);
+    const uint8_t* left = ThumbnailTest_GetPixel(rgba, AssetThumbnail_Size / 4, lower);
+    const uint8_t* right = ThumbnailTest_GetPixel(rgba, AssetThumbnail_Size * 3 / 4, lower);
+    UNI_CHECK(top[3] == 255 && left[3] == 255 && right[3] == 255);
+    UNI_CHECK(std::memcmp(top, left, 3) != 0 && std::memcmp(left, right, 3) != 0);
+    // Drawing the same mesh again gives the same pixels
+    std::vector<uint8_t> again(ThumbnailTest_ByteCount, 0);
+    AssetThumbnail_Render(source, again.data());
+    UNI_CHECK(again == rgba);
+    // An empty mesh leaves every pixel transparent
+    AssetThumbnailSource empty;
+    AssetThumbnail_Render(empty, again.data());
+    UNI_CHECK(again == std::vector<uint8_t>(ThumbnailTest_ByteCount, 0));
+}
+
+UNI_TEST(AssetThumbnail_KeysFollowMeshContents) {
+    LevelMesh cube = LevelMesh_CreateCube(Symbol("Cube"));
+    const LevelMesh copy = LevelMesh_CreateCube(Symbol("Other Cube"));
+    const uint64_t key = AssetThumbnail_GetKey(AssetThumbnailSource_FromMesh(1, cube));
+    UNI_CHECK(AssetThumbnail_GetKey(AssetThumbnailSource_FromMesh(2, copy)) == key);
+    cube.positions[0].x += 0.25f;
+    UNI_CHECK(AssetThumbnail_GetKey(AssetThumbnailSource_FromMesh(1, cube)) != key);
+}
+
+UNI_TEST(AssetThumbnail_CacheRejectsDamagedFiles) {
+    const std::string directory = ThumbnailTest_GetDirectory("thumbnail_cache");
+    const LevelMesh cube = LevelMesh_CreateCube(Symbol("Cube"));
+    const AssetThumbnailSource source = AssetThumbnailSource_FromMesh(1, cube);
+    const uint64_t key = AssetThumbnail_GetKey(source);
+    std::vector<uint8_t> rgba(ThumbnailTest_ByteCount);
+    AssetThumbnail_Render(source, rgba.data());
+    std::vector<uint8_t> loaded(ThumbnailTest_ByteCount, 0);
+    UNI_CHECK(!AssetThumbnail_Load(directory, key, loaded.data()));
+    UNI_CHECK(AssetThumbnail_Save(directory, key, rgba.data()));
+    UNI_CHECK(AssetThumbnail_Load(directory, key, loaded.data()));
+    UNI_CHECK(loaded == rgba);
+    // Run length encoding keeps the mostly transparent image small
+    const std::string path = AssetThumbnail_GetPath(directory, key);
+    const uintmax_t file_size = std::filesystem::file_size(path);
+    UNI_CHECK(file_size < ThumbnailTest_ByteCount / 2);
+    // A file under another key's name is out of date
+    std::filesystem::copy_file(path, AssetThumbnail_GetPath(directory, key + 1));
+    UNI_CHECK(!AssetThumbnail_Load(directory, key + 1, loaded.data()));
+    // A cut short file is damaged, and the pixels are left alone
+    std::fill(loaded.begin(), loaded.end(), 0x5a);
+    std::filesystem::resize_file(path, file_size - 3);
+    UNI_CHECK(!AssetThumbnail_Load(directory, key, loaded.data()));
+    UNI_CHECK(loaded == std::vector<uint8_t>(ThumbnailTest_ByteCount, 0x5a));
+    // As is one with an overwritten header
+    UNI_CHECK(AssetThumbnail_Save(directory, key, rgba.data()));
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    UNI_CHECK(file != nullptr);
+    if(file) {
+        std::fputc('X', file);
+        std::fclose(file);
+    }
+    UNI_CHECK(!AssetThumbnail_Load(directory, key, loaded.data()));
+}
+
+UNI_TEST(AssetThumbnailer_DrawsInBackgroundAndReusesCache) {
+    const std::string directory = ThumbnailTest_GetDirectory("thumbnailer_cache");
+    JobSystem jobs;
+    jobs.init(2);
+    const LevelMesh cube = LevelMesh_CreateCube(Symbol("Cube"));
+    const AssetThumbnailSource source = AssetThumbnailSource_FromMesh(7, cube);
+    std::vector<uint8_t> expected(ThumbnailTest_ByteCount);
+    AssetThumbnail_Render(source, expected.data());
+    const auto generate = [&jobs, &directory, &source](AssetThumbnail* thumbnail) {
+        AssetThumbnailer thumbnailer(&jobs);
+        thumbnailer.cache_directory = directory;
+        thumbnailer.request(source);
+        // Asking twice before it's drawn makes one thumbnail
+        thumbnailer.request(source);
+        uint32_t ready_count = 0;
+        for(int frame = 0; frame < 10000 && ready_count == 0; ++frame) {
+            jobs.update();
+            thumbnailer.update();
+            while(thumbnailer.pop_ready(thumbnail)) {
+                ready_count++;
+            }
+            if(ready_count == 0) {
+                std::this_thread::yield();
+            }
+        }
+        for(int frame = 0; frame < 10; ++frame) {
+            jobs.update();
+            thumbnailer.update();
+            AssetThumbnail extra;
+            while(thumbnailer.pop_ready(&extra)) {
+                ready_count++;
+            }
+        }
+        return ready_count;
+    };
+    AssetThumbnail thumbnail;
+    UNI_CHECK(generate(&thumbnail) == 1);
+    UNI_CHECK(thumbnail.id == 7 && thumbnail.key == AssetThumbnail_GetKey(source));
+    UNI_CHECK(thumbnail.pixels == expected);
+    UNI_CHECK(std::filesystem::exists(AssetThumbnail_GetPath(directory, thumbnail.key)));
+    // A cached thumbnail is loaded rather than drawn again
+    std::vector<uint8_t> marked(ThumbnailTest_ByteCount, 0x11);
+    UNI_CHECK(AssetThumbnail_Save(directory, thumbnail.key, marked.data()));
+    UNI_CHECK(generate(&thumbnail) == 1);
+    UNI_CHECK(thumbnail.pixels == marked);
+    // Generating everything up front replaces damaged files
+    std::filesystem::resize_file(AssetThumbnail_GetPath(directory, thumbnail.key), 8);
+    AssetThumbnailer thumbnailer(&jobs);
+    thumbnailer.cache_directory = directory;
+    const LevelMesh other = LevelMesh_CreateCube(Symbol("Other Cube"));
+    std::vector<AssetThumbnailSource> sources = {source, AssetThumbnailSource_FromMesh(8, other)};
+    UNI_CHECK(thumbnailer.generate_all(sources) == 0);
+    std::vector<uint8_t> loaded(ThumbnailTest_ByteCount);
+    UNI_CHECK(AssetThumbnail_Load(directory, thumbnail.key, loaded.data()));
+    UNI_CHECK(loaded == expected);
+    jobs.conclude();
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "jobs/job_system.hpp"
+#include "level/vertex_hash.hpp"
+#include "level_fixture.hpp"
+#include "test.hpp"
+
+struct VertexHashTestPoint {
+    Vec3 position;
+    LevelHandle handle;
+};
+
+// Get the world-space vertexes of every visible entity, each
+// distinct position of a mesh once per entity.
+static std::vector<VertexHashTestPoint> VertexHashTest_GetPoints(const LevelDocument& document) {
+    std::vector<VertexHashTestPoint> points;
+    for(uint32_t row = 0; row < document.get_count(); ++row) {
+        if(document.flags[row] & LevelEntityFlags_Hidden) {
+            continue;
+        }
+        const LevelHandle handle = document.get_handle(row);
+        const LevelMesh* mesh = document.get_mesh(document.meshes[row]);
+        if(!mesh) {
+            points.push_back(VertexHashTestPoint{document.positions[row], handle});
+            continue;
+        }
+        std::vector<Vec3> distinct;
+        for(const Vec3& vertex : mesh->positions) {
+            if(std::find(distinct.begin(), distinct.end(), vertex) == distinct.end()) {
+                distinct.push_back(vertex);
+            }
+        }
+        for(const Vec3& vertex : distinct) {
+            const Vec3 position = document.positions[row] + Quat_Rotate(
+                document.rotations[row], vertex * document.scales[row]
+            );
+            points.push_back(VertexHashTestPoint{position, handle});
+        }
+    }
+    return points;
+}
+
+// Run random queries against the hash and by brute force, and
+// count those whose results differ.
+static uint32_t VertexHashTest_CountMismatches(
+    const LevelDocument& document,
+    const LevelVertexHash& hash,
+    uint32_t seed
+) {
+    const std::vector<VertexHashTestPoint> points = VertexHashTest_GetPoints(document);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> radii(0.5f, 5.0f);
+    uint32_t mismatch_count = 0;
+    std::vector<LevelVertexHit> hits;
+    std::vector<float> expected;
+    for(int i = 0; i < 200; ++i) {
+        Vec3 center = LevelFixture_RandomPoint(random, 110.0f);
+        if(i % 2 == 0) {
+            center = points[random() % points.size()].position + LevelFixture_RandomPoint(random, 1.0f);
+        }
+        const float radius = radii(random);
+        const LevelHandle ignore = i % 3 == 0 ? points[random() % points.size()].handle : LevelHandle_None;
+        expected.clear();
+        for(const VertexHashTestPoint& point : points) {
+            const Vec3 offset = point.position - center;
+            const float distance_squared = Vec3_Dot(offset, offset);
+            if(point.handle != ignore) {
+                expected.push_back(distance_squared);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        // Radius queries
+        hits.clear();
+        const uint32_t found = hash.find_in_radius(center, radius, &hits, ignore);
+        const size_t expected_count = std::upper_bound(
+            expected.begin(), expected.end(), radius * radius
+        ) - expected.begin();
+        std::sort(hits.begin(), hits.end(), [](const LevelVertexHit& a, const LevelVertexHit& b) {
+            return a.distance_squared < b.distance_squared;
+        });
+        bool same = found == expected_count && hits.size() == expected_count;
+        for(size_t j = 0; same && j < expected_count; ++j) {
+            same = std::fabs(hits[j].distance_squared - expected[j]) < 1e-3f && hits[j].handle != ignore;
+        }
+        // Nearest queries
+        LevelVertexHit nearest[8];
+        const uint32_t nearest_count = hash.find_nearest(center, 8, radius, nearest, ignore);
+        same = same && nearest_count == std::min<size_t>(8, expected_count);
+        for(uint32_t j = 0; same && j < nearest_count; ++j) {
+            same = std::fabs(nearest[j].distance_squared - expected[j]) < 1e-3f && nearest[j].handle != ignore;
+        }
+        mismatch_count += same ? 0 : 1;
+    }
+    return mismatch_count;
+}
+
+UNI_TEST(LevelVertexHash_QueriesMatchBruteForce) {
+    JobSystem jobs;
+    jobs.init(2);
+    LevelDocument document;
+    LevelFixture_Fill(&document, 2000, 17);
+    // Entities without a mesh count as one vertex
+    for(uint32_t row = 0; row < 100; ++row) {
+        document.set_mesh(row, LevelMeshId_None);
+    }
+    LevelVertexHash hash = LevelVertexHash(&jobs);
+    hash.cell_size = 2.0f;
+    hash.update(document);
+    UNI_CHECK(hash.get_point_count() == VertexHashTest_GetPoints(document).size());
+    UNI_CHECK(VertexHashTest_CountMismatches(document, hash, 1) == 0);
+    jobs.conclude();
+}
+
+UNI_TEST(LevelVertexHash_FollowsChangedEntities) {
+    LevelDocument document;
+    LevelFixture_Fill(&document, 1000, 18);
+    LevelVertexHash hash;
+    hash.update(document);
+    std::mt19937 random(19);
+    std::vector<LevelHandle> changed;
+    for(uint32_t i = 0; i < 100; ++i) {
+        const uint32_t row = random() % document.get_count();
+        document.set_position(row, LevelFixture_RandomPoint(random, 100.0f));
+        document.set_flags(row, document.flags[row] ^ LevelEntityFlags_Hidden);
+        changed.push_back(document.get_handle(row));
+    }
+    for(uint32_t i = 0; i < 100; ++i) {
+        const LevelHandle handle = document.get_handle(random() % document.get_count());
+        document.destroy(handle);
+        changed.push_back(handle);
+    }
+    for(uint32_t i = 0; i < 100; ++i) {
+        LevelEntityDesc desc;
+        desc.position = LevelFixture_RandomPoint(random, 100.0f);
+        desc.mesh = 0;
+        changed.push_back(document.create(desc));
+    }
+    hash.mark_changed(changed.data(), (uint32_t) changed.size());
+    hash.update(document);
+    UNI_CHECK(hash.get_point_count() == VertexHashTest_GetPoints(document).size());
+    UNI_CHECK(VertexHashTest_CountMismatches(document, hash, 2) == 0);
+    // A new cell size rebuilds everything
+    hash.cell_size = 0.5f;
+    hash.update(document);
+    UNI_CHECK(VertexHashTest_CountMismatches(document, hash, 3) == 0);
+}